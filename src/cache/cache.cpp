@@ -0,0 +1,117 @@
+#include "cache/cache.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+std::string cacheDirectory()
+{
+	std::string root;
+	const char* xdgCacheHome = getenv("XDG_CACHE_HOME");
+	if (xdgCacheHome != NULL && xdgCacheHome[0] != '\0')
+	{
+		root = xdgCacheHome;
+	}
+	else
+	{
+		const char* home = getenv("HOME");
+		if (home == NULL || home[0] == '\0') return "";
+		root = std::string(home) + "/.cache";
+	}
+
+	const std::string directory = root + "/voxelToy";
+	mkdir(root.c_str(), 0755);
+	mkdir(directory.c_str(), 0755);
+
+	struct stat info;
+	if (stat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) return "";
+	return directory;
+}
+
+// Whether the file is being written (see writeProgramCache), or was left
+// behind by a write which was interrupted.
+inline bool isTemporary(const std::string& name)
+{
+	static const std::string suffix = ".tmp";
+	return name.size() >= suffix.size() &&
+		   name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Regular files in the cache directory whose name starts with the given
+// prefix, temporary ones included.
+static std::vector<CacheEntry> listCacheFiles(const std::string& prefix)
+{
+	std::vector<CacheEntry> entries;
+	const std::string directory = cacheDirectory();
+	if (directory.empty()) return entries;
+
+	DIR* dir = opendir(directory.c_str());
+	if (dir == NULL) return entries;
+	while (const dirent* file = readdir(dir))
+	{
+		CacheEntry entry;
+		entry.name = file->d_name;
+		if (entry.name.compare(0, prefix.size(), prefix) != 0) continue;
+		entry.path = directory + "/" + entry.name;
+
+		struct stat info;
+		if (stat(entry.path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) continue;
+		entry.size = info.st_size;
+		entry.lastUsed = info.st_mtime;
+		entries.push_back(entry);
+	}
+	closedir(dir);
+	return entries;
+}
+
+std::vector<CacheEntry> listCacheEntries(const std::string& prefix)
+{
+	std::vector<CacheEntry> files = listCacheFiles(prefix);
+	std::vector<CacheEntry> entries;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		if (!isTemporary(files[i].name)) entries.push_back(files[i]);
+	}
+	return entries;
+}
+
+void touchCacheEntry(const std::string& path)
+{
+	// access times aren't reliable (see the relatime mount option), the
+	// modification time is used instead.
+	utime(path.c_str(), NULL);
+}
+
+inline bool usedLater(const CacheEntry& a, const CacheEntry& b)
+{
+	return a.lastUsed > b.lastUsed;
+}
+
+// Temporary files older than this were left behind by interrupted writes,
+// rather than being written right now.
+static const time_t STALE_TEMPORARY_SECONDS = 60 * 60;
+
+void pruneCache(const std::string& prefix, boost::uint64_t maxSize)
+{
+	const std::vector<CacheEntry> files = listCacheFiles(prefix);
+	const time_t now = time(NULL);
+	std::vector<CacheEntry> entries;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		if (!isTemporary(files[i].name)) entries.push_back(files[i]);
+		else if (now - files[i].lastUsed > STALE_TEMPORARY_SECONDS) remove(files[i].path.c_str());
+	}
+	std::sort(entries.begin(), entries.end(), usedLater);
+
+	boost::uint64_t size = 0;
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		size += entries[i].size;
+		if (size > maxSize) remove(entries[i].path.c_str());
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <boost/cstdint.hpp>
+
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// Helpers to store data on disk, across runs of the application: e.g. the
+// preprocessed environment maps, program binaries and render checkpoints.
+
+// 64 bit FNV-1a hashing, which identifies the contents a file was generated
+// from. Values are hashed a 32 bit word at a time, rather than byte by byte,
+// which is good enough to tell contents apart and several times faster on
+// large buffers.
+static const boost::uint64_t HASH_SEED = 14695981039346656037ULL;
+
+inline boost::uint64_t hashCombine(boost::uint64_t hash, boost::uint32_t value)
+{
+	return (hash ^ value) * 1099511628211ULL;
+}
+
+// Hash a buffer of 32 bit values (ints or floats)
+inline boost::uint64_t hashWords(boost::uint64_t hash, const void* data, size_t numWords)
+{
+	const char* bytes = (const char*)data;
+	for (size_t i = 0; i < numWords; ++i)
+	{
+		boost::uint32_t word;
+		memcpy(&word, bytes + i * sizeof(word), sizeof(word));
+		hash = hashCombine(hash, word);
+	}
+	return hash;
+}
+
+inline boost::uint64_t hashString(boost::uint64_t hash, const std::string& s)
+{
+	for (size_t i = 0; i < s.size(); ++i)
+	{
+		hash = hashCombine(hash, (unsigned char)s[i]);
+	}
+	return hash;
+}
+
+// Directory where the application caches data, following the XDG base
+// directory specification ($XDG_CACHE_HOME/voxelToy, or ~/.cache/voxelToy).
+// It is created if needed; returns an empty string if that's not possible.
+std::string cacheDirectory();
+
+// File in the cache directory
+struct CacheEntry
+{
+	std::string path;
+	std::string name;
+	boost::uint64_t size;
+	// when it was last used (see touchCacheEntry)
+	time_t lastUsed;
+};
+
+// Entries of the cache directory whose name starts with the given prefix.
+// Files still being written, named <entry>.<pid>.tmp until they're renamed
+// to the entry, are left out.
+std::vector<CacheEntry> listCacheEntries(const std::string& prefix);
+
+// Mark an entry as used, so pruneCache keeps it over older ones.
+void touchCacheEntry(const std::string& path);
+
+// Remove the least recently used entries whose name starts with the given
+// prefix, until the rest take maxSize bytes at most. Temporary files left
+// behind by interrupted writes are removed too.
+void pruneCache(const std::string& prefix, boost::uint64_t maxSize);
@@ -22,6 +22,7 @@ void Camera::setFocalDistance(float distance)      { m_parameters.setFocalDistan
 void Camera::setFilmSize(float filmW, float filmH) { m_parameters.setFilmSize(filmW, filmH);     }
 void Camera::setLensRadius(float radius)           { m_parameters.setLensRadius(radius);         }
 void Camera::setFStop(float fstop)                 { m_parameters.setFStop(fstop);               }
+void Camera::setEyeTarget(const Imath::V3f& eye, const Imath::V3f& target) { m_parameters.setEyeTarget(eye, target); }
 
 void Camera::setCameraController(CameraControllerMode mode)
 {
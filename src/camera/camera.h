@@ -20,6 +20,8 @@ public:
 	void setFilmSize(float filmW, float filmH);
 	void setLensRadius(float radius);
 	void setFStop(float fstop);
+	// Set the camera direction explicitly from eye and target points.
+	void setEyeTarget(const Imath::V3f& eye, const Imath::V3f& target);
 
 	enum CameraControllerMode
 	{
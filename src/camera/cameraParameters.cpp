@@ -11,7 +11,8 @@ CameraParameters::CameraParameters() :
 	m_far(10000),
 	m_focalDistance(100),
 	m_lensRadius(0),
-	m_filmSize(36)
+	m_filmSize(36),
+	m_lensModel(CLM_PINHOLE)
 {
 	this->setFocalLength(50);
 }
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "voxel/voxelGrid.h"
+
+#include <OpenEXR/ImathVec.h>
+
+#include <algorithm>
+#include <math.h>
+
+// Port of the coordinate conversions in shared/coordinates.h and
+// shared/dda.h used by the CPU path tracer.
+//
+// Variable naming conventions:
+// ws = world space
+// vs = voxel space
+// ls = local (tangent) space, where the surface normal is +Y
+
+struct Basis
+{
+	Imath::V3f position;
+	Imath::V3f tangent;
+	Imath::V3f normal;
+	Imath::V3f binormal;
+
+	Imath::V3f localToWorld(const Imath::V3f& lsV) const
+	{
+		return lsV.x * tangent + lsV.y * normal + lsV.z * binormal;
+	}
+
+	Imath::V3f worldToLocal(const Imath::V3f& wsV) const
+	{
+		return Imath::V3f(wsV.dot(tangent), wsV.dot(normal), wsV.dot(binormal));
+	}
+};
+
+// Distance along the ray to the given box, or -1 if the ray misses it. Rays
+// starting inside the box return 0.
+inline float rayAABBIntersection(const Imath::V3f& o, const Imath::V3f& d,
+								 const Imath::V3f& boundsMin, const Imath::V3f& boundsMax)
+{
+	float tminf = -HUGE_VALF, tmaxf = HUGE_VALF;
+	for( int i = 0; i < 3; ++i )
+	{
+		// parallel to the slab: 1/d would be infinite and, for an origin on
+		// one of its planes, 0 * inf would turn the distances into NaNs.
+		if (d[i] == 0)
+		{
+			if (o[i] < boundsMin[i] || o[i] > boundsMax[i]) return -1;
+			continue;
+		}
+		const float invDir = 1.0f / d[i];
+		const float t0 = (boundsMin[i] - o[i]) * invDir;
+		const float t1 = (boundsMax[i] - o[i]) * invDir;
+		tminf = std::max(tminf, std::min(t0, t1));
+		tmaxf = std::min(tmaxf, std::max(t0, t1));
+	}
+
+	// the whole box is behind us, or the ray misses it
+	if (tmaxf < 0 || tminf > tmaxf) return -1;
+
+	return std::max(0.0f, tminf);
+}
+
+// Find the point where the ray hits the voxel vsP (its lower-left corner),
+// and the basis of the face it lies on.
+inline Basis voxelSpaceToWorldSpace(const VoxelGrid& grid,
+									const Imath::V3i& vsP,
+									const Imath::V3f& wsRayOrigin,
+									const Imath::V3f& wsRayDir)
+{
+	Basis wsHitBasis;
+	const Imath::V3f wsVoxelMin = grid.voxelToWorld(Imath::V3f(vsP));
+	const Imath::V3f wsVoxelMax = wsVoxelMin + Imath::V3f(grid.voxelSize());
+	const float voxelHitDistance = rayAABBIntersection(wsRayOrigin, wsRayDir, wsVoxelMin, wsVoxelMax);
+	wsHitBasis.position = wsRayOrigin + wsRayDir * std::max(0.0f, voxelHitDistance);
+
+	// the normal is the axis along which the hit point is furthest from the
+	// voxel center
+	const Imath::V3f centerToHit = wsHitBasis.position - (wsVoxelMin + Imath::V3f(grid.voxelSize() * 0.5f));
+	const Imath::V3f absCenterToHit(fabsf(centerToHit.x), fabsf(centerToHit.y), fabsf(centerToHit.z));
+	int axis = 0;
+	if (absCenterToHit.y > absCenterToHit[axis]) axis = 1;
+	if (absCenterToHit.z > absCenterToHit[axis]) axis = 2;
+	wsHitBasis.normal = Imath::V3f(0);
+	wsHitBasis.normal[axis] = centerToHit[axis] >= 0 ? 1.0f : -1.0f;
+
+	// since we're dealing with axis-aligned voxels, a diagonal unit vector is a
+	// safe choice for the cross product.
+	const Imath::V3f tangent = wsHitBasis.normal.cross(Imath::V3f(0.57735026919f));
+	wsHitBasis.binormal = tangent.cross(wsHitBasis.normal).normalized();
+	wsHitBasis.tangent = wsHitBasis.binormal.cross(wsHitBasis.normal).normalized();
+	return wsHitBasis;
+}
+
+// pole at +Y (theta = 0)
+inline Imath::V3f sphericalToCartesian(float phi, float cosTheta, float sinTheta)
+{
+	return Imath::V3f(sinTheta * cosf(phi), cosTheta, sinTheta * sinf(phi));
+}
+
+// Coordinates of a (normalized) direction in the latitude-longitude
+// environment map, which is rotated by the given angle around +Y.
+inline void uvCoordFromVector(const Imath::V3f& v, float rotation, float& u, float& t)
+{
+	const float theta = acosf(std::max(-1.0f, std::min(v.y, 1.0f)));
+	const float phi = atan2f(v.z, v.x) + (float)M_PI + rotation;
+	u = phi / (2.0f * (float)M_PI);
+	u -= floorf(u);
+	t = theta / (float)M_PI;
+}
+
+inline Imath::V3f directionFromUVCoord(float u, float v, float rotation)
+{
+	const float phi = u * 2.0f * (float)M_PI - (float)M_PI - rotation;
+	const float theta = v * (float)M_PI;
+	return sphericalToCartesian(phi, cosf(theta), sinf(theta));
+}
+
@@ -0,0 +1,352 @@
+#include "cpuRenderer/cpuPathTracer.h"
+#include "cpuRenderer/workStealingPool.h"
+#include "cpuRenderer/dda.h"
+#include "cpuRenderer/materials.h"
+#include "cpuRenderer/sampling.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <bitset>
+#include <float.h>
+#include <math.h>
+
+CpuPathTracer::CpuPathTracer(const CpuScene& scene,
+							 const CpuCamera& camera,
+							 const RenderSettings& settings) :
+	m_scene(scene),
+	m_camera(camera),
+	m_resolution(settings.m_imageResolution),
+	m_maxNumBounces(settings.m_pathtracerMaxNumBounces),
+	m_wireframeOpacity(settings.m_wireframeOpacity),
+	m_wireframeThickness(settings.m_wireframeThickness),
+	m_samplerRank1PixelDecorrelation(settings.m_samplerRank1PixelDecorrelation),
+	m_adaptiveSamplingThreshold(settings.m_adaptiveSamplingThreshold),
+	m_adaptiveSamplingMinSamples(settings.m_adaptiveSamplingMinSamples),
+	m_numberSamples(0),
+	m_accumulation((size_t)settings.m_imageResolution.x * settings.m_imageResolution.y * 4, 0.0f),
+	m_numUnconvergedTiles(-1)
+{
+	m_forward = (m_camera.target - m_camera.eye).normalized();
+	m_right = Imath::V3f(0,1,0).cross(m_forward).normalized();
+	m_up = m_forward.cross(m_right);
+	m_tanHalfFovY = tanf(m_camera.fovY / 2);
+
+	const int numTiles = ((m_resolution.x + TILE_SIZE - 1) / TILE_SIZE) *
+						 ((m_resolution.y + TILE_SIZE - 1) / TILE_SIZE);
+	m_tileConverged.assign(numTiles, false);
+	if (m_adaptiveSamplingThreshold > 0)
+	{
+		m_moments.assign((size_t)m_resolution.x * m_resolution.y, 0.0f);
+		m_numUnconvergedTiles = numTiles;
+	}
+}
+
+void CpuPathTracer::render(int numSamples, WorkStealingPool& pool)
+{
+	std::vector<WorkStealingPool::Task> tiles;
+	int tile = 0;
+	for( int y = 0; y < m_resolution.y; y += TILE_SIZE )
+	{
+		for( int x = 0; x < m_resolution.x; x += TILE_SIZE, ++tile )
+		{
+			if (m_tileConverged[tile]) continue;
+			tiles.push_back(boost::bind(&CpuPathTracer::renderTile, this,
+										x, y,
+										std::min(x + TILE_SIZE, m_resolution.x),
+										std::min(y + TILE_SIZE, m_resolution.y),
+										numSamples));
+		}
+	}
+	pool.run(tiles);
+	m_numberSamples += numSamples;
+
+	if (m_numUnconvergedTiles < 0 || m_numberSamples < m_adaptiveSamplingMinSamples) return;
+
+	// the test is cheap next to the samples, so it isn't worth spreading
+	tile = 0;
+	for( int y = 0; y < m_resolution.y; y += TILE_SIZE )
+	{
+		for( int x = 0; x < m_resolution.x; x += TILE_SIZE, ++tile )
+		{
+			if (m_tileConverged[tile] ||
+				!isTileConverged(x, y,
+								 std::min(x + TILE_SIZE, m_resolution.x),
+								 std::min(y + TILE_SIZE, m_resolution.y)))
+			{
+				continue;
+			}
+			m_tileConverged[tile] = true;
+			m_numUnconvergedTiles--;
+		}
+	}
+}
+
+bool CpuPathTracer::isTileConverged(int x0, int y0, int x1, int y1) const
+{
+	for( int y = y0; y < y1; ++y )
+	{
+		for( int x = x0; x < x1; ++x )
+		{
+			const size_t index = (size_t)y * m_resolution.x + x;
+			const float* pixel = &m_accumulation[index * 4];
+
+			const float n = std::max(pixel[3], 1.0f);
+			const float mean = luminance(Imath::V3f(pixel[0], pixel[1], pixel[2])) / n;
+			const float variance = std::max(0.0f, m_moments[index] / n - mean * mean);
+			// offset the mean so that dark pixels aren't required to reach an
+			// (imperceptible) tiny absolute error
+			const float relativeError = sqrtf(variance / n) / (mean + 0.01f);
+			if (pixel[3] < m_adaptiveSamplingMinSamples || relativeError > m_adaptiveSamplingThreshold) return false;
+		}
+	}
+	return true;
+}
+
+void CpuPathTracer::renderTile(int x0, int y0, int x1, int y1, int numSamples)
+{
+	// tiles don't overlap, so each pixel is only written by one thread
+	for( int y = y0; y < y1; ++y )
+	{
+		for( int x = x0; x < x1; ++x )
+		{
+			Imath::V3f radiance(0);
+			float luminanceSquared = 0;
+			for( int i = 0; i < numSamples; ++i )
+			{
+				Sampler sampler(x, y, m_numberSamples + i, m_samplerRank1PixelDecorrelation);
+				const Imath::V3f sample = samplePixel(x, y, sampler);
+				radiance += sample;
+				luminanceSquared += luminance(sample) * luminance(sample);
+			}
+
+			const size_t index = (size_t)y * m_resolution.x + x;
+			float* pixel = &m_accumulation[index * 4];
+			pixel[0] += radiance.x;
+			pixel[1] += radiance.y;
+			pixel[2] += radiance.z;
+			pixel[3] += numSamples;
+			if (!m_moments.empty()) m_moments[index] += luminanceSquared;
+		}
+	}
+}
+
+void CpuPathTracer::generateRay(int x, int y, Sampler& sampler,
+								Imath::V3f& wsRayOrigin, Imath::V3f& wsRayDir) const
+{
+	// see Renderer::updateCamera for the projections, and shared/generateRay.h
+	// for the ray generation
+	const float aspectRatio = (float)m_resolution.x / m_resolution.y;
+
+	if (m_camera.lensModel == CameraParameters::CLM_ORTHOGRAPHIC)
+	{
+		// rays go through the pixel centers, and draw no random numbers
+		const float ndcX = 2.0f * (x + 0.5f) / m_resolution.x - 1.0f;
+		const float ndcY = 2.0f * (y + 0.5f) / m_resolution.y - 1.0f;
+		const float halfWidth = m_tanHalfFovY * (m_camera.target - m_camera.eye).length();
+		const float halfHeight = halfWidth / aspectRatio;
+		wsRayOrigin = m_camera.eye + m_right * (ndcX * halfWidth) + m_up * (ndcY * halfHeight);
+		wsRayDir = m_forward;
+		return;
+	}
+
+	const Imath::V4f u = sampler.next();
+	if (m_camera.lensModel == CameraParameters::CLM_THIN_LENS)
+	{
+		// The sample through the center of the lens (the pinhole one) gives
+		// the point on the focal plane where all the rays from this film
+		// sample converge.
+		const float ndcX = 2.0f * (x + u[2]) / m_resolution.x - 1.0f;
+		const float ndcY = 2.0f * (y + u[3]) / m_resolution.y - 1.0f;
+		const Imath::V3f pinholeDir = (m_forward +
+									   m_right * (ndcX * aspectRatio * m_tanHalfFovY) +
+									   m_up * (ndcY * m_tanHalfFovY)).normalized();
+		const Imath::V3f wsFocalPlanePoint = m_camera.eye +
+											 pinholeDir * (m_camera.focalDistance / pinholeDir.dot(m_forward));
+
+		float lensX, lensY;
+		uniformlySampleDisk(u[0], u[1], lensX, lensY);
+		wsRayOrigin = m_camera.eye + m_right * (lensX * m_camera.lensRadius) + m_up * (lensY * m_camera.lensRadius);
+		wsRayDir = (wsFocalPlanePoint - wsRayOrigin).normalized();
+		return;
+	}
+
+	// pinhole, jittered within the pixel
+	const float ndcX = 2.0f * (x + u[0]) / m_resolution.x - 1.0f;
+	const float ndcY = 2.0f * (y + u[1]) / m_resolution.y - 1.0f;
+	wsRayOrigin = m_camera.eye;
+	wsRayDir = (m_forward +
+				m_right * (ndcX * aspectRatio * m_tanHalfFovY) +
+				m_up * (ndcY * m_tanHalfFovY)).normalized();
+}
+
+Imath::V3f CpuPathTracer::directLighting(int materialDataOffset,
+										 const Basis& wsHitBasis,
+										 const Imath::V3f& wsWo,
+										 Sampler& sampler) const
+{
+	const VoxelGrid& grid = m_scene.grid();
+
+	Imath::V3f wsToLight;
+	float lightPdf;
+	Imath::V3f lightRadiance;
+	// length of the shadow ray: the ray must reach the light unoccluded
+	float wsShadowRayLength = FLT_MAX;
+
+	// Pick one of the emissive voxels or the environment by their power
+	const Imath::V4f u = sampler.next();
+	float lightPmf;
+	int emissiveVoxelFaces;
+	const int emissiveVoxelIndex = m_scene.selectLight(u[0], lightPmf, emissiveVoxelFaces);
+	if (lightPmf <= 0) return Imath::V3f(0);
+	if (emissiveVoxelIndex >= 0)
+	{
+		const Imath::V3i vsEmissiveVoxelPos = grid.voxelPosition(emissiveVoxelIndex);
+		lightRadiance = CpuScene::EMISSIVE_VOXEL_RADIANCE_SCALE *
+						emissionBSDF(m_scene.materialData(), grid.material(emissiveVoxelIndex));
+
+		// Pick one of the exposed faces uniformly, and a point on it
+		const int numFaces = (int)std::bitset<6>(emissiveVoxelFaces).count();
+		if (numFaces == 0) return Imath::V3f(0);
+		int face = 0;
+		for( int i = std::min((int)(u[3] * numFaces), numFaces - 1); i >= 0; --i )
+		{
+			for( face = 0; (emissiveVoxelFaces & (1 << face)) == 0; ++face ) {}
+			emissiveVoxelFaces &= ~(1 << face);
+		}
+
+		// faces are ordered +X, -X, +Y, -Y, +Z, -Z
+		const int axis = face >> 1;
+		const bool positiveFace = (face & 1) == 0;
+		Imath::V3f wsLightNormal(0);
+		wsLightNormal[axis] = positiveFace ? 1.0f : -1.0f;
+		Imath::V3f faceOffset;
+		faceOffset[axis] = positiveFace ? 1.0f : 0.0f;
+		faceOffset[(axis + 1) % 3] = u[1];
+		faceOffset[(axis + 2) % 3] = u[2];
+		const Imath::V3f wsLightPos = grid.voxelToWorld(Imath::V3f(vsEmissiveVoxelPos) + faceOffset);
+
+		const Imath::V3f toLight = wsLightPos - wsHitBasis.position;
+		const float r = toLight.length();
+		wsToLight = toLight / r;
+
+		// faces only emit light outwards
+		const float cosThetaLight = -wsToLight.dot(wsLightNormal);
+		if (cosThetaLight <= 0) return Imath::V3f(0);
+
+		wsShadowRayLength = r;
+
+		// area pdf, converted to solid angle
+		const float facesArea = numFaces * grid.voxelSize() * grid.voxelSize();
+		lightPdf = (r * r) / cosThetaLight / facesArea;
+	}
+	else
+	{
+		lightRadiance = m_scene.sampleEnvironmentRadiance(wsHitBasis, u[1], u[2], wsToLight, lightPdf);
+	}
+
+	// account for the probability of having selected the light
+	lightPdf *= lightPmf;
+	if (lightPdf <= 0) return Imath::V3f(0);
+
+	if (occluded(grid, wsHitBasis.position, wsToLight, wsShadowRayLength)) return Imath::V3f(0);
+
+	// Apply MIS weight for the sampled direction (PBRT2 page 748/749). The BSDF
+	// sampling half is done by samplePixel when a path escapes.
+	const Imath::V3f lsWo = wsHitBasis.worldToLocal(wsWo);
+	const Imath::V3f lsWi = wsHitBasis.worldToLocal(wsToLight);
+	// the materials only reflect light (see directLighting.h)
+	if (lsWi.y <= 0) return Imath::V3f(0);
+	const BSDFValue bsdf = evaluateMaterialBSDF(m_scene.materialData(), materialDataOffset, lsWo, lsWi);
+
+	const float misWeight = powerHeuristic(lightPdf, bsdf.pdf);
+	return bsdf.f * lightRadiance * (fabsf(wsToLight.dot(wsHitBasis.normal)) * misWeight / lightPdf);
+}
+
+float CpuPathTracer::wireframe(const Basis& wsHitBasis, const Imath::V3i& vsHitPos) const
+{
+	// position of the hit within the voxel face, see pathTracer.fs
+	const Imath::V3f uvw = Imath::V3f(vsHitPos) - m_scene.grid().worldToVoxel(wsHitBasis.position);
+	const Imath::V3f& n = wsHitBasis.normal;
+	const float u = fabsf(Imath::V3f(n.y, n.z, n.x).dot(uvw));
+	const float v = fabsf(Imath::V3f(n.z, n.x, n.y).dot(uvw));
+	const bool inside = u >= m_wireframeThickness && u <= 1 - m_wireframeThickness &&
+						v >= m_wireframeThickness && v <= 1 - m_wireframeThickness;
+
+	return (1 - m_wireframeOpacity) + (inside ? m_wireframeOpacity : 0.0f);
+}
+
+Imath::V3f CpuPathTracer::samplePixel(int x, int y, Sampler& sampler) const
+{
+	const VoxelGrid& grid = m_scene.grid();
+	Imath::V3f radiance(0);
+
+	Imath::V3f wsRayOrigin, wsRayDir;
+	generateRay(x, y, sampler, wsRayOrigin, wsRayDir);
+
+	// discard rays missing the volume before entering traversal
+	const float aabbIsectDist = rayAABBIntersection(wsRayOrigin, wsRayDir,
+													grid.bounds().min, grid.bounds().max);
+	if (aabbIsectDist < 0) return m_scene.backgroundColor(wsRayDir);
+
+	const Imath::V3f wsRayEntryPoint = wsRayOrigin + aabbIsectDist * wsRayDir;
+
+	// Cast primary ray
+	Imath::V3i vsHitPos;
+	bool hitGround;
+	if (!traverse(grid, wsRayEntryPoint, wsRayDir, vsHitPos, hitGround))
+	{
+		return m_scene.backgroundColor(wsRayDir);
+	}
+
+	Imath::V3f throughput(1);
+
+	// PBRT2 section 16.3
+	for( int bounces = 0; bounces < m_maxNumBounces; ++bounces )
+	{
+		const Basis wsHitBasis = voxelSpaceToWorldSpace(grid, vsHitPos, wsRayOrigin, wsRayDir);
+		const int materialDataOffset = hitGround ? m_scene.groundMaterialOffset() : grid.material(vsHitPos);
+
+		const Imath::V3f wsWo = -wsRayDir;
+		const Imath::V3f lsWo = wsHitBasis.worldToLocal(wsWo);
+
+		// add emission from surface
+		if (bounces == 0)
+		{
+			radiance += throughput * emissionBSDF(m_scene.materialData(), materialDataOffset);
+		}
+
+		// Sample illumination from lights to find path contribution
+		radiance += throughput * directLighting(materialDataOffset, wsHitBasis, wsWo, sampler);
+
+		// Sample the BSDF to get the new path direction
+		const Imath::V4f u = sampler.next();
+		BSDFValue bsdf;
+		const Imath::V3f lsWi = sampleMaterialBSDF(m_scene.materialData(), materialDataOffset,
+												   lsWo, u[0], u[1], bsdf);
+		// no direction to carry on in (the shaders end the path here too)
+		if (bsdf.pdf <= 0) break;
+
+		if (m_wireframeOpacity > 0) bsdf.f *= wireframe(wsHitBasis, vsHitPos);
+
+		const Imath::V3f wsWi = wsHitBasis.localToWorld(lsWi);
+		throughput *= bsdf.f * (fabsf(wsWi.dot(wsHitBasis.normal)) / bsdf.pdf);
+
+		wsRayOrigin = wsHitBasis.position;
+		wsRayDir = wsWi;
+
+		// find new vertex of path
+		if (!traverse(grid, wsRayOrigin, wsRayDir, vsHitPos, hitGround))
+		{
+			// the ray missed the scene. Handle the environment light here.
+			float lightPdf;
+			const Imath::V3f lightRadiance = m_scene.evaluateEnvironmentRadiance(wsRayDir, lightPdf);
+			lightPdf *= m_scene.environmentLightPmf();
+			radiance += throughput * lightRadiance * powerHeuristic(bsdf.pdf, lightPdf);
+			break;
+		}
+	}
+
+	return radiance;
+}
+
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "cpuRenderer/cpuScene.h"
+#include "cpuRenderer/sampler.h"
+#include "camera/cameraParameters.h"
+#include "renderer/renderSettings.h"
+
+#include <OpenEXR/ImathVec.h>
+
+#include <vector>
+
+class WorkStealingPool;
+
+// Camera for the CPU path tracer. This holds the subset of CameraParameters
+// used to generate rays, so no camera controllers are needed to set it up.
+struct CpuCamera
+{
+	Imath::V3f eye;
+	Imath::V3f target;
+	float fovY;          // radians
+	float lensRadius;    // thin lens only
+	float focalDistance; // thin lens only
+	CameraParameters::CameraLensModel lensModel;
+};
+
+// Reference implementation of the path tracer in integrator/pathTracer.fs,
+// running on the CPU. It takes the same samples as the GPU integrator (same
+// sampler, BSDFs, light selection by power and MIS between light and BSDF
+// sampling), so its renders can be compared against the GPU ones, or produced
+// on machines without a capable GPU.
+//
+// Rays are always traced through the full resolution voxels, as the GPU ones
+// are by default. Renders using the voxel mip chain (see
+// RenderSettings::m_voxelLodMaxLevel) converge to a slightly different image,
+// so the reference doesn't follow them there: it stays the unbiased result
+// they're measured against.
+//
+// The image is split into tiles which are rendered in parallel by a
+// WorkStealingPool. Samples are accumulated as in the GPU accumulation
+// buffer: rows from bottom to top of RGBA floats, with the sum of the
+// samples' radiance in RGB and their number in A.
+//
+// With adaptive sampling, tiles stop receiving samples once they converge,
+// by the same test as adaptiveSampling/convergence.cs (over the tiles of
+// TILE_SIZE pixels rendered here, rather than the GPU's).
+class CpuPathTracer
+{
+public:
+	// Only the image resolution, number of bounces, wireframe, sampler and
+	// adaptive sampling settings are used.
+	CpuPathTracer(const CpuScene& scene,
+				  const CpuCamera& camera,
+				  const RenderSettings& settings);
+
+	// Add numSamples samples to every pixel yet to converge
+	void render(int numSamples, WorkStealingPool& pool);
+
+	// Whether all the tiles have converged. Never true without adaptive
+	// sampling.
+	bool converged() const { return m_numUnconvergedTiles == 0; }
+
+	// Number of passes rendered; pixels of converged tiles may have fewer
+	// samples (see the alpha of the accumulation buffer).
+	int numberSamples() const { return m_numberSamples; }
+	const Imath::V2i& resolution() const { return m_resolution; }
+	const std::vector<float>& accumulation() const { return m_accumulation; }
+
+	static const int TILE_SIZE = 32;
+
+private:
+	void renderTile(int x0, int y0, int x1, int y1, int numSamples);
+	// Whether the relative error of every pixel of the tile is below the
+	// adaptive sampling threshold.
+	bool isTileConverged(int x0, int y0, int x1, int y1) const;
+
+	// Trace a single path through the pixel and return the radiance it
+	// carries.
+	Imath::V3f samplePixel(int x, int y, Sampler& sampler) const;
+	void generateRay(int x, int y, Sampler& sampler,
+					 Imath::V3f& wsRayOrigin, Imath::V3f& wsRayDir) const;
+	Imath::V3f directLighting(int materialDataOffset,
+							  const Basis& wsHitBasis,
+							  const Imath::V3f& wsWo,
+							  Sampler& sampler) const;
+	float wireframe(const Basis& wsHitBasis, const Imath::V3i& vsHitPos) const;
+
+	const CpuScene& m_scene;
+	CpuCamera m_camera;
+	// camera basis, see CameraParameters::getBasis
+	Imath::V3f m_forward, m_right, m_up;
+	float m_tanHalfFovY;
+
+	Imath::V2i m_resolution;
+	int m_maxNumBounces;
+	float m_wireframeOpacity;
+	float m_wireframeThickness;
+	bool m_samplerRank1PixelDecorrelation;
+	float m_adaptiveSamplingThreshold;
+	int m_adaptiveSamplingMinSamples;
+
+	int m_numberSamples;
+	std::vector<float> m_accumulation;
+	// sum of the squared sample luminances of each pixel, only kept for
+	// adaptive sampling
+	std::vector<float> m_moments;
+	// convergence of each tile, in the order they're rendered
+	std::vector<bool> m_tileConverged;
+	// -1 without adaptive sampling
+	int m_numUnconvergedTiles;
+};
+
@@ -0,0 +1,209 @@
+#include "cpuRenderer/cpuScene.h"
+#include "cpuRenderer/sampling.h"
+#include "cpuRenderer/materials.h"
+#include "renderer/lights/aliasTable.h"
+#include "renderer/material/material.h"
+#include "voxel/voxelSurface.h"
+
+#include <algorithm>
+#include <bitset>
+#include <math.h>
+
+const float CpuScene::EMISSIVE_VOXEL_RADIANCE_SCALE = 10.0f;
+
+CpuScene::CpuScene(const GLint* voxelMaterials,
+				   const Imath::V3i& resolution,
+				   const float* materialData,
+				   size_t materialDataSize) :
+	m_grid(voxelMaterials, resolution),
+	m_materialData(materialData, materialData + materialDataSize),
+	m_backgroundRotation(0)
+{
+	// the ground material goes after the scene ones
+	m_groundMaterialOffset = (int)m_materialData.size();
+	const float ground[] = { Material::MT_LAMBERT, 0, 0, 0, 0.5f, 0.5f, 0.5f };
+	m_materialData.insert(m_materialData.end(), ground, ground + sizeof(ground) / sizeof(ground[0]));
+
+	// Only the exposed faces of emissive voxels are sampled, interior voxels
+	// never contribute to the image.
+	VoxelSurface surface(voxelMaterials, resolution);
+	std::vector<GLint> surfaceVoxels;
+	std::vector<unsigned char> faceMasks;
+	surface.surfaceVoxels(surfaceVoxels, faceMasks);
+	for( size_t i = 0; i < surfaceVoxels.size(); ++i )
+	{
+		const GLint materialOffset = voxelMaterials[surfaceVoxels[i]];
+		const float emissionLuminance = luminance(emissionBSDF(&m_materialData[0], materialOffset));
+		if (emissionLuminance <= 0) continue;
+
+		EmissiveVoxel voxel;
+		voxel.voxelIndex = surfaceVoxels[i];
+		voxel.faceMask = faceMasks[i];
+		voxel.emissionLuminance = emissionLuminance;
+		m_emissiveVoxels.push_back(voxel);
+	}
+
+	// default gradient, see pathTracer.fs
+	setBackgroundColors(Imath::V3f(153.0f / 255, 187.0f / 255, 201.0f / 255) * 2.0f,
+						Imath::V3f(77.0f / 255, 64.0f / 255, 50.0f / 255));
+}
+
+void CpuScene::setBackgroundColors(const Imath::V3f& top, const Imath::V3f& bottom)
+{
+	m_backgroundColor[0] = top;
+	m_backgroundColor[1] = bottom;
+	updateLights();
+}
+
+void CpuScene::setBackgroundImage(const boost::shared_ptr<EnvironmentMap>& map, float rotationRadians)
+{
+	m_backgroundImage = map;
+	m_backgroundRotation = rotationRadians;
+	updateLights();
+}
+
+void CpuScene::updateLights()
+{
+	const float voxelFaceArea = m_grid.voxelSize() * m_grid.voxelSize();
+
+	// The power the environment sends through the scene bounds is that of a
+	// distant light falling on a disk of the bounding sphere's radius.
+	float environmentRadianceIntegral;
+	if (m_backgroundImage)
+	{
+		environmentRadianceIntegral = m_backgroundImage->radianceIntegral;
+	}
+	else
+	{
+		environmentRadianceIntegral = 4.0f * M_PI * (0.75f * luminance(m_backgroundColor[1]) +
+													 0.25f * luminance(m_backgroundColor[0]));
+	}
+	const float sceneRadius = m_grid.bounds().size().length() * 0.5f;
+
+	std::vector<float> power(m_emissiveVoxels.size() + 1);
+	power[0] = M_PI * sceneRadius * sceneRadius * environmentRadianceIntegral;
+	for( size_t i = 0; i < m_emissiveVoxels.size(); ++i )
+	{
+		const EmissiveVoxel& voxel = m_emissiveVoxels[i];
+		const int numFaces = (int)std::bitset<6>(voxel.faceMask).count();
+		power[i + 1] = M_PI * EMISSIVE_VOXEL_RADIANCE_SCALE * voxel.emissionLuminance *
+					   numFaces * voxelFaceArea;
+	}
+
+	std::vector<AliasTable::Entry> aliasTable;
+	std::vector<float> pmf;
+	AliasTable::build(power, aliasTable, pmf);
+
+	m_lights.resize(power.size());
+	for( size_t i = 0; i < m_lights.size(); ++i )
+	{
+		m_lights[i].probability = aliasTable[i].probability;
+		m_lights[i].alias       = aliasTable[i].alias;
+		m_lights[i].pmf         = pmf[i];
+		m_lights[i].voxelIndex  = i == 0 ? -1 : m_emissiveVoxels[i - 1].voxelIndex;
+		m_lights[i].faceMask    = i == 0 ? 0 : m_emissiveVoxels[i - 1].faceMask;
+	}
+}
+
+int CpuScene::selectLight(float u, float& pmf, int& faceMask) const
+{
+	// the integer part of the scaled random number picks an entry, and its
+	// fractional part decides between the entry and its alias.
+	const int numLights = (int)m_lights.size();
+	const float scaled = u * numLights;
+	int light = std::min((int)scaled, numLights - 1);
+	if (scaled - light >= m_lights[light].probability) light = m_lights[light].alias;
+
+	pmf = m_lights[light].pmf;
+	faceMask = m_lights[light].faceMask;
+	return m_lights[light].voxelIndex;
+}
+
+Imath::V3f CpuScene::environmentTexel(float u, float v) const
+{
+	// nearest texel, so the radiance is constant over each texel just like
+	// the distributions used to sample it
+	const EnvironmentMap& map = *m_backgroundImage;
+	const unsigned int x = std::min((unsigned int)std::max(0.0f, u * map.width), map.width - 1);
+	const unsigned int y = std::min((unsigned int)std::max(0.0f, v * map.height), map.height - 1);
+	const float* texel = &map.pixels[((size_t)y * map.width + x) * 3];
+	return Imath::V3f(texel[0], texel[1], texel[2]);
+}
+
+Imath::V3f CpuScene::backgroundColor(const Imath::V3f& wsDir) const
+{
+	if (m_backgroundImage)
+	{
+		float u, v;
+		uvCoordFromVector(wsDir, m_backgroundRotation, u, v);
+		return environmentTexel(u, v);
+	}
+	const float bias = std::max(0.0f, wsDir.y);
+	return m_backgroundColor[1] * (1.0f - bias) + m_backgroundColor[0] * bias;
+}
+
+Imath::V3f CpuScene::evaluateEnvironmentRadiance(const Imath::V3f& wsDir, float& pdf) const
+{
+	const Imath::V3f radiance = backgroundColor(wsDir);
+	pdf = m_backgroundImage ?
+		  luminance(radiance) / m_backgroundImage->radianceIntegral :
+		  1.0f / (4.0f * (float)M_PI); // uniformly sampled sphere
+	return radiance;
+}
+
+// Choose between an alias table entry's own index and its alias, and remap
+// the random number to [0,1) again (see envLight/envMapSample.h).
+static int resolveAlias(unsigned int entry, int index, float& randomSample)
+{
+	const float probability = (float)(entry >> 16) / 65535.0f;
+	if (randomSample < probability)
+	{
+		randomSample = std::min(randomSample / probability, 0.99999994f);
+		return index;
+	}
+	randomSample = std::min((randomSample - probability) / (1.0f - probability), 0.99999994f);
+	return (int)(entry & 0xffff);
+}
+
+void CpuScene::sampleEnvironmentTexture(float u0, float u1, float& u, float& v) const
+{
+	const EnvironmentMap& map = *m_backgroundImage;
+	const int width = (int)map.aliasUWidth;
+	const int height = (int)map.aliasUHeight;
+
+	// pick the row from the marginal distribution, then the column from the
+	// row's distribution
+	float sampleV = u1 * height;
+	int row = std::min((int)sampleV, height - 1);
+	sampleV -= row;
+	row = resolveAlias(map.aliasV[row], row, sampleV);
+
+	float sampleU = u0 * width;
+	int column = std::min((int)sampleU, width - 1);
+	sampleU -= column;
+	column = resolveAlias(map.aliasU[(size_t)row * width + column], column, sampleU);
+
+	u = (column + sampleU) / width;
+	v = (row + sampleV) / height;
+}
+
+Imath::V3f CpuScene::sampleEnvironmentRadiance(const Basis& surfaceBasis,
+											   float u0, float u1,
+											   Imath::V3f& wsDir,
+											   float& pdf) const
+{
+	if (m_backgroundImage)
+	{
+		float u, v;
+		sampleEnvironmentTexture(u0, u1, u, v);
+		wsDir = directionFromUVCoord(u, v, m_backgroundRotation);
+		const Imath::V3f radiance = environmentTexel(u, v);
+		pdf = luminance(radiance) / m_backgroundImage->radianceIntegral;
+		return radiance;
+	}
+
+	const Imath::V3f lsDir = uniformlySampledHemisphere(u0, u1, pdf);
+	wsDir = surfaceBasis.localToWorld(lsDir);
+	return backgroundColor(wsDir);
+}
+
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "voxel/voxelGrid.h"
+#include "renderer/environmentMap.h"
+#include "shaders/lightSampling/lightAliasTableHost.h"
+#include "cpuRenderer/coordinates.h"
+
+#include <GL/gl.h>
+#include <OpenEXR/ImathVec.h>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+// Scene rendered by the CPU path tracer: the voxel and material data as
+// produced by the loaders (see VoxLoader::load), the background, and the
+// lights built from them. This holds the state the GPU path tracer reads from
+// its textures, uniforms and light selection buffers.
+//
+// The voxel data is referenced, not copied, and must outlive the scene. Once
+// set up, a scene is only read from, so it can be shared by any number of
+// threads.
+class CpuScene
+{
+public:
+	CpuScene(const GLint* voxelMaterials,
+			 const Imath::V3i& resolution,
+			 const float* materialData,
+			 size_t materialDataSize);
+
+	const VoxelGrid& grid() const { return m_grid; }
+	const float* materialData() const { return &m_materialData[0]; }
+
+	// Material of the ground under the volume, where rays leaving it through
+	// the bottom land (see traverse in shared/dda.h): a grey matte.
+	int groundMaterialOffset() const { return m_groundMaterialOffset; }
+
+	// The background is either a vertical gradient (see
+	// RenderSettings::m_backgroundColor) or an environment map, rotated
+	// around +Y. Setting either updates the light selection.
+	void setBackgroundColors(const Imath::V3f& top, const Imath::V3f& bottom);
+	void setBackgroundImage(const boost::shared_ptr<EnvironmentMap>& map, float rotationRadians);
+
+	// Radiance seen along a direction
+	Imath::V3f backgroundColor(const Imath::V3f& wsDir) const;
+	// Radiance seen along a direction, and the pdf of sampling it through
+	// sampleEnvironmentRadiance.
+	Imath::V3f evaluateEnvironmentRadiance(const Imath::V3f& wsDir, float& pdf) const;
+	// Sample a direction towards the environment, proportionally to its
+	// radiance for environment maps.
+	Imath::V3f sampleEnvironmentRadiance(const Basis& surfaceBasis,
+										 float u0, float u1,
+										 Imath::V3f& wsDir,
+										 float& pdf) const;
+
+	// Emission of the sampled emissive voxels is scaled by this factor (see
+	// directLighting in pathTracer.fs).
+	static const float EMISSIVE_VOXEL_RADIANCE_SCALE;
+
+	// Select a light proportionally to its power, with a single uniform
+	// random number. Returns the index of the emissive voxel (and the mask of
+	// its exposed faces), or -1 for the environment, and the probability of
+	// having selected it.
+	int selectLight(float u, float& pmf, int& faceMask) const;
+	// Probability of selecting the environment light
+	float environmentLightPmf() const { return m_lights[0].pmf; }
+
+	size_t numEmissiveVoxels() const { return m_emissiveVoxels.size(); }
+
+private:
+	// Build the alias table to select lights by their power, matching
+	// Renderer::updateLightSelection.
+	void updateLights();
+	// Look up the texel of the environment map at the given coordinates
+	Imath::V3f environmentTexel(float u, float v) const;
+	// Sample the environment map coordinates through its alias tables
+	void sampleEnvironmentTexture(float u0, float u1, float& u, float& v) const;
+
+	VoxelGrid m_grid;
+	std::vector<float> m_materialData;
+	int m_groundMaterialOffset;
+
+	Imath::V3f m_backgroundColor[2]; // top, bottom
+	boost::shared_ptr<EnvironmentMap> m_backgroundImage;
+	float m_backgroundRotation;
+
+	struct EmissiveVoxel
+	{
+		GLint voxelIndex;
+		int faceMask;
+		float emissionLuminance;
+	};
+	std::vector<EmissiveVoxel> m_emissiveVoxels;
+	// the first entry is the environment light
+	std::vector<LightAliasTableEntry> m_lights;
+};
+
@@ -0,0 +1,130 @@
+#include "cpuRenderer/dda.h"
+
+#include <algorithm>
+#include <math.h>
+
+// State of the DDA walk through the grid
+struct DDA
+{
+	Imath::V3i voxelPos;
+	// distance along the ray, in voxels, at which it crosses the next voxel
+	// boundary along each axis, and the distance between boundaries
+	Imath::V3f dis;
+	Imath::V3f disIncrement;
+	int step[3];
+
+	DDA(const VoxelGrid& grid, Imath::V3f wsRayOrigin, Imath::V3f wsRayDir)
+	{
+		// move the ray origin slightly towards the ray direction to avoid
+		// self-intersections
+		for( int i = 0; i < 3; ++i )
+		{
+			if (wsRayDir[i] > 0) wsRayOrigin[i] += ISECT_EPSILON;
+			else if (wsRayDir[i] < 0) wsRayOrigin[i] -= ISECT_EPSILON;
+		}
+		const Imath::V3f voxelOrigin = grid.worldToVoxel(wsRayOrigin);
+
+		for( int i = 0; i < 3; ++i )
+		{
+			voxelPos[i] = (int)floorf(voxelOrigin[i]);
+			// prevent div by 0 (the shader replaces small components by
+			// +1e-5 regardless of their sign)
+			const float d = fabsf(wsRayDir[i]) < 1e-5f ? 1e-5f : wsRayDir[i];
+			step[i] = d > 0 ? 1 : -1;
+			const float increment = 1.0f / d;
+			dis[i] = (voxelPos[i] - voxelOrigin[i] + 0.5f + step[i] * 0.5f) * increment;
+			disIncrement[i] = fabsf(increment);
+		}
+	}
+
+	// distance at which the ray leaves the current voxel
+	float exitDistance() const { return std::min(dis.x, std::min(dis.y, dis.z)); }
+
+	void next()
+	{
+		const int axis = (dis.x <= dis.y && dis.x <= dis.z) ? 0 : (dis.y <= dis.z ? 1 : 2);
+		dis[axis] += disIncrement[axis];
+		voxelPos[axis] += step[axis];
+	}
+};
+
+int maxTraversalSteps(const Imath::V3i& resolution)
+{
+	// see traverse() in shared/dda.h
+	return (int)(2 * ceilf(Imath::V3f(resolution).length()));
+}
+
+TraversalResult walk(const VoxelGrid& grid,
+					 const Imath::V3f& wsRayOrigin,
+					 const Imath::V3f& wsRayDir,
+					 float vsMaxDistance,
+					 int maxSteps,
+					 Imath::V3i& vsPos)
+{
+	DDA dda(grid, wsRayOrigin, wsRayDir);
+
+	// distance at which the ray enters the current voxel
+	float vsDistance = 0;
+	TraversalResult result = TRAVERSAL_STOPPED;
+	for( int steps = 0; steps < maxSteps && vsDistance < vsMaxDistance; ++steps )
+	{
+		// break from the traversal if we've gone out of bounds
+		if (!grid.contains(dda.voxelPos))
+		{
+			result = TRAVERSAL_LEFT_GRID;
+			break;
+		}
+		if (grid.material(dda.voxelPos) >= 0)
+		{
+			result = TRAVERSAL_HIT;
+			break;
+		}
+
+		vsDistance = dda.exitDistance();
+		dda.next();
+	}
+	vsPos = dda.voxelPos;
+	return result;
+}
+
+bool raymarch(const VoxelGrid& grid,
+			  const Imath::V3f& wsRayOrigin,
+			  const Imath::V3f& wsRayDir,
+			  int maxSteps,
+			  Imath::V3i& vsHitPos)
+{
+	return walk(grid, wsRayOrigin, wsRayDir, HUGE_VALF, maxSteps, vsHitPos) == TRAVERSAL_HIT;
+}
+
+bool traverse(const VoxelGrid& grid,
+			  const Imath::V3f& wsRayOrigin,
+			  const Imath::V3f& wsRayDir,
+			  Imath::V3i& vsHitPos,
+			  bool& hitGround)
+{
+	if (raymarch(grid, wsRayOrigin, wsRayDir, maxTraversalSteps(grid.resolution()), vsHitPos))
+	{
+		hitGround = false;
+		return true;
+	}
+	hitGround = vsHitPos.y < 0;
+	return hitGround;
+}
+
+bool occluded(const VoxelGrid& grid,
+			  const Imath::V3f& wsRayOrigin,
+			  const Imath::V3f& wsRayDir,
+			  float wsMaxDistance)
+{
+	// leaving the volume through the bottom means the ray hit the ground
+	Imath::V3i vsPos;
+	switch(walk(grid, wsRayOrigin, wsRayDir,
+				occlusionWalkDistance(grid, wsMaxDistance),
+				maxTraversalSteps(grid.resolution()),
+				vsPos))
+	{
+		case TRAVERSAL_HIT:       return true;
+		case TRAVERSAL_LEFT_GRID: return vsPos.y < 0;
+		default:                  return false;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "voxel/voxelGrid.h"
+
+#include <OpenEXR/ImathVec.h>
+
+// Scalar 3D-DDA traversal of a voxel grid, a port of shared/dda.h. Rays are
+// given in world space; the step logic (origin offset, handling of direction
+// components close to 0, step limit) matches the shader's so both renderers
+// agree on which voxels are hit.
+
+// Offset applied to ray origins along the ray direction, in world units, to
+// avoid self-intersections.
+static const float ISECT_EPSILON = 0.001f;
+
+// Maximum number of DDA steps taken through a grid of the given resolution
+int maxTraversalSteps(const Imath::V3i& resolution);
+
+// How a walk through the grid ended
+enum TraversalResult
+{
+	TRAVERSAL_HIT,        // found an occupied voxel
+	TRAVERSAL_LEFT_GRID,  // left the grid, vsPos is the first voxel outside
+	TRAVERSAL_STOPPED     // reached the maximum distance or number of steps
+};
+
+// Walk the grid from wsRayOrigin along wsRayDir, for up to vsMaxDistance (in
+// voxels) and maxSteps voxels. vsPos returns the voxel where the walk ended.
+// The queries below, and the packet traversal in packetTraversal.h, all follow
+// these steps.
+TraversalResult walk(const VoxelGrid& grid,
+					 const Imath::V3f& wsRayOrigin,
+					 const Imath::V3f& wsRayDir,
+					 float vsMaxDistance,
+					 int maxSteps,
+					 Imath::V3i& vsPos);
+
+// Convert the length of an occlusion query to the distance walk() may cover.
+// Some slack is left for the origin offset, so that a ray ending right at a
+// voxel face doesn't enter that voxel.
+inline float occlusionWalkDistance(const VoxelGrid& grid, float wsMaxDistance)
+{
+	return wsMaxDistance / grid.voxelSize() - 0.01f;
+}
+
+// Walk the grid from wsRayOrigin along wsRayDir and return true if an occupied
+// voxel is found, along with its position. If the ray leaves the grid
+// vsHitPos is the first voxel outside of it.
+bool raymarch(const VoxelGrid& grid,
+			  const Imath::V3f& wsRayOrigin,
+			  const Imath::V3f& wsRayDir,
+			  int maxSteps,
+			  Imath::V3i& vsHitPos);
+
+// Same as raymarch, but a ray leaving the grid through the bottom is
+// considered to hit the (optional) ground.
+bool traverse(const VoxelGrid& grid,
+			  const Imath::V3f& wsRayOrigin,
+			  const Imath::V3f& wsRayDir,
+			  Imath::V3i& vsHitPos,
+			  bool& hitGround);
+
+// Occlusion query, used for shadow rays: returns true as soon as an occupied
+// voxel (or the ground) is found closer than wsMaxDistance.
+bool occluded(const VoxelGrid& grid,
+			  const Imath::V3f& wsRayOrigin,
+			  const Imath::V3f& wsRayDir,
+			  float wsMaxDistance);
+
@@ -0,0 +1,323 @@
+// VoxelToyCPU: renders a MagicaVoxel scene with the CPU path tracer, without
+// a GPU or a display.
+//
+// usage: VoxelToyCPU scene.vox [output.exr] [options]
+//
+// The image is written through ImageWriter, with the same display gamma the
+// renderer uses for the path tracer. Rays are traced at full resolution, so
+// it matches the renderer with its default settings (the coarse voxel LOD
+// off, see RenderSettings::m_voxelLodMaxLevel).
+//
+// With --scaling, the same samples are rendered with 1, 2, 4... up to
+// --threads threads, and the throughput is reported for each, instead of
+// writing an image. --benchmark-traversal compares the throughput of the
+// scalar and packet traversals instead (see traversalBenchmark.h).
+//
+// With --adaptive-error, tiles of the image stop receiving samples once their
+// relative error falls below the given value, as with the renderer's adaptive
+// sampling (see RenderSettings::m_adaptiveSamplingThreshold), and --samples
+// becomes the most any pixel takes.
+
+#include "cpuRenderer/cpuPathTracer.h"
+#include "cpuRenderer/cpuScene.h"
+#include "cpuRenderer/traversalBenchmark.h"
+#include "cpuRenderer/workStealingPool.h"
+#include "renderer/environmentMap.h"
+#include "renderer/imageWriter.h"
+#include "renderer/loaders/magicaVoxel.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <math.h>
+#include <string>
+#include <vector>
+
+static const float PATHTRACER_DISPLAY_GAMMA = 2.2f;
+
+struct Options
+{
+	std::string scene;
+	std::string output;
+	Imath::V2i resolution;
+	int samples;
+	int bounces;
+	int threads;
+	float adaptiveError;
+	int adaptiveMinSamples;
+	std::string background;
+	float backgroundRotationDegrees;
+	CpuCamera camera;
+	bool cameraSet;
+	bool scaling;
+	bool benchmarkTraversal;
+};
+
+static void usage()
+{
+	fprintf(stderr,
+			"usage: VoxelToyCPU scene.vox [output.exr] [options]\n"
+			"  --resolution W H       image resolution (default 640 480)\n"
+			"  --samples N            samples per pixel (default 64)\n"
+			"  --bounces N            maximum path length (default 4)\n"
+			"  --threads N            worker threads (default: one per core)\n"
+			"  --adaptive-error E     stop sampling tiles once their relative error is\n"
+			"                         below E (default 0: off)\n"
+			"  --adaptive-min-samples N\n"
+			"                         samples per pixel before tiles may converge\n"
+			"                         (default 64)\n"
+			"  --background FILE      environment map\n"
+			"  --rotation DEG         environment map rotation around +Y\n"
+			"  --camera EX EY EZ TX TY TZ\n"
+			"                         eye and target (default: framing the volume)\n"
+			"  --fov DEG              vertical field of view (default 45)\n"
+			"  --lens-radius R        thin lens camera aperture radius\n"
+			"  --focal-distance D     thin lens camera focal distance\n"
+			"  --scaling              report the throughput for 1, 2, 4... threads\n"
+			"  --benchmark-traversal  report the throughput of the ray traversals\n");
+}
+
+static bool parseOptions(int argc, char* argv[], Options& options)
+{
+	options.resolution = Imath::V2i(640, 480);
+	options.samples = 64;
+	options.bounces = 4;
+	options.threads = 0;
+	options.adaptiveError = 0;
+	options.adaptiveMinSamples = 64;
+	options.backgroundRotationDegrees = 0;
+	options.camera.fovY = 45.0f * (float)M_PI / 180.0f;
+	options.camera.lensRadius = 0;
+	options.camera.focalDistance = 0;
+	options.camera.lensModel = CameraParameters::CLM_PINHOLE;
+	options.cameraSet = false;
+	options.scaling = false;
+	options.benchmarkTraversal = false;
+
+	std::vector<std::string> positional;
+	for( int i = 1; i < argc; ++i )
+	{
+		const std::string arg = argv[i];
+		// number of values following the option
+		int values = 0;
+		if (arg == "--resolution") values = 2;
+		else if (arg == "--camera") values = 6;
+		else if (arg == "--samples" || arg == "--bounces" || arg == "--threads" ||
+				 arg == "--adaptive-error" || arg == "--adaptive-min-samples" ||
+				 arg == "--background" || arg == "--rotation" || arg == "--fov" ||
+				 arg == "--lens-radius" || arg == "--focal-distance") values = 1;
+		else if (arg == "--scaling") { options.scaling = true; continue; }
+		else if (arg == "--benchmark-traversal") { options.benchmarkTraversal = true; continue; }
+		else if (arg.compare(0, 2, "--") == 0)
+		{
+			fprintf(stderr, "Unknown option %s\n", arg.c_str());
+			return false;
+		}
+		else
+		{
+			positional.push_back(arg);
+			continue;
+		}
+
+		if (i + values >= argc)
+		{
+			fprintf(stderr, "Missing values for %s\n", arg.c_str());
+			return false;
+		}
+		char** v = argv + i + 1;
+		i += values;
+
+		if (arg == "--resolution") options.resolution = Imath::V2i(atoi(v[0]), atoi(v[1]));
+		else if (arg == "--samples") options.samples = atoi(v[0]);
+		else if (arg == "--bounces") options.bounces = atoi(v[0]);
+		else if (arg == "--threads") options.threads = atoi(v[0]);
+		else if (arg == "--adaptive-error") options.adaptiveError = (float)atof(v[0]);
+		else if (arg == "--adaptive-min-samples") options.adaptiveMinSamples = atoi(v[0]);
+		else if (arg == "--background") options.background = v[0];
+		else if (arg == "--rotation") options.backgroundRotationDegrees = (float)atof(v[0]);
+		else if (arg == "--fov") options.camera.fovY = (float)atof(v[0]) * (float)M_PI / 180.0f;
+		else if (arg == "--lens-radius") options.camera.lensRadius = (float)atof(v[0]);
+		else if (arg == "--focal-distance") options.camera.focalDistance = (float)atof(v[0]);
+		else if (arg == "--camera")
+		{
+			options.camera.eye = Imath::V3f((float)atof(v[0]), (float)atof(v[1]), (float)atof(v[2]));
+			options.camera.target = Imath::V3f((float)atof(v[3]), (float)atof(v[4]), (float)atof(v[5]));
+			options.cameraSet = true;
+		}
+	}
+
+	// benchmarks don't write any image
+	const size_t numFiles = options.scaling || options.benchmarkTraversal ? 1 : 2;
+	if (positional.size() < numFiles || positional.size() > 2 ||
+		options.resolution.x <= 0 || options.resolution.y <= 0 ||
+		options.samples <= 0 || options.bounces <= 0 ||
+		options.adaptiveError < 0)
+	{
+		return false;
+	}
+	options.scene = positional[0];
+	if (positional.size() > 1) options.output = positional[1];
+
+	if (options.camera.lensRadius > 0)
+	{
+		options.camera.lensModel = CameraParameters::CLM_THIN_LENS;
+	}
+	return true;
+}
+
+static double secondsSince(const boost::posix_time::ptime& start)
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() * 1e-6;
+}
+
+// Render the image in passes, so progress can be reported, until it has the
+// given number of samples or converges. Returns the time taken in seconds.
+static double render(CpuPathTracer& pathTracer, int numSamples, WorkStealingPool& pool, bool verbose)
+{
+	const int SAMPLES_PER_PASS = 4;
+	const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	while (pathTracer.numberSamples() < numSamples && !pathTracer.converged())
+	{
+		pathTracer.render(std::min(SAMPLES_PER_PASS, numSamples - pathTracer.numberSamples()), pool);
+		if (verbose)
+		{
+			printf("\r%d/%d samples", pathTracer.numberSamples(), numSamples);
+			fflush(stdout);
+		}
+	}
+	if (verbose) printf("\n");
+	return secondsSince(start);
+}
+
+// Samples taken over the whole image, which is less than the number of passes
+// times the number of pixels once tiles converge.
+static double totalSamples(const CpuPathTracer& pathTracer)
+{
+	const std::vector<float>& accumulation = pathTracer.accumulation();
+	double samples = 0;
+	for( size_t i = 3; i < accumulation.size(); i += 4 ) samples += accumulation[i];
+	return samples;
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		usage();
+		return 1;
+	}
+
+	std::vector<GLint> voxelMaterials;
+	std::vector<float> materialData;
+	std::vector<GLint> emissiveVoxelIndices;
+	Imath::V3i voxelResolution;
+	MagicaVoxelLoader loader;
+	if (!loader.load(options.scene, voxelMaterials, materialData, emissiveVoxelIndices, voxelResolution))
+	{
+		fprintf(stderr, "Failed to load scene %s\n", options.scene.c_str());
+		return 1;
+	}
+
+	CpuScene scene(&voxelMaterials[0], voxelResolution, &materialData[0], materialData.size());
+	if (!options.background.empty())
+	{
+		boost::shared_ptr<EnvironmentMap> map = boost::make_shared<EnvironmentMap>();
+		if (!loadEnvironmentMap(options.background, *map))
+		{
+			fprintf(stderr, "Failed to load background image %s\n", options.background.c_str());
+			return 1;
+		}
+		scene.setBackgroundImage(map, options.backgroundRotationDegrees * (float)M_PI / 180.0f);
+	}
+
+	if (!options.cameraSet)
+	{
+		// look at the volume from the front, slightly above, far enough to
+		// fit its bounding sphere within the field of view.
+		const Imath::Box3f& bounds = scene.grid().bounds();
+		const Imath::V3f center = (bounds.min + bounds.max) * 0.5f;
+		const float radius = bounds.size().length() * 0.5f;
+		const float distance = radius / sinf(options.camera.fovY / 2);
+		options.camera.target = center;
+		options.camera.eye = center + Imath::V3f(0, 0.5f, -1).normalized() * distance;
+	}
+	if (options.camera.focalDistance <= 0)
+	{
+		options.camera.focalDistance = (options.camera.target - options.camera.eye).length();
+	}
+
+	RenderSettings settings;
+	settings.m_imageResolution = options.resolution;
+	settings.m_pathtracerMaxNumBounces = options.bounces;
+	settings.m_wireframeOpacity = 0;
+	settings.m_wireframeThickness = 0.01f;
+	settings.m_samplerRank1PixelDecorrelation = false;
+	settings.m_adaptiveSamplingThreshold = options.adaptiveError;
+	settings.m_adaptiveSamplingMinSamples = options.adaptiveMinSamples;
+
+	printf("Scene %s: %dx%dx%d voxels, %d emissive\n",
+		   options.scene.c_str(),
+		   voxelResolution.x, voxelResolution.y, voxelResolution.z,
+		   (int)scene.numEmissiveVoxels());
+
+	if (options.benchmarkTraversal)
+	{
+		WorkStealingPool pool(options.threads);
+		benchmarkTraversal(scene, options.camera, options.resolution, pool);
+		return 0;
+	}
+
+	if (options.scaling)
+	{
+		const int maxThreads = options.threads > 0 ?
+							   options.threads :
+							   (int)std::max(1u, boost::thread::hardware_concurrency());
+		double baseline = 0;
+		printf("threads  samples/s     speedup  efficiency  steals\n");
+		for( int threads = 1; ; threads = std::min(threads * 2, maxThreads) )
+		{
+			WorkStealingPool pool(threads);
+			CpuPathTracer pathTracer(scene, options.camera, settings);
+			const double seconds = render(pathTracer, options.samples, pool, false);
+			const double samplesPerSecond = totalSamples(pathTracer) / seconds;
+			if (threads == 1) baseline = samplesPerSecond;
+			printf("%7d  %12.0f  %7.2fx  %9.0f%%  %6d\n",
+				   threads,
+				   samplesPerSecond,
+				   samplesPerSecond / baseline,
+				   100.0 * samplesPerSecond / baseline / threads,
+				   (int)pool.numSteals());
+			if (threads == maxThreads) break;
+		}
+		return 0;
+	}
+
+	WorkStealingPool pool(options.threads);
+	CpuPathTracer pathTracer(scene, options.camera, settings);
+	const double seconds = render(pathTracer, options.samples, pool, true);
+	printf("%.2f s, %.0f samples/s on %d threads\n", seconds, totalSamples(pathTracer) / seconds, pool.numThreads());
+	if (pathTracer.converged())
+	{
+		printf("Converged after %d samples, %.1f per pixel on average\n",
+			   pathTracer.numberSamples(),
+			   totalSamples(pathTracer) / ((double)options.resolution.x * options.resolution.y));
+	}
+
+	// same gamma as the path tracer's images saved from the UI, so both can be
+	// compared directly
+	if (!ImageWriter::write(options.output,
+							&pathTracer.accumulation()[0],
+							options.resolution.x,
+							options.resolution.y,
+							PATHTRACER_DISPLAY_GAMMA))
+	{
+		fprintf(stderr, "Failed to write %s\n", options.output.c_str());
+		return 1;
+	}
+	return 0;
+}
+
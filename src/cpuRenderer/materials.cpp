@@ -0,0 +1,179 @@
+#include "cpuRenderer/materials.h"
+#include "cpuRenderer/coordinates.h"
+#include "cpuRenderer/sampling.h"
+#include "renderer/material/material.h"
+
+#include <algorithm>
+#include <math.h>
+
+static const float INDEX_OF_REFRACTION = 7.3f;
+
+static inline Imath::V3f readColor(const float* materialData, int offset)
+{
+	return Imath::V3f(materialData[offset], materialData[offset + 1], materialData[offset + 2]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Lambertian (bsdf/lambertian.h)
+
+static BSDFValue evaluateBSDF_Lambertian(const Imath::V3f& albedo, const Imath::V3f& lsWi)
+{
+	BSDFValue value;
+	value.f = albedo / (float)M_PI;
+	value.pdf = lsWi.y / (float)M_PI;
+	return value;
+}
+
+static Imath::V3f sampleBSDF_Lambertian(const Imath::V3f& albedo, float u0, float u1, BSDFValue& value)
+{
+	const Imath::V3f lsWi = cosineSampledHemisphere(u0, u1, value.pdf);
+	value.f = albedo / (float)M_PI;
+	return lsWi;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Torrance-Sparrow microfacet model with a Blinn-Phong distribution
+// (bsdf/microfacet.h)
+
+// Geometry term. Masking function based on V cavities model.
+static float G(const Imath::V3f& lsWo, const Imath::V3f& lsWi, const Imath::V3f& lsWh)
+{
+	const float NdotWh = lsWh.y;
+	const float NdotWo = lsWo.y;
+	const float NdotWi = lsWi.y;
+	const float WoDotWh = fabsf(lsWo.dot(lsWh));
+	return std::min(1.0f, std::min((2.0f * NdotWh * NdotWo / WoDotWh),
+								   (2.0f * NdotWh * NdotWi / WoDotWh)));
+}
+
+// Blinn-Phong microfacet distribution
+static BSDFValue D(const Imath::V3f& reflectance, float exponent, const Imath::V3f& lsWo, const Imath::V3f& lsWh)
+{
+	const float powCosTheta = powf(lsWh.y, exponent);
+	const float woDotWh = lsWo.dot(lsWh);
+
+	BSDFValue value;
+	value.f = reflectance * ((exponent + 2.0f) / (2.0f * (float)M_PI) * powCosTheta);
+	value.pdf = woDotWh <= 0.0f ?
+				0.0f :
+				((exponent + 1.0f) * powCosTheta) / (2.0f * (float)M_PI * 4.0f * woDotWh);
+	return value;
+}
+
+// Fresnel term. Schlick approximation.
+static float F(float cosThetaH)
+{
+	const float sqrtR0 = (1.0f - INDEX_OF_REFRACTION) / (1.0f + INDEX_OF_REFRACTION);
+	const float r0 = sqrtR0 * sqrtR0;
+	return r0 + (1.0f - r0) * powf(1.0f - cosThetaH, 5);
+}
+
+static BSDFValue evaluateBSDF_Microfacet(const Imath::V3f& reflectance,
+										float exponent,
+										const Imath::V3f& lsWo,
+										const Imath::V3f& lsWi)
+{
+	const Imath::V3f lsWh = (lsWi + lsWo).normalized();
+	const float cosThetaH = lsWi.dot(lsWh);
+
+	BSDFValue value = D(reflectance, exponent, lsWo, lsWh);
+	value.f *= G(lsWo, lsWi, lsWh) * F(cosThetaH) / (4.0f * lsWo.y * lsWi.y);
+	return value;
+}
+
+static Imath::V3f sampleBSDF_Microfacet(const Imath::V3f& reflectance,
+										float exponent,
+										const Imath::V3f& lsWo,
+										float u0, float u1,
+										BSDFValue& value)
+{
+	// Sample half-angle
+	const float cosTheta = powf(u0, 1.0f / (exponent + 1.0f));
+	const float sinTheta = sqrtf(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+	const float phi = u1 * 2.0f * (float)M_PI;
+	const Imath::V3f lsWh = sphericalToCartesian(phi, cosTheta, sinTheta);
+
+	// compute incident direction by reflecting about Wh
+	const Imath::V3f lsWi = -lsWo + 2.0f * lsWo.dot(lsWh) * lsWh;
+
+	value = D(reflectance, exponent, lsWo, lsWh);
+
+	// Note the shader applies the reflectance twice to sampled directions
+	// (once in D and once here), and so do we, so both renderers converge to
+	// the same image.
+	const Imath::V3f lsWhSampled = (lsWi + lsWo).normalized();
+	const float cosThetaH = lsWi.dot(lsWhSampled);
+	value.f = reflectance * value.f * (G(lsWo, lsWi, lsWhSampled) * F(cosThetaH) / (4.0f * lsWo.y * lsWi.y));
+	return lsWi;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Materials (materials/*.h). The properties follow the material type.
+
+BSDFValue evaluateMaterialBSDF(const float* materialData,
+							   int materialDataOffset,
+							   const Imath::V3f& lsWo,
+							   const Imath::V3f& lsWi)
+{
+	const int properties = materialDataOffset + 1;
+	switch((int)materialData[materialDataOffset])
+	{
+		case Material::MT_LAMBERT:
+			return evaluateBSDF_Lambertian(readColor(materialData, properties + 3), lsWi);
+		case Material::MT_METAL:
+			return evaluateBSDF_Microfacet(readColor(materialData, properties + 3),
+										   materialData[properties + 6],
+										   lsWo, lsWi);
+		case Material::MT_PLASTIC:
+			return evaluateBSDF_Microfacet(Imath::V3f(1),
+										   materialData[properties + 6],
+										   lsWo, lsWi);
+		default:
+		{
+			BSDFValue value;
+			value.f = Imath::V3f(0);
+			value.pdf = 0;
+			return value;
+		}
+	}
+}
+
+Imath::V3f sampleMaterialBSDF(const float* materialData,
+							  int materialDataOffset,
+							  const Imath::V3f& lsWo,
+							  float u0, float u1,
+							  BSDFValue& value)
+{
+	const int properties = materialDataOffset + 1;
+	switch((int)materialData[materialDataOffset])
+	{
+		case Material::MT_LAMBERT:
+			return sampleBSDF_Lambertian(readColor(materialData, properties + 3), u0, u1, value);
+		case Material::MT_METAL:
+			return sampleBSDF_Microfacet(readColor(materialData, properties + 3),
+										 materialData[properties + 6],
+										 lsWo, u0, u1, value);
+		case Material::MT_PLASTIC:
+			return sampleBSDF_Microfacet(Imath::V3f(1),
+										 materialData[properties + 6],
+										 lsWo, u0, u1, value);
+		default:
+			value.f = Imath::V3f(0);
+			value.pdf = 0;
+			return Imath::V3f(0);
+	}
+}
+
+Imath::V3f emissionBSDF(const float* materialData, int materialDataOffset)
+{
+	switch((int)materialData[materialDataOffset])
+	{
+		case Material::MT_LAMBERT:
+		case Material::MT_METAL:
+		case Material::MT_PLASTIC:
+			return readColor(materialData, materialDataOffset + 1);
+		default:
+			return Imath::V3f(0);
+	}
+}
+
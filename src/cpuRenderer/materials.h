@@ -0,0 +1,35 @@
+#pragma once
+
+#include <OpenEXR/ImathVec.h>
+
+// Port of the materials (materials/*.h) and BSDFs (bsdf/*.h) used by the GPU
+// path tracer, reading the same material data array the loaders produce (see
+// VoxLoader::load): [type][emission rgb][albedo/reflectance rgb][roughness].
+//
+// Directions are given in local (tangent) space, where the normal is +Y.
+
+// Value of a BSDF for a pair of directions, and the pdf of sampling them
+struct BSDFValue
+{
+	Imath::V3f f;
+	float pdf;
+};
+
+// Calculate the BSDF value and pdf for a pair of local space directions.
+BSDFValue evaluateMaterialBSDF(const float* materialData,
+							   int materialDataOffset,
+							   const Imath::V3f& lsWo,
+							   const Imath::V3f& lsWi);
+
+// Sample the BSDF by choosing an incoming direction lsWi, given the outgoing
+// lsWo direction and a pair of uniform random numbers. Returns the sampled
+// direction along with the BSDF value and pdf for it.
+Imath::V3f sampleMaterialBSDF(const float* materialData,
+							  int materialDataOffset,
+							  const Imath::V3f& lsWo,
+							  float u0, float u1,
+							  BSDFValue& value);
+
+// Radiance emitted by the material
+Imath::V3f emissionBSDF(const float* materialData, int materialDataOffset);
+
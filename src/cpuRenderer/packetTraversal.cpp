@@ -0,0 +1,158 @@
+#include "cpuRenderer/packetTraversal.h"
+#include "cpuRenderer/packetTraversalKernels.h"
+
+#include <algorithm>
+#include <math.h>
+
+void walkPacketScalar(const VoxelGrid& grid,
+					  const RayPacket& packet,
+					  int activeMask,
+					  int maxSteps,
+					  PacketHits& hits)
+{
+	for( int i = 0; i < RayPacket::SIZE; ++i )
+	{
+		if ((activeMask & (1 << i)) == 0) continue;
+		Imath::V3i vsPos;
+		hits.result[i] = walk(grid,
+							  Imath::V3f(packet.originX[i], packet.originY[i], packet.originZ[i]),
+							  Imath::V3f(packet.dirX[i], packet.dirY[i], packet.dirZ[i]),
+							  packet.vsMaxDistance[i],
+							  maxSteps,
+							  vsPos);
+		hits.voxelX[i] = vsPos.x;
+		hits.voxelY[i] = vsPos.y;
+		hits.voxelZ[i] = vsPos.z;
+	}
+}
+
+bool packetTraversalUsesAVX2()
+{
+	static const bool useAVX2 = walkPacketAVX2Available() && __builtin_cpu_supports("avx2");
+	return useAVX2;
+}
+
+void walkPacket(const VoxelGrid& grid,
+				const RayPacket& packet,
+				int activeMask,
+				int maxSteps,
+				PacketHits& hits)
+{
+	if (packetTraversalUsesAVX2()) walkPacketAVX2(grid, packet, activeMask, maxSteps, hits);
+	else walkPacketScalar(grid, packet, activeMask, maxSteps, hits);
+}
+
+// Walk the given rays (indices into the arrays) in packets of consecutive
+// rays.
+static void walkPackets(const VoxelGrid& grid,
+						const size_t* rays,
+						size_t numRays,
+						const float* wsOrigins,
+						const float* wsDirections,
+						const float* vsMaxDistances,
+						Imath::V3i* vsPositions,
+						TraversalResult* results)
+{
+	const int maxSteps = maxTraversalSteps(grid.resolution());
+	RayPacket packet;
+	PacketHits hits;
+	for( size_t first = 0; first < numRays; first += RayPacket::SIZE )
+	{
+		const int packetSize = (int)std::min((size_t)RayPacket::SIZE, numRays - first);
+		for( int i = 0; i < packetSize; ++i )
+		{
+			const size_t ray = rays ? rays[first + i] : first + i;
+			packet.originX[i] = wsOrigins[ray * 3];
+			packet.originY[i] = wsOrigins[ray * 3 + 1];
+			packet.originZ[i] = wsOrigins[ray * 3 + 2];
+			packet.dirX[i] = wsDirections[ray * 3];
+			packet.dirY[i] = wsDirections[ray * 3 + 1];
+			packet.dirZ[i] = wsDirections[ray * 3 + 2];
+			packet.vsMaxDistance[i] = vsMaxDistances ? vsMaxDistances[ray] : HUGE_VALF;
+		}
+		// the loads in the AVX2 kernel read the whole packet
+		for( int i = packetSize; i < RayPacket::SIZE; ++i )
+		{
+			packet.originX[i] = packet.originY[i] = packet.originZ[i] = 0;
+			packet.dirX[i] = packet.dirY[i] = packet.dirZ[i] = 1;
+			packet.vsMaxDistance[i] = 0;
+		}
+
+		walkPacket(grid, packet, (1 << packetSize) - 1, maxSteps, hits);
+
+		for( int i = 0; i < packetSize; ++i )
+		{
+			const size_t ray = rays ? rays[first + i] : first + i;
+			vsPositions[ray] = Imath::V3i(hits.voxelX[i], hits.voxelY[i], hits.voxelZ[i]);
+			results[ray] = hits.result[i];
+		}
+	}
+}
+
+void walkRayPackets(const VoxelGrid& grid,
+					size_t numRays,
+					const float* wsOrigins,
+					const float* wsDirections,
+					const float* vsMaxDistances,
+					Imath::V3i* vsPositions,
+					TraversalResult* results)
+{
+	walkPackets(grid, NULL, numRays, wsOrigins, wsDirections, vsMaxDistances, vsPositions, results);
+}
+
+// Interleave the bits of a 10 bit integer with two zeros after each
+static inline unsigned int expandBits(unsigned int v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+// Sort key for a ray: its direction octant first, so the rays in a packet
+// step in the same directions, then the Morton code of the cell its origin
+// lies in, so they start close to each other.
+static unsigned int rayStreamKey(const VoxelGrid& grid, const float* wsOrigin, const float* wsDirection)
+{
+	// cells of 8x8x8 voxels, 9 bits per axis
+	static const float CELL_SIZE = 8.0f;
+	static const unsigned int MAX_CELL = 511;
+
+	const Imath::V3f vsOrigin = grid.worldToVoxel(Imath::V3f(wsOrigin[0], wsOrigin[1], wsOrigin[2]));
+	unsigned int cell[3];
+	for( int i = 0; i < 3; ++i )
+	{
+		const float c = std::max(0.0f, std::min(vsOrigin[i] / CELL_SIZE, (float)MAX_CELL));
+		cell[i] = (unsigned int)c;
+	}
+	const unsigned int octant = (wsDirection[0] < 0 ? 1 : 0) |
+								(wsDirection[1] < 0 ? 2 : 0) |
+								(wsDirection[2] < 0 ? 4 : 0);
+	const unsigned int morton = expandBits(cell[0]) | (expandBits(cell[1]) << 1) | (expandBits(cell[2]) << 2);
+	return (octant << 27) | morton;
+}
+
+void walkRayStream(const VoxelGrid& grid,
+				   size_t numRays,
+				   const float* wsOrigins,
+				   const float* wsDirections,
+				   const float* vsMaxDistances,
+				   Imath::V3i* vsPositions,
+				   TraversalResult* results)
+{
+	if (numRays == 0) return;
+
+	std::vector<std::pair<unsigned int, size_t> > keys(numRays);
+	for( size_t i = 0; i < numRays; ++i )
+	{
+		keys[i] = std::make_pair(rayStreamKey(grid, wsOrigins + i * 3, wsDirections + i * 3), i);
+	}
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<size_t> rays(numRays);
+	for( size_t i = 0; i < numRays; ++i ) rays[i] = keys[i].second;
+
+	walkPackets(grid, &rays[0], numRays, wsOrigins, wsDirections, vsMaxDistances, vsPositions, results);
+}
+
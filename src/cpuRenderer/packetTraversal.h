@@ -0,0 +1,76 @@
+#pragma once
+
+#include "cpuRenderer/dda.h"
+#include "voxel/voxelGrid.h"
+
+#include <OpenEXR/ImathVec.h>
+
+#include <vector>
+
+// Traversal of several rays through the voxel grid at once.
+//
+// Ray packets walk 8 rays in lockstep through the grid, one per SIMD lane,
+// following the same steps as walk() in dda.h. Each ray carries on until it
+// finishes; the lanes of finished rays are masked off, and once only a couple
+// of rays are left they are finished one at a time. This pays off for
+// coherent rays (primary rays through neighbouring pixels, shadow rays towards
+// the same light), which visit similar voxels and finish at similar times.
+//
+// Incoherent rays, such as those bounced off diffuse surfaces, are traced as
+// a ray stream: they are first sorted by direction octant and origin cell, so
+// that each packet gathers rays which are as coherent as possible.
+//
+// The packet kernel uses AVX2 when the CPU supports it, and walks each ray in
+// turn otherwise.
+
+// Rays traversed together, as structure of arrays
+struct RayPacket
+{
+	static const int SIZE = 8;
+	float originX[SIZE], originY[SIZE], originZ[SIZE];
+	float dirX[SIZE], dirY[SIZE], dirZ[SIZE];
+	// Distance (in voxels, see occlusionWalkDistance) after which rays stop
+	// without a hit
+	float vsMaxDistance[SIZE];
+};
+
+// Outcome of each ray in a packet, as in walk()
+struct PacketHits
+{
+	int voxelX[RayPacket::SIZE], voxelY[RayPacket::SIZE], voxelZ[RayPacket::SIZE];
+	TraversalResult result[RayPacket::SIZE];
+};
+
+// Walk the rays whose bits are set in activeMask. The results of the other
+// lanes are left untouched.
+void walkPacket(const VoxelGrid& grid,
+				const RayPacket& packet,
+				int activeMask,
+				int maxSteps,
+				PacketHits& hits);
+
+// Whether walkPacket runs the AVX2 kernel
+bool packetTraversalUsesAVX2();
+
+// Walk a set of rays sorted into coherent packets. Origins and directions are
+// given as x,y,z triplets; vsMaxDistances may be NULL to walk the rays up to
+// the maximum number of steps. Returns the voxel and result of each ray, in
+// the order they were given.
+void walkRayStream(const VoxelGrid& grid,
+				   size_t numRays,
+				   const float* wsOrigins,
+				   const float* wsDirections,
+				   const float* vsMaxDistances,
+				   Imath::V3i* vsPositions,
+				   TraversalResult* results);
+
+// Same as walkRayStream, without sorting the rays first: consecutive rays are
+// walked together. Use this for rays which are known to be coherent already.
+void walkRayPackets(const VoxelGrid& grid,
+					size_t numRays,
+					const float* wsOrigins,
+					const float* wsDirections,
+					const float* vsMaxDistances,
+					Imath::V3i* vsPositions,
+					TraversalResult* results);
+
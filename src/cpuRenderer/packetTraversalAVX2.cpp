@@ -0,0 +1,240 @@
+#include "cpuRenderer/packetTraversalKernels.h"
+
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+#include <algorithm>
+
+// All-ones lanes for the rays whose bits are set in the mask
+static inline __m256i laneMask(int mask)
+{
+	const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(mask), bits), bits);
+}
+
+static inline __m256 asFloat(__m256i v) { return _mm256_castsi256_ps(v); }
+static inline __m256i asInt(__m256 v) { return _mm256_castps_si256(v); }
+
+bool walkPacketAVX2Available()
+{
+	return true;
+}
+
+// Rays left in a packet which are walked one at a time
+static const int SCALAR_TAIL_RAYS = 2;
+
+// DDA state of a single lane
+struct LaneState
+{
+	Imath::V3i voxelPos;
+	Imath::V3f dis;
+	Imath::V3f disIncrement;
+	int step[3];
+};
+
+// Carry on walking a lane where the packet left it, following the same steps
+// as walk() in dda.cpp.
+static TraversalResult finishWalk(const VoxelGrid& grid,
+								  LaneState& lane,
+								  float vsDistance,
+								  float vsMaxDistance,
+								  int maxSteps)
+{
+	for( int steps = 0; steps < maxSteps && vsDistance < vsMaxDistance; ++steps )
+	{
+		if (!grid.contains(lane.voxelPos)) return TRAVERSAL_LEFT_GRID;
+		if (grid.material(lane.voxelPos) >= 0) return TRAVERSAL_HIT;
+
+		const Imath::V3f& dis = lane.dis;
+		vsDistance = std::min(dis.x, std::min(dis.y, dis.z));
+		const int axis = (dis.x <= dis.y && dis.x <= dis.z) ? 0 : (dis.y <= dis.z ? 1 : 2);
+		lane.dis[axis] += lane.disIncrement[axis];
+		lane.voxelPos[axis] += lane.step[axis];
+	}
+	return TRAVERSAL_STOPPED;
+}
+
+// Set up the DDA along one axis for all lanes, as DDA does in dda.cpp. The
+// operations are the same, in the same order, so each lane walks exactly the
+// same voxels as the scalar traversal.
+static inline void setupAxis(const float* origin,
+							 const float* dir,
+							 float boundsMin,
+							 float invVoxelSize,
+							 __m256i& voxelPos,
+							 __m256& dis,
+							 __m256& disIncrement,
+							 __m256i& step)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 epsilon = _mm256_set1_ps(ISECT_EPSILON);
+	const __m256 minComponent = _mm256_set1_ps(1e-5f);
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+	__m256 o = _mm256_loadu_ps(origin);
+	const __m256 d = _mm256_loadu_ps(dir);
+
+	// move the ray origin slightly towards the ray direction
+	o = _mm256_add_ps(o, _mm256_and_ps(_mm256_cmp_ps(d, zero, _CMP_GT_OQ), epsilon));
+	o = _mm256_sub_ps(o, _mm256_and_ps(_mm256_cmp_ps(d, zero, _CMP_LT_OQ), epsilon));
+	const __m256 voxelOrigin = _mm256_mul_ps(_mm256_sub_ps(o, _mm256_set1_ps(boundsMin)),
+											 _mm256_set1_ps(invVoxelSize));
+	const __m256 voxelPosF = _mm256_floor_ps(voxelOrigin);
+	voxelPos = _mm256_cvttps_epi32(voxelPosF);
+
+	// prevent div by 0
+	const __m256 absD = _mm256_andnot_ps(signBit, d);
+	const __m256 safeD = _mm256_blendv_ps(d, minComponent, _mm256_cmp_ps(absD, minComponent, _CMP_LT_OQ));
+	const __m256 positive = _mm256_cmp_ps(safeD, zero, _CMP_GT_OQ);
+	const __m256 stepF = _mm256_blendv_ps(_mm256_set1_ps(-1.0f), _mm256_set1_ps(1.0f), positive);
+	step = _mm256_cvttps_epi32(stepF);
+
+	const __m256 increment = _mm256_div_ps(_mm256_set1_ps(1.0f), safeD);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	dis = _mm256_add_ps(_mm256_add_ps(_mm256_sub_ps(voxelPosF, voxelOrigin), half), _mm256_mul_ps(stepF, half));
+	dis = _mm256_mul_ps(dis, increment);
+	disIncrement = _mm256_andnot_ps(signBit, increment);
+}
+
+void walkPacketAVX2(const VoxelGrid& grid,
+					const RayPacket& packet,
+					int activeMask,
+					int maxSteps,
+					PacketHits& hits)
+{
+	const Imath::V3f& boundsMin = grid.bounds().min;
+	const float invVoxelSize = 1.0f / grid.voxelSize();
+
+	__m256i posX, posY, posZ, stepX, stepY, stepZ;
+	__m256 disX, disY, disZ, incX, incY, incZ;
+	setupAxis(packet.originX, packet.dirX, boundsMin.x, invVoxelSize, posX, disX, incX, stepX);
+	setupAxis(packet.originY, packet.dirY, boundsMin.y, invVoxelSize, posY, disY, incY, stepY);
+	setupAxis(packet.originZ, packet.dirZ, boundsMin.z, invVoxelSize, posZ, disZ, incZ, stepZ);
+
+	const Imath::V3i& resolution = grid.resolution();
+	const __m256i minusOne = _mm256_set1_epi32(-1);
+	const __m256i resX = _mm256_set1_epi32(resolution.x);
+	const __m256i resY = _mm256_set1_epi32(resolution.y);
+	const __m256i resZ = _mm256_set1_epi32(resolution.z);
+	const int* materials = grid.materials();
+
+	const __m256 vsMaxDistance = _mm256_loadu_ps(packet.vsMaxDistance);
+	__m256 vsDistance = _mm256_setzero_ps();
+
+	// lanes still walking, all ones if so
+	__m256i active = laneMask(activeMask);
+	__m256i result = _mm256_set1_epi32(TRAVERSAL_STOPPED);
+
+	int stepsTaken = 0;
+	for( ; stepsTaken < maxSteps && !_mm256_testz_si256(active, active); ++stepsTaken )
+	{
+		// Once only a few rays are left, most of the lanes would be idle for
+		// the rest of the walk. Finish those rays one at a time instead.
+		if (__builtin_popcount(_mm256_movemask_ps(asFloat(active))) <= SCALAR_TAIL_RAYS) break;
+
+		// rays which went past their maximum distance stop here
+		active = _mm256_and_si256(active, asInt(_mm256_cmp_ps(vsDistance, vsMaxDistance, _CMP_LT_OQ)));
+
+		// rays leaving the grid
+		__m256i inside = _mm256_and_si256(_mm256_cmpgt_epi32(posX, minusOne), _mm256_cmpgt_epi32(resX, posX));
+		inside = _mm256_and_si256(inside, _mm256_and_si256(_mm256_cmpgt_epi32(posY, minusOne), _mm256_cmpgt_epi32(resY, posY)));
+		inside = _mm256_and_si256(inside, _mm256_and_si256(_mm256_cmpgt_epi32(posZ, minusOne), _mm256_cmpgt_epi32(resZ, posZ)));
+		const __m256i left = _mm256_andnot_si256(inside, active);
+		result = _mm256_blendv_epi8(result, _mm256_set1_epi32(TRAVERSAL_LEFT_GRID), left);
+		active = _mm256_and_si256(active, inside);
+
+		// fetch the materials of the voxels the active rays are in, see
+		// VoxelGrid::voxelIndex
+		const __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(posZ, resY), posY), resX), posX);
+		const __m256i material = _mm256_mask_i32gather_epi32(minusOne, materials, index, active, 4);
+		const __m256i hit = _mm256_and_si256(active, _mm256_cmpgt_epi32(material, minusOne));
+		result = _mm256_blendv_epi8(result, _mm256_set1_epi32(TRAVERSAL_HIT), hit);
+		active = _mm256_andnot_si256(hit, active);
+
+		// step the remaining rays into the next voxel, along a single axis
+		const __m256 exitDistance = _mm256_min_ps(disX, _mm256_min_ps(disY, disZ));
+		vsDistance = _mm256_blendv_ps(vsDistance, exitDistance, asFloat(active));
+
+		const __m256 selectX = _mm256_and_ps(_mm256_cmp_ps(disX, disY, _CMP_LE_OQ), _mm256_cmp_ps(disX, disZ, _CMP_LE_OQ));
+		const __m256 selectY = _mm256_andnot_ps(selectX, _mm256_cmp_ps(disY, disZ, _CMP_LE_OQ));
+		const __m256 selectZ = _mm256_andnot_ps(_mm256_or_ps(selectX, selectY), asFloat(minusOne));
+		const __m256i moveX = _mm256_and_si256(asInt(selectX), active);
+		const __m256i moveY = _mm256_and_si256(asInt(selectY), active);
+		const __m256i moveZ = _mm256_and_si256(asInt(selectZ), active);
+
+		disX = _mm256_add_ps(disX, _mm256_and_ps(asFloat(moveX), incX));
+		disY = _mm256_add_ps(disY, _mm256_and_ps(asFloat(moveY), incY));
+		disZ = _mm256_add_ps(disZ, _mm256_and_ps(asFloat(moveZ), incZ));
+		posX = _mm256_add_epi32(posX, _mm256_and_si256(moveX, stepX));
+		posY = _mm256_add_epi32(posY, _mm256_and_si256(moveY, stepY));
+		posZ = _mm256_add_epi32(posZ, _mm256_and_si256(moveZ, stepZ));
+	}
+
+	int voxelX[RayPacket::SIZE], voxelY[RayPacket::SIZE], voxelZ[RayPacket::SIZE], results[RayPacket::SIZE];
+	_mm256_storeu_si256((__m256i*)voxelX, posX);
+	_mm256_storeu_si256((__m256i*)voxelY, posY);
+	_mm256_storeu_si256((__m256i*)voxelZ, posZ);
+	_mm256_storeu_si256((__m256i*)results, result);
+
+	const int tailMask = _mm256_movemask_ps(asFloat(active));
+	if (tailMask != 0)
+	{
+		LaneState lane;
+		float distances[3][RayPacket::SIZE], increments[3][RayPacket::SIZE], vsDistances[RayPacket::SIZE];
+		int stepDirections[3][RayPacket::SIZE];
+		_mm256_storeu_ps(distances[0], disX);
+		_mm256_storeu_ps(distances[1], disY);
+		_mm256_storeu_ps(distances[2], disZ);
+		_mm256_storeu_ps(increments[0], incX);
+		_mm256_storeu_ps(increments[1], incY);
+		_mm256_storeu_ps(increments[2], incZ);
+		_mm256_storeu_si256((__m256i*)stepDirections[0], stepX);
+		_mm256_storeu_si256((__m256i*)stepDirections[1], stepY);
+		_mm256_storeu_si256((__m256i*)stepDirections[2], stepZ);
+		_mm256_storeu_ps(vsDistances, vsDistance);
+		for( int i = 0; i < RayPacket::SIZE; ++i )
+		{
+			if ((tailMask & (1 << i)) == 0) continue;
+			lane.voxelPos = Imath::V3i(voxelX[i], voxelY[i], voxelZ[i]);
+			for( int axis = 0; axis < 3; ++axis )
+			{
+				lane.dis[axis] = distances[axis][i];
+				lane.disIncrement[axis] = increments[axis][i];
+				lane.step[axis] = stepDirections[axis][i];
+			}
+			results[i] = finishWalk(grid, lane, vsDistances[i], packet.vsMaxDistance[i], maxSteps - stepsTaken);
+			voxelX[i] = lane.voxelPos.x;
+			voxelY[i] = lane.voxelPos.y;
+			voxelZ[i] = lane.voxelPos.z;
+		}
+	}
+
+	for( int i = 0; i < RayPacket::SIZE; ++i )
+	{
+		if ((activeMask & (1 << i)) == 0) continue;
+		hits.voxelX[i] = voxelX[i];
+		hits.voxelY[i] = voxelY[i];
+		hits.voxelZ[i] = voxelZ[i];
+		hits.result[i] = (TraversalResult)results[i];
+	}
+}
+
+#else
+
+bool walkPacketAVX2Available()
+{
+	return false;
+}
+
+void walkPacketAVX2(const VoxelGrid& grid,
+					const RayPacket& packet,
+					int activeMask,
+					int maxSteps,
+					PacketHits& hits)
+{
+	walkPacketScalar(grid, packet, activeMask, maxSteps, hits);
+}
+
+#endif
+
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "cpuRenderer/packetTraversal.h"
+
+// Implementations of walkPacket. The AVX2 kernel lives in its own file, the
+// only one compiled with AVX2 enabled (see CMakeLists.txt), so the rest of the
+// program still runs on CPUs without it.
+
+void walkPacketScalar(const VoxelGrid& grid,
+					  const RayPacket& packet,
+					  int activeMask,
+					  int maxSteps,
+					  PacketHits& hits);
+
+// Returns false if the kernel wasn't compiled in
+bool walkPacketAVX2Available();
+void walkPacketAVX2(const VoxelGrid& grid,
+					const RayPacket& packet,
+					int activeMask,
+					int maxSteps,
+					PacketHits& hits);
+
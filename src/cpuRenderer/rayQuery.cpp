@@ -0,0 +1,194 @@
+#include "cpuRenderer/rayQuery.h"
+#include "cpuRenderer/coordinates.h"
+#include "cpuRenderer/packetTraversal.h"
+#include "cpuRenderer/workStealingPool.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+// std::min takes it by reference
+const size_t RayQuery::CHUNK_SIZE;
+
+void RayHits::resize(size_t numRays)
+{
+	voxel.resize(numRays);
+	normal.resize(numRays);
+	distance.resize(numRays);
+	materialOffset.resize(numRays);
+}
+
+RayQuery::RayQuery(const VoxelGrid& grid, WorkStealingPool& pool) :
+	m_grid(grid),
+	m_pool(pool)
+{
+}
+
+// Rays of a chunk which enter the volume, moved to the point where they do so,
+// as the traversal expects.
+struct ClippedRays
+{
+	std::vector<size_t> rays; // index within the chunk
+	std::vector<float> wsOrigins;
+	std::vector<float> wsDirections;
+	std::vector<Imath::V3i> vsPositions;
+	std::vector<TraversalResult> results;
+
+	size_t size() const { return rays.size(); }
+
+	void add(size_t ray, const Imath::V3f& wsOrigin, const Imath::V3f& wsDirection, float wsEntryDistance)
+	{
+		const Imath::V3f wsEntryPoint = wsOrigin + wsDirection * wsEntryDistance;
+		rays.push_back(ray);
+		wsOrigins.push_back(wsEntryPoint.x);
+		wsOrigins.push_back(wsEntryPoint.y);
+		wsOrigins.push_back(wsEntryPoint.z);
+		wsDirections.push_back(wsDirection.x);
+		wsDirections.push_back(wsDirection.y);
+		wsDirections.push_back(wsDirection.z);
+	}
+
+	void walk(const VoxelGrid& grid, const float* vsMaxDistances, RayQuery::RayOrder order)
+	{
+		if (rays.empty()) return;
+		vsPositions.resize(rays.size());
+		results.resize(rays.size());
+		if (order == RayQuery::RAYS_INCOHERENT)
+		{
+			walkRayStream(grid, rays.size(), &wsOrigins[0], &wsDirections[0], vsMaxDistances,
+						  &vsPositions[0], &results[0]);
+		}
+		else
+		{
+			walkRayPackets(grid, rays.size(), &wsOrigins[0], &wsDirections[0], vsMaxDistances,
+						   &vsPositions[0], &results[0]);
+		}
+	}
+};
+
+static inline Imath::V3f readVector(const float* v)
+{
+	return Imath::V3f(v[0], v[1], v[2]);
+}
+
+void RayQuery::intersect(size_t numRays,
+						 const float* wsOrigins,
+						 const float* wsDirections,
+						 RayHits& hits,
+						 RayOrder order) const
+{
+	hits.resize(numRays);
+
+	std::vector<WorkStealingPool::Task> chunks;
+	for( size_t first = 0; first < numRays; first += CHUNK_SIZE )
+	{
+		chunks.push_back(boost::bind(&RayQuery::intersectChunk, this,
+									 first, std::min(CHUNK_SIZE, numRays - first),
+									 wsOrigins, wsDirections, &hits, order));
+	}
+	m_pool.run(chunks);
+}
+
+void RayQuery::occluded(size_t numRays,
+						const float* wsOrigins,
+						const float* wsDirections,
+						const float* wsMaxDistances,
+						std::vector<unsigned char>& occluded,
+						RayOrder order) const
+{
+	occluded.resize(numRays);
+
+	std::vector<WorkStealingPool::Task> chunks;
+	for( size_t first = 0; first < numRays; first += CHUNK_SIZE )
+	{
+		chunks.push_back(boost::bind(&RayQuery::occludedChunk, this,
+									 first, std::min(CHUNK_SIZE, numRays - first),
+									 wsOrigins, wsDirections, wsMaxDistances,
+									 numRays > 0 ? &occluded[0] : NULL, order));
+	}
+	m_pool.run(chunks);
+}
+
+void RayQuery::intersectChunk(size_t firstRay,
+							  size_t numRays,
+							  const float* wsOrigins,
+							  const float* wsDirections,
+							  RayHits* hits,
+							  RayOrder order) const
+{
+	const Imath::Box3f& bounds = m_grid.bounds();
+
+	ClippedRays clipped;
+	for( size_t i = 0; i < numRays; ++i )
+	{
+		const size_t ray = firstRay + i;
+		hits->voxel[ray] = Imath::V3i(0);
+		hits->normal[ray] = Imath::V3f(0);
+		hits->distance[ray] = -1;
+		hits->materialOffset[ray] = -1;
+
+		const Imath::V3f wsOrigin = readVector(wsOrigins + ray * 3);
+		const Imath::V3f wsDirection = readVector(wsDirections + ray * 3).normalized();
+		if (wsDirection.length2() == 0) continue;
+
+		const float wsEntryDistance = rayAABBIntersection(wsOrigin, wsDirection, bounds.min, bounds.max);
+		if (wsEntryDistance < 0) continue;
+		clipped.add(i, wsOrigin, wsDirection, wsEntryDistance);
+	}
+
+	clipped.walk(m_grid, NULL, order);
+
+	for( size_t i = 0; i < clipped.size(); ++i )
+	{
+		if (clipped.results[i] != TRAVERSAL_HIT) continue;
+
+		// the hit point and face, along the ray as given
+		const size_t ray = firstRay + clipped.rays[i];
+		const Imath::V3f wsOrigin = readVector(wsOrigins + ray * 3);
+		const Imath::V3f wsDirection = readVector(&clipped.wsDirections[i * 3]);
+		const Imath::V3i& vsHitPos = clipped.vsPositions[i];
+		const Basis wsHitBasis = voxelSpaceToWorldSpace(m_grid, vsHitPos, wsOrigin, wsDirection);
+
+		hits->voxel[ray] = vsHitPos;
+		hits->normal[ray] = wsHitBasis.normal;
+		hits->distance[ray] = (wsHitBasis.position - wsOrigin).length();
+		hits->materialOffset[ray] = m_grid.material(vsHitPos);
+	}
+}
+
+void RayQuery::occludedChunk(size_t firstRay,
+							 size_t numRays,
+							 const float* wsOrigins,
+							 const float* wsDirections,
+							 const float* wsMaxDistances,
+							 unsigned char* occluded,
+							 RayOrder order) const
+{
+	const Imath::Box3f& bounds = m_grid.bounds();
+
+	ClippedRays clipped;
+	std::vector<float> vsMaxDistances;
+	for( size_t i = 0; i < numRays; ++i )
+	{
+		const size_t ray = firstRay + i;
+		occluded[ray] = 0;
+
+		const Imath::V3f wsOrigin = readVector(wsOrigins + ray * 3);
+		const Imath::V3f wsDirection = readVector(wsDirections + ray * 3).normalized();
+		if (wsDirection.length2() == 0) continue;
+
+		// nothing to hit before the ray reaches the volume
+		const float wsEntryDistance = rayAABBIntersection(wsOrigin, wsDirection, bounds.min, bounds.max);
+		if (wsEntryDistance < 0 || wsEntryDistance >= wsMaxDistances[ray]) continue;
+		clipped.add(i, wsOrigin, wsDirection, wsEntryDistance);
+		vsMaxDistances.push_back(occlusionWalkDistance(m_grid, wsMaxDistances[ray] - wsEntryDistance));
+	}
+
+	clipped.walk(m_grid, vsMaxDistances.empty() ? NULL : &vsMaxDistances[0], order);
+
+	for( size_t i = 0; i < clipped.size(); ++i )
+	{
+		occluded[firstRay + clipped.rays[i]] = clipped.results[i] == TRAVERSAL_HIT ? 1 : 0;
+	}
+}
+
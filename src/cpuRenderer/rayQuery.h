@@ -0,0 +1,92 @@
+#pragma once
+
+#include "voxel/voxelGrid.h"
+
+#include <GL/gl.h>
+#include <OpenEXR/ImathVec.h>
+
+#include <vector>
+
+class WorkStealingPool;
+
+// Hit records of a batch of rays, one entry per ray in each array. Rays which
+// don't hit any voxel have a distance of -1, a material offset of -1, and a
+// voxel and normal of 0.
+struct RayHits
+{
+	// hit voxel, in voxel space
+	std::vector<Imath::V3i> voxel;
+	// world space normal of the voxel face hit
+	std::vector<Imath::V3f> normal;
+	// world space distance from the ray origin to the hit point
+	std::vector<float> distance;
+	// material data offset of the hit voxel (see VoxLoader::load)
+	std::vector<GLint> materialOffset;
+
+	size_t size() const { return distance.size(); }
+	void resize(size_t numRays);
+};
+
+// Casts batches of rays against a voxel grid on the CPU, e.g. for visibility
+// or line of sight analysis over a scene. Rays are given in world space,
+// placed as in the renderer (see VoxelGrid::volumeBounds); the ground under
+// the volume is not considered.
+//
+// The batch is split in chunks which run in parallel on the pool's threads,
+// and the rays of each chunk are walked in packets (see packetTraversal.h).
+// A query only reads the grid, so any number of threads may run queries at
+// the same time, although they share (and take turns on) the pool.
+class RayQuery
+{
+public:
+	// Consecutive coherent rays (e.g. a grid of rays from the same viewpoint)
+	// walk faster together as they are given. Incoherent ones are sorted
+	// first (see walkRayStream).
+	enum RayOrder
+	{
+		RAYS_COHERENT,
+		RAYS_INCOHERENT
+	};
+
+	RayQuery(const VoxelGrid& grid, WorkStealingPool& pool);
+
+	// Find the closest voxel hit by each ray. Origins and directions are given
+	// as x,y,z triplets, directions need not be normalized.
+	void intersect(size_t numRays,
+				   const float* wsOrigins,
+				   const float* wsDirections,
+				   RayHits& hits,
+				   RayOrder order = RAYS_COHERENT) const;
+
+	// Find whether there are any voxels along each ray before the given
+	// distance (e.g. between two points). occluded returns 1 for the rays
+	// which are blocked, 0 otherwise.
+	void occluded(size_t numRays,
+				  const float* wsOrigins,
+				  const float* wsDirections,
+				  const float* wsMaxDistances,
+				  std::vector<unsigned char>& occluded,
+				  RayOrder order = RAYS_COHERENT) const;
+
+	// Rays processed by each task
+	static const size_t CHUNK_SIZE = 4096;
+
+private:
+	void intersectChunk(size_t firstRay,
+						size_t numRays,
+						const float* wsOrigins,
+						const float* wsDirections,
+						RayHits* hits,
+						RayOrder order) const;
+	void occludedChunk(size_t firstRay,
+					   size_t numRays,
+					   const float* wsOrigins,
+					   const float* wsDirections,
+					   const float* wsMaxDistances,
+					   unsigned char* occluded,
+					   RayOrder order) const;
+
+	const VoxelGrid& m_grid;
+	WorkStealingPool& m_pool;
+};
+
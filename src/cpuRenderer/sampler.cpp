@@ -0,0 +1,50 @@
+#include "cpuRenderer/sampler.h"
+
+// Sobol direction numbers for dimensions 1-3 (Joe & Kuo), as in shared/random.h.
+// Dimension 0 is the van der Corput sequence, which is just the bit-reversed
+// index.
+static const boost::uint32_t sobolDirections[96] = {
+	0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u, 0xaa000000u, 0xff000000u,
+	0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u, 0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u,
+	0x80008000u, 0xc000c000u, 0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u,
+	0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu, 0xaaaaaaaau, 0xffffffffu,
+
+	0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u, 0x8e000000u, 0xc5000000u,
+	0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u, 0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u,
+	0xe8808000u, 0x5cc0c000u, 0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u,
+	0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu, 0x8e00eeeeu, 0xc5005555u,
+
+	0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u, 0xa2000000u, 0x93000000u,
+	0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u, 0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u,
+	0x208f8000u, 0x51474000u, 0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u,
+	0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u, 0x200200a2u, 0x50050093u
+};
+
+void Sampler::sobol4D(boost::uint32_t index, boost::uint32_t x[4])
+{
+	x[0] = reverseBits(index);
+	x[1] = x[2] = x[3] = 0;
+	for( int bit = 0; index != 0; ++bit, index >>= 1 )
+	{
+		if (index & 1)
+		{
+			x[1] ^= sobolDirections[bit];
+			x[2] ^= sobolDirections[32 + bit];
+			x[3] ^= sobolDirections[64 + bit];
+		}
+	}
+}
+
+// Uses the generalized golden ratio for 4 dimensions (the positive root of
+// x^5 = x + 1)
+Imath::V4f Sampler::rank1PixelShift() const
+{
+	static const float alpha[4] = { 0.8566748839f, 0.7338918566f, 0.6287067210f, 0.5385972572f };
+	Imath::V4f shift;
+	for( int i = 0; i < 4; ++i )
+	{
+		const float v = m_pixelX * alpha[i] + m_pixelY * alpha[(i + 1) % 4];
+		shift[i] = v - floorf(v);
+	}
+	return shift;
+}
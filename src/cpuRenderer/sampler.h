@@ -0,0 +1,102 @@
+#pragma once
+
+#include <OpenEXR/ImathVec.h>
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <math.h>
+
+// Owen-scrambled Sobol sampler, a port of shared/random.h so the CPU path
+// tracer draws the same well stratified sequences as the GPU one. Random
+// numbers are drawn 4 dimensions at a time; see the shader for the details.
+class Sampler
+{
+public:
+	// rank1PixelDecorrelation: see RenderSettings::m_samplerRank1PixelDecorrelation
+	Sampler(int pixelX, int pixelY, int sampleIndex, bool rank1PixelDecorrelation)
+	{
+		m_pixelX = (boost::uint32_t)pixelX;
+		m_pixelY = (boost::uint32_t)pixelY;
+		m_rank1 = rank1PixelDecorrelation;
+		m_seed = m_rank1 ? 0u : hash(hashCombine(hash(m_pixelX), m_pixelY));
+		m_sampleIndex = (boost::uint32_t)sampleIndex;
+		m_dimension = 0;
+	}
+
+	// Draw the next 4 dimensions of the current sample, in [0,1)
+	Imath::V4f next()
+	{
+		const boost::uint32_t seed = hash(hashCombine(m_seed, m_dimension));
+		m_dimension += 4;
+
+		const boost::uint32_t index = nestedUniformScramble(m_sampleIndex, seed);
+		boost::uint32_t x[4];
+		sobol4D(index, x);
+		Imath::V4f u;
+		for( int i = 0; i < 4; ++i )
+		{
+			// keep 24 bits, so the conversion to float doesn't round up to 1
+			u[i] = (float)(nestedUniformScramble(x[i], hashCombine(seed, i)) >> 8) * (1.0f / 16777216.0f);
+		}
+		if (m_rank1)
+		{
+			const Imath::V4f shift = rank1PixelShift();
+			for( int i = 0; i < 4; ++i )
+			{
+				const float v = u[i] + shift[i];
+				u[i] = std::min(v - floorf(v), 0.99999994f);
+			}
+		}
+		return u;
+	}
+
+private:
+	// PCG hash, from Jarzynski & Olano "Hash Functions for GPU Rendering"
+	static boost::uint32_t hash(boost::uint32_t v)
+	{
+		const boost::uint32_t state = v * 747796405u + 2891336453u;
+		const boost::uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+	static boost::uint32_t hashCombine(boost::uint32_t seed, boost::uint32_t v)
+	{
+		return seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+	}
+
+	static boost::uint32_t reverseBits(boost::uint32_t x)
+	{
+		x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+		x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+		x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+		x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+		return (x >> 16) | (x << 16);
+	}
+
+	static void sobol4D(boost::uint32_t index, boost::uint32_t x[4]);
+
+	static boost::uint32_t laineKarrasPermutation(boost::uint32_t x, boost::uint32_t seed)
+	{
+		x += seed;
+		x ^= x * 0x6c50b47cu;
+		x ^= x * 0xb82f1e52u;
+		x ^= x * 0xc7afe638u;
+		x ^= x * 0x8d22f6e6u;
+		return x;
+	}
+
+	static boost::uint32_t nestedUniformScramble(boost::uint32_t x, boost::uint32_t seed)
+	{
+		return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+	}
+
+	// Toroidal shift for the pixel from a rank-1 lattice
+	Imath::V4f rank1PixelShift() const;
+
+	boost::uint32_t m_pixelX, m_pixelY;
+	bool            m_rank1;
+	boost::uint32_t m_seed;
+	boost::uint32_t m_sampleIndex;
+	boost::uint32_t m_dimension;
+};
+
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <OpenEXR/ImathVec.h>
+
+#include <algorithm>
+#include <math.h>
+
+// Port of shared/sampling.h and shared/color.h
+
+// Rec709 luminance, matching shared/color.h
+inline float luminance(const Imath::V3f& rgb)
+{
+	return 0.2126f * rgb.x + 0.7152f * rgb.y + 0.0722f * rgb.z;
+}
+
+// PBRT2. Chapter 13. Page 666.
+inline void uniformlySampleDisk(float u0, float u1, float& x, float& y)
+{
+	const float r = sqrtf(u0);
+	const float theta = 2.0f * (float)M_PI * u1;
+	x = r * cosf(theta);
+	y = r * sinf(theta);
+}
+
+// Sample a hemisphere with pole at +Y axis with a distribution proportional to
+// the cosine of the theta angle. PBRT2. Chapter 13. Page 669.
+inline Imath::V3f cosineSampledHemisphere(float u0, float u1, float& pdf)
+{
+	float x, z;
+	uniformlySampleDisk(u0, u1, x, z);
+	const float y = sqrtf(std::max(0.0f, 1.0f - x*x - z*z));
+	pdf = y / (float)M_PI;
+	return Imath::V3f(x, y, z);
+}
+
+// Sample a hemisphere with pole at +Y axis with uniform distribution.
+// PBRT2. Chapter 13. Page 664.
+inline Imath::V3f uniformlySampledHemisphere(float u0, float u1, float& pdf)
+{
+	const float y = u0;
+	const float r = sqrtf(std::max(0.0f, 1.0f - y*y));
+	const float phi = u1 * 2.0f * (float)M_PI;
+	pdf = 1.0f / (2.0f * (float)M_PI);
+	return Imath::V3f(r * cosf(phi), y, r * sinf(phi));
+}
+
+// Used for Multiple Importance Sampling.
+// PBRT2. Chapter 14. Page 693.
+inline float powerHeuristic(float f, float g)
+{
+	return f*f / (f*f + g*g);
+}
+
@@ -0,0 +1,213 @@
+#include "cpuRenderer/traversalBenchmark.h"
+#include "cpuRenderer/packetTraversal.h"
+#include "cpuRenderer/rayQuery.h"
+#include "cpuRenderer/workStealingPool.h"
+#include "cpuRenderer/sampler.h"
+#include "cpuRenderer/sampling.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <cstdio>
+#include <math.h>
+#include <vector>
+
+// Rays stored the way the traversal functions take them
+struct RaySet
+{
+	std::vector<float> origins;
+	std::vector<float> directions;
+	std::vector<float> vsMaxDistances;
+
+	size_t size() const { return origins.size() / 3; }
+
+	void add(const Imath::V3f& origin, const Imath::V3f& direction, float vsMaxDistance)
+	{
+		origins.push_back(origin.x);
+		origins.push_back(origin.y);
+		origins.push_back(origin.z);
+		directions.push_back(direction.x);
+		directions.push_back(direction.y);
+		directions.push_back(direction.z);
+		vsMaxDistances.push_back(vsMaxDistance);
+	}
+};
+
+enum TraversalMode
+{
+	MODE_SCALAR,
+	MODE_PACKET,
+	MODE_STREAM,
+};
+
+static void walkRays(const VoxelGrid& grid,
+					 const RaySet& rays,
+					 TraversalMode mode,
+					 std::vector<Imath::V3i>& vsPositions,
+					 std::vector<TraversalResult>& results)
+{
+	const size_t numRays = rays.size();
+	vsPositions.resize(numRays);
+	results.resize(numRays);
+	switch(mode)
+	{
+		case MODE_SCALAR:
+		{
+			const int maxSteps = maxTraversalSteps(grid.resolution());
+			for( size_t i = 0; i < numRays; ++i )
+			{
+				results[i] = walk(grid,
+								  Imath::V3f(rays.origins[i * 3], rays.origins[i * 3 + 1], rays.origins[i * 3 + 2]),
+								  Imath::V3f(rays.directions[i * 3], rays.directions[i * 3 + 1], rays.directions[i * 3 + 2]),
+								  rays.vsMaxDistances[i],
+								  maxSteps,
+								  vsPositions[i]);
+			}
+			break;
+		}
+		case MODE_PACKET:
+			walkRayPackets(grid, numRays, &rays.origins[0], &rays.directions[0], &rays.vsMaxDistances[0],
+						   &vsPositions[0], &results[0]);
+			break;
+		case MODE_STREAM:
+			walkRayStream(grid, numRays, &rays.origins[0], &rays.directions[0], &rays.vsMaxDistances[0],
+						  &vsPositions[0], &results[0]);
+			break;
+	}
+}
+
+// Walk the rays repeatedly for a while, and return the rays per second
+static double measure(const VoxelGrid& grid,
+					  const RaySet& rays,
+					  TraversalMode mode,
+					  std::vector<Imath::V3i>& vsPositions,
+					  std::vector<TraversalResult>& results)
+{
+	const double MIN_SECONDS = 0.5;
+	const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	double seconds = 0;
+	size_t numWalked = 0;
+	do
+	{
+		walkRays(grid, rays, mode, vsPositions, results);
+		numWalked += rays.size();
+		seconds = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() * 1e-6;
+	} while (seconds < MIN_SECONDS);
+	return numWalked / seconds;
+}
+
+static void benchmark(const char* name, const VoxelGrid& grid, const RaySet& rays)
+{
+	if (rays.size() == 0)
+	{
+		printf("%-8s no rays\n", name);
+		return;
+	}
+
+	std::vector<Imath::V3i> referencePositions, vsPositions;
+	std::vector<TraversalResult> referenceResults, results;
+	const double scalar = measure(grid, rays, MODE_SCALAR, referencePositions, referenceResults);
+
+	printf("%-8s %9d rays  scalar %7.2f Mrays/s", name, (int)rays.size(), scalar * 1e-6);
+	const TraversalMode modes[] = { MODE_PACKET, MODE_STREAM };
+	const char* modeNames[] = { "packet", "stream" };
+	for( int m = 0; m < 2; ++m )
+	{
+		const double rate = measure(grid, rays, modes[m], vsPositions, results);
+		size_t mismatches = 0;
+		for( size_t i = 0; i < rays.size(); ++i )
+		{
+			if (results[i] != referenceResults[i] || vsPositions[i] != referencePositions[i]) ++mismatches;
+		}
+		printf("  %s %7.2f Mrays/s (%.2fx)", modeNames[m], rate * 1e-6, rate / scalar);
+		if (mismatches > 0) printf(" [%d mismatches]", (int)mismatches);
+	}
+	printf("\n");
+}
+
+// Measure the rays per second of batched intersection queries
+static void benchmarkQueries(const char* name,
+							 const VoxelGrid& grid,
+							 const RaySet& rays,
+							 RayQuery::RayOrder order,
+							 WorkStealingPool& pool)
+{
+	if (rays.size() == 0) return;
+
+	const RayQuery query(grid, pool);
+	RayHits hits;
+	const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	double seconds = 0;
+	size_t numQueried = 0;
+	do
+	{
+		query.intersect(rays.size(), &rays.origins[0], &rays.directions[0], hits, order);
+		numQueried += rays.size();
+		seconds = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() * 1e-6;
+	} while (seconds < 0.5);
+
+	printf("%-8s %9d rays  %7.2f Mrays/s\n", name, (int)rays.size(), numQueried / seconds * 1e-6);
+}
+
+void benchmarkTraversal(const CpuScene& scene,
+						const CpuCamera& camera,
+						const Imath::V2i& resolution,
+						WorkStealingPool& pool)
+{
+	const VoxelGrid& grid = scene.grid();
+	const int maxSteps = maxTraversalSteps(grid.resolution());
+
+	// primary rays through the pixel centers, starting where they enter the
+	// volume as in the path tracer
+	const Imath::V3f forward = (camera.target - camera.eye).normalized();
+	const Imath::V3f right = Imath::V3f(0,1,0).cross(forward).normalized();
+	const Imath::V3f up = forward.cross(right);
+	const float tanHalfFovY = tanf(camera.fovY / 2);
+	const float aspectRatio = (float)resolution.x / resolution.y;
+
+	RaySet primary;
+	std::vector<Imath::V2i> primaryPixels;
+	for( int y = 0; y < resolution.y; ++y )
+	{
+		for( int x = 0; x < resolution.x; ++x )
+		{
+			const float ndcX = 2.0f * (x + 0.5f) / resolution.x - 1.0f;
+			const float ndcY = 2.0f * (y + 0.5f) / resolution.y - 1.0f;
+			const Imath::V3f wsRayDir = (forward +
+										 right * (ndcX * aspectRatio * tanHalfFovY) +
+										 up * (ndcY * tanHalfFovY)).normalized();
+			const float entry = rayAABBIntersection(camera.eye, wsRayDir, grid.bounds().min, grid.bounds().max);
+			if (entry < 0) continue;
+			primary.add(camera.eye + wsRayDir * entry, wsRayDir, HUGE_VALF);
+			primaryPixels.push_back(Imath::V2i(x, y));
+		}
+	}
+
+	// shadow and bounce rays from the voxels hit by the primary rays
+	const Imath::V3f wsLightDir = Imath::V3f(0.4f, 1.0f, 0.3f).normalized();
+	RaySet shadow, bounce;
+	for( size_t i = 0; i < primary.size(); ++i )
+	{
+		const Imath::V3f origin(primary.origins[i * 3], primary.origins[i * 3 + 1], primary.origins[i * 3 + 2]);
+		const Imath::V3f direction(primary.directions[i * 3], primary.directions[i * 3 + 1], primary.directions[i * 3 + 2]);
+		Imath::V3i vsHitPos;
+		if (walk(grid, origin, direction, HUGE_VALF, maxSteps, vsHitPos) != TRAVERSAL_HIT) continue;
+
+		const Basis wsHitBasis = voxelSpaceToWorldSpace(grid, vsHitPos, origin, direction);
+		shadow.add(wsHitBasis.position, wsLightDir, occlusionWalkDistance(grid, HUGE_VALF));
+
+		Sampler sampler(primaryPixels[i].x, primaryPixels[i].y, 0, false);
+		const Imath::V4f u = sampler.next();
+		float pdf;
+		bounce.add(wsHitBasis.position, wsHitBasis.localToWorld(cosineSampledHemisphere(u[0], u[1], pdf)), HUGE_VALF);
+	}
+
+	printf("Traversal throughput on one thread (%s packets)\n",
+		   packetTraversalUsesAVX2() ? "AVX2" : "scalar");
+	benchmark("primary", grid, primary);
+	benchmark("shadow", grid, shadow);
+	benchmark("bounce", grid, bounce);
+
+	printf("Batched intersection queries on %d threads\n", pool.numThreads());
+	benchmarkQueries("primary", grid, primary, RayQuery::RAYS_COHERENT, pool);
+	benchmarkQueries("bounce", grid, bounce, RayQuery::RAYS_INCOHERENT, pool);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "cpuRenderer/cpuPathTracer.h"
+#include "cpuRenderer/cpuScene.h"
+
+class WorkStealingPool;
+
+// Measure the throughput, in rays per second on a single thread, of the
+// scalar, packet and ray stream traversals (see packetTraversal.h) for the
+// kinds of rays the path tracer casts:
+//
+//  - primary rays through the pixels of the camera (coherent)
+//  - shadow rays from the primary hits towards a distant light (coherent)
+//  - rays bounced off the primary hits in cosine distributed directions
+//    (incoherent)
+//
+// The results of the packet traversals are checked against the scalar ones.
+// The throughput of batched ray queries (see RayQuery) on all the pool's
+// threads is measured as well. Results are printed to stdout.
+void benchmarkTraversal(const CpuScene& scene,
+						const CpuCamera& camera,
+						const Imath::V2i& resolution,
+						WorkStealingPool& pool);
+
@@ -0,0 +1,137 @@
+#include "cpuRenderer/workStealingPool.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(int numThreads)
+{
+	if (numThreads <= 0) numThreads = std::max(1u, boost::thread::hardware_concurrency());
+
+	m_tasks = NULL;
+	m_batch = 0;
+	m_busyWorkers = 0;
+	m_quit = false;
+
+	for( int i = 0; i < numThreads; ++i )
+	{
+		m_queues.push_back(new Queue());
+		m_queues.back()->stolen = 0;
+	}
+	// worker 0 is the thread calling run()
+	for( int i = 1; i < numThreads; ++i )
+	{
+		m_threads.create_thread(boost::bind(&WorkStealingPool::workerLoop, this, i));
+	}
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_batchStarted.notify_all();
+	m_threads.join_all();
+
+	for( size_t i = 0; i < m_queues.size(); ++i ) delete m_queues[i];
+}
+
+void WorkStealingPool::run(const std::vector<Task>& tasks)
+{
+	if (tasks.empty()) return;
+	boost::lock_guard<boost::mutex> runLock(m_runMutex);
+
+	// deal out the tasks in contiguous blocks
+	const size_t numWorkers = m_queues.size();
+	for( size_t i = 0; i < numWorkers; ++i )
+	{
+		Queue& queue = *m_queues[i];
+		boost::lock_guard<boost::mutex> lock(queue.mutex);
+		queue.tasks.clear();
+		queue.stolen = 0;
+		for( size_t task = tasks.size() * i / numWorkers; task < tasks.size() * (i + 1) / numWorkers; ++task )
+		{
+			queue.tasks.push_back(task);
+		}
+	}
+
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		m_tasks = &tasks;
+		m_busyWorkers = (int)numWorkers - 1;
+		++m_batch;
+	}
+	m_batchStarted.notify_all();
+
+	work(0);
+
+	boost::unique_lock<boost::mutex> lock(m_mutex);
+	while (m_busyWorkers > 0) m_batchFinished.wait(lock);
+	m_tasks = NULL;
+}
+
+size_t WorkStealingPool::numSteals() const
+{
+	size_t steals = 0;
+	for( size_t i = 0; i < m_queues.size(); ++i ) steals += m_queues[i]->stolen;
+	return steals;
+}
+
+void WorkStealingPool::workerLoop(int worker)
+{
+	unsigned int batch = 0;
+	for(;;)
+	{
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			while (!m_quit && m_batch == batch) m_batchStarted.wait(lock);
+			if (m_quit) return;
+			batch = m_batch;
+		}
+
+		work(worker);
+
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		if (--m_busyWorkers == 0) m_batchFinished.notify_one();
+	}
+}
+
+void WorkStealingPool::work(int worker)
+{
+	const std::vector<Task>& tasks = *m_tasks;
+	size_t task;
+	while (pop(worker, task) || steal(worker, task))
+	{
+		tasks[task]();
+	}
+}
+
+bool WorkStealingPool::pop(int worker, size_t& task)
+{
+	Queue& queue = *m_queues[worker];
+	boost::lock_guard<boost::mutex> lock(queue.mutex);
+	if (queue.tasks.empty()) return false;
+	task = queue.tasks.front();
+	queue.tasks.pop_front();
+	return true;
+}
+
+bool WorkStealingPool::steal(int worker, size_t& task)
+{
+	// Take the task furthest from the ones the victim is working on. No new
+	// tasks are added during a batch, so once every queue is empty we're done.
+	const int numWorkers = (int)m_queues.size();
+	for( int i = 1; i < numWorkers; ++i )
+	{
+		Queue& victim = *m_queues[(worker + i) % numWorkers];
+		boost::lock_guard<boost::mutex> lock(victim.mutex);
+		if (victim.tasks.empty()) continue;
+		task = victim.tasks.back();
+		victim.tasks.pop_back();
+		++victim.stolen;
+		return true;
+	}
+	return false;
+}
+
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+#include <deque>
+#include <vector>
+
+// Pool of threads running batches of independent tasks, e.g. the tiles of an
+// image. The tasks of a batch are dealt out to the workers in contiguous
+// blocks, so each works on a coherent region of the image; a worker which runs
+// out of tasks steals them from the back of the others' queues. This keeps all
+// cores busy when some tiles are much more expensive than others, without
+// every worker contending for a single shared queue.
+//
+// The calling thread takes part as one of the workers, the rest are kept
+// waiting for the next batch between runs.
+class WorkStealingPool
+{
+public:
+	typedef boost::function<void ()> Task;
+
+	// Create a pool with the given number of threads (0 = one per core)
+	explicit WorkStealingPool(int numThreads = 0);
+	~WorkStealingPool();
+
+	int numThreads() const { return (int)m_queues.size(); }
+
+	// Run all the tasks and wait for them to finish. Tasks must not throw, nor
+	// call run themselves. Calls from different threads run one after the
+	// other.
+	void run(const std::vector<Task>& tasks);
+
+	// Number of tasks stolen during the last run
+	size_t numSteals() const;
+
+private:
+	// Tasks dealt to a worker, as indices into the batch
+	struct Queue
+	{
+		boost::mutex mutex;
+		std::deque<size_t> tasks;
+		size_t stolen;
+	};
+
+	void workerLoop(int worker);
+	// Run tasks until there are none left in any queue
+	void work(int worker);
+	bool pop(int worker, size_t& task);
+	bool steal(int worker, size_t& task);
+
+	// held for the whole of run()
+	boost::mutex m_runMutex;
+
+	std::vector<Queue*> m_queues;
+	boost::thread_group m_threads;
+
+	// current batch, guarded by m_mutex
+	boost::mutex m_mutex;
+	boost::condition_variable m_batchStarted;
+	boost::condition_variable m_batchFinished;
+	const std::vector<Task>* m_tasks;
+	unsigned int m_batch;
+	int m_busyWorkers;
+	bool m_quit;
+};
+
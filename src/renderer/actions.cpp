@@ -17,8 +17,9 @@ void Renderer::requestAction(float x, float y,
 	m_scheduledActions.push_back(a);
 }
 
-void Renderer::processPendingActions()
+bool Renderer::processPendingActions()
 {
+	bool volumeModified = false;
 	for( size_t i = 0; i < m_scheduledActions.size(); ++i )
 	{	
 		const Action& a = m_scheduledActions[i];
@@ -38,17 +39,26 @@ void Renderer::processPendingActions()
 			case Action::PA_SELECT_ACTIVE_VOXEL: requiredService = SERVICE_SELECT_ACTIVE_VOXEL; break;
 			case Action::PA_ADD_VOXEL:           requiredService = SERVICE_ADD_VOXEL          ; break;
 			case Action::PA_REMOVE_VOXEL:        requiredService = SERVICE_REMOVE_VOXEL       ; break;
+			case Action::PA_END_EDIT:            m_voxelEditInProgress = false                ; break;
 			default: break;
 		}
 
-		if ( m_services[requiredService] != NULL )
+		RendererService* rendererService = service(requiredService);
+		if ( rendererService != NULL )
 		{
-			m_services[requiredService]->setMouseParameters(position, velocity);
-			m_services[requiredService]->execute();
+			rendererService->setMouseParameters(position, velocity);
+			rendererService->execute();
+			if (requiredService == SERVICE_ADD_VOXEL || 
+				requiredService == SERVICE_REMOVE_VOXEL)
+			{
+				volumeModified = true;
+				m_voxelEditInProgress = true;
+			}
 		}
 	}
 	glUseProgram(0);
 	m_scheduledActions.resize(0);
+	return volumeModified;
 }
 
 
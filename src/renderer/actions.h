@@ -9,7 +9,9 @@ struct Action
 		PA_SELECT_FOCAL_POINT,
 		PA_SELECT_ACTIVE_VOXEL,
 		PA_ADD_VOXEL,
-		PA_REMOVE_VOXEL
+		PA_REMOVE_VOXEL,
+		// the edit stroke (e.g. a mouse drag adding voxels) is over
+		PA_END_EDIT
 	};
 	
 	PICKING_ACTION m_type;
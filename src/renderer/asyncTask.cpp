@@ -0,0 +1,38 @@
+#include "renderer/asyncTask.h"
+
+#include <boost/bind.hpp>
+
+AsyncTask::AsyncTask(const boost::function<bool ()>& function) :
+	m_function(function),
+	m_finished(false),
+	m_succeeded(false)
+{
+	m_thread = boost::thread(boost::bind(&AsyncTask::run, this));
+}
+
+AsyncTask::~AsyncTask()
+{
+	m_thread.join();
+}
+
+bool AsyncTask::finished()
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	return m_finished;
+}
+
+bool AsyncTask::succeeded()
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	return m_succeeded;
+}
+
+void AsyncTask::run()
+{
+	const bool success = m_function();
+
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	m_succeeded = success;
+	m_finished = true;
+}
+
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+// Runs a function in a worker thread, and lets the thread which started it
+// poll for its completion without blocking.
+class AsyncTask
+{
+public:
+	// Start running the function. It returns whether it succeeded.
+	AsyncTask(const boost::function<bool ()>& function);
+	// Waits for the function to return.
+	~AsyncTask();
+
+	// Whether the function returned.
+	bool finished();
+	// Whether the function succeeded. Only valid once finished.
+	bool succeeded();
+
+private:
+	void run();
+
+	boost::function<bool ()> m_function;
+
+	boost::mutex  m_mutex;
+	bool          m_finished;
+	bool          m_succeeded;
+	boost::thread m_thread;
+};
+
@@ -0,0 +1,156 @@
+#include "renderer/checkpoint.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+// Bump this whenever the file layout changes.
+static const boost::uint32_t CHECKPOINT_VERSION = 2;
+static const char CHECKPOINT_MAGIC[4] = { 'V', 'T', 'C', 'P' };
+
+template<typename T>
+inline void writeValue(std::ostream& out, const T& value)
+{
+	out.write((const char*)&value, sizeof(T));
+}
+
+template<typename T>
+inline bool readValue(std::istream& in, T& value)
+{
+	return (bool)in.read((char*)&value, sizeof(T));
+}
+
+inline void writeString(std::ostream& out, const std::string& s)
+{
+	writeValue(out, (boost::uint32_t)s.size());
+	out.write(s.data(), s.size());
+}
+
+inline bool readString(std::istream& in, std::string& s)
+{
+	boost::uint32_t size;
+	if (!readValue(in, size) || size > 4096) return false;
+	s.resize(size);
+	return size == 0 || (bool)in.read(&s[0], size);
+}
+
+bool Checkpoint::write(const std::string& file, const float* pixels) const
+{
+	// write to a temporary file first, so a crash while writing never
+	// destroys the previous checkpoint.
+	std::ostringstream ss;
+	ss << file << "." << getpid() << ".tmp";
+	const std::string temporaryFile = ss.str();
+	{
+		std::ofstream out(temporaryFile.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+
+		out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+		writeValue(out, CHECKPOINT_VERSION);
+		writeValue(out, sceneHash);
+		writeValue(out, (boost::int32_t)integrator);
+		writeValue(out, (boost::int32_t)numberSamples);
+		writeValue(out, (boost::int32_t)width);
+		writeValue(out, (boost::int32_t)height);
+
+		writeValue(out, eye);
+		writeValue(out, target);
+		writeValue(out, focalLength);
+		writeValue(out, focalDistance);
+		writeValue(out, lensRadius);
+		writeValue(out, (boost::int32_t)lensModel);
+
+		writeValue(out, (boost::int32_t)settings.m_pathtracerMaxNumBounces);
+		writeValue(out, (boost::int32_t)settings.m_pathtracerMaxSamples);
+		writeValue(out, settings.m_adaptiveSamplingThreshold);
+		writeValue(out, (boost::int32_t)settings.m_adaptiveSamplingMinSamples);
+		writeValue(out, settings.m_wireframeOpacity);
+		writeValue(out, settings.m_wireframeThickness);
+		writeValue(out, (boost::int32_t)settings.m_voxelLodMaxLevel);
+		writeValue(out, (boost::int32_t)(settings.m_samplerRank1PixelDecorrelation ? 1 : 0));
+		writeValue(out, (boost::int32_t)settings.m_lightSelectionStrategy);
+		writeString(out, settings.m_backgroundImage);
+		writeValue(out, settings.m_backgroundColor[0]);
+		writeValue(out, settings.m_backgroundColor[1]);
+		writeValue(out, (boost::int32_t)settings.m_backgroundRotationDegrees);
+
+		out.write((const char*)pixels, pixelDataSize() * sizeof(float));
+		if (!out)
+		{
+			out.close();
+			remove(temporaryFile.c_str());
+			return false;
+		}
+	}
+	if (rename(temporaryFile.c_str(), file.c_str()) != 0)
+	{
+		remove(temporaryFile.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool Checkpoint::read(const std::string& file, std::vector<float>& pixels)
+{
+	std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+	if (!in) return false;
+
+	char magic[4];
+	boost::uint32_t version;
+	if (!in.read(magic, sizeof(magic)) ||
+		memcmp(magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 ||
+		!readValue(in, version) ||
+		version != CHECKPOINT_VERSION)
+	{
+		return false;
+	}
+
+	boost::int32_t i32[5];
+	if (!readValue(in, sceneHash) ||
+		!readValue(in, i32[3]) ||
+		!readValue(in, i32[0]) ||
+		!readValue(in, i32[1]) ||
+		!readValue(in, i32[2])) return false;
+	integrator = i32[3];
+	numberSamples = i32[0];
+	width = i32[1];
+	height = i32[2];
+	if (integrator < 0 || numberSamples < 0 || width <= 0 || height <= 0 || width > 65536 || height > 65536) return false;
+
+	if (!readValue(in, eye) ||
+		!readValue(in, target) ||
+		!readValue(in, focalLength) ||
+		!readValue(in, focalDistance) ||
+		!readValue(in, lensRadius) ||
+		!readValue(in, i32[0])) return false;
+	lensModel = i32[0];
+
+	if (!readValue(in, i32[0]) ||
+		!readValue(in, i32[1]) ||
+		!readValue(in, settings.m_adaptiveSamplingThreshold) ||
+		!readValue(in, i32[2]) ||
+		!readValue(in, settings.m_wireframeOpacity) ||
+		!readValue(in, settings.m_wireframeThickness) ||
+		!readValue(in, i32[3]) ||
+		!readValue(in, i32[4])) return false;
+	settings.m_pathtracerMaxNumBounces = i32[0];
+	settings.m_pathtracerMaxSamples = i32[1];
+	settings.m_adaptiveSamplingMinSamples = i32[2];
+	settings.m_voxelLodMaxLevel = i32[3];
+	settings.m_samplerRank1PixelDecorrelation = i32[4] != 0;
+
+	if (!readValue(in, i32[0]) ||
+		!readString(in, settings.m_backgroundImage) ||
+		!readValue(in, settings.m_backgroundColor[0]) ||
+		!readValue(in, settings.m_backgroundColor[1]) ||
+		!readValue(in, i32[1])) return false;
+	settings.m_lightSelectionStrategy = (RenderSettings::LightSelectionStrategy)i32[0];
+	settings.m_backgroundRotationDegrees = i32[1];
+
+	pixels.resize(pixelDataSize());
+	return (bool)in.read((char*)&pixels[0], pixels.size() * sizeof(float));
+}
+
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "renderer/renderSettings.h"
+
+#include <OpenEXR/ImathVec.h>
+#include <boost/cstdint.hpp>
+
+#include <string>
+#include <vector>
+
+// State of a progressive render, saved periodically so long renders can be
+// resumed after the application (or the machine) restarts.
+struct Checkpoint
+{
+	// Identifies the scene the samples were rendered from (see
+	// Renderer::sceneHash). A checkpoint is only resumed on the same scene.
+	boost::uint64_t sceneHash;
+
+	// Integrator which produced the samples (Renderer::Integrator)
+	int integrator;
+
+	int numberSamples;
+	// resolution of the accumulation buffer
+	int width, height;
+
+	// camera
+	Imath::V3f eye;
+	Imath::V3f target;
+	float focalLength;
+	float focalDistance;
+	float lensRadius;
+	int   lensModel;
+
+	// Render settings. Only those which affect the rendered image are stored,
+	// the rest are left untouched when reading.
+	RenderSettings settings;
+
+	// Number of floats of the buffers saved along with the checkpoint: the
+	// accumulation buffer (RGBA) followed by the second moments used by
+	// adaptive sampling (R).
+	size_t pixelDataSize() const { return (size_t)width * height * 5; }
+
+	// Write the checkpoint along with the given pixel data. The file is only
+	// replaced once it's been fully written. Returns true if successful.
+	bool write(const std::string& file, const float* pixels) const;
+	// Read a checkpoint and its pixel data. Returns false if the file is
+	// missing or invalid.
+	bool read(const std::string& file, std::vector<float>& pixels);
+};
+
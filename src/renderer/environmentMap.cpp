@@ -0,0 +1,218 @@
+#include "renderer/environmentMap.h"
+#include "renderer/image.h"
+#include "cache/cache.h"
+
+#include <boost/bind.hpp>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+// Bump this whenever the way the distributions are computed changes, so
+// outdated cache entries are ignored.
+static const boost::uint32_t CACHE_VERSION = 3;
+static const char CACHE_MAGIC[4] = { 'V', 'T', 'E', 'M' };
+// Cached environment maps take this much disk space at most, the least
+// recently used ones are removed beyond that.
+static const boost::uint64_t CACHE_MAX_SIZE = 256 << 20;
+
+// Header of a cached environment map. The data follows it: alias U
+// (aliasUWidth x aliasUHeight entries) then alias V (aliasVSize entries).
+struct CacheHeader
+{
+	char magic[4];
+	boost::uint32_t version;
+	boost::uint32_t maxCDFSize;
+	boost::uint32_t aliasUWidth;
+	boost::uint32_t aliasUHeight;
+	boost::uint32_t aliasVSize;
+	float radianceIntegral;
+};
+
+// Hash identifying an image file by its absolute path, size and modification
+// time, so the cache can be looked up without decoding the image. Returns
+// false if the file can't be found.
+bool hashImageFile(const std::string& path, boost::uint64_t& hash)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) return false;
+
+	char* absolutePath = realpath(path.c_str(), NULL);
+	if (absolutePath == NULL) return false;
+	hash = hashString(HASH_SEED, absolutePath);
+	free(absolutePath);
+
+	const boost::uint64_t size = st.st_size;
+	const boost::uint64_t mtime = st.st_mtime;
+	hash = hashCombine(hash, (boost::uint32_t)size);
+	hash = hashCombine(hash, (boost::uint32_t)(size >> 32));
+	hash = hashCombine(hash, (boost::uint32_t)mtime);
+	hash = hashCombine(hash, (boost::uint32_t)(mtime >> 32));
+	return true;
+}
+
+// Path of the cache entry for an image with the given hash (see
+// hashImageFile). The resolution of the distributions is part of it, as they
+// depend on it.
+std::string cacheFile(const std::string& directory, boost::uint64_t hash)
+{
+	std::ostringstream ss;
+	ss << directory << "/envmap-" << std::hex << hash << "-" << std::dec << MAX_CDF_SIZE << ".alias";
+	return ss.str();
+}
+
+bool readCache(const std::string& file, EnvironmentMap& map)
+{
+	std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+	if (!in) return false;
+
+	CacheHeader header;
+	if (!in.read((char*)&header, sizeof(header))) return false;
+	if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+		header.version != CACHE_VERSION ||
+		header.maxCDFSize != MAX_CDF_SIZE ||
+		header.aliasUWidth == 0 || header.aliasUWidth > MAX_CDF_SIZE ||
+		header.aliasUHeight == 0 || header.aliasUHeight > MAX_CDF_SIZE ||
+		header.aliasVSize != header.aliasUHeight)
+	{
+		return false;
+	}
+
+	map.aliasUWidth = header.aliasUWidth;
+	map.aliasUHeight = header.aliasUHeight;
+	map.aliasU.resize(header.aliasUWidth * header.aliasUHeight);
+	map.aliasV.resize(header.aliasVSize);
+	map.radianceIntegral = header.radianceIntegral;
+	if (!in.read((char*)&map.aliasU[0], map.aliasU.size() * sizeof(unsigned int)) ||
+		!in.read((char*)&map.aliasV[0], map.aliasV.size() * sizeof(unsigned int))) return false;
+	touchCacheEntry(file);
+	return true;
+}
+
+void writeCache(const std::string& file, const EnvironmentMap& map)
+{
+	CacheHeader header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.maxCDFSize = MAX_CDF_SIZE;
+	header.aliasUWidth = map.aliasUWidth;
+	header.aliasUHeight = map.aliasUHeight;
+	header.aliasVSize = map.aliasV.size();
+	header.radianceIntegral = map.radianceIntegral;
+
+	// write to a temporary file first, so other instances never read a
+	// partially written entry.
+	std::ostringstream ss;
+	ss << file << "." << getpid() << ".tmp";
+	const std::string temporaryFile = ss.str();
+	{
+		std::ofstream out(temporaryFile.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out) return;
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)&map.aliasU[0], map.aliasU.size() * sizeof(unsigned int));
+		out.write((const char*)&map.aliasV[0], map.aliasV.size() * sizeof(unsigned int));
+		if (!out)
+		{
+			out.close();
+			remove(temporaryFile.c_str());
+			return;
+		}
+	}
+	if (rename(temporaryFile.c_str(), file.c_str()) != 0) remove(temporaryFile.c_str());
+
+	pruneCache("envmap-", CACHE_MAX_SIZE);
+}
+
+bool loadEnvironmentMap(const std::string& path, EnvironmentMap& map)
+{
+	map.path = path;
+
+	// look the distributions up before decoding the image. The pixels are
+	// still needed to draw the background, but not the pass over them to
+	// build the distributions.
+	const std::string directory = cacheDirectory();
+	boost::uint64_t hash;
+	const std::string file = (directory.empty() || !hashImageFile(path, hash)) ? "" : cacheFile(directory, hash);
+	const bool cached = !file.empty() && readCache(file, map);
+
+	if (!loadImage(path, map.width, map.height, map.pixels)) return false;
+	if (cached) return true;
+
+	if (!calculateAliasTables(&map.pixels[0], map.width, map.height,
+							  map.aliasU, map.aliasUWidth, map.aliasUHeight,
+							  map.aliasV,
+							  map.radianceIntegral)) return false;
+
+	if (!file.empty()) writeCache(file, map);
+	return true;
+}
+
+EnvironmentMapLoader::EnvironmentMapLoader()
+{
+	m_busy = false;
+	m_finished = false;
+}
+
+EnvironmentMapLoader::~EnvironmentMapLoader()
+{
+	if (m_busy) m_thread.join();
+}
+
+void EnvironmentMapLoader::request(const std::string& path)
+{
+	m_requested = path;
+	// if the worker is busy, the new request is started once it's done (see
+	// poll). There's no way to interrupt reading an image.
+	if (!m_busy && !m_requested.empty()) start();
+}
+
+void EnvironmentMapLoader::start()
+{
+	m_loading = m_requested;
+	m_finished = false;
+	m_result.reset();
+	m_busy = true;
+	m_thread = boost::thread(boost::bind(&EnvironmentMapLoader::load, this, m_loading));
+}
+
+void EnvironmentMapLoader::load(std::string path)
+{
+	boost::shared_ptr<EnvironmentMap> map(new EnvironmentMap());
+	if (!loadEnvironmentMap(path, *map)) map.reset();
+
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	m_result = map;
+	m_finished = true;
+}
+
+EnvironmentMapLoader::Status EnvironmentMapLoader::poll(boost::shared_ptr<EnvironmentMap>& map)
+{
+	if (!m_busy) return STATUS_IDLE;
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		if (!m_finished) return STATUS_LOADING;
+	}
+	m_thread.join();
+	m_busy = false;
+
+	boost::shared_ptr<EnvironmentMap> result;
+	result.swap(m_result);
+	if (m_loading != m_requested)
+	{
+		// the image requested changed while this one was being loaded
+		if (m_requested.empty()) return STATUS_IDLE;
+		start();
+		return STATUS_LOADING;
+	}
+
+	if (!result) return STATUS_FAILED;
+	map = result;
+	return STATUS_LOADED;
+}
+
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <string>
+#include <vector>
+
+// Background image, along with the distributions used to importance sample it
+// (see calculateAliasTables in image.h).
+struct EnvironmentMap
+{
+	std::string path;
+
+	// RGB float pixels
+	unsigned int width, height;
+	std::vector<float> pixels;
+
+	unsigned int aliasUWidth, aliasUHeight;
+	std::vector<unsigned int> aliasU;
+	std::vector<unsigned int> aliasV;
+	// integral of the image luminance times sin(theta), used to calculate the
+	// PDF of each environment sample.
+	float radianceIntegral;
+};
+
+// Load an image and compute the distributions to sample it. These only depend
+// on the image contents and the resolution of the distributions, so they are
+// cached on disk (under $XDG_CACHE_HOME/voxelToy) the first time an image is
+// processed and read back from there afterwards, as long as the file isn't
+// modified. Returns false if the image could not be loaded.
+bool loadEnvironmentMap(const std::string& path, EnvironmentMap& map);
+
+// Loads environment maps in a worker thread, so switching the background
+// image doesn't freeze the renderer. All methods are meant to be called from
+// the same (render) thread.
+class EnvironmentMapLoader
+{
+public:
+	EnvironmentMapLoader();
+	// Waits for the image being loaded, if any.
+	~EnvironmentMapLoader();
+
+	// Start loading the given image. The result of any earlier request which
+	// hasn't been collected yet is discarded; an empty path simply cancels it.
+	void request(const std::string& path);
+
+	// Image of the last request.
+	const std::string& requested() const { return m_requested; }
+
+	// Whether the worker thread is running.
+	bool busy() const { return m_busy; }
+
+	enum Status
+	{
+		STATUS_IDLE,
+		STATUS_LOADING,
+		STATUS_LOADED,
+		STATUS_FAILED,
+	};
+
+	// Check on the last request. Once it is loaded, the environment map is
+	// returned along with STATUS_LOADED; STATUS_LOADED and STATUS_FAILED are
+	// reported only once, after which the loader is idle again.
+	Status poll(boost::shared_ptr<EnvironmentMap>& map);
+
+private:
+	// Spawn the worker thread for the last request.
+	void start();
+	// Worker thread entry point.
+	void load(std::string path);
+
+	// Image of the last request, and image being loaded by the worker thread.
+	std::string m_requested;
+	std::string m_loading;
+	bool m_busy;
+	boost::thread m_thread;
+
+	// Result of the worker thread, guarded by m_mutex.
+	boost::mutex m_mutex;
+	bool m_finished;
+	boost::shared_ptr<EnvironmentMap> m_result;
+};
+
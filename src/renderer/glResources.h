@@ -10,37 +10,88 @@ struct GLResourceConfiguration
 	{
 		TEXTURE_UNIT_MATERIAL_OFFSET = 0,
 		TEXTURE_UNIT_MATERIAL_DATA,
-		TEXTURE_UNIT_SAMPLE,
-		TEXTURE_UNIT_AVERAGE0,
-		TEXTURE_UNIT_AVERAGE1,
-		TEXTURE_UNIT_NOISE,
+		TEXTURE_UNIT_ACCUMULATION,
+		TEXTURE_UNIT_PREVIEW_ACCUMULATION,
+		TEXTURE_UNIT_MOMENTS,
+		TEXTURE_UNIT_CONVERGENCE_MASK,
 		TEXTURE_UNIT_BACKGROUND,
-		TEXTURE_UNIT_BACKGROUND_CDF_U,
-		TEXTURE_UNIT_BACKGROUND_CDF_V,
-		TEXTURE_UNIT_EMISSIVE_VOXEL_INDICES,
+		TEXTURE_UNIT_BACKGROUND_ALIAS_U,
+		TEXTURE_UNIT_BACKGROUND_ALIAS_V,
 	};
 
 	static const GLuint m_focalDistanceSSBOBindingPointIndex = 0;
 	static const GLuint m_selectedVoxelSSBOBindingPointIndex = 1;
-	
+	static const GLuint m_lightAliasTableSSBOBindingPointIndex = 2;
+	static const GLuint m_lightTreeSSBOBindingPointIndex = 3;
+	static const GLuint m_unconvergedTilesCounterBindingPointIndex = 0;
+	static const GLuint m_convergenceMaskImageUnit = 2;
+	// size in pixels of the tiles of the convergence mask. Must match the
+	// work group size in adaptiveSampling/convergence.cs
+	static const int m_convergenceTileSize = 16;
+	static const GLuint m_wavefrontPathsSSBOBindingPointIndex = 4;
+	static const GLuint m_wavefrontQueuesSSBOBindingPointIndex = 5;
+	static const GLuint m_wavefrontQueueCountersSSBOBindingPointIndex = 6;
+	static const GLuint m_wavefrontAccumulationImageUnit = 3;
+	static const GLuint m_wavefrontMomentsImageUnit = 4;
+	// levels of the voxel mip chain read and written while building it on
+	// the GPU, and the work group size. Must match voxelMipmap/downsample.cs
+	static const GLuint m_voxelMipmapSourceImageUnit = 5;
+	static const GLuint m_voxelMipmapDestinationImageUnit = 6;
+	static const int m_voxelMipmapWorkGroupSize = 4;
+	// most paths traced at once by the wavefront path tracer. Larger images
+	// are rendered in several waves.
+	static const int m_wavefrontMaxPaths = 1 << 19;
+	// binding points of the uniform buffers shared by all the programs. Must
+	// match shaders/uniformBlocks/uniformBlocksDevice.h
+	static const GLuint m_cameraUBOBindingPointIndex = 0;
+	static const GLuint m_volumeUBOBindingPointIndex = 1;
+	static const GLuint m_settingsUBOBindingPointIndex = 2;
+
 	GLuint m_mainFBO;
 	GLuint m_mainRBO;
-	GLuint m_sampleTexture;
-	GLuint m_averageTexture[2];
-	GLuint m_noiseTexture;
+	// vertex array with no attributes, bound to draw the triangle covering the
+	// viewport (see shared/screenSpace.vs)
+	GLuint m_fullscreenVAO;
+	// sum of all the samples rendered so far (rgb) and their count (alpha)
+	GLuint m_accumulationTexture;
+	// same as above, for the reduced resolution image rendered during
+	// interaction (only its bottom-left corner is used).
+	GLuint m_previewAccumulationTexture;
+	// sum of the squared luminance of all the samples rendered so far
+	GLuint m_momentsTexture;
+	// one texel per tile of the image, non-zero once the tile has converged
+	GLuint m_convergenceMaskTexture;
+	// atomic counter with the number of tiles yet to converge, and the buffer
+	// it's copied into to be read back without stalling
+	GLuint m_unconvergedTilesCounter;
+	GLuint m_unconvergedTilesReadback;
 	GLint m_textureDimensions[2];
 
 	GLuint m_focalDistanceSSBO;
 	GLuint m_selectedVoxelSSBO;
+	// table used to select the light to sample (see lightAliasTableHost.h)
+	GLuint m_lightAliasTableSSBO;
+	// light tree over the emissive voxels (see lightTreeHost.h)
+	GLuint m_lightTreeSSBO;
+
+	// state of the paths traced by the wavefront path tracer, the queues of
+	// paths waiting on each of its stages, and their sizes (see
+	// wavefrontHost.h). They're only allocated once the wavefront path tracer
+	// is used, for as many paths as m_wavefrontCapacity.
+	GLuint m_wavefrontPathsSSBO;
+	GLuint m_wavefrontQueuesSSBO;
+	GLuint m_wavefrontQueueCountersSSBO;
+	int    m_wavefrontCapacity;
 
 	GLuint m_materialOffsetTexture;
 	GLuint m_materialDataTexture;
 	GLuint m_backgroundTexture;
-	GLuint m_backgroundCDFUTexture;
-	GLuint m_backgroundCDFVTexture;
-	GLuint m_emissiveVoxelIndicesTexture;
+	GLuint m_backgroundAliasUTexture;
+	GLuint m_backgroundAliasVTexture;
 
 	Imath::V3i	 m_volumeResolution;
+	// number of levels in the voxel mip chain stored in m_materialOffsetTexture
+	int          m_volumeNumLevels;
 };
 
 
@@ -1,21 +1,24 @@
 #include "renderer/image.h"
+#include "renderer/lights/aliasTable.h"
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
 
+#include "thirdParty/boost/threadpool.hpp"
+
 #include <math.h>
 
-// This clamps the resolution of the CDF functions used to sample the
-// environment map. It is a tradeoff between quality and performance: larger CDF
-// will capture more detail (e.g. small and bright pixels on the image which act
-// as point lights) but require more steps on the binary search thus degrading
-// performance. The smaller the map, the faster we'll find the region to sample
-// from, but we might miss high frequency detail on the original image.
-#define MAX_CDF_SIZE 512
+using namespace boost::threadpool;
 
 /// Forward declaration
-float calculateImageIntegral(const OpenImageIO::ImageBuf& image,
-							 float* functionU);
+inline unsigned int packAliasEntry(const AliasTable::Entry& entry);
+void calculateRowDistributions(const float* intensities,
+							   unsigned int imageWidth,
+							   unsigned int imageHeight,
+							   unsigned int fromY,
+							   unsigned int toY,
+							   unsigned int* aliasU,
+							   float* functionV);
 bool generateImageFunction( const float* rgbPixels, 
 							unsigned int imageWidth, 
 							unsigned int imageHeight,
@@ -60,15 +63,15 @@ bool loadImage(const std::string& path,
 
 // =============================================================================
 /// This method computes the distribution functions over a 2D image used to
-/// sample such image. We'll do this to perform importance sampling of the
-/// environment map. 
-/// The implementation here matches that of PBRT 2 (Chapter 14.6.5).
+/// sample such image, and turns them into alias tables. We'll do this to 
+/// perform importance sampling of the environment map. 
+/// The distributions match those of PBRT 2 (Chapter 14.6.5).
 // =============================================================================
 
-bool calculateCDF( const float* rgbPixels, unsigned int imageWidth, unsigned int imageHeight,
-				   std::vector<float>& cdfUData, unsigned int& cdfUDataWidth, unsigned int& cdfUDataHeight,
-				   std::vector<float>& cdfVData, 
-				   float& environmentTextureIntegral )
+bool calculateAliasTables( const float* rgbPixels, unsigned int imageWidth, unsigned int imageHeight,
+						   std::vector<unsigned int>& aliasUData, unsigned int& aliasUDataWidth, unsigned int& aliasUDataHeight,
+						   std::vector<unsigned int>& aliasVData, 
+						   float& environmentTextureIntegral )
 {
 	/*
 	 *  pixel intensities
@@ -92,73 +95,46 @@ bool calculateCDF( const float* rgbPixels, unsigned int imageWidth, unsigned int
 	 *         ...         |
 	 *                    Column N
 	 *
-	 *  CDF U
-	 *  -----
+	 *  Alias U
+	 *  -------
 	 *
-	 *  Has one extra column than the original image, and the same number of
-	 *  row. Each row contains the normalized cummulative distribution of the
-	 *  matching row in the original image. 
-	 *  For a given row r, we calculate the monotonically increasing values of
-	 *  the columns by adding the pixel intensity to the previous column value,
-	 *  and normalizing the result by the sum of the row's intensities. The last
-	 *  column is thus be Sum(Row) / Sum(Row) = 1. It is there to simplify the 
-	 *  binary search algorithm we'll use on this data.
+	 *  Has the same dimensions as the original image. Each row holds the alias
+	 *  table (see AliasTable) of the matching row in the original image, which
+	 *  picks a column proportionally to its pixel intensity.
 	 *
 	 *       Example intensities in original image
 	 *       ----------------------------
 	 *      | 1 | 1 | 0 | 2 | 1 | 0 | 5 |  Row 0
 	 *       ---+---+---+---+---+---+---+
-	 *       C0                      CM  CM+1
-	 *
-	 *   first sum intensity values
-	 *   -------------------------------
-	 *  | 0 | 1 | 2 | 2 | 4 | 5 | 5 |10 | Row 0
-	 *   ---+---+---+---+---+---+---+---+
-	 *  | ------------------------->|   |
-	 *  | monotonically increasing  |   |
+	 *       C0                      CM
 	 *
-	 *   C0                      CM  CM+1
+	 *  Alias V
+	 *  -------
 	 *
-	 *   Then normalize (div by 10)
-	 *   -------------------------------
-	 *  | 0 |0.1|0.2|0.2|0.4|0.5|0.5| 1 | Row 0
-	 *   ---+---+---+---+---+---+---+---
-	 *  | ------------------------->|   |
-	 *  | monotonically increasing  |   |
-	 *  |                           |   |
-	 *  |                           |   |
-	 *   ---+---+---+---+---+---+---+---
-	 *  | 0 |   |   |   |   |   |   | 1 | Row M
-	 *   ---+---+---+---+---+---+---+---
-	 *   C0                      CM  CM+1
+	 *  Here we apply a similar process than above, but generating a 1D
+	 *  distribution from the integral of the intensities of each row on the
+	 *  original image. It has one entry per row, and picks a row
+	 *  proportionally to its integral.
 	 *
-	 * CDF V
-	 * -----
+	 *    original image intensities          Row integrals
+	 *   ---------------------------         ----
+	 *  | 1 | 1 | 0 | 2 | 1 | 0 | 5 |------->| 10 |
+	 *  |---+---+---+---+---+---+---|        |----|
+	 *  | 2 | 1 | 5 | 0 | 0 | 1 | 3 |        | 12 |
+	 *  |---+---+---+---+---+---+---|        |----|
+	 *  |                           | ...    | .. |
+	 *  |---+---+---+---+---+---+---|        |----|
+	 *  |   |   |   |   |   |   |   | Row M  |  3 |
+	 *   ---+---+---+---+---+---+---          ---- 
 	 *
-	 * Here we apply a similar process than above, but generating a 1D
-	 * distribution by integrating the intensities of each row on the original
-	 * image. The CDF V array has one extra row than the original image. Each
-	 * row contains the monotonically increasing distribution of the intgral
-	 * over each row pixels intensity.
+	 * Once we have alias U and V, the sampling process is to simply choose two
+	 * uniform random variables, Ux and Uy. We use Uy to pick a row from alias
+	 * V, and then Ux to pick a column from the corresponding row of alias U,
+	 * giving us the pixel to sample. Unlike searching a CDF, each of these
+	 * takes constant time regardless of the image resolution.
 	 *
-	 *                                        CDF V      Normalized CDF V 
-	 *                                        ----        ----                  
-	 *    original image intensities         | 0  |      | 0  | |
-	 *   ---------------------------         |----|      |----| |
-	 *  | 1 | 1 | 0 | 2 | 1 | 0 | 5 |------->| 10 |----->|0.06| | monotonically
-	 *  |---+---+---+---+---+---+---|        |----|      |----| | increasing
-	 *  | 2 | 1 | 5 | 0 | 0 | 1 | 3 |        | 22 |      |0.14| |
-	 *  |---+---+---+---+---+---+---|        |----|      |----| |
-	 *  |                           | ...    | .. |      | .. | V
-	 *  |---+---+---+---+---+---+---|        |----|      |----|
-	 *  |   |   |   |   |   |   |   | Row M  |150 |      | 1  | Row M+1
-	 *   ---+---+---+---+---+---+---          ----        ---- 
-	 * 
-	 *
-	 * Once we have CDF U and V, the sampling process is to simply choose two
-	 * uniform random variables, Ux and Uy. We use Uy to pick a row by searching
-	 * the corresponding element in CDF V. Then we do the same with Ux and the
-	 * corresponding row in CDF U, giving us the pixel column.
+	 * Entries are packed in 32 bits: the probability of keeping the entry's
+	 * own index, quantized to 16 bits, followed by the 16 bit alias index.
 	 *
 	 */
 
@@ -173,111 +149,71 @@ bool calculateCDF( const float* rgbPixels, unsigned int imageWidth, unsigned int
 	imageWidth  = filteredIntensities.spec().width;
 	imageHeight = filteredIntensities.spec().height;
 
-	cdfUDataWidth                      = imageWidth + 1;
-	cdfUDataHeight                     = imageHeight;
-	const unsigned int cdfVNumElements = imageHeight + 1;
+	aliasUDataWidth  = imageWidth;
+	aliasUDataHeight = imageHeight;
 
-	cdfUData.resize( cdfUDataWidth * cdfUDataHeight );
-	cdfVData.resize( cdfVNumElements );
-	float* cdfU = &cdfUData[0];
-	float* cdfV = &cdfVData[0];
+	aliasUData.resize( aliasUDataWidth * aliasUDataHeight );
 
-	// The actual functions we generate the CDF from are:
+	// The actual functions we generate the alias tables from are:
 	// Function U (2D) : pixel intensities
 	// Function V (1D) : integral of intensities over each row
-	std::vector<float> storageFuncU, storageFuncV;
-	storageFuncU.resize( imageWidth * imageHeight );
-	storageFuncV.resize( imageHeight + 1 );
-	float* functionU = &storageFuncU[0];
-	float* functionV = &storageFuncV[0];
-
-	const float iW = (float)imageWidth;
-	const float iH = (float)imageHeight;
-
-
-	// first generate the data for Function U
-	environmentTextureIntegral = calculateImageIntegral( filteredIntensities, 
-														 functionU );
-
-	// Now generate the CDF U.
-	// Normalized 1D distributions in the rows of the 2D buffer, and the
-	// marginal CDF in the 1D buffer. 
-	// Include the starting 0.0 and the ending 1.0 to avoid special cases during
-	// the continuous sampling.
-
-	// note this matches the original image dimensions, only CDFU is 1 element 
-	// longer
-	const unsigned int functionUWidth = imageWidth; 
-	const unsigned int numStepsW = iW; // PBRT2 p.648.
-	for (unsigned int y = 0; y < imageHeight; ++y)
+	std::vector<float> functionV( imageHeight );
+
+	// Read the intensities into a plain buffer, so the rows can be processed
+	// without going through the ImageBuf accessors.
+	std::vector<float> intensities( imageWidth * imageHeight );
+	if (!filteredIntensities.get_pixels(0, imageWidth,
+										0, imageHeight,
+										0, 1,
+										TypeDesc::FLOAT,
+										&intensities[0])) return false;
+
+	// Now generate alias U. Rows are independent of each other, so we spread
+	// them across all available cores.
 	{
-		unsigned int row = y * cdfUDataWidth; 
-		cdfU[row + 0] = 0.0f; // CDF starts at 0.0f.
-
-		for (unsigned int x = 1; x <= imageWidth; ++x)
-		{
-			const float f = functionU[y * functionUWidth + x - 1] / numStepsW; 
-			unsigned int columnOffset = row + x;
-			// this is not yet a CDF, but the step function integral. We'll turn
-			// it into an actual CDF when we divide by rowIntegral.
-			cdfU[columnOffset] = cdfU[columnOffset - 1] + f; 
-		}
-
-		// The last CDF element contains the integral over the row. Note we have
-		// not yet normalized the cdf.
-		const float rowIntegral = cdfU[row + imageWidth]; 
-		// Store this as function values of the marginal CDF.
-		functionV[y] = rowIntegral; 
-
-		// If all texels were black in this row, generate an equal distribution.
-		if (rowIntegral > 0.0f)
+		const unsigned int numThreads = std::max(1u, boost::thread::hardware_concurrency());
+		pool tp(numThreads);
+		const unsigned int rowsPerTask = std::max(1u, imageHeight / numThreads);
+		for (unsigned int y = 0; y < imageHeight; y += rowsPerTask)
 		{
-			for (unsigned int x = 1; x <= imageWidth; ++x)
-			{
-				cdfU[row + x] /= rowIntegral;
-			}
+			tp.schedule(boost::bind(calculateRowDistributions,
+									&intensities[0],
+									imageWidth,
+									imageHeight,
+									y,
+									std::min(imageHeight, y + rowsPerTask),
+									&aliasUData[0],
+									&functionV[0]));
 		}
-		else 
-		{
-			for (unsigned int x = 1; x <= imageWidth; ++x)
-			{
-				cdfU[row + x] = (float)x / numStepsW;
-			}
-		}
-	} // for y
-
-	// Now do the same thing with the marginal CDF.
-
-	cdfV[0] = 0.0f; // CDF starts at 0.0f.
-	const unsigned int numStepsH = imageHeight;
-
-	for (unsigned int y = 1; y <= imageHeight; ++y)
-	{
-		const float f = functionV[y - 1] / numStepsH;
-		// step function integral.
-		cdfV[y] = cdfV[y - 1] + f;
+		tp.wait();
 	}
-	
-	// Convert step function integral into CDF V. 
-	// The integral over this marginal CDF is in the last element.
-	const float imageIntegral = cdfV[imageHeight]; 
-	functionV[imageHeight] = imageIntegral; 
 
-	// If all texels were black in the whole image, generate an equal distribution.
-	if (imageIntegral > 0.0f)
+	// Now do the same thing with the marginal distribution.
+	std::vector<AliasTable::Entry> table;
+	std::vector<float> pmf;
+	AliasTable::build(functionV, table, pmf);
+	aliasVData.resize( imageHeight );
+	for (unsigned int y = 0; y < imageHeight; ++y)
 	{
-		for (unsigned int y = 1; y <= imageHeight; ++y)
-		{
-			cdfV[y] /= imageIntegral;
-		}
+		aliasVData[y] = packAliasEntry(table[y]);
 	}
-	else 
+
+	// The integral of the texture times a sin factor is used to calculate the
+	// PDF. The idea is to reduce the oversampling that would otherwise occur at
+	// the poles of the sampled sphere by 'toning down' the importance at such
+	// poles with a sin factor. Each row integral is already divided by the
+	// image width, so we just average them.
+	double textureTimesSinSum = 0;
+	for (unsigned int y = 0; y < imageHeight; ++y)
 	{
-		for (unsigned int y = 1; y <= imageHeight; ++y)
-		{
-			cdfV[y] = (float)y / iH;
-		}
+		textureTimesSinSum += functionV[y];
 	}
+	environmentTextureIntegral = (float)(textureTimesSinSum / imageHeight);
+
+	// Roll the 2PI^2 factor required to calculate the jacobian on the area PDF 
+	// right into this constant to save the calculation. PBRT2 page 729. This is 
+	// taken into account in EnvironmentLight.cu
+	environmentTextureIntegral *= 2.0f * M_PI * M_PI;
 
 	return true;
 }
@@ -288,14 +224,14 @@ bool generateImageFunction( const float* rgbPixels,
 							OpenImageIO::ImageBuf& result )
 {
 	// PBRT2 Page 726.
-	// The CDF is generated over a slightly blurred version of the
+	// The distribution is generated over a slightly blurred version of the
 	// original image. The reason is that we use linear blending of
 	// texels during rendering, and that may mean that a black texel has
 	// non-zero radiance near its center due to contribution of an
 	// adjacent (non-black texel). If we simply copied the texel values
-	// for the piecewise _CONSTANT_ CDF we sample from, the whole
+	// for the piecewise _CONSTANT_ distribution we sample from, the whole
 	// surface of the texel would be black. This would not happen if we
-	// used a piecewise linear CDF, but constant is easier/cheaper. To
+	// used a piecewise linear distribution, but constant is easier/cheaper. To
 	// solve this, we simply blur the source image function slightly
 	// which addresses this problem and produces non-zero values for the
 	// case described, guaranteed that the "almost" black pixel would be
@@ -346,46 +282,56 @@ bool generateImageFunction( const float* rgbPixels,
 }
 
 
-float calculateImageIntegral(const OpenImageIO::ImageBuf& image,
-							 float* functionU)
+// Pack an alias table entry in 32 bits, as read by sampleEnvironmentTexture
+// (see envMapSample.h)
+inline unsigned int packAliasEntry(const AliasTable::Entry& entry)
+{
+	const unsigned int probability = (unsigned int)(std::min(1.0f, std::max(0.0f, entry.probability)) * 65535.0f + 0.5f);
+	return (probability << 16) | (unsigned int)entry.alias;
+}
+
+// Generate the rows [fromY, toY) of alias U from the image intensities, along
+// with their integrals (function V).
+void calculateRowDistributions(const float* intensities,
+							   unsigned int imageWidth,
+							   unsigned int imageHeight,
+							   unsigned int fromY,
+							   unsigned int toY,
+							   unsigned int* aliasU,
+							   float* functionV)
 {
-	unsigned int imageWidth  = image.spec().width;
-	unsigned int imageHeight = image.spec().height;
-	const float iW = (float)imageWidth;
 	const float iH = (float)imageHeight;
-	const float iA = iW * iH;
+	const unsigned int numStepsW = imageWidth; // PBRT2 p.648.
 
-	float textureTimesSinSum = 0;
+	std::vector<float> functionU( imageWidth );
+	std::vector<AliasTable::Entry> table;
+	std::vector<float> pmf;
 
-	float value;
-	for( unsigned int y = 0; y < imageHeight; ++y )
+	for (unsigned int y = fromY; y < toY; ++y)
 	{
 		// Scale distribution by the sine to get the sampling uniform. (Avoid
 		// sampling more value near the poles.)
 		// See PBRT2, chapter 14.6.5 on Infinite Area Lights, page 727.
-		float sinTheta = (float)sin(M_PI * ((float)y + 0.5f) / iH); 
+		const float sinTheta = (float)sin(M_PI * ((float)y + 0.5f) / iH); 
 
-		for( unsigned int x = 0; x < imageWidth; ++x )
+		const float* rowIntensities = intensities + y * imageWidth;
+		double rowIntegral = 0;
+		for (unsigned int x = 0; x < imageWidth; ++x)
 		{
-			image.getpixel(x, y, &value, 1);
-			value = std::max(0.f, value);
-			functionU[y * imageWidth + x] =  value * sinTheta;
-			textureTimesSinSum            += value * sinTheta;
+			functionU[x] = std::max(0.f, rowIntensities[x]) * sinTheta; 
+			rowIntegral += functionU[x];
 		}
-	}
-
-	// The integral of the texture times a sin factor is used to calculate the
-	// PDF. The idea is to reduce the oversampling that would otherwise occur at
-	// the poles of the sampled sphere by 'toning down' the importance at such
-	// poles with a sin factor.
-	float environmentTextureIntegral = textureTimesSinSum / iA;
-
-	// Roll the 2PI^2 factor required to calculate the jacobian on the area PDF 
-	// right into this constant to save the calculation. PBRT2 page 729. This is 
-	// taken into account in EnvironmentLight.cu
-	environmentTextureIntegral *= 2.0f * M_PI * M_PI;
-
-	return environmentTextureIntegral;
+		// Store the integral over the row as function values of the marginal
+		// distribution.
+		functionV[y] = (float)(rowIntegral / numStepsW); 
+
+		// If all texels were black in this row, this generates an equal
+		// distribution.
+		AliasTable::build(functionU, table, pmf);
+		unsigned int* row = aliasU + y * imageWidth; 
+		for (unsigned int x = 0; x < imageWidth; ++x)
+		{
+			row[x] = packAliasEntry(table[x]);
+		}
+	} // for y
 }
-
-
@@ -3,6 +3,14 @@
 #include <string>
 #include <vector>
 
+// This clamps the resolution of the distributions used to sample the
+// environment map; smaller images keep their own resolution. Sampling them
+// takes constant time (see calculateAliasTables), so this only bounds their
+// memory footprint: 4 bytes per texel, i.e. 8MB for a 2048x1024 map (an 8K
+// map would take 128MB). It must not exceed 65536, the largest alias index an
+// entry can hold.
+#define MAX_CDF_SIZE 2048
+
 /// Load image and convert it to float RGB format. Return true if successful,
 /// false if an error occurred. 
 bool loadImage(const std::string& path,
@@ -10,9 +18,10 @@ bool loadImage(const std::string& path,
 			   std::vector<float>& outPixelData);
 
 /// This method computes the piece-wise constant distribution functions over a 
-/// 2D image used to sample such image. We'll do this to perform importance 
-/// sampling of the environment map. 
-/// The implementation here matches that of PBRT 2 (Chapter 14.6.5).
+/// 2D image used to sample such image, as alias tables. We'll do this to
+/// perform importance sampling of the environment map. 
+/// The distributions match those of PBRT 2 (Chapter 14.6.5). The rows
+/// of the distribution are computed in parallel.
 ///
 /// Parameters:
 ///
@@ -20,17 +29,19 @@ bool loadImage(const std::string& path,
 ///     imagewidth, 
 ///     imageHeight : original RGB float image
 ///
-///     cdfUData, 
-///     cdfUDataWidth, 
-///     cdfUDataHeight: 2D buffer describing the resulting 2D CDF function.
+///     aliasUData, 
+///     aliasUDataWidth, 
+///     aliasUDataHeight: 2D buffer holding the alias table of each row,
+///                       selecting a column.
 ///
-///     cdfVData : 1D buffer describing the marginal 1D CDF function. The size
-///                is given by cdfVData.size().
+///     aliasVData : 1D buffer holding the alias table of the marginal
+///                  distribution, selecting a row. The size is given by
+///                  aliasVData.size().
 ///
 ///     environmentTextureIntegral : intgral of image pixel intensities (used to
 ///                                  calculate each sample's PDF).
 ///
-bool calculateCDF( const float* rgbPixels, unsigned int imageWidth, unsigned int imageHeight,
-				   std::vector<float>& cdfUData, unsigned int& cdfUDataWidth, unsigned int& cdfUDataHeight, // (imageWidth + 1 ) x imageHeight
-				   std::vector<float>& cdfVData, 
-				   float& environmentTextureIntegral );
+bool calculateAliasTables( const float* rgbPixels, unsigned int imageWidth, unsigned int imageHeight,
+						   std::vector<unsigned int>& aliasUData, unsigned int& aliasUDataWidth, unsigned int& aliasUDataHeight, // imageWidth x imageHeight
+						   std::vector<unsigned int>& aliasVData, 
+						   float& environmentTextureIntegral );
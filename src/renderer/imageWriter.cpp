@@ -0,0 +1,210 @@
+#include "renderer/imageWriter.h"
+
+#include <OpenImageIO/imageio.h>
+
+#include <algorithm>
+#include <cctype>
+#include <math.h>
+#include <vector>
+
+enum OutputFormat
+{
+	OUTPUT_EXR,
+	OUTPUT_8_BIT,
+	OUTPUT_FLOAT,
+};
+
+OutputFormat outputFormat(const std::string& file)
+{
+	const size_t dot = file.find_last_of('.');
+	std::string extension = dot == std::string::npos ? "" : file.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+	if (extension == "exr") return OUTPUT_EXR;
+	if (extension == "png" ||
+		extension == "jpg" ||
+		extension == "jpeg" ||
+		extension == "bmp" ||
+		extension == "tga") return OUTPUT_8_BIT;
+	return OUTPUT_FLOAT;
+}
+
+// Resolve the accumulated sums into the displayed (tonemapped) image, see
+// shared/textureMap.fs. Rows are flipped, so the output goes from top to
+// bottom.
+void resolveFloat(const float* pixels, int width, int height, float gamma, float* output)
+{
+	const int channels = 4; // RGBA
+	const float invGamma = 1.0f / gamma;
+	for( int y = 0; y < height; ++y )
+	{
+		const float* row = pixels + (size_t)(height - 1 - y) * width * channels;
+		float* outputRow = output + (size_t)y * width * channels;
+		for( int x = 0; x < width; ++x )
+		{
+			const float* pixel = row + x * channels;
+			float* outputPixel = outputRow + x * channels;
+			const float invNumSamples = 1.0f / std::max(pixel[3], 1.0f);
+			for( int c = 0; c < 3; ++c ) outputPixel[c] = powf(pixel[c] * invNumSamples, invGamma);
+			outputPixel[3] = 1.0f;
+		}
+	}
+}
+
+// Same as resolveFloat, but quantizing to 8 bits. Rather than applying the
+// gamma curve to every pixel, we compare the linear values against the ones
+// at which the quantized output steps from one level to the next.
+void resolve8Bit(const float* pixels, int width, int height, float gamma, unsigned char* output)
+{
+	const int channels = 4; // RGBA
+	float thresholds[255];
+	for( int level = 1; level <= 255; ++level )
+	{
+		thresholds[level - 1] = powf((level - 0.5f) / 255.0f, gamma);
+	}
+
+	for( int y = 0; y < height; ++y )
+	{
+		const float* row = pixels + (size_t)(height - 1 - y) * width * channels;
+		unsigned char* outputRow = output + (size_t)y * width * channels;
+		for( int x = 0; x < width; ++x )
+		{
+			const float* pixel = row + x * channels;
+			unsigned char* outputPixel = outputRow + x * channels;
+			const float invNumSamples = 1.0f / std::max(pixel[3], 1.0f);
+			for( int c = 0; c < 3; ++c )
+			{
+				const float value = pixel[c] * invNumSamples;
+				outputPixel[c] = (unsigned char)(std::upper_bound(thresholds, thresholds + 255, value) - thresholds);
+			}
+			outputPixel[3] = 255;
+		}
+	}
+}
+
+/*static*/ bool ImageWriter::write(const std::string& file,
+								   const float* pixels,
+								   int width,
+								   int height,
+								   float gamma)
+{
+	OIIO_NAMESPACE_USING
+
+	const int channels = 4; // RGBA
+	const OutputFormat format = outputFormat(file);
+
+	ImageOutput* out = ImageOutput::create(file.c_str());
+	if (!out) return false;
+
+	ImageSpec spec (width, height, channels, format == OUTPUT_8_BIT ? TypeDesc::UINT8 : TypeDesc::FLOAT);
+	if (format == OUTPUT_EXR)
+	{
+		spec.tile_width = 64;
+		spec.tile_height = 64;
+		spec.attribute("compression", "zip");
+	}
+	else if (format == OUTPUT_8_BIT)
+	{
+		// favour speed over size
+		spec.attribute("png:compressionLevel", 3);
+	}
+
+	if (!out->open(file.c_str(), spec))
+	{
+		delete out;
+		return false;
+	}
+
+	bool success;
+	if (format == OUTPUT_8_BIT)
+	{
+		std::vector<unsigned char> resolved((size_t)width * height * channels);
+		resolve8Bit(pixels, width, height, gamma, &resolved[0]);
+		success = out->write_image(TypeDesc::UINT8, &resolved[0]);
+	}
+	else
+	{
+		std::vector<float> resolved((size_t)width * height * channels);
+		resolveFloat(pixels, width, height, gamma, &resolved[0]);
+		success = out->write_image(TypeDesc::FLOAT, &resolved[0]);
+	}
+
+	success = out->close() && success;
+	delete out;
+	return success;
+}
+
+
+TiledImageWriter::TiledImageWriter() :
+	m_output(NULL),
+	m_gamma(1.0f)
+{
+}
+
+TiledImageWriter::~TiledImageWriter()
+{
+	close();
+}
+
+bool TiledImageWriter::open(const std::string& file, int width, int height, float gamma)
+{
+	OIIO_NAMESPACE_USING
+
+	close();
+
+	ImageOutput* out = ImageOutput::create(file.c_str());
+	if (!out) return false;
+	if (!out->supports("tiles"))
+	{
+		delete out;
+		return false;
+	}
+
+	const int channels = 4; // RGBA
+	ImageSpec spec (width, height, channels, TypeDesc::FLOAT);
+	spec.tile_width = tileSize;
+	spec.tile_height = tileSize;
+	spec.attribute("compression", "zip");
+	// write the tiles as they come, rather than buffering them until those
+	// above are written
+	spec.attribute("openexr:lineOrder", "randomY");
+
+	if (!out->open(file.c_str(), spec))
+	{
+		delete out;
+		return false;
+	}
+
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	m_output = out;
+	m_gamma = gamma;
+	return true;
+}
+
+bool TiledImageWriter::writeRegion(const float* pixels, int x, int y, int width, int height)
+{
+	OIIO_NAMESPACE_USING
+
+	const int channels = 4; // RGBA
+	std::vector<float> resolved((size_t)width * height * channels);
+	resolveFloat(pixels, width, height, m_gamma, &resolved[0]);
+
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	if (!m_output) return false;
+	return m_output->write_tiles(x, x + width,
+								 y, y + height,
+								 0, 1, // z
+								 TypeDesc::FLOAT,
+								 &resolved[0]);
+}
+
+bool TiledImageWriter::close()
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	if (!m_output) return true;
+
+	const bool success = m_output->close();
+	delete m_output;
+	m_output = NULL;
+	return success;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <OpenImageIO/imageio.h>
+#include <boost/thread.hpp>
+
+#include <string>
+
+// Writes an accumulated render to an image file. The renderer runs this in a
+// worker thread (see AsyncTask), so saving doesn't stall it.
+//
+// The input pixels are read straight from the accumulation buffer: rows from
+// bottom to top of RGBA floats, where RGB is the sum of the samples' radiance
+// and A the number of samples. They are resolved into the displayed image
+// (see shared/textureMap.fs) and written as:
+//
+//  - EXR: float, tiled and ZIP compressed.
+//  - PNG, JPEG, BMP, TGA: 8 bits per channel. The quantization is done here,
+//    without evaluating the gamma curve per pixel.
+//  - anything else: float, as OpenImageIO sees fit for the format.
+class ImageWriter
+{
+public:
+	// Write the image. Returns true if successful.
+	static bool write(const std::string& file,
+					  const float* pixels,
+					  int width,
+					  int height,
+					  float gamma);
+};
+
+
+// Writes an image region by region, as they finish rendering, so it never has
+// to be held in memory as a whole (see Renderer::renderTiledImage). The file
+// is tiled, in float, and ZIP compressed if it's an EXR; the regions are
+// written in whatever order they arrive, and may come from any thread.
+class TiledImageWriter
+{
+public:
+	// size in pixels of the tiles of the file. Regions are made of whole
+	// tiles, except along the right and bottom edges of the image.
+	static const int tileSize = 64;
+
+	TiledImageWriter();
+	// Closes the file, if still open.
+	~TiledImageWriter();
+
+	// Create the file. The format must support tiles (e.g. EXR, TIFF).
+	// Returns true if successful.
+	bool open(const std::string& file, int width, int height, float gamma);
+	// Write a region of the image from its accumulated samples, laid out as
+	// ImageWriter::write takes them. x, y is the top-left corner of the
+	// region, counting from the top-left corner of the image, and must lie on
+	// a tile boundary. Returns true if successful.
+	bool writeRegion(const float* pixels, int x, int y, int width, int height);
+	// Finish writing the file. Returns true if successful.
+	bool close();
+
+private:
+	OpenImageIO::ImageOutput* m_output;
+	float m_gamma;
+	// the file is written to by one thread at a time
+	boost::mutex m_mutex;
+};
@@ -5,6 +5,10 @@
 #include "voxelize/cpuVoxelizer.h"
 #include "voxelize/gpuVoxelizer.h"
 #include "camera/cameraController.h"
+#include "voxel/voxelSurface.h"
+#include "cache/cache.h"
+
+#include <sstream>
 
 #define VOXELIZE_GPU 1
 
@@ -27,17 +31,34 @@ void Renderer::loadVoxFile(const std::string& file)
 	// as a variance-reduction technique, we eliminate all those voxels which
 	// are completely surrounded by other voxels from the list of emissive
 	// voxels. These would otherwise be randomly sampled, but never contribute
-	// to the image.
-	pruneInteriorEmissiveVoxels(voxelMaterials, 
-								m_glResources.m_volumeResolution, 
-								emissiveVoxelIndices);
+	// to the image. Light is only sampled from the exposed faces of the rest.
+	VoxelSurface surface(&voxelMaterials[0], m_glResources.m_volumeResolution);
+	std::vector<EmissiveVoxel> emissiveVoxels;
+	emissiveVoxels.reserve(emissiveVoxelIndices.size());
+	for(size_t i = 0; i < emissiveVoxelIndices.size(); ++i)
+	{
+		EmissiveVoxel voxel;
+		voxel.voxelIndex = emissiveVoxelIndices[i];
+		voxel.faceMask = surface.faceMask(voxel.voxelIndex);
+		if (voxel.faceMask == 0) continue; // interior voxel
+		voxel.materialOffset = voxelMaterials[voxel.voxelIndex];
+		emissiveVoxels.push_back(voxel);
+	}
+	if (m_logger && !emissiveVoxelIndices.empty())
+	{
+		const size_t numPruned = emissiveVoxelIndices.size() - emissiveVoxels.size();
+		std::ostringstream msg;
+		msg << "Pruned emissive voxels: " << numPruned << "/" << emissiveVoxelIndices.size()
+			<< " (" << (float)numPruned / emissiveVoxelIndices.size() * 100 << "%)";
+		(*m_logger)(msg.str());
+	}
 							
 	createVoxelDataTexture(m_glResources.m_volumeResolution, 
 						   &voxelMaterials[0], 
 						   &materialData[0],
 						   materialData.size(),
-						   &emissiveVoxelIndices[0],
-						   emissiveVoxelIndices.size());
+						   emissiveVoxels.empty() ? NULL : &emissiveVoxels[0],
+						   emissiveVoxels.size());
 	m_camera.controller().setDistanceFromTarget(m_volumeBounds.size().length() * 0.5f);
 
 	resetRender();
@@ -127,78 +148,9 @@ void Renderer::loadMesh(const std::string& file)
 	free(materialOffsetTexels);
 #endif
 
-	resetRender();
-}
-
-Imath::V3i voxelCoordinate(GLint voxel, const Imath::V3i& volumeResolution)
-{
-	Imath::V3i c;
-	c.z = voxel / (volumeResolution.x * volumeResolution.y);
-	voxel -= c.z * volumeResolution.x * volumeResolution.y;
-	c.y = voxel / volumeResolution.x;
-	c.x = voxel - c.y * volumeResolution.x;
-	return c;
-}
-						
-inline GLint voxelIndex(const Imath::V3i& voxel, const Imath::V3i& volumeResolution)
-{
-	return voxel.x + voxel.y * volumeResolution.x + voxel.z * volumeResolution.x * volumeResolution.y;
-}
-
-inline bool occupiedNeightbour(GLint voxel,
-							  const Imath::V3i& neighbourOffset,
-							  const std::vector<GLint>& voxelMaterials,
-							  Imath::V3i& volumeResolution)
-{
-	Imath::V3i neighbour = voxelCoordinate(voxel, volumeResolution) + neighbourOffset;
-	const float outOfBounds = neighbour.x < 0 || neighbour.x >= volumeResolution.x ||
-							  neighbour.y < 0 || neighbour.y >= volumeResolution.y ||
-							  neighbour.z < 0 || neighbour.z >= volumeResolution.z;
-	if (outOfBounds) return false;
-	return voxelMaterials[voxelIndex(neighbour, volumeResolution)] >= 0;
-}
-
-const Imath::V3i neighbours[6] = { Imath::V3i(1,0,0),
-								   Imath::V3i(-1,0,0),
-								   Imath::V3i(0,1,0),
-								   Imath::V3i(0,-1,0),
-								   Imath::V3i(0,0,1),
-								   Imath::V3i(0,0,-1) };
-
-inline bool anyVisibleFace(GLint voxel, 
-						   const std::vector<GLint>& voxelMaterials,
-						   Imath::V3i& volumeResolution)
-{
-	return !occupiedNeightbour(voxel, neighbours[0], voxelMaterials, volumeResolution) ||
-		   !occupiedNeightbour(voxel, neighbours[1], voxelMaterials, volumeResolution) ||
-		   !occupiedNeightbour(voxel, neighbours[2], voxelMaterials, volumeResolution) ||
-		   !occupiedNeightbour(voxel, neighbours[3], voxelMaterials, volumeResolution) ||
-		   !occupiedNeightbour(voxel, neighbours[4], voxelMaterials, volumeResolution) ||
-		   !occupiedNeightbour(voxel, neighbours[5], voxelMaterials, volumeResolution);
-}
-
-void Renderer::pruneInteriorEmissiveVoxels(const std::vector<GLint>& voxelMaterials, 
-										   Imath::V3i& volumeResolution, 
-										   std::vector<GLint>& emissiveVoxelIndices)
-{
-	size_t numInputVoxels = emissiveVoxelIndices.size();
-	if (numInputVoxels == 0) return;
+	// the voxels are generated on the GPU, identify the scene by its source
+	m_sceneVoxelsHash = hashString(m_sceneVoxelsHash, file);
 
-	size_t numPruned = 0;
-	// TODO there's probably much smarter ways of doing this rather than brute
-	// force (i.e. there's a lot of redundancy on the adjacency checks)
-	for(int i = 0; i < (int)emissiveVoxelIndices.size(); ++i)
-	{
-		if(!anyVisibleFace(emissiveVoxelIndices[i], voxelMaterials, volumeResolution))
-		{
-			// prune this emissive voxel
-			emissiveVoxelIndices[i] = emissiveVoxelIndices[emissiveVoxelIndices.size() - 1];
-			emissiveVoxelIndices.resize(emissiveVoxelIndices.size()-1);
-			i--;
-			numPruned++;
-		}
-	}
-	std::cout << "Pruned emissive voxels: " << numPruned << "/" << numInputVoxels 
-			  << " (" << (float)numPruned/numInputVoxels*100 << "%)" << std::endl;
+	resetRender();
 }
 
@@ -0,0 +1,62 @@
+#include "renderer/lights/aliasTable.h"
+
+#include <algorithm>
+
+/*static*/ void AliasTable::build(const std::vector<float>& weights,
+								  std::vector<Entry>& table,
+								  std::vector<float>& pmf)
+{
+	const size_t n = weights.size();
+	table.resize(n);
+	pmf.resize(n);
+	if (n == 0) return;
+
+	// accumulate in double precision, there might be millions of weights
+	double sum = 0;
+	for(size_t i = 0; i < n; ++i) sum += std::max(0.f, weights[i]);
+
+	// probabilities scaled by the number of outcomes, so that the average
+	// entry has exactly 1. Entries are split into those under and over it.
+	std::vector<double> scaled(n);
+	std::vector<int> small, large;
+	small.reserve(n);
+	large.reserve(n);
+	for(size_t i = 0; i < n; ++i)
+	{
+		const double p = sum > 0 ? std::max(0.f, weights[i]) / sum : 1.0 / n;
+		pmf[i] = (float)p;
+		scaled[i] = p * n;
+		if (scaled[i] < 1.0) small.push_back((int)i);
+		else                 large.push_back((int)i);
+	}
+
+	// fill up each underfull entry with probability taken from an overfull one
+	while(!small.empty() && !large.empty())
+	{
+		const int s = small.back(); small.pop_back();
+		const int l = large.back();
+
+		table[s].probability = (float)scaled[s];
+		table[s].alias = l;
+
+		scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+		if (scaled[l] < 1.0)
+		{
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	// whatever is left is (up to rounding errors) exactly full
+	for(size_t i = 0; i < large.size(); ++i)
+	{
+		table[large[i]].probability = 1.0f;
+		table[large[i]].alias = large[i];
+	}
+	for(size_t i = 0; i < small.size(); ++i)
+	{
+		table[small[i]].probability = 1.0f;
+		table[small[i]].alias = small[i];
+	}
+}
+
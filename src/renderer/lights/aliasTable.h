@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+// Walker's alias method, for drawing samples from a discrete distribution in
+// constant time regardless of the number of outcomes.
+//
+// The table has one entry per outcome. To draw a sample, pick an entry
+// uniformly, then keep its own index with the entry's probability, or take its
+// alias otherwise. The table is built in linear time with Vose's algorithm.
+class AliasTable
+{
+public:
+	struct Entry
+	{
+		// probability of keeping the entry's own index
+		float probability;
+		// index selected otherwise
+		int alias;
+	};
+
+	// Build the table for the given (non-negative) weights. The resulting
+	// probability of drawing each index is returned in pmf. If all weights are
+	// zero the distribution is uniform.
+	static void build(const std::vector<float>& weights,
+					  std::vector<Entry>& table,
+					  std::vector<float>& pmf);
+};
+
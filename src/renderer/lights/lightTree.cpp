@@ -0,0 +1,271 @@
+#include "renderer/lights/lightTree.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Number of buckets the lights are binned into, along each axis, when
+// searching for the best split of a node.
+static const int NUM_BUCKETS = 12;
+
+inline float safeAcos(float x)
+{
+	return acos(std::min(1.0f, std::max(-1.0f, x)));
+}
+
+inline float safeSqrt(float x)
+{
+	return sqrt(std::max(0.0f, x));
+}
+
+// Rotate v around the (unit length) axis by the given angle (Rodrigues'
+// rotation formula)
+inline Imath::V3f rotate(const Imath::V3f& v, const Imath::V3f& axis, float angle)
+{
+	const float c = cos(angle), s = sin(angle);
+	return v * c + axis.cross(v) * s + axis * (axis.dot(v) * (1.0f - c));
+}
+
+/*static*/ LightTree::LightBounds LightTree::merge(const LightBounds& a, const LightBounds& b)
+{
+	if (a.bounds.isEmpty()) return b;
+	if (b.bounds.isEmpty()) return a;
+
+	LightBounds result;
+	result.bounds = a.bounds;
+	result.bounds.extendBy(b.bounds);
+	result.phi = a.phi + b.phi;
+	result.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+	result.light = -1;
+	result.faceMask = 0;
+
+	// smallest cone enclosing both cones of normals. Skip the trigonometry for
+	// the common cases of coincident cones and cones covering every direction.
+	if (a.cosThetaO <= -1 || (b.w == a.w && b.cosThetaO >= a.cosThetaO))
+	{
+		result.w = a.w;
+		result.cosThetaO = a.cosThetaO;
+		return result;
+	}
+	if (b.cosThetaO <= -1 || (b.w == a.w && a.cosThetaO >= b.cosThetaO))
+	{
+		result.w = b.w;
+		result.cosThetaO = b.cosThetaO;
+		return result;
+	}
+
+	const float thetaA = safeAcos(a.cosThetaO);
+	const float thetaB = safeAcos(b.cosThetaO);
+	const float thetaD = safeAcos(a.w.dot(b.w));
+	if (std::min(thetaD + thetaB, (float)M_PI) <= thetaA)
+	{
+		// b is within a
+		result.w = a.w;
+		result.cosThetaO = a.cosThetaO;
+		return result;
+	}
+	if (std::min(thetaD + thetaA, (float)M_PI) <= thetaB)
+	{
+		// a is within b
+		result.w = b.w;
+		result.cosThetaO = b.cosThetaO;
+		return result;
+	}
+
+	const float thetaO = (thetaA + thetaD + thetaB) * 0.5f;
+	Imath::V3f axis = a.w.cross(b.w);
+	if (thetaO >= M_PI || axis.length2() == 0)
+	{
+		// the whole sphere of directions
+		result.w = Imath::V3f(0, 0, 1);
+		result.cosThetaO = -1;
+		return result;
+	}
+	// rotate a's axis towards b's, so the new cone just touches both
+	result.w = rotate(a.w, axis.normalize(), thetaO - thetaA);
+	result.cosThetaO = cos(thetaO);
+	return result;
+}
+
+// Surface area orientation heuristic: cost of a node bounding the given
+// lights (PBRT v4, section 12.6.3).
+float evaluateCost(const LightTree::LightBounds& b, int dimension)
+{
+	const float thetaO = safeAcos(b.cosThetaO);
+	const float thetaE = safeAcos(b.cosThetaE);
+	const float thetaW = std::min(thetaO + thetaE, (float)M_PI);
+	const float sinThetaO = safeSqrt(1 - b.cosThetaO * b.cosThetaO);
+	// solid angle measure of the directions light is emitted along
+	const float mOmega = 2 * M_PI * (1 - b.cosThetaO) +
+						 M_PI / 2 * (2 * thetaW * sinThetaO - cos(thetaO - 2 * thetaW) -
+									 2 * thetaO * sinThetaO + b.cosThetaO);
+
+	const Imath::V3f d = b.bounds.size();
+	// penalize thin nodes along the split dimension
+	const float kr = std::max(d.x, std::max(d.y, d.z)) / d[dimension];
+	const float area = 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+	return b.phi * mOmega * kr * area;
+}
+
+struct CentroidBucket
+{
+	CentroidBucket(int dimension, float centroidMin, float centroidExtent) :
+		m_dimension(dimension), m_min(centroidMin), m_extent(centroidExtent) {}
+
+	int operator()(const LightTree::LightBounds& l) const
+	{
+		const float c = l.bounds.center()[m_dimension];
+		return std::min(NUM_BUCKETS - 1, (int)(NUM_BUCKETS * (c - m_min) / m_extent));
+	}
+
+	int m_dimension;
+	float m_min, m_extent;
+};
+
+struct BelowSplit
+{
+	BelowSplit(const CentroidBucket& bucket, int split) : m_bucket(bucket), m_split(split) {}
+	bool operator()(const LightTree::LightBounds& l) const { return m_bucket(l) <= m_split; }
+
+	CentroidBucket m_bucket;
+	int m_split;
+};
+
+struct CentroidLess
+{
+	CentroidLess(int dimension) : m_dimension(dimension) {}
+	bool operator()(const LightTree::LightBounds& a, const LightTree::LightBounds& b) const
+	{
+		return a.bounds.center()[m_dimension] < b.bounds.center()[m_dimension];
+	}
+
+	int m_dimension;
+};
+
+void writeNode(const LightTree::LightBounds& b, LightTreeNode& node)
+{
+	for(int i = 0; i < 3; ++i)
+	{
+		node.boundsMin[i] = b.bounds.min[i];
+		node.boundsMax[i] = b.bounds.max[i];
+		node.w[i] = b.w[i];
+	}
+	node.phi = b.phi;
+	node.cosThetaO = b.cosThetaO;
+	node.cosThetaE = b.cosThetaE;
+	node.isLeaf = b.light >= 0 ? 1 : 0;
+	node.child = b.light;
+	node.faceMask = b.faceMask;
+	node.padding = 0;
+}
+
+// Build the subtree over lights [begin, end), and return its bounds.
+LightTree::LightBounds buildRecursive(std::vector<LightTree::LightBounds>& lights,
+									  size_t begin,
+									  size_t end,
+									  std::vector<LightTreeNode>& nodes)
+{
+	const size_t nodeIndex = nodes.size();
+	nodes.push_back(LightTreeNode());
+
+	if (end - begin == 1)
+	{
+		writeNode(lights[begin], nodes[nodeIndex]);
+		return lights[begin];
+	}
+
+	Imath::Box3f centroidBounds;
+	LightTree::LightBounds bounds = lights[begin];
+	for(size_t i = begin; i < end; ++i)
+	{
+		centroidBounds.extendBy(lights[i].bounds.center());
+		if (i > begin) bounds = LightTree::merge(bounds, lights[i]);
+	}
+
+	// find the split of lowest cost, out of the bucket boundaries along every
+	// axis
+	float bestCost = -1;
+	int bestDimension = -1, bestSplit = -1;
+	for(int dimension = 0; dimension < 3; ++dimension)
+	{
+		const float extent = centroidBounds.max[dimension] - centroidBounds.min[dimension];
+		if (extent <= 0) continue; // all lights are aligned along this axis
+
+		const CentroidBucket bucketOf(dimension, centroidBounds.min[dimension], extent);
+		LightTree::LightBounds buckets[NUM_BUCKETS];
+		for(int b = 0; b < NUM_BUCKETS; ++b) buckets[b].bounds.makeEmpty();
+		for(size_t i = begin; i < end; ++i)
+		{
+			LightTree::LightBounds& bucket = buckets[bucketOf(lights[i])];
+			bucket = LightTree::merge(bucket, lights[i]);
+		}
+
+		// bounds of the buckets above each split, swept from the right
+		LightTree::LightBounds above[NUM_BUCKETS];
+		above[NUM_BUCKETS - 1] = buckets[NUM_BUCKETS - 1];
+		for(int b = NUM_BUCKETS - 2; b > 0; --b) above[b] = LightTree::merge(buckets[b], above[b + 1]);
+
+		LightTree::LightBounds below;
+		below.bounds.makeEmpty();
+		for(int split = 0; split < NUM_BUCKETS - 1; ++split)
+		{
+			below = LightTree::merge(below, buckets[split]);
+			if (below.bounds.isEmpty() || above[split + 1].bounds.isEmpty()) continue;
+
+			const float cost = evaluateCost(below, dimension) + evaluateCost(above[split + 1], dimension);
+			if (bestCost < 0 || cost < bestCost)
+			{
+				bestCost = cost;
+				bestDimension = dimension;
+				bestSplit = split;
+			}
+		}
+	}
+
+	size_t middle;
+	if (bestDimension >= 0)
+	{
+		const float extent = centroidBounds.max[bestDimension] - centroidBounds.min[bestDimension];
+		const CentroidBucket bucketOf(bestDimension, centroidBounds.min[bestDimension], extent);
+		middle = std::partition(lights.begin() + begin,
+								lights.begin() + end,
+								BelowSplit(bucketOf, bestSplit)) - lights.begin();
+	}
+	else
+	{
+		// all centroids are coincident, split the lights evenly
+		middle = (begin + end) / 2;
+		std::nth_element(lights.begin() + begin,
+						 lights.begin() + middle,
+						 lights.begin() + end,
+						 CentroidLess(0));
+	}
+
+	// the first child follows its parent, so we only need to store the index
+	// of the second one.
+	buildRecursive(lights, begin, middle, nodes);
+	const int secondChild = (int)nodes.size();
+	buildRecursive(lights, middle, end, nodes);
+
+	writeNode(bounds, nodes[nodeIndex]);
+	nodes[nodeIndex].child = secondChild;
+	return bounds;
+}
+
+/*static*/ void LightTree::build(std::vector<LightBounds>& lights,
+								 std::vector<LightTreeNode>& nodes)
+{
+	nodes.clear();
+
+	// lights which emit nothing can never be chosen
+	size_t numLights = 0;
+	for(size_t i = 0; i < lights.size(); ++i)
+	{
+		if (lights[i].phi > 0) lights[numLights++] = lights[i];
+	}
+	lights.resize(numLights);
+	if (numLights == 0) return;
+
+	nodes.reserve(2 * numLights - 1);
+	buildRecursive(lights, 0, numLights, nodes);
+}
+
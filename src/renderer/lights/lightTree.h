@@ -0,0 +1,49 @@
+#pragma once
+
+#include "shaders/lightSampling/lightTreeHost.h"
+
+#include <OpenEXR/ImathVec.h>
+#include <OpenEXR/ImathBox.h>
+
+#include <vector>
+
+// Bounding volume hierarchy over the emissive voxels, used to choose which
+// light to sample from a given shading point according to its estimated
+// contribution, rather than just its power. This follows the light BVH in
+// PBRT v4 (Conty Estevez & Kulla, "Importance Sampling of Many Lights with
+// Adaptive Tree Splitting").
+//
+// Each node bounds the position, power and emission directions of the lights
+// below it. Shading points walk down the tree choosing either child 
+// stochastically, proportionally to an upper bound of the light they might
+// receive from each (see lightSampling/lightTreeDevice.h).
+class LightTree
+{
+public:
+	// Spatial and directional bounds of the light emitted by a set of lights
+	struct LightBounds
+	{
+		Imath::Box3f bounds;
+		// emitted power
+		float phi;
+		// cone bounding the normals of the emitting surfaces
+		Imath::V3f w;
+		float cosThetaO;
+		// angle, past the normals, over which the surfaces emit light
+		float cosThetaE;
+		// index of the light, and its faces which emit light (single lights
+		// only)
+		int light;
+		int faceMask;
+	};
+
+	// Bounds enclosing both a and b
+	static LightBounds merge(const LightBounds& a, const LightBounds& b);
+
+	// Build the tree over the given lights, which are reordered in the
+	// process. Lights which emit no power are left out. The nodes are
+	// output in depth-first order, the root being the first one.
+	static void build(std::vector<LightBounds>& lights,
+					  std::vector<LightTreeNode>& nodes);
+};
+
@@ -266,6 +266,7 @@ namespace MagicaVoxel
 bool MagicaVoxelLoader::load(const std::string& filePath,
 							 std::vector<GLint>& voxelMaterials, 
 							 std::vector<float>& materialData,
+							 std::vector<GLint>& emissiveVoxelIndices,
 							 Imath::V3i& voxelResolution)
 {
 	using namespace MagicaVoxel;
@@ -298,24 +299,26 @@ bool MagicaVoxelLoader::load(const std::string& filePath,
 
 		// index material
 		voxelMaterials[voxelOffset] = materialDataOffset[v.colorIndex]; 
-		if ( voxelMaterials[voxelOffset] >= 0 )
+		if ( voxelMaterials[voxelOffset] < 0 )
 		{
-			// we've inserted this material already, continue
-			continue;
-		}
+			// New material -- append data
+			// With the information available we can only generate Lambertian materials
+			GLint materialOffset = (GLint)materialData.size();
+			materialDataOffset[v.colorIndex] = materialOffset;
+			voxelMaterials[voxelOffset] = materialOffset; 
 
-		// New material -- append data
-		// With the information available we can only generate Lambertian materials
-		GLint materialOffset = (GLint)materialData.size();
-		materialDataOffset[v.colorIndex] = materialOffset;
-		voxelMaterials[voxelOffset] = materialOffset; 
+			Imath::V3f emission(0,0,0);
+			Imath::V3f albedo((float)palette[4*v.colorIndex+0] / 255,
+							  (float)palette[4*v.colorIndex+1] / 255,
+							  (float)palette[4*v.colorIndex+2] / 255);
 
-		Imath::V3f emission(0,0,0);
-		Imath::V3f albedo((float)palette[4*v.colorIndex+0] / 255,
-						  (float)palette[4*v.colorIndex+1] / 255,
-						  (float)palette[4*v.colorIndex+2] / 255);
+			generateMaterialLambert(emission, albedo, materialData);
+		}
 
-		generateMaterialLambert(emission, albedo, materialData);
+		if (getMaterialEmisiveness(&materialData[voxelMaterials[voxelOffset]]) > 0)
+		{
+			emissiveVoxelIndices.push_back((GLint)voxelOffset);
+		}
 	}
 	return true;
 }
@@ -12,6 +12,49 @@ struct RenderSettings
     // Max number of accumulated samples before the render finishes
     int m_pathtracerMaxSamples;
 
+	// Number of samples per pixel taken by the integrator on each render pass.
+	// These are added straight onto the accumulation buffer within a single
+	// draw call.
+	int m_samplesPerPass;
+
+	// Target GPU time per displayed frame. As many passes are rendered as fit
+	// within it, based on the measured cost of previous ones. The interactive
+	// budget applies while the render keeps being reset (e.g. the camera is
+	// moving), the idle one otherwise. A budget of 0 renders a single pass per
+	// frame.
+	float m_interactiveFrameBudgetMs;
+	float m_idleFrameBudgetMs;
+
+	// Tiled rendering: once not even a single pass over the image fits within
+	// the frame budget (e.g. at very high resolutions or bounce counts), each
+	// pass is split in square tiles of m_tileSize pixels, and every frame
+	// only renders as many of them as the budget allows. No draw call or
+	// dispatch then runs for long enough to stall the desktop or trip the
+	// driver's watchdog. A tile size of 0 disables it.
+	int m_tileSize;
+	// Order in which the tiles of a pass are rendered: top to bottom, or
+	// from the center of the image outwards, which is usually where the
+	// subject is.
+	enum TileOrder
+	{
+		TILE_ORDER_SCANLINE = 0,
+		TILE_ORDER_CENTER,
+	};
+	TileOrder m_tileOrder;
+
+	// Smallest fraction of the image resolution (per axis) that may be used
+	// to render while interacting, so frames fit within the interactive
+	// budget. The image is then refined at full resolution once the
+	// interaction stops. A value of 1 disables dynamic resolution.
+	float m_dynamicResolutionMinScale;
+
+	// Adaptive sampling: tiles of the image stop receiving samples once the
+	// relative error of their pixels falls below the threshold (after a
+	// minimum number of samples), and the render finishes when all of them
+	// have converged. A threshold of 0 disables it.
+	float m_adaptiveSamplingThreshold;
+	int m_adaptiveSamplingMinSamples;
+
 	// rendered image resolution in pixels
 	Imath::V2i m_imageResolution;
 
@@ -23,6 +66,46 @@ struct RenderSettings
 	float m_wireframeOpacity;
 	float m_wireframeThickness;
 
+	// coarsest level of the voxel mip chain that bounce rays may traverse when
+	// their footprint is wide enough (0 = always trace at full resolution).
+	// Coarse levels trade accuracy for speed: the image converges to a
+	// slightly different (biased) result, so this is off unless asked for.
+	// The CPU reference path tracer always traces at full resolution.
+	int m_voxelLodMaxLevel;
+
+	// Decorrelate the sample sequences of neighbouring pixels by shifting them
+	// along a rank-1 lattice, rather than scrambling each one independently.
+	// This distributes the error as (roughly) blue noise, which is perceived
+	// as less noisy at low sample counts.
+	bool m_samplerRank1PixelDecorrelation;
+
+	// How the path tracer chooses which light to sample at each vertex:
+	// proportionally to the power of the lights, or to their estimated
+	// contribution to the vertex (by traversing a tree of light bounds),
+	// which pays off when each point only sees a few of many lights.
+	enum LightSelectionStrategy
+	{
+		LIGHT_SELECTION_POWER = 0,
+		LIGHT_SELECTION_LIGHT_TREE,
+	};
+	LightSelectionStrategy m_lightSelectionStrategy;
+
+	// Checkpoints: while rendering progressively with the path tracer, the
+	// accumulated samples are saved every so many seconds (0 disables it), so
+	// the render can be resumed after a restart (see
+	// Renderer::resumeFromCheckpoint). Unless a file is given, checkpoints go
+	// to the cache directory, named after the scene they were rendered from,
+	// where the least recently used ones are pruned. Either way, a checkpoint
+	// is removed once its render is finished.
+	int m_checkpointIntervalSeconds;
+	std::string m_checkpointFile;
+
+	// Size in pixels of the regions a tiled image is rendered in (see
+	// Renderer::renderTiledImage), rounded up to whole tiles of the file.
+	// The render buffers are sized to match while it renders, so this bounds
+	// the memory used regardless of the image resolution.
+	int m_outputTileSize;
+
 	std::string m_backgroundImage;
 	Imath::V3f m_backgroundColor[2]; // gradient (top/bottom)
 	int m_backgroundRotationDegrees;
@@ -3,16 +3,23 @@
 #include <GL/glut.h>
 #include <GL/glu.h>
 
-#include <OpenImageIO/imageio.h>
 #include <OpenEXR/ImathMatrixAlgo.h>
 
 #include "renderer/renderer.h"
 
 #include "content.h"
 #include "camera/cameraController.h"
-#include "renderer/image.h"
+#include "voxel/voxelMipmap.h"
+#include "voxel/voxelGrid.h"
 #include "shaders/focalDistance/focalDistanceHost.h"
 #include "shaders/editVoxels/selectVoxelHost.h"
+#include "shaders/lightSampling/lightAliasTableHost.h"
+#include "shaders/wavefront/wavefrontHost.h"
+#include "renderer/lights/aliasTable.h"
+#include "renderer/lights/lightTree.h"
+#include "renderer/imageWriter.h"
+#include "renderer/checkpoint.h"
+#include "cache/cache.h"
 #include "shaders/shared/constants.h"
 
 #include "renderer/services/serviceAddVoxel.h"
@@ -20,8 +27,15 @@
 #include "renderer/services/serviceSelectActiveVoxel.h"
 #include "renderer/services/serviceSetFocalDistance.h"
 
+#include <boost/bind.hpp>
+
+#include <sys/stat.h>
+
 #include <memory.h>
 #include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <sstream>
 
 #include <Qt> // FIXME used for Qt::Key codes
 
@@ -30,12 +44,16 @@ struct IntegratorSetup
 	std::string vs;
 	std::string fs;
 	std::string name;
+	// gamma applied when displaying the accumulated image
+	float displayGamma;
 };
 
 IntegratorSetup integratorSetup[Renderer::INTEGRATOR_TOTAL] = 
 {
-	{"shared/screenSpace.vs" , "integrator/pathTracer.fs" , "PT"} ,
-	{"shared/screenSpace.vs" , "integrator/editMode.fs"   , "EditMode"} ,
+	{"shared/screenSpace.vs" , "integrator/pathTracer.fs" , "PT"       , 2.2f} ,
+	{"shared/screenSpace.vs" , "integrator/editMode.fs"   , "EditMode" , 1.0f} ,
+	// built from compute stages instead, see startWavefrontShaders
+	{""                      , ""                         , "WavefrontPT" , 2.2f} ,
 };
 
 Renderer::Renderer()
@@ -44,28 +62,100 @@ Renderer::Renderer()
 	m_camera.controller().lookAt(Imath::V3f(0,0,0));
 	m_camera.controller().setDistanceFromTarget(100);
 	m_camera.setFStop(16);
-	m_activeSampleTexture = 0;
 	m_numberSamples = 0;
+	m_nextTile = 0;
+	m_framesSinceReset = 0;
+	m_renderingPreview = false;
+	m_previewNumberSamples = 0;
+	m_convergenceMaskValid = false;
+	m_convergenceFence = 0;
+	m_unconvergedTiles = -1;
 
 	m_renderSettings.m_imageResolution.x = 512;
 	m_renderSettings.m_imageResolution.y = 512;
 	m_renderSettings.m_pathtracerMaxNumBounces = 1;
 	m_renderSettings.m_pathtracerMaxSamples = 2048 * 2048;
+	m_renderSettings.m_samplesPerPass = 1;
+	m_renderSettings.m_interactiveFrameBudgetMs = 16;
+	m_renderSettings.m_idleFrameBudgetMs = 100;
+	m_renderSettings.m_tileSize = 256;
+	m_renderSettings.m_tileOrder = RenderSettings::TILE_ORDER_CENTER;
+	m_renderSettings.m_dynamicResolutionMinScale = 0.25f;
+	m_renderSettings.m_adaptiveSamplingThreshold = 0; // off
+	m_renderSettings.m_adaptiveSamplingMinSamples = 64;
+	m_renderSettings.m_samplerRank1PixelDecorrelation = false;
+	m_renderSettings.m_lightSelectionStrategy = RenderSettings::LIGHT_SELECTION_LIGHT_TREE;
+	m_renderSettings.m_voxelLodMaxLevel = 0; // off
+
+	// objects are only deleted before being recreated if glIs* recognizes
+	// them, so their names must not start with a value which could belong to
+	// someone else's (e.g. the uniform buffers).
+	m_glResources.m_mainFBO = 0;
+	m_glResources.m_mainRBO = 0;
+	m_glResources.m_fullscreenVAO = 0;
+	m_glResources.m_accumulationTexture = 0;
+	m_glResources.m_previewAccumulationTexture = 0;
+	m_glResources.m_momentsTexture = 0;
+	m_glResources.m_convergenceMaskTexture = 0;
+	m_glResources.m_unconvergedTilesCounter = 0;
+	m_glResources.m_unconvergedTilesReadback = 0;
+	m_glResources.m_focalDistanceSSBO = 0;
+	m_glResources.m_selectedVoxelSSBO = 0;
+	m_glResources.m_lightAliasTableSSBO = 0;
+	m_glResources.m_lightTreeSSBO = 0;
+	m_glResources.m_wavefrontPathsSSBO = 0;
+	m_glResources.m_wavefrontQueuesSSBO = 0;
+	m_glResources.m_wavefrontQueueCountersSSBO = 0;
+	m_glResources.m_materialOffsetTexture = 0;
+	m_glResources.m_materialDataTexture = 0;
+	m_glResources.m_backgroundTexture = 0;
+	m_glResources.m_backgroundAliasUTexture = 0;
+	m_glResources.m_backgroundAliasVTexture = 0;
+	m_glResources.m_volumeNumLevels = 1;
+	m_glResources.m_wavefrontCapacity = 0;
+	m_voxelMipmapsDirty = false;
+	m_voxelEditInProgress = false;
+	m_sceneVoxelsEdited = false;
+	m_settingsVoxelMipmap.m_program = 0;
 
 	m_currentIntegrator = INTEGRATOR_PATHTRACER;
+	for( int i = 0; i < INTEGRATOR_TOTAL; ++i )
+	{
+		m_integratorState[i] = PROGRAM_UNLOADED;
+	}
 
 	m_currentBackgroundImage = "";
 	m_currentBackgroundRadianceIntegral = 0;
 
+	m_renderSettings.m_checkpointIntervalSeconds = 600;
+	m_renderSettings.m_outputTileSize = 1024;
+	m_tiledImage = NULL;
+	m_sceneVoxelsHash = HASH_SEED;
+	m_lastCheckpointTime = time(NULL);
+	m_checkpointNumberSamples = 0;
+	m_pendingResume = NULL;
+
 	m_logger = NULL;
 
 	memset(m_services, 0, SERVICE_TOTAL * sizeof(RendererService*));
+	memset(m_serviceLoaded, 0, SERVICE_TOTAL * sizeof(bool));
 
 	m_initialized = false;
 }
 
 Renderer::~Renderer()
 {
+	// let the files being written finish
+	for( size_t i = 0; i < m_pendingReadbacks.size(); ++i )
+	{
+		delete m_pendingReadbacks[i].task;
+	}
+	if (m_tiledImage != NULL)
+	{
+		delete m_tiledImage->writer;
+		delete m_tiledImage;
+	}
+	delete m_pendingResume;
 }
 
 void Renderer::setLogger(Logger* logger)
@@ -79,19 +169,24 @@ void Renderer::initialize(const std::string& shaderPath)
 
 	glewExperimental = true;
 	glewInit();
+	if (Shader::enableParallelCompilation() && m_logger) (*m_logger)("Building shaders in parallel.");
 	glClearColor(0.1f, 0.1f, 0.1f, 0);
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_CULL_FACE);
 
-	glEnable(GL_TEXTURE_1D);
-	glEnable(GL_TEXTURE_2D);
-	glEnable(GL_TEXTURE_3D);
+	if (glIsVertexArray(m_glResources.m_fullscreenVAO)) glDeleteVertexArrays(1, &m_glResources.m_fullscreenVAO);
+	glGenVertexArrays(1, &m_glResources.m_fullscreenVAO);
 	if (glIsTexture(m_glResources.m_materialOffsetTexture)) glDeleteTextures(1, &m_glResources.m_materialOffsetTexture);
 	glGenTextures(1, &m_glResources.m_materialOffsetTexture);
 	if (glIsTexture(m_glResources.m_materialDataTexture)) glDeleteTextures(1, &m_glResources.m_materialDataTexture);
 	glGenTextures(1, &m_glResources.m_materialDataTexture);
-	if (glIsTexture(m_glResources.m_emissiveVoxelIndicesTexture)) glDeleteTextures(1, &m_glResources.m_emissiveVoxelIndicesTexture);
-	glGenTextures(1, &m_glResources.m_emissiveVoxelIndicesTexture);
+	if (glIsBuffer(m_glResources.m_lightAliasTableSSBO)) glDeleteBuffers(1, &m_glResources.m_lightAliasTableSSBO);
+	glGenBuffers(1, &m_glResources.m_lightAliasTableSSBO);
+	if (glIsBuffer(m_glResources.m_lightTreeSSBO)) glDeleteBuffers(1, &m_glResources.m_lightTreeSSBO);
+	glGenBuffers(1, &m_glResources.m_lightTreeSSBO);
+	m_cameraUniforms.create(GLResourceConfiguration::m_cameraUBOBindingPointIndex);
+	m_volumeUniforms.create(GLResourceConfiguration::m_volumeUBOBindingPointIndex);
+	m_settingsUniforms.create(GLResourceConfiguration::m_settingsUBOBindingPointIndex);
 
 	createFramebuffer();
 	reloadShaders(shaderPath);
@@ -118,28 +213,15 @@ void Renderer::initialize(const std::string& shaderPath)
 			);
 
 
-	// init services
+	// init services. Their shaders are loaded once they're first used (see
+	// service).
 	m_services[SERVICE_ADD_VOXEL]           = new RendererServiceAddVoxel();
 	m_services[SERVICE_REMOVE_VOXEL]        = new RendererServiceRemoveVoxel();
 	m_services[SERVICE_SELECT_ACTIVE_VOXEL] = new RendererServiceSelectActiveVoxel();
 	m_services[SERVICE_SET_FOCAL_DISTANCE]  = new RendererServiceSetFocalDistance();
 
-	for( int i = 0; i < SERVICE_TOTAL; ++i)
-	{
-		if (m_services[i] == NULL) continue;
-		m_services[i]->reload(shaderPath, m_logger);
-		m_services[i]->glResourcesCreated(m_glResources);
-		m_services[i]->cameraUpdated(Imath::M44f(),
-									 Imath::M44f(),
-									 Imath::M44f(),
-									 Imath::M44f(),
-									 m_camera);
-		m_services[i]->frameResized(m_renderSettings.m_viewport);
-		m_services[i]->volumeReloaded(m_glResources.m_volumeResolution,
-									  m_volumeBounds);
-	}
-
 	m_frameTimer.init();
+	m_sampleTimer.init();
 
 	if (m_logger) (*m_logger)("Renderer initialized.");
 
@@ -169,8 +251,13 @@ bool Renderer::reloadTexturedShader(const std::string& shaderPath)
 	
 	glUseProgram(m_settingsTextured.m_program);
 
-	m_settingsTextured.m_uniformTexture  = glGetUniformLocation(m_settingsTextured.m_program, "texture");
+	m_settingsTextured.m_uniformTexture  = glGetUniformLocation(m_settingsTextured.m_program, "accumulationTexture");
 	m_settingsTextured.m_uniformViewport = glGetUniformLocation(m_settingsTextured.m_program, "viewport");
+	m_settingsTextured.m_uniformTonemappingGamma = glGetUniformLocation(m_settingsTextured.m_program, "tonemappingGamma");
+	m_settingsTextured.m_uniformTextureWeight    = glGetUniformLocation(m_settingsTextured.m_program, "textureWeight");
+	m_settingsTextured.m_uniformPreviewTexture   = glGetUniformLocation(m_settingsTextured.m_program, "previewTexture");
+	m_settingsTextured.m_uniformPreviewScale     = glGetUniformLocation(m_settingsTextured.m_program, "previewScale");
+	m_settingsTextured.m_uniformPreviewWeight    = glGetUniformLocation(m_settingsTextured.m_program, "previewWeight");
 
 	glUniform4f(m_settingsTextured.m_uniformViewport, 
 				(float)m_renderSettings.m_viewport[0],
@@ -183,87 +270,198 @@ bool Renderer::reloadTexturedShader(const std::string& shaderPath)
 	return true;
 }
 
-bool Renderer::reloadAverageShader(const std::string& shaderPath)
+bool Renderer::reloadConvergenceShader(const std::string& shaderPath)
 {
-	std::string vs = shaderPath + std::string("shared/screenSpace.vs");
-	std::string fs = shaderPath + std::string("shared/accumulation.fs");
+	std::string cs = shaderPath + std::string("adaptiveSampling/convergence.cs");
 
-	if ( !Shader::compileProgramFromFile("accumulation",
-										shaderPath,
-										vs, "",
-										fs, "",
-										m_settingsAverage.m_program,
-										m_logger) )
+	if ( !Shader::compileComputeProgramFromFile("convergence",
+												shaderPath,
+												cs, "",
+												m_settingsConvergence.m_program,
+												m_logger) )
 	{
 		return false;
 	}
 	
-	glUseProgram(m_settingsAverage.m_program);
+	glUseProgram(m_settingsConvergence.m_program);
 
-	m_settingsAverage.m_uniformSampleTexture  = glGetUniformLocation(m_settingsAverage.m_program, "sampleTexture");
-	m_settingsAverage.m_uniformAverageTexture = glGetUniformLocation(m_settingsAverage.m_program, "averageTexture");
-	m_settingsAverage.m_uniformSampleCount    = glGetUniformLocation(m_settingsAverage.m_program, "sampleCount");
-	m_settingsAverage.m_uniformViewport       = glGetUniformLocation(m_settingsAverage.m_program, "viewport");
+	m_settingsConvergence.m_uniformAccumulationTexture = glGetUniformLocation(m_settingsConvergence.m_program, "accumulationTexture");
+	m_settingsConvergence.m_uniformMomentsTexture      = glGetUniformLocation(m_settingsConvergence.m_program, "momentsTexture");
+	m_settingsConvergence.m_uniformImageResolution     = glGetUniformLocation(m_settingsConvergence.m_program, "imageResolution");
+	m_settingsConvergence.m_uniformMinSamples          = glGetUniformLocation(m_settingsConvergence.m_program, "minSamples");
+	m_settingsConvergence.m_uniformErrorThreshold      = glGetUniformLocation(m_settingsConvergence.m_program, "errorThreshold");
 
-	glUniform4f(m_settingsAverage.m_uniformViewport, 0, 0, (float)m_renderSettings.m_imageResolution.x, (float)m_renderSettings.m_imageResolution.y);
+	glUniform1i(m_settingsConvergence.m_uniformAccumulationTexture, GLResourceConfiguration::TEXTURE_UNIT_ACCUMULATION);
+	glUniform1i(m_settingsConvergence.m_uniformMomentsTexture, GLResourceConfiguration::TEXTURE_UNIT_MOMENTS);
 
 	glUseProgram(0);
 
 	return true;
 }
 
-bool Renderer::reloadIntegratorShader(const std::string& shaderPath, 
-									  const std::string& name,
-									  const std::string& vsFile,
-									  const std::string& fsFile,
-									  IntegratorShaderSettings& settings)
+bool Renderer::reloadVoxelMipmapShader(const std::string& shaderPath)
 {
-	std::string vs = shaderPath + vsFile;
-	std::string fs = shaderPath + fsFile; 
+	std::string cs = shaderPath + std::string("voxelMipmap/downsample.cs");
 
-	if ( !Shader::compileProgramFromFile(name,
-										shaderPath,
-										vs, "",
-										fs, "#define PINHOLE\n#define THINLENS\n",
-										settings.m_program,
-										m_logger) )
+	if ( !Shader::compileComputeProgramFromFile("voxelMipmap",
+												shaderPath,
+												cs, "",
+												m_settingsVoxelMipmap.m_program,
+												m_logger) )
 	{
 		return false;
 	}
-	
+
+	m_settingsVoxelMipmap.m_uniformDestinationResolution = glGetUniformLocation(m_settingsVoxelMipmap.m_program, "destinationResolution");
+
+	return true;
+}
+
+void Renderer::requestIntegrator(Integrator integrator)
+{
+	if (m_integratorState[integrator] != PROGRAM_UNLOADED) return;
+
+	std::vector<ShaderProgramBuild>& builds = m_integratorBuilds[integrator];
+	bool started = false;
+	if (integrator == INTEGRATOR_WAVEFRONT_PATHTRACER)
+	{
+		started = startWavefrontShaders(builds);
+	}
+	else
+	{
+		builds.resize(1);
+		started = Shader::startProgramFromFile(integratorSetup[integrator].name,
+											   m_shaderPath,
+											   m_shaderPath + integratorSetup[integrator].vs, "",
+											   m_shaderPath + integratorSetup[integrator].fs, "#define PINHOLE\n#define THINLENS\n",
+											   builds[0],
+											   m_logger);
+	}
+	if (!started)
+	{
+		for( size_t i = 0; i < builds.size(); ++i ) glDeleteProgram(builds[i].program);
+		builds.clear();
+		m_integratorState[integrator] = PROGRAM_FAILED;
+		m_status = integratorSetup[integrator].name + " loading failed";
+		return;
+	}
+	m_integratorState[integrator] = PROGRAM_BUILDING;
+}
+
+bool Renderer::isIntegratorReady(Integrator integrator, bool wait)
+{
+	requestIntegrator(integrator);
+	if (m_integratorState[integrator] != PROGRAM_BUILDING) return m_integratorState[integrator] == PROGRAM_READY;
+
+	std::vector<ShaderProgramBuild>& builds = m_integratorBuilds[integrator];
+	if (!wait)
+	{
+		for( size_t i = 0; i < builds.size(); ++i )
+		{
+			if (!Shader::isProgramReady(builds[i])) return false;
+		}
+	}
+
+	bool built = false;
+	if (integrator == INTEGRATOR_WAVEFRONT_PATHTRACER)
+	{
+		built = finishWavefrontShaders(builds);
+	}
+	else
+	{
+		IntegratorShaderSettings& settings = m_settingsIntegrator[integrator];
+		built = Shader::finishProgram(builds[0], settings.m_program, m_logger);
+		if (built) setupIntegratorProgram(settings);
+	}
+	builds.clear();
+
+	m_integratorState[integrator] = built ? PROGRAM_READY : PROGRAM_FAILED;
+	if (!built) m_status = integratorSetup[integrator].name + " loading failed";
+	return built;
+}
+
+bool Renderer::startWavefrontShaders(std::vector<ShaderProgramBuild>& builds)
+{
+	struct Stage
+	{
+		const char* cs;
+		const char* name;
+		// material shaded by the shading stages
+		const char* defines;
+	};
+	const Stage stages[WavefrontShaderSettings::STAGE_TOTAL] = 
+	{
+		{"wavefront/generate.cs"   , "WavefrontGenerate"     , ""},
+		{"wavefront/extend.cs"     , "WavefrontExtend"       , ""},
+		{"wavefront/shade.cs"      , "WavefrontShadeMatte"   , "#define SHADE_MATERIAL MATERIAL_MATTE\n"},
+		{"wavefront/shade.cs"      , "WavefrontShadeMetal"   , "#define SHADE_MATERIAL MATERIAL_METAL\n"},
+		{"wavefront/shade.cs"      , "WavefrontShadePlastic" , "#define SHADE_MATERIAL MATERIAL_PLASTIC\n"},
+		{"wavefront/connect.cs"    , "WavefrontConnect"      , ""},
+		{"wavefront/accumulate.cs" , "WavefrontAccumulate"   , ""},
+		{"wavefront/dispatch.cs"   , "WavefrontDispatch"     , ""},
+	};
+
+	// all the stages are started before any is waited on, so the driver can
+	// build them side by side
+	builds.resize(WavefrontShaderSettings::STAGE_TOTAL);
+	for( int i = 0; i < WavefrontShaderSettings::STAGE_TOTAL; ++i )
+	{
+		if ( !Shader::startComputeProgramFromFile(stages[i].name,
+												  m_shaderPath,
+												  m_shaderPath + stages[i].cs,
+												  std::string("#define PINHOLE\n#define THINLENS\n") + stages[i].defines,
+												  builds[i],
+												  m_logger) )
+		{
+			builds.resize(i);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Renderer::finishWavefrontShaders(const std::vector<ShaderProgramBuild>& builds)
+{
+	for( int i = 0; i < WavefrontShaderSettings::STAGE_TOTAL; ++i )
+	{
+		IntegratorShaderSettings& settings = m_settingsWavefront.m_stages[i];
+		if ( !Shader::finishProgram(builds[i], settings.m_program, m_logger) )
+		{
+			return false;
+		}
+		setupIntegratorProgram(settings);
+	}
+
+	const GLuint generateProgram = m_settingsWavefront.m_stages[WavefrontShaderSettings::STAGE_GENERATE].m_program;
+	m_settingsWavefront.m_uniformGenerateWaveOrigin = glGetUniformLocation(generateProgram, "waveOrigin");
+	m_settingsWavefront.m_uniformGenerateWaveSize   = glGetUniformLocation(generateProgram, "waveSize");
+
+	const GLuint accumulateProgram = m_settingsWavefront.m_stages[WavefrontShaderSettings::STAGE_ACCUMULATE].m_program;
+	m_settingsWavefront.m_uniformAccumulateWaveOrigin = glGetUniformLocation(accumulateProgram, "waveOrigin");
+	m_settingsWavefront.m_uniformAccumulateWaveSize   = glGetUniformLocation(accumulateProgram, "waveSize");
+	m_settingsWavefront.m_uniformAccumulateMoments    = glGetUniformLocation(accumulateProgram, "accumulateMoments");
+
+	const GLuint dispatchProgram = m_settingsWavefront.m_stages[WavefrontShaderSettings::STAGE_DISPATCH].m_program;
+	m_settingsWavefront.m_uniformDispatchQueues = glGetUniformLocation(dispatchProgram, "queues");
+
+	return true;
+}
+
+void Renderer::setupIntegratorProgram(IntegratorShaderSettings& settings)
+{
 	glUseProgram(settings.m_program);
 
 	settings.m_uniformMaterialOffsetTexture     = glGetUniformLocation(settings.m_program, "materialOffsetTexture");
 	settings.m_uniformMaterialDataTexture       = glGetUniformLocation(settings.m_program, "materialDataTexture");
-	settings.m_emissiveVoxelIndicesTexture      = glGetUniformLocation(settings.m_program, "emissiveVoxelIndicesTexture");
-	settings.m_uniformNoiseTexture              = glGetUniformLocation(settings.m_program, "noiseTexture");
-	settings.m_uniformVoxelDataResolution       = glGetUniformLocation(settings.m_program, "voxelResolution");
-	settings.m_uniformVolumeBoundsMin           = glGetUniformLocation(settings.m_program, "volumeBoundsMin");
-	settings.m_uniformVolumeBoundsMax           = glGetUniformLocation(settings.m_program, "volumeBoundsMax");
-	settings.m_uniformVoxelSize                 = glGetUniformLocation(settings.m_program, "wsVoxelSize");
 	settings.m_uniformViewport                  = glGetUniformLocation(settings.m_program, "viewport");
-	settings.m_uniformCameraNear                = glGetUniformLocation(settings.m_program, "cameraNear");
-	settings.m_uniformCameraFar                 = glGetUniformLocation(settings.m_program, "cameraFar");
-	settings.m_uniformCameraProj                = glGetUniformLocation(settings.m_program, "cameraProj");
-	settings.m_uniformCameraInverseProj         = glGetUniformLocation(settings.m_program, "cameraInverseProj");
-	settings.m_uniformCameraInverseModelView    = glGetUniformLocation(settings.m_program, "cameraInverseModelView");
-	settings.m_uniformCameraFocalLength         = glGetUniformLocation(settings.m_program, "cameraFocalLength");
-	settings.m_uniformCameraLensRadius          = glGetUniformLocation(settings.m_program, "cameraLensRadius");
-	settings.m_uniformCameraFilmSize            = glGetUniformLocation(settings.m_program, "cameraFilmSize");
-	settings.m_uniformCameraLensModel           = glGetUniformLocation(settings.m_program, "cameraLensModel");
 	settings.m_uniformLightDir                  = glGetUniformLocation(settings.m_program, "wsLightDir");
 	settings.m_uniformSampleCount               = glGetUniformLocation(settings.m_program, "sampleCount");
-	settings.m_uniformPathtracerMaxPathBounces  = glGetUniformLocation(settings.m_program, "pathtracerMaxNumBounces");
-	settings.m_uniformWireframeOpacity          = glGetUniformLocation(settings.m_program, "wireframeOpacity");
-	settings.m_uniformWireframeThickness        = glGetUniformLocation(settings.m_program, "wireframeThickness");
-	settings.m_uniformBackgroundColorTop        = glGetUniformLocation(settings.m_program, "backgroundColorTop");
-	settings.m_uniformBackgroundColorBottom     = glGetUniformLocation(settings.m_program, "backgroundColorBottom");
-	settings.m_uniformBackgroundUseImage        = glGetUniformLocation(settings.m_program, "backgroundUseImage");
+	settings.m_uniformSamplesPerPass            = glGetUniformLocation(settings.m_program, "samplesPerPass");
 	settings.m_uniformBackgroundTexture         = glGetUniformLocation(settings.m_program, "backgroundTexture");
-	settings.m_uniformBackgroundCDFUTexture     = glGetUniformLocation(settings.m_program, "backgroundCDFUTexture");
-	settings.m_uniformBackgroundCDFVTexture     = glGetUniformLocation(settings.m_program, "backgroundCDFVTexture");
-	settings.m_uniformBackgroundIntegral        = glGetUniformLocation(settings.m_program, "backgroundIntegral");
-	settings.m_uniformBackgroundRotationRadians = glGetUniformLocation(settings.m_program, "backgroundRotationRadians");
+	settings.m_uniformBackgroundAliasUTexture    = glGetUniformLocation(settings.m_program, "backgroundAliasUTexture");
+	settings.m_uniformBackgroundAliasVTexture    = glGetUniformLocation(settings.m_program, "backgroundAliasVTexture");
+	settings.m_uniformAdaptiveSampling          = glGetUniformLocation(settings.m_program, "adaptiveSampling");
+	settings.m_uniformConvergenceMask           = glGetUniformLocation(settings.m_program, "convergenceMask");
 
 	settings.m_uniformFocalDistanceSSBOStorageBlock = glGetProgramResourceIndex(settings.m_program, GL_SHADER_STORAGE_BLOCK, "FocalDistanceData");
 	glShaderStorageBlockBinding(settings.m_program, settings.m_uniformFocalDistanceSSBOStorageBlock, GLResourceConfiguration::m_focalDistanceSSBOBindingPointIndex);
@@ -273,85 +471,108 @@ bool Renderer::reloadIntegratorShader(const std::string& shaderPath,
 	glShaderStorageBlockBinding(settings.m_program, settings.m_uniformSelectedVoxelSSBOStorageBlock, GLResourceConfiguration::m_selectedVoxelSSBOBindingPointIndex);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GLResourceConfiguration::m_selectedVoxelSSBOBindingPointIndex, m_glResources.m_selectedVoxelSSBO);
 
+	settings.m_uniformLightAliasTableSSBOStorageBlock = glGetProgramResourceIndex(settings.m_program, GL_SHADER_STORAGE_BLOCK, "LightAliasTable_t");
+	if (settings.m_uniformLightAliasTableSSBOStorageBlock != GL_INVALID_INDEX)
+	{
+		// only the path tracer samples lights
+		glShaderStorageBlockBinding(settings.m_program, settings.m_uniformLightAliasTableSSBOStorageBlock, GLResourceConfiguration::m_lightAliasTableSSBOBindingPointIndex);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GLResourceConfiguration::m_lightAliasTableSSBOBindingPointIndex, m_glResources.m_lightAliasTableSSBO);
+
+	settings.m_uniformLightTreeSSBOStorageBlock = glGetProgramResourceIndex(settings.m_program, GL_SHADER_STORAGE_BLOCK, "LightTree_t");
+	if (settings.m_uniformLightTreeSSBOStorageBlock != GL_INVALID_INDEX)
+	{
+		glShaderStorageBlockBinding(settings.m_program, settings.m_uniformLightTreeSSBOStorageBlock, GLResourceConfiguration::m_lightTreeSSBOBindingPointIndex);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GLResourceConfiguration::m_lightTreeSSBOBindingPointIndex, m_glResources.m_lightTreeSSBO);
+
 	glViewport(0,0,m_renderSettings.m_imageResolution.x, m_renderSettings.m_imageResolution.y);
-	glUniform4f(settings.m_uniformViewport, 0, 0, (float)m_renderSettings.m_imageResolution.x, (float)m_renderSettings.m_imageResolution.y);
+	setIntegratorViewport(settings, m_renderSettings.m_imageResolution);
 
 	Imath::V3f lightDir = lightDirection();
 	glUniform3f(settings.m_uniformLightDir, lightDir.x, lightDir.y, -lightDir.z);
 
 	glUniform1i(settings.m_uniformMaterialOffsetTexture, GLResourceConfiguration::TEXTURE_UNIT_MATERIAL_OFFSET);
 	glUniform1i(settings.m_uniformMaterialDataTexture, GLResourceConfiguration::TEXTURE_UNIT_MATERIAL_DATA);
-	glUniform1i(settings.m_uniformNoiseTexture, GLResourceConfiguration::TEXTURE_UNIT_NOISE);
-	glUniform1i(settings.m_emissiveVoxelIndicesTexture, GLResourceConfiguration::TEXTURE_UNIT_EMISSIVE_VOXEL_INDICES);
-	
-	glUniform3i(settings.m_uniformVoxelDataResolution, 
-				m_glResources.m_volumeResolution.x, 
-				m_glResources.m_volumeResolution.y, 
-				m_glResources.m_volumeResolution.z);
-
-	glUniform3f(settings.m_uniformVolumeBoundsMin,
-				m_volumeBounds.min.x,
-				m_volumeBounds.min.y,
-				m_volumeBounds.min.z);
-
-	glUniform3f(settings.m_uniformVolumeBoundsMax,
-				m_volumeBounds.max.x,
-				m_volumeBounds.max.y,
-				m_volumeBounds.max.z);
-
-	glUniform3f(settings.m_uniformVoxelSize,
-				(m_volumeBounds.max.x-m_volumeBounds.min.x) / m_glResources.m_volumeResolution.x,
-				(m_volumeBounds.max.y-m_volumeBounds.min.y) / m_glResources.m_volumeResolution.y,
-				(m_volumeBounds.max.z-m_volumeBounds.min.z) / m_glResources.m_volumeResolution.z);
-
-	updateCamera();
+	glUniform1i(settings.m_uniformConvergenceMask, GLResourceConfiguration::TEXTURE_UNIT_CONVERGENCE_MASK);
+	glUniform1i(settings.m_uniformBackgroundTexture, GLResourceConfiguration::TEXTURE_UNIT_BACKGROUND);
+	glUniform1i(settings.m_uniformBackgroundAliasUTexture, GLResourceConfiguration::TEXTURE_UNIT_BACKGROUND_ALIAS_U);
+	glUniform1i(settings.m_uniformBackgroundAliasVTexture, GLResourceConfiguration::TEXTURE_UNIT_BACKGROUND_ALIAS_V);
 
 	glUseProgram(0);
+}
 
-	return true;
+std::vector<IntegratorShaderSettings*> Renderer::integratorPrograms()
+{
+	std::vector<IntegratorShaderSettings*> programs;
+	for( int i = 0; i < INTEGRATOR_TOTAL; ++i )
+	{
+		if (i == INTEGRATOR_WAVEFRONT_PATHTRACER || m_integratorState[i] != PROGRAM_READY) continue;
+		programs.push_back(&m_settingsIntegrator[i]);
+	}
+	if (m_integratorState[INTEGRATOR_WAVEFRONT_PATHTRACER] == PROGRAM_READY)
+	{
+		for( int i = 0; i < WavefrontShaderSettings::STAGE_TOTAL; ++i )
+		{
+			programs.push_back(&m_settingsWavefront.m_stages[i]);
+		}
+	}
+	return programs;
+}
+
+RendererService* Renderer::service(RendererServiceType type)
+{
+	if (type < 0 || type >= SERVICE_TOTAL || m_services[type] == NULL) return NULL;
+	if (m_serviceLoaded[type]) return m_services[type];
+
+	// bring the service up to date with the renderer, as it's only told about
+	// changes once loaded
+	RendererService* rendererService = m_services[type];
+	rendererService->reload(m_shaderPath, m_logger);
+	rendererService->glResourcesCreated(m_glResources);
+	Imath::M44f mvm, pm;
+	cameraMatrices(mvm, pm);
+	rendererService->cameraUpdated(mvm, mvm.inverse(), pm, pm.inverse(), m_camera);
+	rendererService->frameResized(m_renderSettings.m_viewport);
+	rendererService->volumeReloaded(m_glResources.m_volumeResolution, m_volumeBounds);
+	m_serviceLoaded[type] = true;
+	return rendererService;
 }
 
 void Renderer::reloadShaders(const std::string& shaderPath)
 {
-	if (!reloadAverageShader(shaderPath) ||
-		!reloadTexturedShader(shaderPath))
+	m_shaderPath = shaderPath;
+	if (!reloadTexturedShader(shaderPath) ||
+		!reloadConvergenceShader(shaderPath) ||
+		!reloadVoxelMipmapShader(shaderPath))
 	{
 		m_status = "Shader loading failed";
 		return;
 	}
+
+	// the integrators and services are rebuilt as they're next used, but for
+	// the current integrator, which is started right away.
 	for( int i = 0; i < INTEGRATOR_TOTAL; ++i )
 	{
-		if ( !reloadIntegratorShader(shaderPath, 
-									 integratorSetup[i].name,
-									 integratorSetup[i].vs,
-									 integratorSetup[i].fs,
-									 m_settingsIntegrator[i]) )
-		{
-			m_status = integratorSetup[i].name + " loading failed";
-		}
-	}
-	for( int i = 0; i < SERVICE_TOTAL; ++i)
-	{
-		if (m_services[i] == NULL) continue;
-		m_services[i]->reload(shaderPath, m_logger);
+		std::vector<ShaderProgramBuild>& builds = m_integratorBuilds[i];
+		for( size_t j = 0; j < builds.size(); ++j ) glDeleteProgram(builds[j].program);
+		builds.clear();
+		m_integratorState[i] = PROGRAM_UNLOADED;
 	}
+	requestIntegrator(m_currentIntegrator);
+	memset(m_serviceLoaded, 0, SERVICE_TOTAL * sizeof(bool));
 
 	updateCamera();
 	updateRenderSettings();
 }
 
-void Renderer::updateCamera()
+void Renderer::cameraMatrices(Imath::M44f& mvm, Imath::M44f& pm) const
 {
-	if (!m_initialized) return;
-
 	using namespace Imath;
 	V3f eye	 = m_camera.parameters().eye();
 	V3f right, up, forward;
 	m_camera.parameters().getBasis(forward, right, up);
 
-	M44f mvm; // modelViewMatrix
-	M44f pm; // projectionMatrix
-
 	{ // gluLookAt
 		mvm.makeIdentity()        ;
 		mvm.x[0][0] = right[0]    ; mvm.x[0][1] = right[1]    ; mvm.x[0][2] = right[2]    ; mvm.x[0][3] = -eye.dot(right)  ;
@@ -363,7 +584,7 @@ void Renderer::updateCamera()
 	if (m_camera.parameters().lensModel() == CameraParameters::CLM_ORTHOGRAPHIC)
 	{ // gluOrtho2D
 	
-		const float a = (float)m_renderSettings.m_imageResolution.x / m_renderSettings.m_imageResolution.y;
+		const float a = (float)imageResolution().x / imageResolution().y;
 		const float left = -tan(m_camera.parameters().fovY() / 2) * m_camera.parameters().distanceToTarget();
 		const float right = -left;
 		const float bottom = -tan(m_camera.parameters().fovY() / 2) * m_camera.parameters().distanceToTarget() / a;
@@ -382,7 +603,7 @@ void Renderer::updateCamera()
 	}
 	else
 	{ // gluPerspective
-		const float a = (float)m_renderSettings.m_imageResolution.x / m_renderSettings.m_imageResolution.y;
+		const float a = (float)imageResolution().x / imageResolution().y;
 		const float n = m_camera.parameters().nearDistance();
 		const float f = m_camera.parameters().farDistance();
 		const float e = 1.0f / tan(m_camera.parameters().fovY()/2);
@@ -392,57 +613,48 @@ void Renderer::updateCamera()
 		pm.x[2][0] = 0   ; pm.x[2][1] = 0 ; pm.x[2][2] = (f+n)/(n-f) ; pm.x[2][3] = 2.0f*f*n/(n-f) ;
 		pm.x[3][0] = 0   ; pm.x[3][1] = 0 ; pm.x[3][2] = -1          ; pm.x[3][3] = 0              ;
 	}
+}
+
+void Renderer::updateCamera()
+{
+	if (!m_initialized) return;
+
+	using namespace Imath;
+	M44f mvm; // modelViewMatrix
+	M44f pm; // projectionMatrix
+	cameraMatrices(mvm, pm);
 
 	M44f invModelView = mvm.inverse();
 	M44f invProj = pm.inverse();
 
+	// the matrices keep the layout Imath gives them, see uniformBlocksHost.h
+	CameraUniforms& uniforms = m_cameraUniforms.data();
+	memcpy(uniforms.cameraProj, &pm.x[0][0], sizeof(uniforms.cameraProj));
+	memcpy(uniforms.cameraInverseProj, &invProj.x[0][0], sizeof(uniforms.cameraInverseProj));
+	memcpy(uniforms.cameraInverseModelView, &invModelView.x[0][0], sizeof(uniforms.cameraInverseModelView));
+	uniforms.cameraFilmSize[0] = m_camera.parameters().filmSize().x;
+	uniforms.cameraFilmSize[1] = m_camera.parameters().filmSize().y;
+	uniforms.cameraNear = m_camera.parameters().nearDistance();
+	uniforms.cameraFar = m_camera.parameters().farDistance();
+	// TODO the focal length can be extracted from the perspective matrix (FOV)
+	// so we should choose either method, but not both.
+	uniforms.cameraFocalLength = m_camera.parameters().focalLength();
+	uniforms.cameraLensRadius = m_camera.parameters().lensRadius();
+	uniforms.cameraLensModel = (int)m_camera.parameters().lensModel();
+
+	// this runs every frame, but only does anything when the camera moved
+	if (!m_cameraUniforms.update()) return;
+
 	// Inform services 
 	for( int i = 0; i < SERVICE_TOTAL; ++i)
 	{
-		if (m_services[i] == NULL) continue;
+		if (m_services[i] == NULL || !m_serviceLoaded[i]) continue;
 		m_services[i]->cameraUpdated(mvm, 
 									 invModelView, 
 									 pm, 
 									 invProj,
 									 m_camera);
 	}
-
-	// integrator shaders
-	
-	for( int i = 0; i < INTEGRATOR_TOTAL; ++i )
-	{
-		const IntegratorShaderSettings& integratorSettings = m_settingsIntegrator[i];
-		glUseProgram(integratorSettings.m_program);
-
-		glUniform1f(integratorSettings.m_uniformCameraNear, m_camera.parameters().nearDistance());
-		glUniform1f(integratorSettings.m_uniformCameraFar, m_camera.parameters().farDistance());
-
-		glUniformMatrix4fv(integratorSettings.m_uniformCameraInverseModelView,
-						   1,
-						   GL_TRUE,
-						   &invModelView.x[0][0]);
-
-		glUniformMatrix4fv(integratorSettings.m_uniformCameraProj,
-						   1,
-						   GL_TRUE,
-						   &pm.x[0][0]);
-
-		glUniformMatrix4fv(integratorSettings.m_uniformCameraInverseProj,
-						   1,
-						   GL_TRUE,
-						   &invProj.x[0][0]);
-
-		// TODO the focal length can be extracted from the perspective matrix (FOV)
-		// so we should choose either method, but not both.
-		glUseProgram(integratorSettings.m_program);
-		glUniform1f(integratorSettings.m_uniformCameraFocalLength  , m_camera.parameters().focalLength());
-		glUniform1f(integratorSettings.m_uniformCameraLensRadius   , m_camera.parameters().lensRadius());
-		glUniform1i(integratorSettings.m_uniformCameraLensModel	, (int)m_camera.parameters().lensModel());
-		glUniform2f(integratorSettings.m_uniformCameraFilmSize	 , m_camera.parameters().filmSize().x, 
-																	   m_camera.parameters().filmSize().y);
-		
-	}
-	glUseProgram(0);
 }
 
 void Renderer::resizeFrame(int frameBufferWidth, 
@@ -450,46 +662,46 @@ void Renderer::resizeFrame(int frameBufferWidth,
 						   int viewportX, int viewportY,
 						   int viewportW, int viewportH)
 {
-	m_numberSamples = 0;
-
-	m_renderSettings.m_imageResolution.x = frameBufferWidth;
-	m_renderSettings.m_imageResolution.y = frameBufferHeight;
-
 	m_renderSettings.m_viewport[0] = viewportX;
 	m_renderSettings.m_viewport[1] = viewportY;
 	m_renderSettings.m_viewport[2] = viewportW;
 	m_renderSettings.m_viewport[3] = viewportH;
 
-	for( int i = 0; i < INTEGRATOR_TOTAL; ++i )
-	{
-		const IntegratorShaderSettings& integratorSettings = m_settingsIntegrator[i];
-
-		glUseProgram(integratorSettings.m_program);
-		glUniform4f(integratorSettings.m_uniformViewport, 
-					0, 
-					0, 
-					m_renderSettings.m_imageResolution.x, 
-					m_renderSettings.m_imageResolution.y);
-	}
-
-	glUseProgram(m_settingsAverage.m_program);
-	glUniform4f(m_settingsAverage.m_uniformViewport,
-				0, 
-				0, 
-				m_renderSettings.m_imageResolution.x, 
-				m_renderSettings.m_imageResolution.y);
-
 	glUseProgram(m_settingsTextured.m_program);
 	glUniform4f(m_settingsTextured.m_uniformViewport,
 				(float)m_renderSettings.m_viewport[0],
 				(float)m_renderSettings.m_viewport[1],
 				(float)m_renderSettings.m_viewport[2],
 				(float)m_renderSettings.m_viewport[3]);
-
 	glUseProgram(0);
-	
-	const float viewportAspectRatio = (float)m_renderSettings.m_imageResolution.x / m_renderSettings.m_imageResolution.y;
 
+	if (m_tiledImage != NULL)
+	{
+		// the render buffers hold a region of the tiled image until it's
+		// finished
+		m_tiledImage->frameResolution = Imath::V2i(frameBufferWidth, frameBufferHeight);
+	}
+	else
+	{
+		resizeRenderBuffers(frameBufferWidth, frameBufferHeight);
+	}
+
+	// Inform services 
+	for( int i = 0; i < SERVICE_TOTAL; ++i)
+	{
+		if (m_services[i] == NULL || !m_serviceLoaded[i]) continue;
+		m_services[i]->frameResized(m_renderSettings.m_viewport);
+	}
+}
+
+Imath::V2i Renderer::imageResolution() const
+{
+	return m_tiledImage != NULL ? m_tiledImage->resolution : m_renderSettings.m_imageResolution;
+}
+
+void Renderer::updateFilmSize()
+{
+	const float viewportAspectRatio = (float)imageResolution().x / imageResolution().y;
 	if (viewportAspectRatio >= 1.0f) 
 	{
 		m_camera.setFilmSize(CameraParameters::FILM_SIZE_35MM, CameraParameters::FILM_SIZE_35MM / viewportAspectRatio);
@@ -498,39 +710,67 @@ void Renderer::resizeFrame(int frameBufferWidth,
 	{
 		m_camera.setFilmSize(CameraParameters::FILM_SIZE_35MM * viewportAspectRatio, CameraParameters::FILM_SIZE_35MM);
 	}
-	updateCamera();
+}
+
+void Renderer::setIntegratorViewport(const IntegratorShaderSettings& settings, const Imath::V2i& resolution) const
+{
+	if (m_tiledImage != NULL && m_tiledImage->regionStarted)
+	{
+		// the frame is a region of the image: offset the viewport so its
+		// pixels cast the rays of the image pixels they stand for.
+		const Imath::Box2i& region = m_tiledImage->regions[m_tiledImage->currentRegion];
+		glUniform4f(settings.m_uniformViewport, 
+					-(float)region.min.x, 
+					-(float)region.min.y, 
+					(float)m_tiledImage->resolution.x, 
+					(float)m_tiledImage->resolution.y);
+		return;
+	}
+	glUniform4f(settings.m_uniformViewport, 0, 0, (float)resolution.x, (float)resolution.y);
+}
 
+void Renderer::resizeRenderBuffers(int width, int height)
+{
+	m_numberSamples = 0;
 
-	// create texture
-	for( int i = 0; i < 3; ++i )
+	m_renderSettings.m_imageResolution.x = width;
+	m_renderSettings.m_imageResolution.y = height;
+
+	const std::vector<IntegratorShaderSettings*> programs = integratorPrograms();
+	for( size_t i = 0; i < programs.size(); ++i )
+	{
+		const IntegratorShaderSettings& integratorSettings = *programs[i];
+
+		glUseProgram(integratorSettings.m_program);
+		setIntegratorViewport(integratorSettings, m_renderSettings.m_imageResolution);
+	}
+	glUseProgram(0);
+	
+	updateFilmSize();
+	updateCamera();
+
+	// resize accumulation textures
+	for( int i = 0; i < 2; ++i )
 	{
-		switch(i)
+		if ( i == 0 )
 		{
-			case 0: 
-				glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_SAMPLE);
-				glBindTexture(GL_TEXTURE_2D, m_glResources.m_sampleTexture);
-				break;
-			case 1: 
-				glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_AVERAGE0);
-				glBindTexture(GL_TEXTURE_2D, m_glResources.m_averageTexture[0]);
-				break;
-			case 2: 
-				glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_AVERAGE1);
-				glBindTexture(GL_TEXTURE_2D, m_glResources.m_averageTexture[1]);
-				break;
-			default: break;
+			glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_ACCUMULATION);
+			glBindTexture(GL_TEXTURE_2D, m_glResources.m_accumulationTexture);
+		}
+		else
+		{
+			glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_PREVIEW_ACCUMULATION);
+			glBindTexture(GL_TEXTURE_2D, m_glResources.m_previewAccumulationTexture);
 		}
-
 		glTexImage2D(GL_TEXTURE_2D,
 					 0,
-					 GL_RGBA,
+					 GL_RGBA32F,
 					 m_renderSettings.m_imageResolution.x,
 					 m_renderSettings.m_imageResolution.y,
 					 0,
 					 GL_RGBA,
 					 GL_FLOAT,
 					 NULL);
-
 	}
 
 	// these should match the viewport resolution, but maybe some older hardware
@@ -538,125 +778,688 @@ void Renderer::resizeFrame(int frameBufferWidth,
 	// values to match the viewport when rendering to texture.
 	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &m_glResources.m_textureDimensions[0]);
 	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &m_glResources.m_textureDimensions[1]);
+
+	// resize adaptive sampling textures
+	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_MOMENTS);
+	glBindTexture(GL_TEXTURE_2D, m_glResources.m_momentsTexture);
+	glTexImage2D(GL_TEXTURE_2D,
+				 0,
+				 GL_R32F,
+				 m_renderSettings.m_imageResolution.x,
+				 m_renderSettings.m_imageResolution.y,
+				 0,
+				 GL_RED,
+				 GL_FLOAT,
+				 NULL);
+
+	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_CONVERGENCE_MASK);
+	glBindTexture(GL_TEXTURE_2D, m_glResources.m_convergenceMaskTexture);
+	glTexImage2D(GL_TEXTURE_2D,
+				 0,
+				 GL_R8UI,
+				 (m_glResources.m_textureDimensions[0] + GLResourceConfiguration::m_convergenceTileSize - 1) / GLResourceConfiguration::m_convergenceTileSize,
+				 (m_glResources.m_textureDimensions[1] + GLResourceConfiguration::m_convergenceTileSize - 1) / GLResourceConfiguration::m_convergenceTileSize,
+				 0,
+				 GL_RED_INTEGER,
+				 GL_UNSIGNED_BYTE,
+				 NULL);
 	
 	glBindRenderbuffer(GL_RENDERBUFFER, m_glResources.m_mainRBO);
 	glRenderbufferStorage(GL_RENDERBUFFER, 
 						  GL_DEPTH_COMPONENT,
 						  m_renderSettings.m_imageResolution.x,
 						  m_renderSettings.m_imageResolution.y);
-
-	// Inform services 
-	for( int i = 0; i < SERVICE_TOTAL; ++i)
-	{
-		if (m_services[i] == NULL) continue;
-		m_services[i]->frameResized(m_renderSettings.m_viewport);
-	}
 }
 
 Renderer::RenderResult Renderer::render()
 {
 	if (!m_initialized) return RR_FINISHED_RENDERING;
 
+	if (updateBackgroundImage())
+	{
+		// the new background image finished loading, and the checkpoint
+		// being resumed may have been waiting for it
+		updateRenderSettings();
+		if (m_pendingResume != NULL) restoreCheckpoint();
+	}
+	updatePendingReadbacks();
+	if (m_tiledImage != NULL) updateTiledImage();
+
 	m_frameTimer.sampleBegin();
 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
 	glDisable(GL_DEPTH_TEST);
 
-	processPendingActions();
-
-	const float viewportAspectRatio = (float)m_renderSettings.m_imageResolution.x / m_renderSettings.m_imageResolution.y;
-	if (viewportAspectRatio >= 1.0f) 
+	if (processPendingActions())
 	{
-		m_camera.setFilmSize(CameraParameters::FILM_SIZE_35MM, CameraParameters::FILM_SIZE_35MM / viewportAspectRatio);
+		// the volume was edited, so its checkpoints no longer apply. The
+		// edited voxels are hashed once they're needed (see hashEditedVoxels).
+		m_sceneVoxelsEdited = true;
+
+		// the coarse levels of the voxel mip chain no longer match the edited
+		// volume. Stick to the finest level until the edits are over.
+		if (!m_voxelMipmapsDirty)
+		{
+			m_voxelMipmapsDirty = true;
+			updateVoxelLod();
+		}
 	}
-	else 
+	// rebuilding takes a pass over the whole volume, so it waits for the end
+	// of the edit stroke rather than running between its mouse events.
+	if (m_voxelMipmapsDirty && !m_voxelEditInProgress)
 	{
-		m_camera.setFilmSize(CameraParameters::FILM_SIZE_35MM * viewportAspectRatio, CameraParameters::FILM_SIZE_35MM);
+		rebuildVoxelMipmaps();
 	}
+
+	updateFilmSize();
 	updateCamera();
+	// the integrator may still be building, in which case the frame shows what
+	// was rendered so far
+	const bool integratorReady = isIntegratorReady(m_currentIntegrator, false);
 	
-	// render frame into m_glResources.m_sampleTexture
+	// render the next batch of samples and add them onto
+	// m_glResources.m_accumulationTexture (or the preview one, while the user
+	// is interacting)
 
 	glBindFramebuffer(GL_FRAMEBUFFER, m_glResources.m_mainFBO);
 
+	if (m_numberSamples == 0)
+	{
+		// the render was reset, which usually means the user is interacting.
+		// Render at a reduced resolution if the full one is too slow.
+		m_framesSinceReset = 0;
+		m_previewNumberSamples = 0;
+		m_nextTile = 0;
+		m_convergenceMaskValid = false;
+		discardConvergenceReadback();
+		m_unconvergedTiles = -1;
+		m_lastCheckpointTime = time(NULL);
+		m_checkpointNumberSamples = 0;
+		m_checkpointWritten = "";
+
+		const float scale = chooseResolutionScale();
+		m_renderingPreview = scale < 1.0f;
+		m_previewResolution.x = std::max(1, (int)(m_glResources.m_textureDimensions[0] * scale));
+		m_previewResolution.y = std::max(1, (int)(m_glResources.m_textureDimensions[1] * scale));
+
+		const GLuint textures[3] = { m_glResources.m_accumulationTexture, 
+									 m_glResources.m_previewAccumulationTexture,
+									 m_glResources.m_momentsTexture };
+		const GLfloat zero[4] = {0, 0, 0, 0};
+		glDrawBuffer(GL_COLOR_ATTACHMENT0);
+		for( int i = 0; i < 3; ++i )
+		{
+			glFramebufferTexture2D(GL_FRAMEBUFFER,
+								   GL_COLOR_ATTACHMENT0,
+								   GL_TEXTURE_2D,
+								   textures[i],
+								   0);
+			glClearBufferfv(GL_COLOR, 0, zero);
+		}
+	}
+	else if (m_renderingPreview && !isInteractive() && integratorReady)
+	{
+		// the interaction is over, start refining the image at full resolution.
+		// The preview samples stay on screen until there are enough of these.
+		// While the integrator is still building there wouldn't be any, so
+		// the preview is kept until it's done.
+		m_renderingPreview = false;
+		m_previewNumberSamples = m_numberSamples;
+		m_numberSamples = 0;
+		m_nextTile = 0;
+	}
+
 	glFramebufferTexture2D(GL_FRAMEBUFFER,
 						   GL_COLOR_ATTACHMENT0,
 						   GL_TEXTURE_2D,
-						   m_glResources.m_sampleTexture, // where we'll write to
+						   m_renderingPreview ? m_glResources.m_previewAccumulationTexture :
+												m_glResources.m_accumulationTexture, // where we'll write to
 						   0);
 
-	const IntegratorShaderSettings& integratorSettings = m_settingsIntegrator[m_currentIntegrator];
-	glUseProgram(integratorSettings.m_program);
-	glUniform1i(integratorSettings.m_uniformSampleCount, std::min(m_numberSamples, m_renderSettings.m_pathtracerMaxSamples - 1));
-
-	glViewport(0,0,m_glResources.m_textureDimensions[0], m_glResources.m_textureDimensions[1]);
-	drawFullscreenQuad();
-
-	// m_glResources.m_sampleTexture and m_average[active] ---> m_average[active^1]
-
+	// the second moments are only tracked at full resolution, for adaptive
+	// sampling
 	glFramebufferTexture2D(GL_FRAMEBUFFER,
-						   GL_COLOR_ATTACHMENT0,
+						   GL_COLOR_ATTACHMENT1,
 						   GL_TEXTURE_2D,
-						   m_glResources.m_averageTexture[m_activeSampleTexture ^ 1], // where we'll write to
+						   m_glResources.m_momentsTexture,
 						   0);
+	if (isAdaptiveSamplingActive())
+	{
+		const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, drawBuffers);
+	}
+	else
+	{
+		glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	}
 
-	glUseProgram(m_settingsAverage.m_program);
-	glUniform1i(m_settingsAverage.m_uniformSampleTexture, GLResourceConfiguration::TEXTURE_UNIT_SAMPLE);
-	glUniform1i(m_settingsAverage.m_uniformAverageTexture, GLResourceConfiguration::TEXTURE_UNIT_AVERAGE0 + m_activeSampleTexture);
-	glUniform1i(m_settingsAverage.m_uniformSampleCount, m_numberSamples);
-	drawFullscreenQuad();
-	
-	// finally draw to screen
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glUseProgram(m_settingsTextured.m_program);
-	glUniform1i(m_settingsTextured.m_uniformTexture, GLResourceConfiguration::TEXTURE_UNIT_AVERAGE0 + (m_activeSampleTexture^1));
-	glViewport(m_renderSettings.m_viewport[0],
-			   m_renderSettings.m_viewport[1],
-			   m_renderSettings.m_viewport[2],
-			   m_renderSettings.m_viewport[3]);
-	drawFullscreenQuad();
-
-	m_frameTimer.sampleEnd();
+	updateConvergenceReadback();
+	const bool converged = isAdaptiveSamplingActive() && m_unconvergedTiles == 0;
+
+	const Imath::V2i renderResolution = m_renderingPreview ? 
+										m_previewResolution :
+										Imath::V2i(m_glResources.m_textureDimensions[0], m_glResources.m_textureDimensions[1]);
+	glViewport(0, 0, renderResolution.x, renderResolution.y);
+
+	const float pixelFraction = (float)(renderResolution.x * renderResolution.y) / 
+								(m_glResources.m_textureDimensions[0] * m_glResources.m_textureDimensions[1]);
+	// a pass over the image is rendered in tiles when it doesn't fit within
+	// a frame, and then it must be finished before the next one starts.
+	if (m_nextTile == 0) buildTiles(renderResolution);
+	const bool samplesPending = integratorReady &&
+								m_pendingResume == NULL &&
+								!converged &&
+								m_numberSamples < m_renderSettings.m_pathtracerMaxSamples;
+	const int frameTiles = integratorReady && (m_nextTile > 0 || samplesPending) ? scheduleFrameTiles(pixelFraction) : 0;
+	const int frameSamples = !samplesPending || frameTiles > 0 ? 0 :
+							 std::min(scheduleFrameSamples(pixelFraction),
+									  m_renderSettings.m_pathtracerMaxSamples - m_numberSamples);
+	bool passesCompleted = false;
+	if (frameTiles > 0)
 	{
-		const float averageFrameSeconds = m_frameTimer.averageSampleTime();
-		if ( averageFrameSeconds > 0.f)
+		// the pass counts as soon as it's started, see m_nextTile
+		if (m_nextTile == 0) m_numberSamples++;
+
+		m_sampleTimer.sampleBegin();
+		size_t tilePixels = 0;
+		for( int i = 0; i < frameTiles; ++i, ++m_nextTile )
 		{
-			const float fps = 1.0f / averageFrameSeconds;
-			std::stringstream ss;
-			ss << "fps " << fps;
-			m_status = ss.str();
+			const Imath::Box2i& tile = m_tiles[m_nextTile];
+			renderSamples(renderResolution, tile, m_numberSamples - 1, 1);
+			tilePixels += (size_t)(tile.max.x - tile.min.x + 1) * (tile.max.y - tile.min.y + 1);
+		}
+		m_sampleTimer.sampleEnd((float)tilePixels / 
+								((float)m_glResources.m_textureDimensions[0] * m_glResources.m_textureDimensions[1]));
+
+		if (m_nextTile == m_tiles.size())
+		{
+			m_nextTile = 0;
+			passesCompleted = true;
+		}
+	}
+	else if (frameSamples > 0)
+	{
+		m_sampleTimer.sampleBegin();
+		renderSamples(renderResolution,
+					  Imath::Box2i(Imath::V2i(0, 0), renderResolution - Imath::V2i(1, 1)), 
+					  m_numberSamples, 
+					  frameSamples);
+		m_numberSamples += frameSamples;
+		m_sampleTimer.sampleEnd(frameSamples * pixelFraction);
+		passesCompleted = true;
+	}
+
+	if (passesCompleted &&
+		isAdaptiveSamplingActive() && 
+		m_numberSamples >= m_renderSettings.m_adaptiveSamplingMinSamples)
+	{
+		testConvergence();
+	}
+	m_framesSinceReset++;
+
+	// the region of the tiled image is done: write it out, and move on to
+	// the next one on the following frame
+	if (m_tiledImage != NULL &&
+		m_tiledImage->regionStarted &&
+		m_nextTile == 0 &&
+		(converged || m_numberSamples >= m_renderSettings.m_pathtracerMaxSamples))
+	{
+		saveTiledImageRegion();
+	}
+
+	// save the progress every so often, so the render can be resumed
+	if (m_renderSettings.m_checkpointIntervalSeconds > 0 &&
+		(m_currentIntegrator == INTEGRATOR_PATHTRACER ||
+		 m_currentIntegrator == INTEGRATOR_WAVEFRONT_PATHTRACER) &&
+		!m_renderingPreview &&
+		m_tiledImage == NULL && // a region of an image can't be resumed
+		!m_voxelEditInProgress && // the scene is still changing
+		m_nextTile == 0 && // only whole passes are saved
+		m_numberSamples > m_checkpointNumberSamples &&
+		difftime(time(NULL), m_lastCheckpointTime) >= m_renderSettings.m_checkpointIntervalSeconds)
+	{
+		writeCheckpoint();
+	}
+	// the render is finished, so there's nothing left to resume
+	if (!m_checkpointWritten.empty() &&
+		m_nextTile == 0 &&
+		(converged || m_numberSamples >= m_renderSettings.m_pathtracerMaxSamples))
+	{
+		removeCheckpoint();
+	}
+
+	// finally draw to screen
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glUseProgram(m_settingsTextured.m_program);
+	glUniform1i(m_settingsTextured.m_uniformTexture, GLResourceConfiguration::TEXTURE_UNIT_ACCUMULATION);
+	glUniform1i(m_settingsTextured.m_uniformPreviewTexture, GLResourceConfiguration::TEXTURE_UNIT_PREVIEW_ACCUMULATION);
+	glUniform2f(m_settingsTextured.m_uniformPreviewScale,
+				(float)m_previewResolution.x / m_glResources.m_textureDimensions[0],
+				(float)m_previewResolution.y / m_glResources.m_textureDimensions[1]);
+	{
+		// blend the preview in with a weight fading out as the full
+		// resolution samples build up.
+		float previewWeight = 1.0f;
+		if (!m_renderingPreview)
+		{
+			previewWeight = m_previewNumberSamples > 0 ? 
+							std::max(0.0f, 1.0f - (float)m_numberSamples / m_previewNumberSamples) :
+							0.0f;
+		}
+		glUniform1f(m_settingsTextured.m_uniformTextureWeight, m_renderingPreview ? 0.0f : 1.0f);
+		glUniform1f(m_settingsTextured.m_uniformPreviewWeight, previewWeight);
+	}
+	glUniform1f(m_settingsTextured.m_uniformTonemappingGamma, integratorSetup[m_currentIntegrator].displayGamma);
+	glViewport(m_renderSettings.m_viewport[0],
+			   m_renderSettings.m_viewport[1],
+			   m_renderSettings.m_viewport[2],
+			   m_renderSettings.m_viewport[3]);
+	drawFullscreenTriangle();
+
+	m_frameTimer.sampleEnd();
+	{
+		const float averageFrameSeconds = m_frameTimer.averageSampleTime();
+		if ( averageFrameSeconds > 0.f)
+		{
+			const float fps = 1.0f / averageFrameSeconds;
+			std::stringstream ss;
+			ss << "fps " << fps;
+			if (m_tiledImage != NULL)
+			{
+				ss << " - rendering tile " << std::min(m_tiledImage->currentRegion + 1, m_tiledImage->regions.size())
+				   << "/" << m_tiledImage->regions.size() << " of " << m_tiledImage->file;
+			}
+			if (m_integratorState[m_currentIntegrator] == PROGRAM_BUILDING)
+			{
+				ss << " - building " << integratorSetup[m_currentIntegrator].name << " shaders";
+			}
+			m_status = ss.str();
 		}
 	}
 
 	glUseProgram(0);
 	
-	// run continuously?
-	if ( m_numberSamples++ < m_renderSettings.m_pathtracerMaxSamples)
+	// run continuously? We also keep going while a background image is
+	// loading, a file is being saved or the integrator is being built, to
+	// follow up on them as soon as they're ready.
+	if ( (m_numberSamples < m_renderSettings.m_pathtracerMaxSamples && !converged) ||
+		 m_nextTile > 0 ||
+		 m_integratorState[m_currentIntegrator] == PROGRAM_BUILDING ||
+		 m_tiledImage != NULL ||
+		 m_environmentMapLoader.busy() ||
+		 !m_pendingReadbacks.empty() )
 	{
-		m_activeSampleTexture ^= 1;
 		return RR_SAMPLES_PENDING; 
 	}
 	return RR_FINISHED_RENDERING;
 }
 
-void Renderer::drawFullscreenQuad()
+bool Renderer::isInteractive() const
+{
+	const int interactiveFrames = 10;
+	return m_framesSinceReset < interactiveFrames;
+}
+
+float Renderer::chooseResolutionScale() const
+{
+	// a tiled image is only rendered at full resolution
+	if (m_tiledImage != NULL) return 1.0f;
+
+	const float minScale = std::max(0.01f, m_renderSettings.m_dynamicResolutionMinScale);
+	const float budgetMs = m_renderSettings.m_interactiveFrameBudgetMs;
+	const float secondsPerSample = m_sampleTimer.averageSampleTime();
+	if ( minScale >= 1.0f || budgetMs <= 0 || secondsPerSample <= 0 ) return 1.0f;
+
+	// the cost of a sample is roughly proportional to the number of pixels.
+	// Pick the resolution at which a sample per pixel fits within the budget.
+	const float scale = sqrtf(budgetMs * 0.001f / secondsPerSample);
+	return std::max(minScale, std::min(scale, 1.0f));
+}
+
+bool Renderer::isAdaptiveSamplingActive() const
+{
+	return m_renderSettings.m_adaptiveSamplingThreshold > 0 && !m_renderingPreview;
+}
+
+void Renderer::testConvergence()
+{
+	// one test at a time. Otherwise, with the GPU a few frames behind, each
+	// test would discard the last before it could be read back.
+	if (m_convergenceFence != 0) return;
+
+	const GLuint zero = 0;
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_glResources.m_unconvergedTilesCounter);
+	glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &zero);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+	glBindImageTexture(GLResourceConfiguration::m_convergenceMaskImageUnit, // image unit
+					   m_glResources.m_convergenceMaskTexture,             // texture
+					   0,                                                  // level
+					   GL_FALSE,                                           // layered
+					   0,                                                  // layer
+					   GL_WRITE_ONLY,                                      // access
+					   GL_R8UI                                             // format
+			);
+
+	glUseProgram(m_settingsConvergence.m_program);
+	glUniform2i(m_settingsConvergence.m_uniformImageResolution,
+				m_glResources.m_textureDimensions[0],
+				m_glResources.m_textureDimensions[1]);
+	glUniform1i(m_settingsConvergence.m_uniformMinSamples, m_renderSettings.m_adaptiveSamplingMinSamples);
+	glUniform1f(m_settingsConvergence.m_uniformErrorThreshold, m_renderSettings.m_adaptiveSamplingThreshold);
+
+	const int tileSize = GLResourceConfiguration::m_convergenceTileSize;
+	glDispatchCompute((m_glResources.m_textureDimensions[0] + tileSize - 1) / tileSize,
+					  (m_glResources.m_textureDimensions[1] + tileSize - 1) / tileSize,
+					  1);
+
+	// make the mask visible to the integrators' texture fetches, and the
+	// counter to the copy below.
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	// copy the counter into the readback buffer, which is read once the fence
+	// is signaled (see updateConvergenceReadback), so the CPU never waits on
+	// the GPU.
+	glBindBuffer(GL_COPY_READ_BUFFER, m_glResources.m_unconvergedTilesCounter);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_glResources.m_unconvergedTilesReadback);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(GLuint));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	m_convergenceFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	m_convergenceMaskValid = true;
+}
+
+void Renderer::updateConvergenceReadback()
+{
+	if (m_convergenceFence == 0) return;
+
+	const GLenum status = glClientWaitSync(m_convergenceFence, 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return;
+	discardConvergenceReadback();
+
+	GLuint unconvergedTiles = 0;
+	glBindBuffer(GL_COPY_READ_BUFFER, m_glResources.m_unconvergedTilesReadback);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GLuint), &unconvergedTiles);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	m_unconvergedTiles = (int)unconvergedTiles;
+}
+
+void Renderer::discardConvergenceReadback()
 {
-	// draw quad
-	glBegin(GL_QUADS);
-		glVertex3f(  1.0f,  1.0f, m_camera.parameters().nearDistance());
-		glVertex3f( -1.0f,  1.0f, m_camera.parameters().nearDistance());
-		glVertex3f( -1.0f, -1.0f, m_camera.parameters().nearDistance());
-		glVertex3f(  1.0f, -1.0f, m_camera.parameters().nearDistance());
-	glEnd();
+	if (m_convergenceFence == 0) return;
+	glDeleteSync(m_convergenceFence);
+	m_convergenceFence = 0;
+}
+
+float Renderer::frameBudgetMs() const
+{
+	return isInteractive() ? 
+		   m_renderSettings.m_interactiveFrameBudgetMs :
+		   m_renderSettings.m_idleFrameBudgetMs;
+}
+
+int Renderer::scheduleFrameSamples(float pixelFraction) const
+{
+	const float budgetMs = frameBudgetMs();
+
+	const int samplesPerPass = std::max(1, m_renderSettings.m_samplesPerPass);
+	const float secondsPerSample = m_sampleTimer.averageSampleTime() * pixelFraction;
+	if ( budgetMs <= 0 || secondsPerSample <= 0 ) return samplesPerPass;
+
+	// cap the number of samples to prevent a bad estimate (e.g. right after
+	// switching integrators) from stalling the UI.
+	const int maxFrameSamples = 1024;
+	const int samples = (int)(budgetMs * 0.001f / secondsPerSample);
+	return std::max(1, std::min(samples, maxFrameSamples));
+}
+
+int Renderer::scheduleFrameTiles(float pixelFraction) const
+{
+	const int remainingTiles = (int)(m_tiles.size() - m_nextTile);
+	if (m_nextTile == 0 && remainingTiles <= 1) return 0;
+
+	const float budgetMs = frameBudgetMs();
+	const float secondsPerSample = m_sampleTimer.averageSampleTime() * pixelFraction;
+	if (budgetMs <= 0) return m_nextTile > 0 ? remainingTiles : 0;
+	// without an estimate of the cost of a pass (e.g. right after switching
+	// integrators), start with a single tile rather than risk a whole pass.
+	if (secondsPerSample <= 0) return 1;
+
+	// tiles are only needed once a whole pass doesn't fit within the budget.
+	const float passes = budgetMs * 0.001f / secondsPerSample;
+	if (m_nextTile == 0 && passes >= 1.0f) return 0;
+
+	// the cost of a tile is roughly proportional to its share of the pixels
+	const int tiles = (int)(passes * m_tiles.size());
+	return std::max(1, std::min(tiles, remainingTiles));
+}
+
+// tiles closer to the center of the image go first
+struct TileCenterDistanceLess
+{
+	Imath::V2i center;
+	static int distance2(const Imath::Box2i& tile, const Imath::V2i& center)
+	{
+		const int dx = tile.min.x + tile.max.x - center.x;
+		const int dy = tile.min.y + tile.max.y - center.y;
+		return dx * dx + dy * dy;
+	}
+	bool operator()(const Imath::Box2i& a, const Imath::Box2i& b) const
+	{
+		return distance2(a, center) < distance2(b, center);
+	}
+};
+
+void Renderer::buildTiles(const Imath::V2i& resolution)
+{
+	m_tiles.clear();
+	const int tileSize = m_renderSettings.m_tileSize > 0 ? 
+						 m_renderSettings.m_tileSize : 
+						 std::max(resolution.x, resolution.y);
+
+	// top to bottom, left to right (the image origin is its bottom-left
+	// corner)
+	for( int y = resolution.y; y > 0; y -= tileSize )
+	{
+		for( int x = 0; x < resolution.x; x += tileSize )
+		{
+			m_tiles.push_back(Imath::Box2i(Imath::V2i(x, std::max(0, y - tileSize)),
+										   Imath::V2i(std::min(x + tileSize, resolution.x) - 1, y - 1)));
+		}
+	}
+
+	if (m_renderSettings.m_tileOrder == RenderSettings::TILE_ORDER_CENTER)
+	{
+		// distances are measured in twice the pixel coordinates, to stay on
+		// integers
+		TileCenterDistanceLess less;
+		less.center = Imath::V2i(resolution.x - 1, resolution.y - 1);
+		std::stable_sort(m_tiles.begin(), m_tiles.end(), less);
+	}
+}
+
+void Renderer::renderSamples(const Imath::V2i& resolution, const Imath::Box2i& region, int firstSample, int numSamples)
+{
+	if (m_currentIntegrator == INTEGRATOR_WAVEFRONT_PATHTRACER)
+	{
+		renderWavefront(resolution, region, firstSample, numSamples);
+		return;
+	}
+
+	const IntegratorShaderSettings& integratorSettings = m_settingsIntegrator[m_currentIntegrator];
+	glUseProgram(integratorSettings.m_program);
+	setIntegratorViewport(integratorSettings, resolution);
+	glUniform1i(integratorSettings.m_uniformAdaptiveSampling, isAdaptiveSamplingActive() && m_convergenceMaskValid ? 1 : 0);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	// the quad still covers the whole image, so the pixels map to the same
+	// rays; only those within the region are shaded.
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(region.min.x, region.min.y, 
+			  region.max.x - region.min.x + 1, 
+			  region.max.y - region.min.y + 1);
+
+	// split the samples in passes, so a single draw call doesn't run for too
+	// long.
+	const int samplesPerPass = std::max(1, m_renderSettings.m_samplesPerPass);
+	for( int sample = 0; sample < numSamples; sample += samplesPerPass )
+	{
+		const int passSamples = std::min(samplesPerPass, numSamples - sample);
+		glUniform1i(integratorSettings.m_uniformSampleCount, firstSample + sample);
+		glUniform1i(integratorSettings.m_uniformSamplesPerPass, passSamples);
+		drawFullscreenTriangle();
+	}
+
+	glDisable(GL_SCISSOR_TEST);
+	glDisable(GL_BLEND);
+}
+
+void Renderer::renderWavefront(const Imath::V2i& resolution, const Imath::Box2i& region, int firstSample, int numSamples)
+{
+	const Imath::V2i regionSize(region.max.x - region.min.x + 1, region.max.y - region.min.y + 1);
+	// waves are made of whole rows of the region
+	const int waveRows = std::max(1, std::min(regionSize.y, GLResourceConfiguration::m_wavefrontMaxPaths / regionSize.x));
+	const int capacity = regionSize.x * waveRows;
+	if (capacity > m_glResources.m_wavefrontCapacity)
+	{
+		createWavefrontBuffers(capacity);
+	}
+
+	const IntegratorShaderSettings* stages = m_settingsWavefront.m_stages;
+	for( int i = 0; i < WavefrontShaderSettings::STAGE_TOTAL; ++i )
+	{
+		glUseProgram(stages[i].m_program);
+		setIntegratorViewport(stages[i], resolution);
+	}
+	glUseProgram(stages[WavefrontShaderSettings::STAGE_GENERATE].m_program);
+	glUniform1i(stages[WavefrontShaderSettings::STAGE_GENERATE].m_uniformAdaptiveSampling, 
+				isAdaptiveSamplingActive() && m_convergenceMaskValid ? 1 : 0);
+	glUseProgram(stages[WavefrontShaderSettings::STAGE_ACCUMULATE].m_program);
+	// the second moments are only tracked at full resolution, as in the
+	// fullscreen passes
+	glUniform1i(m_settingsWavefront.m_uniformAccumulateMoments, isAdaptiveSamplingActive() ? 1 : 0);
+
+	glBindImageTexture(GLResourceConfiguration::m_wavefrontAccumulationImageUnit,
+					   m_renderingPreview ? m_glResources.m_previewAccumulationTexture :
+											m_glResources.m_accumulationTexture,
+					   0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+	glBindImageTexture(GLResourceConfiguration::m_wavefrontMomentsImageUnit,
+					   m_glResources.m_momentsTexture,
+					   0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, m_glResources.m_wavefrontQueueCountersSSBO);
+
+	// each stage reads the paths and queues written by the previous one, and
+	// the stages consuming a queue are dispatched with the number of work
+	// groups written by dispatchWavefrontQueues.
+	const GLbitfield stageBarrier = GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT;
+	const int maxBounces = std::max(0, m_renderSettings.m_pathtracerMaxNumBounces);
+
+	for( int sample = 0; sample < numSamples; ++sample )
+	{
+		for( int waveY = region.min.y; waveY <= region.max.y; waveY += waveRows )
+		{
+			const Imath::V2i waveOrigin(region.min.x, waveY);
+			const Imath::V2i waveSize(regionSize.x, std::min(waveRows, region.max.y + 1 - waveY));
+			const int numPaths = waveSize.x * waveSize.y;
+			const GLuint numGroups = (numPaths + WAVEFRONT_GROUP_SIZE - 1) / WAVEFRONT_GROUP_SIZE;
+
+			// start with all the queues empty
+			WavefrontQueueCounters counters;
+			memset(&counters, 0, sizeof(WavefrontQueueCounters));
+			counters.capacity = m_glResources.m_wavefrontCapacity;
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_glResources.m_wavefrontQueueCountersSSBO);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(WavefrontQueueCounters), &counters);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+			glUseProgram(stages[WavefrontShaderSettings::STAGE_GENERATE].m_program);
+			glUniform1i(stages[WavefrontShaderSettings::STAGE_GENERATE].m_uniformSampleCount, firstSample + sample);
+			glUniform2i(m_settingsWavefront.m_uniformGenerateWaveOrigin, waveOrigin.x, waveOrigin.y);
+			glUniform2i(m_settingsWavefront.m_uniformGenerateWaveSize, waveSize.x, waveSize.y);
+			glDispatchCompute(numGroups, 1, 1);
+			glMemoryBarrier(stageBarrier);
+			dispatchWavefrontQueues(WAVEFRONT_QUEUES_EXTEND);
+
+			// paths are extended once per bounce, and once more to find out
+			// whether the last bounce ray leaves the scene
+			for( int bounce = 0; ; ++bounce )
+			{
+				glUseProgram(stages[WavefrontShaderSettings::STAGE_EXTEND].m_program);
+				glDispatchComputeIndirect(offsetof(WavefrontQueueCounters, extendDispatch));
+				glMemoryBarrier(stageBarrier);
+				if (bounce == maxBounces) break;
+
+				dispatchWavefrontQueues(WAVEFRONT_QUEUES_SHADE);
+				for( int material = 0; material < WAVEFRONT_NUM_MATERIALS; ++material )
+				{
+					glUseProgram(stages[WavefrontShaderSettings::STAGE_SHADE_MATTE + material].m_program);
+					glDispatchComputeIndirect(offsetof(WavefrontQueueCounters, shadeDispatch) + 
+											  material * sizeof(counters.shadeDispatch[0]));
+				}
+				glMemoryBarrier(stageBarrier);
+				dispatchWavefrontQueues(WAVEFRONT_QUEUES_EXTEND);
+
+				glUseProgram(stages[WavefrontShaderSettings::STAGE_CONNECT].m_program);
+				glDispatchComputeIndirect(offsetof(WavefrontQueueCounters, connectDispatch));
+				glMemoryBarrier(stageBarrier);
+			}
+
+			glUseProgram(stages[WavefrontShaderSettings::STAGE_ACCUMULATE].m_program);
+			glUniform2i(m_settingsWavefront.m_uniformAccumulateWaveOrigin, waveOrigin.x, waveOrigin.y);
+			glUniform2i(m_settingsWavefront.m_uniformAccumulateWaveSize, waveSize.x, waveSize.y);
+			glDispatchCompute(numGroups, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		}
+	}
+
+	// the accumulated samples are displayed and read back through the texture,
+	// and the fullscreen passes blend onto it.
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+	glUseProgram(0);
+}
+
+void Renderer::dispatchWavefrontQueues(int queues)
+{
+	glUseProgram(m_settingsWavefront.m_stages[WavefrontShaderSettings::STAGE_DISPATCH].m_program);
+	glUniform1i(m_settingsWavefront.m_uniformDispatchQueues, queues);
+	glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+void Renderer::createWavefrontBuffers(int capacity)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_glResources.m_wavefrontPathsSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(WavefrontPathState), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_glResources.m_wavefrontQueuesSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * WAVEFRONT_QUEUES_PER_PATH * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_glResources.m_wavefrontQueueCountersSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(WavefrontQueueCounters), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GLResourceConfiguration::m_wavefrontPathsSSBOBindingPointIndex, m_glResources.m_wavefrontPathsSSBO);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GLResourceConfiguration::m_wavefrontQueuesSSBOBindingPointIndex, m_glResources.m_wavefrontQueuesSSBO);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GLResourceConfiguration::m_wavefrontQueueCountersSSBOBindingPointIndex, m_glResources.m_wavefrontQueueCountersSSBO);
+
+	m_glResources.m_wavefrontCapacity = capacity;
+}
+
+void Renderer::drawFullscreenTriangle()
+{
+	// the vertices are made up by shared/screenSpace.vs, so the vertex array
+	// has no attributes
+	glBindVertexArray(m_glResources.m_fullscreenVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
 }
 
 bool Renderer::onMouseMove(int dx, int dy, int buttons)
 {
+	// the camera stays put while a tiled image renders
+	if (m_tiledImage != NULL) return false;
+
 	const float ndx = (float)dx / this->m_renderSettings.m_imageResolution.x;
 	const float ndy = (float)dy / this->m_renderSettings.m_imageResolution.y;
 	if ( m_camera.controller().onMouseMove(ndx, ndy, buttons) )
@@ -669,6 +1472,8 @@ bool Renderer::onMouseMove(int dx, int dy, int buttons)
 }
 bool Renderer::onKeyPress(int key)
 {
+	if (m_tiledImage != NULL) return false;
+
 	if (m_camera.controller().onKeyPress(key))
 	{
 		updateCamera();
@@ -677,8 +1482,23 @@ bool Renderer::onKeyPress(int key)
 	}
 	if (key == Qt::Key_Space)
 	{
-		m_currentIntegrator = (Integrator)(!(int)m_currentIntegrator);
+		m_currentIntegrator = m_currentIntegrator == INTEGRATOR_EDIT_MODE ? 
+							  INTEGRATOR_PATHTRACER : 
+							  INTEGRATOR_EDIT_MODE;
 		m_numberSamples = 0;
+		// the cost per sample is very different between integrators
+		m_sampleTimer.reset();
+		return true;
+	}
+	else if (key == Qt::Key_P)
+	{
+		// switch between the two implementations of the path tracer, which
+		// should converge to the same image.
+		m_currentIntegrator = m_currentIntegrator == INTEGRATOR_WAVEFRONT_PATHTRACER ? 
+							  INTEGRATOR_PATHTRACER : 
+							  INTEGRATOR_WAVEFRONT_PATHTRACER;
+		m_numberSamples = 0;
+		m_sampleTimer.reset();
 		return true;
 	}
 	else if (key == Qt::Key_F)
@@ -693,14 +1513,23 @@ bool Renderer::onKeyPress(int key)
 
 void Renderer::createFramebuffer()
 {
-	if (glIsTexture(m_glResources.m_sampleTexture)) glDeleteTextures(1, &m_glResources.m_sampleTexture);
-	glGenTextures(1, &m_glResources.m_sampleTexture);
+	if (glIsTexture(m_glResources.m_accumulationTexture)) glDeleteTextures(1, &m_glResources.m_accumulationTexture);
+	glGenTextures(1, &m_glResources.m_accumulationTexture);
+
+	if (glIsTexture(m_glResources.m_previewAccumulationTexture)) glDeleteTextures(1, &m_glResources.m_previewAccumulationTexture);
+	glGenTextures(1, &m_glResources.m_previewAccumulationTexture);
 
-	if (glIsTexture(m_glResources.m_noiseTexture)) glDeleteTextures(1, &m_glResources.m_noiseTexture);
-	glGenTextures(1, &m_glResources.m_noiseTexture);
+	if (glIsTexture(m_glResources.m_momentsTexture)) glDeleteTextures(1, &m_glResources.m_momentsTexture);
+	glGenTextures(1, &m_glResources.m_momentsTexture);
+
+	if (glIsTexture(m_glResources.m_convergenceMaskTexture)) glDeleteTextures(1, &m_glResources.m_convergenceMaskTexture);
+	glGenTextures(1, &m_glResources.m_convergenceMaskTexture);
+
+	if (glIsBuffer(m_glResources.m_unconvergedTilesCounter)) glDeleteBuffers(1, &m_glResources.m_unconvergedTilesCounter);
+	glGenBuffers(1, &m_glResources.m_unconvergedTilesCounter);
+	if (glIsBuffer(m_glResources.m_unconvergedTilesReadback)) glDeleteBuffers(1, &m_glResources.m_unconvergedTilesReadback);
+	glGenBuffers(1, &m_glResources.m_unconvergedTilesReadback);
 
-	if (glIsTexture(m_glResources.m_averageTexture[0])) glDeleteTextures(2, m_glResources.m_averageTexture);
-	glGenTextures(2, m_glResources.m_averageTexture);
 
 	if (glIsBuffer(m_glResources.m_focalDistanceSSBO)) glDeleteBuffers(1, &m_glResources.m_focalDistanceSSBO);
 	glGenBuffers(1, &m_glResources.m_focalDistanceSSBO);
@@ -708,6 +1537,15 @@ void Renderer::createFramebuffer()
 	if (glIsBuffer(m_glResources.m_selectedVoxelSSBO)) glDeleteBuffers(1, &m_glResources.m_selectedVoxelSSBO);
 	glGenBuffers(1, &m_glResources.m_selectedVoxelSSBO);
 
+	// the wavefront path tracer buffers are allocated on first use
+	if (glIsBuffer(m_glResources.m_wavefrontPathsSSBO)) glDeleteBuffers(1, &m_glResources.m_wavefrontPathsSSBO);
+	glGenBuffers(1, &m_glResources.m_wavefrontPathsSSBO);
+	if (glIsBuffer(m_glResources.m_wavefrontQueuesSSBO)) glDeleteBuffers(1, &m_glResources.m_wavefrontQueuesSSBO);
+	glGenBuffers(1, &m_glResources.m_wavefrontQueuesSSBO);
+	if (glIsBuffer(m_glResources.m_wavefrontQueueCountersSSBO)) glDeleteBuffers(1, &m_glResources.m_wavefrontQueueCountersSSBO);
+	glGenBuffers(1, &m_glResources.m_wavefrontQueueCountersSSBO);
+	m_glResources.m_wavefrontCapacity = 0;
+
 	// create focal distance shader storage buffer object 
 	{
 		FocalDistanceData data;
@@ -736,62 +1574,75 @@ void Renderer::createFramebuffer()
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 	}
 	
-	// create noise texture
+	// create accumulation textures
+	for( int i = 0; i < 2; ++i )
 	{
-		const unsigned int noiseTextureSize = 2048;
-		float* noise = (float*)malloc(noiseTextureSize * noiseTextureSize * 4 * sizeof(float));
-		for( unsigned int i = 0; i < 4 * noiseTextureSize * noiseTextureSize; ++i ) noise[i] = (float)rand()/RAND_MAX;
-		glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_NOISE);
-		glBindTexture(GL_TEXTURE_2D, m_glResources.m_noiseTexture);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		if ( i == 0 )
+		{
+			glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_ACCUMULATION);
+			glBindTexture(GL_TEXTURE_2D, m_glResources.m_accumulationTexture);
+		}
+		else
+		{
+			glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_PREVIEW_ACCUMULATION);
+			glBindTexture(GL_TEXTURE_2D, m_glResources.m_previewAccumulationTexture);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glTexImage2D(GL_TEXTURE_2D,
 					 0,
 					 GL_RGBA32F,
-					 1024, 
-					 1024,
+					 m_renderSettings.m_imageResolution.x,
+					 m_renderSettings.m_imageResolution.y,
 					 0,
 					 GL_RGBA,
 					 GL_FLOAT,
-					 noise);
-		free(noise);
+					 NULL);
 	}
 
-	// create sample texture
-	for( int i = 0; i < 3; ++i )
+	// create adaptive sampling resources
 	{
-		switch(i)
-		{
-			case 0: 
-				glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_SAMPLE);
-				glBindTexture(GL_TEXTURE_2D, m_glResources.m_sampleTexture);
-				break;
-			case 1: 
-				glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_AVERAGE0);
-				glBindTexture(GL_TEXTURE_2D, m_glResources.m_averageTexture[0]);
-				break;
-			case 2: 
-				glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_AVERAGE1);
-				glBindTexture(GL_TEXTURE_2D, m_glResources.m_averageTexture[1]);
-				break;
-			default: break;
-		}
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+		glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_MOMENTS);
+		glBindTexture(GL_TEXTURE_2D, m_glResources.m_momentsTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		glTexImage2D(GL_TEXTURE_2D,
 					 0,
-					 GL_RGBA32F,
+					 GL_R32F,
 					 m_renderSettings.m_imageResolution.x,
 					 m_renderSettings.m_imageResolution.y,
 					 0,
-					 GL_RGBA,
+					 GL_RED,
 					 GL_FLOAT,
 					 NULL);
+
+		glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_CONVERGENCE_MASK);
+		glBindTexture(GL_TEXTURE_2D, m_glResources.m_convergenceMaskTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D,
+					 0,
+					 GL_R8UI,
+					 (m_renderSettings.m_imageResolution.x + GLResourceConfiguration::m_convergenceTileSize - 1) / GLResourceConfiguration::m_convergenceTileSize,
+					 (m_renderSettings.m_imageResolution.y + GLResourceConfiguration::m_convergenceTileSize - 1) / GLResourceConfiguration::m_convergenceTileSize,
+					 0,
+					 GL_RED_INTEGER,
+					 GL_UNSIGNED_BYTE,
+					 NULL);
+
+		const GLuint zero = 0;
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_glResources.m_unconvergedTilesCounter);
+		glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+		glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 
+						 GLResourceConfiguration::m_unconvergedTilesCounterBindingPointIndex, 
+						 m_glResources.m_unconvergedTilesCounter);
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_glResources.m_unconvergedTilesReadback);
+		glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), &zero, GL_STREAM_READ);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 	}
 
 	// generate main fbo/rbo
@@ -824,17 +1675,38 @@ void Renderer::createFramebuffer()
 	// Inform services 
 	for( int i = 0; i < SERVICE_TOTAL; ++i)
 	{
-		if (m_services[i] == NULL) continue;
+		if (m_services[i] == NULL || !m_serviceLoaded[i]) continue;
 		m_services[i]->glResourcesCreated(m_glResources);
 	}
 
 }
 
+// Rec709 luminance, matching shared/color.h
+inline float luminance(const float rgb[3])
+{
+	return 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2];
+}
+
+// Identifies a volume by its resolution and contents. voxelMaterials may be
+// NULL if the voxels are generated on the GPU.
+static boost::uint64_t hashVoxels(const Imath::V3i& resolution, const GLint* voxelMaterials)
+{
+	boost::uint64_t hash = HASH_SEED;
+	hash = hashCombine(hash, resolution.x);
+	hash = hashCombine(hash, resolution.y);
+	hash = hashCombine(hash, resolution.z);
+	if (voxelMaterials != NULL)
+	{
+		hash = hashWords(hash, voxelMaterials, (size_t)resolution.x * resolution.y * resolution.z);
+	}
+	return hash;
+}
+
 void Renderer::createVoxelDataTexture(const Imath::V3i& resolution,
 									  const GLint* voxelMaterials,
 									  const float* materialData,
 									  size_t materialDataSize,
-									  const GLint* emissiveVoxelIndices,
+									  const EmissiveVoxel* emissiveVoxels,
 									  size_t numEmissiveVoxels)
 {
 	using namespace Imath;
@@ -842,39 +1714,30 @@ void Renderer::createVoxelDataTexture(const Imath::V3i& resolution,
 	// Texture resolution 
 	m_glResources.m_volumeResolution = resolution;
 
-	float sizeMultiplier = 1000;
-	float voxelSize = sizeMultiplier / std::max(m_glResources.m_volumeResolution.x, std::max(m_glResources.m_volumeResolution.y, m_glResources.m_volumeResolution.z));
-	V3f boundsSize(voxelSize * m_glResources.m_volumeResolution.x, 
-	               voxelSize * m_glResources.m_volumeResolution.y, 
-	               voxelSize * m_glResources.m_volumeResolution.z);
-	m_volumeBounds = Box3f( -boundsSize * 0.5f, boundsSize * 0.5f);
+	m_volumeBounds = VoxelGrid::volumeBounds(m_glResources.m_volumeResolution);
 
 	// Upload texture data to card
 
-	glActiveTexture( GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_MATERIAL_OFFSET);
-	glBindTexture(GL_TEXTURE_3D, m_glResources.m_materialOffsetTexture);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP);
-	glPixelStorei(GL_PACK_ALIGNMENT,1);
-	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-	glTexImage3D(GL_TEXTURE_3D,
-	             0,
-	             GL_R32I,
-	             m_glResources.m_volumeResolution.x,
-	             m_glResources.m_volumeResolution.y,
-	             m_glResources.m_volumeResolution.z,
-	             0,
-	             GL_RED_INTEGER,
-	             GL_INT,
-	             voxelMaterials);
+	uploadVoxelMipmaps(voxelMaterials);
+
+	// identify the scene, so render checkpoints are only resumed on the one
+	// they were rendered from. The material data is hashed on demand, as it
+	// can be edited (see sceneHash).
+	m_sceneVoxelsHash = hashVoxels(resolution, voxelMaterials);
+	m_sceneVoxelsEdited = false;
+	if (materialData != NULL)
+	{
+		m_materialData.assign(materialData, materialData + materialDataSize);
+	}
+	else
+	{
+		m_materialData.clear();
+	}
 
 	glActiveTexture( GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_MATERIAL_DATA);
 	glBindTexture(GL_TEXTURE_1D, m_glResources.m_materialDataTexture);
 	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glPixelStorei(GL_PACK_ALIGNMENT,1);
 	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
 	glTexImage1D(GL_TEXTURE_1D,
@@ -886,222 +1749,447 @@ void Renderer::createVoxelDataTexture(const Imath::V3i& resolution,
 	             GL_FLOAT,
 	             materialData);
 
-	glActiveTexture( GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_EMISSIVE_VOXEL_INDICES);
-	glBindTexture(GL_TEXTURE_1D, m_glResources.m_emissiveVoxelIndicesTexture);
-	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glPixelStorei(GL_PACK_ALIGNMENT,1);
-	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-	glTexImage1D(GL_TEXTURE_1D,
-	             0,
-	             GL_R32I,
-				 numEmissiveVoxels, 
-	             0,
-	             GL_RED_INTEGER,
-	             GL_INT,
-	             emissiveVoxelIndices); 
+	m_emissiveVoxels.assign(emissiveVoxels, emissiveVoxels + numEmissiveVoxels);
+	for(size_t i = 0; i < m_emissiveVoxels.size(); ++i)
+	{
+		// all materials store their emission right after the material type
+		EmissiveVoxel& voxel = m_emissiveVoxels[i];
+		voxel.emissionLuminance = luminance(&materialData[voxel.materialOffset + 1]);
+	}
+	updateLightSelection(true);
 
 	// Set new resolution and volume bounds in all shaders
-
-	for( int i = 0; i < INTEGRATOR_TOTAL; ++i )
+	VolumeUniforms& uniforms = m_volumeUniforms.data();
+	for( int i = 0; i < 3; ++i )
 	{
-		const IntegratorShaderSettings& integratorSettings = m_settingsIntegrator[i];
-		glUseProgram(integratorSettings.m_program);
-		glUniform3i(integratorSettings.m_uniformVoxelDataResolution, 
-		            m_glResources.m_volumeResolution.x, 
-		            m_glResources.m_volumeResolution.y, 
-		            m_glResources.m_volumeResolution.z);
+		uniforms.voxelResolution[i] = m_glResources.m_volumeResolution[i];
+		uniforms.volumeBoundsMin[i] = m_volumeBounds.min[i];
+		uniforms.volumeBoundsMax[i] = m_volumeBounds.max[i];
+		uniforms.wsVoxelSize[i] = (m_volumeBounds.max[i] - m_volumeBounds.min[i]) / m_glResources.m_volumeResolution[i];
+	}
+	m_volumeUniforms.update();
 
-		glUniform3f(integratorSettings.m_uniformVolumeBoundsMin,
-		            m_volumeBounds.min.x,
-		            m_volumeBounds.min.y,
-		            m_volumeBounds.min.z);
+	// inform services
+	for( int i = 0; i < SERVICE_TOTAL; ++i)
+	{
+		if (m_services[i] == NULL || !m_serviceLoaded[i]) continue;
+		m_services[i]->volumeReloaded(m_glResources.m_volumeResolution, 
+									  m_volumeBounds);
+	}
+}
+void Renderer::uploadVoxelMipmaps(const GLint* voxelMaterials)
+{
+	const Imath::V3i& resolution = m_glResources.m_volumeResolution;
+	const int numLevels = VoxelMipmap::numLevels(resolution);
 
-		glUniform3f(integratorSettings.m_uniformVolumeBoundsMax,
-		            m_volumeBounds.max.x,
-		            m_volumeBounds.max.y,
-		            m_volumeBounds.max.z);
+	std::vector< std::vector<GLint> > levels;
+	if (voxelMaterials != NULL)
+	{
+		VoxelMipmap::generate(voxelMaterials, resolution, numLevels, levels);
+	}
 
-		glUniform3f(integratorSettings.m_uniformVoxelSize,
-					(m_volumeBounds.max.x-m_volumeBounds.min.x) / m_glResources.m_volumeResolution.x,
-					(m_volumeBounds.max.y-m_volumeBounds.min.y) / m_glResources.m_volumeResolution.y,
-					(m_volumeBounds.max.z-m_volumeBounds.min.z) / m_glResources.m_volumeResolution.z);
+	glActiveTexture( GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_MATERIAL_OFFSET);
+	glBindTexture(GL_TEXTURE_3D, m_glResources.m_materialOffsetTexture);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+	glPixelStorei(GL_PACK_ALIGNMENT,1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	for( int level = 0; level < numLevels; ++level )
+	{
+		const Imath::V3i levelResolution = VoxelMipmap::levelResolution(resolution, numLevels, level);
+		glTexImage3D(GL_TEXTURE_3D,
+		             level,
+		             GL_R32I,
+		             levelResolution.x,
+		             levelResolution.y,
+		             levelResolution.z,
+		             0,
+		             GL_RED_INTEGER,
+		             GL_INT,
+		             levels.empty() ? NULL : &levels[level][0]);
 	}
 
+	m_glResources.m_volumeNumLevels = numLevels;
+	// without any data supplied, the volume contents will be generated on the
+	// GPU, so the coarser levels will have to be built afterwards.
+	m_voxelMipmapsDirty = (voxelMaterials == NULL);
+	updateVoxelLod();
+}
+
+void Renderer::rebuildVoxelMipmaps()
+{
+	// without the program, rays stick to the full resolution level
+	if (m_settingsVoxelMipmap.m_program == 0) return;
+
+	const Imath::V3i& resolution = m_glResources.m_volumeResolution;
+	const int numLevels = m_glResources.m_volumeNumLevels;
+	const int groupSize = GLResourceConfiguration::m_voxelMipmapWorkGroupSize;
+
+	// make sure any image stores (voxelization, edits) have landed
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	glUseProgram(m_settingsVoxelMipmap.m_program);
+	for( int level = 1; level < numLevels; ++level )
+	{
+		glBindImageTexture(GLResourceConfiguration::m_voxelMipmapSourceImageUnit,
+						   m_glResources.m_materialOffsetTexture,
+						   level - 1, GL_TRUE, 0, GL_READ_ONLY, GL_R32I);
+		glBindImageTexture(GLResourceConfiguration::m_voxelMipmapDestinationImageUnit,
+						   m_glResources.m_materialOffsetTexture,
+						   level, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32I);
+
+		const Imath::V3i levelResolution = VoxelMipmap::levelResolution(resolution, numLevels, level);
+		glUniform3i(m_settingsVoxelMipmap.m_uniformDestinationResolution,
+					levelResolution.x, levelResolution.y, levelResolution.z);
+		glDispatchCompute((levelResolution.x + groupSize - 1) / groupSize,
+						  (levelResolution.y + groupSize - 1) / groupSize,
+						  (levelResolution.z + groupSize - 1) / groupSize);
+
+		// each level is built from the previous one
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
 	glUseProgram(0);
 
-	// inform services
-	for( int i = 0; i < SERVICE_TOTAL; ++i)
+	// make the new levels visible to the integrators' texture fetches
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	m_voxelMipmapsDirty = false;
+	updateVoxelLod();
+}
+
+void Renderer::hashEditedVoxels()
+{
+	if (!m_sceneVoxelsEdited) return;
+
+	const Imath::V3i& resolution = m_glResources.m_volumeResolution;
+	const Imath::V3i paddedResolution = VoxelMipmap::levelResolution(resolution, m_glResources.m_volumeNumLevels, 0);
+
+	// make sure any image stores (voxelization, edits) have landed
+	glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+	std::vector<GLint> paddedVoxelMaterials((size_t)paddedResolution.x * paddedResolution.y * paddedResolution.z);
+	glActiveTexture( GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_MATERIAL_OFFSET);
+	glBindTexture(GL_TEXTURE_3D, m_glResources.m_materialOffsetTexture);
+	glPixelStorei(GL_PACK_ALIGNMENT,1);
+	glGetTexImage(GL_TEXTURE_3D,
+				  0,
+				  GL_RED_INTEGER,
+				  GL_INT,
+				  &paddedVoxelMaterials[0]);
+
+	// strip the padding, so the voxels are hashed the same way as when
+	// loaded, and undoing the edits finds the original checkpoints again
+	std::vector<GLint> voxelMaterials((size_t)resolution.x * resolution.y * resolution.z);
+	for( int z = 0; z < resolution.z; ++z )
 	{
-		if (m_services[i] == NULL) continue;
-		m_services[i]->volumeReloaded(m_glResources.m_volumeResolution, 
-									  m_volumeBounds);
+		for( int y = 0; y < resolution.y; ++y )
+		{
+			const GLint* row = &paddedVoxelMaterials[((size_t)z * paddedResolution.y + y) * paddedResolution.x];
+			std::copy(row, row + resolution.x, &voxelMaterials[((size_t)z * resolution.y + y) * resolution.x]);
+		}
 	}
+
+	m_sceneVoxelsHash = hashVoxels(resolution, &voxelMaterials[0]);
+	m_sceneVoxelsEdited = false;
+}
+
+void Renderer::updateVoxelLod()
+{
+	const int maxLod = m_voxelMipmapsDirty ? 
+					   0 : 
+					   std::max(0, std::min(m_renderSettings.m_voxelLodMaxLevel, m_glResources.m_volumeNumLevels - 1));
+
+	// rays traced through coarser levels give different results, so samples
+	// taken before and after the change can't be averaged together.
+	const bool changed = m_volumeUniforms.data().voxelMaxLod != maxLod;
+	m_volumeUniforms.data().voxelMaxLod = maxLod;
+	m_volumeUniforms.update();
+	if (changed) resetRender();
 }
+
 void Renderer::resetRender()
 {
 	updateCamera();
 	m_numberSamples = 0;
 }
 
-bool Renderer::loadBackgroundImage( float& mapIntegralTimesSin )
+bool Renderer::updateBackgroundImage()
 {
-	if ( m_renderSettings.m_backgroundImage.empty() ) 
-	{
-		// no background iamge set
-		mapIntegralTimesSin = 0;
-		return true;
-	}
-	else if ( m_renderSettings.m_backgroundImage == m_currentBackgroundImage )
+	boost::shared_ptr<EnvironmentMap> map;
+	switch(m_environmentMapLoader.poll(map))
 	{
-		// we've already loaded and processed this image
-		mapIntegralTimesSin = m_currentBackgroundRadianceIntegral;
-		return true;
+		case EnvironmentMapLoader::STATUS_LOADED:
+			setBackgroundImage(map.get());
+			return true;
+		case EnvironmentMapLoader::STATUS_FAILED:
+			if (m_logger) (*m_logger)("Failed to load background image " + m_environmentMapLoader.requested());
+			if (m_pendingResume != NULL)
+			{
+				if (m_logger) (*m_logger)("Can't resume the render from " + m_pendingResume->file + " without its background image");
+				delete m_pendingResume;
+				m_pendingResume = NULL;
+			}
+			return false;
+		default:
+			return false;
 	}
-	
-	// new image
-	
-	mapIntegralTimesSin = 1.0f;
+}
+
+void Renderer::setBackgroundImage(const EnvironmentMap* map)
+{
 	if (glIsTexture(m_glResources.m_backgroundTexture))
 	{
 		glDeleteTextures(1, &m_glResources.m_backgroundTexture);
 		m_glResources.m_backgroundTexture = 0;
 	}
-	if (glIsTexture(m_glResources.m_backgroundCDFUTexture))
+	if (glIsTexture(m_glResources.m_backgroundAliasUTexture))
 	{
-		glDeleteTextures(1, &m_glResources.m_backgroundCDFUTexture);
-		m_glResources.m_backgroundCDFUTexture = 0;
+		glDeleteTextures(1, &m_glResources.m_backgroundAliasUTexture);
+		m_glResources.m_backgroundAliasUTexture = 0;
 	}
-	if (glIsTexture(m_glResources.m_backgroundCDFVTexture))
+	if (glIsTexture(m_glResources.m_backgroundAliasVTexture))
 	{
-		glDeleteTextures(1, &m_glResources.m_backgroundCDFVTexture);
-		m_glResources.m_backgroundCDFVTexture = 0;
+		glDeleteTextures(1, &m_glResources.m_backgroundAliasVTexture);
+		m_glResources.m_backgroundAliasVTexture = 0;
 	}
-	const int useBackgroundImage = m_renderSettings.m_backgroundImage.empty() ? 0 : 1;
-	if(useBackgroundImage == 0) return true; // we're done
 
-	unsigned int w, h;
-	std::vector<float> pixels;
-	if (!loadImage(m_renderSettings.m_backgroundImage, w, h, pixels)) return false;
+	if (map == NULL)
+	{
+		m_currentBackgroundImage = "";
+		m_currentBackgroundRadianceIntegral = 0;
+		return;
+	}
 
 	glGenTextures(1, &m_glResources.m_backgroundTexture);
 	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_BACKGROUND);
 	glBindTexture(GL_TEXTURE_2D, m_glResources.m_backgroundTexture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexImage2D(GL_TEXTURE_2D,
 	             0,
 	             GL_RGBA32F,
-	             w,
-	             h,
+	             map->width,
+	             map->height,
 	             0,
 	             GL_RGB,
 	             GL_FLOAT,
-	             &pixels[0]);
-
-	// Calculate data required for light importance sampling
-
-	unsigned int cdfUDataWidth, cdfUDataHeight;
-	std::vector<float> cdfUData, cdfVData;
-	float integralTimesSin;
-	calculateCDF(&pixels[0], w, h,
-	             cdfUData, cdfUDataWidth, cdfUDataHeight,
-	             cdfVData, 
-	             integralTimesSin);
-	const unsigned int cdfVDataHeight = cdfVData.size();
-
-	glGenTextures(1, &m_glResources.m_backgroundCDFUTexture);
-	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_BACKGROUND_CDF_U);
-	glBindTexture(GL_TEXTURE_2D, m_glResources.m_backgroundCDFUTexture);
+	             &map->pixels[0]);
+
+	// Data required for light importance sampling: the alias tables, with
+	// one packed entry per texel (see calculateAliasTables)
+
+	glGenTextures(1, &m_glResources.m_backgroundAliasUTexture);
+	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_BACKGROUND_ALIAS_U);
+	glBindTexture(GL_TEXTURE_2D, m_glResources.m_backgroundAliasUTexture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexImage2D(GL_TEXTURE_2D,
 	             0,
-	             GL_R32F,
-	             cdfUDataWidth,
-	             cdfUDataHeight,
+	             GL_R32UI,
+	             map->aliasUWidth,
+	             map->aliasUHeight,
 	             0,
-	             GL_RED,
-	             GL_FLOAT,
-	             &cdfUData[0]);
+	             GL_RED_INTEGER,
+	             GL_UNSIGNED_INT,
+	             &map->aliasU[0]);
 
-	glGenTextures(1, &m_glResources.m_backgroundCDFVTexture);
-	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_BACKGROUND_CDF_V);
-	glBindTexture(GL_TEXTURE_1D, m_glResources.m_backgroundCDFVTexture);
+	glGenTextures(1, &m_glResources.m_backgroundAliasVTexture);
+	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_BACKGROUND_ALIAS_V);
+	glBindTexture(GL_TEXTURE_1D, m_glResources.m_backgroundAliasVTexture);
 	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexImage1D(GL_TEXTURE_1D,
 	             0,
-	             GL_R32F,
-	             cdfVDataHeight,
+	             GL_R32UI,
+	             map->aliasV.size(),
 	             0,
-	             GL_RED,
-	             GL_FLOAT,
-	             &cdfVData[0]);
-
-	mapIntegralTimesSin = integralTimesSin;
+	             GL_RED_INTEGER,
+	             GL_UNSIGNED_INT,
+	             &map->aliasV[0]);
 
 	// store the current settings
-	m_currentBackgroundImage			= m_renderSettings.m_backgroundImage;
-	m_currentBackgroundRadianceIntegral = integralTimesSin;
-
-	return true;
+	m_currentBackgroundImage			= map->path;
+	m_currentBackgroundRadianceIntegral = map->radianceIntegral;
 }
 
-void Renderer::updateRenderSettings()
+void Renderer::updateLightSelection(bool emissiveVoxelsChanged)
 {
-	if (!m_initialized) return;
-
-	const int useBackgroundImage = m_renderSettings.m_backgroundImage.empty() ? 0 : 1;
-
-	float mapIntegralTimesSin = 0;
-	if (!loadBackgroundImage(mapIntegralTimesSin)) return;
+	// Lights are selected either proportionally to the power they emit
+	// towards the scene, which we estimate from their luminance only, or by
+	// traversing a tree with the bounds of that power.
+	//
+	// An emissive voxel emits pi * L * A, A being the area of its faces not
+	// covered by a neighbour. Note the integrator scales the emission of the
+	// voxels it samples (see directLighting in pathTracer.fs).
+	const float emissiveVoxelRadianceScale = 10.0f;
+	const Imath::V3f voxelSize = m_volumeBounds.size() / Imath::V3f(m_glResources.m_volumeResolution);
+	const float voxelFaceArea = voxelSize.x * voxelSize.y; // cubic voxels
+
+	// The power the environment sends through the scene bounds is that of a
+	// distant light falling on a disk of the bounding sphere's radius, pi *
+	// r^2 times the integral of the radiance over the sphere of directions.
+	float environmentRadianceIntegral;
+	if (!m_currentBackgroundImage.empty())
+	{
+		environmentRadianceIntegral = m_currentBackgroundRadianceIntegral;
+	}
+	else
+	{
+		// the gradient shows the bottom color under the horizon, and blends
+		// linearly (with the height of the direction) towards the top one
+		// above it.
+		const float top = luminance(&m_renderSettings.m_backgroundColor[0].x);
+		const float bottom = luminance(&m_renderSettings.m_backgroundColor[1].x);
+		environmentRadianceIntegral = 4.0f * M_PI * (0.75f * bottom + 0.25f * top);
+	}
+	const float sceneRadius = m_volumeBounds.size().length() * 0.5f;
 
-	for( int i = 0; i < INTEGRATOR_TOTAL; ++i )
+	std::vector<float> power(m_emissiveVoxels.size() + 1);
+	power[0] = M_PI * sceneRadius * sceneRadius * environmentRadianceIntegral;
+	for(size_t i = 0; i < m_emissiveVoxels.size(); ++i)
 	{
-		const IntegratorShaderSettings& integratorSettings = m_settingsIntegrator[i];
-		glUseProgram(integratorSettings.m_program);
+		const EmissiveVoxel& voxel = m_emissiveVoxels[i];
+		const int numFaces = (int)std::bitset<6>(voxel.faceMask).count();
+		power[i + 1] = M_PI * emissiveVoxelRadianceScale * voxel.emissionLuminance * 
+					   numFaces * voxelFaceArea;
+	}
 
-		glUniform1i(integratorSettings.m_uniformPathtracerMaxPathBounces , m_renderSettings.m_pathtracerMaxNumBounces);
-		glUniform1f(integratorSettings.m_uniformWireframeOpacity		, m_renderSettings.m_wireframeOpacity);
-		glUniform1f(integratorSettings.m_uniformWireframeThickness	  , m_renderSettings.m_wireframeThickness);
+	std::vector<AliasTable::Entry> aliasTable;
+	std::vector<float> pmf;
+	AliasTable::build(power, aliasTable, pmf);
 
-		glUniform3f(integratorSettings.m_uniformBackgroundColorTop, 
-					m_renderSettings.m_backgroundColor[0].x,
-					m_renderSettings.m_backgroundColor[0].y, 
-					m_renderSettings.m_backgroundColor[0].z );
+	std::vector<LightAliasTableEntry> entries(power.size());
+	for(size_t i = 0; i < entries.size(); ++i)
+	{
+		entries[i].probability = aliasTable[i].probability;
+		entries[i].alias       = aliasTable[i].alias;
+		entries[i].pmf         = pmf[i];
+		entries[i].voxelIndex  = i == 0 ? -1 : m_emissiveVoxels[i - 1].voxelIndex;
+		entries[i].faceMask    = i == 0 ? 0 : m_emissiveVoxels[i - 1].faceMask;
+	}
 
-		glUniform3f(integratorSettings.m_uniformBackgroundColorBottom, 
-					m_renderSettings.m_backgroundColor[1].x,
-					m_renderSettings.m_backgroundColor[1].y, 
-					m_renderSettings.m_backgroundColor[1].z );
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_glResources.m_lightAliasTableSSBO);	
+	glBufferData(GL_SHADER_STORAGE_BUFFER, entries.size() * sizeof(LightAliasTableEntry), &entries[0], GL_STATIC_DRAW);	
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GLResourceConfiguration::m_lightAliasTableSSBOBindingPointIndex, m_glResources.m_lightAliasTableSSBO);
+
+	// The environment can't be bounded in space like the voxels are, so the
+	// light tree leaves it out and picks it half of the time instead (as long
+	// as both the environment and the tree emit any light).
+	double emissiveVoxelsPower = 0;
+	for(size_t i = 1; i < power.size(); ++i) emissiveVoxelsPower += power[i];
+	LightTreeHeader header;
+	header.environmentPmf = power[0] <= 0 ? 0.0f : (emissiveVoxelsPower > 0 ? 0.5f : 1.0f);
+	header.numNodes = 0;
+	header.padding[0] = header.padding[1] = 0;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_glResources.m_lightTreeSSBO);	
+	if (emissiveVoxelsChanged)
+	{
+		const Imath::V3i& resolution = m_glResources.m_volumeResolution;
+		std::vector<LightTree::LightBounds> lights(m_emissiveVoxels.size());
+		for(size_t i = 0; i < m_emissiveVoxels.size(); ++i)
+		{
+			const GLint voxelIndex = m_emissiveVoxels[i].voxelIndex;
+			const Imath::V3i voxel(voxelIndex % resolution.x,
+								   (voxelIndex / resolution.x) % resolution.y,
+								   voxelIndex / (resolution.x * resolution.y));
+			const Imath::V3f voxelMin = m_volumeBounds.min + Imath::V3f(voxel) * voxelSize;
+
+			const Imath::Box3f voxelBounds(voxelMin, voxelMin + voxelSize);
+
+			// bound the normals of the exposed faces, each of which emits
+			// light over the hemisphere around its normal.
+			LightTree::LightBounds& light = lights[i];
+			light.bounds.makeEmpty();
+			for(int face = 0; face < 6; ++face)
+			{
+				if ((m_emissiveVoxels[i].faceMask & (1 << face)) == 0) continue;
+				LightTree::LightBounds faceBounds;
+				faceBounds.bounds = voxelBounds;
+				faceBounds.phi = 0;
+				faceBounds.w = Imath::V3f(0);
+				faceBounds.w[face >> 1] = (face & 1) == 0 ? 1.0f : -1.0f;
+				faceBounds.cosThetaO = 1;
+				faceBounds.cosThetaE = 0;
+				light = LightTree::merge(light, faceBounds);
+			}
+			light.phi = power[i + 1];
+			light.light = voxelIndex;
+			light.faceMask = m_emissiveVoxels[i].faceMask;
+		}
 
-		glUniform1i(integratorSettings.m_uniformBackgroundUseImage, 
-					useBackgroundImage);	
+		std::vector<LightTreeNode> nodes;
+		LightTree::build(lights, nodes);
+		header.numNodes = (int)nodes.size();
 
-		glUniform1i(integratorSettings.m_uniformBackgroundTexture, 
-					GLResourceConfiguration::TEXTURE_UNIT_BACKGROUND);	
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(LightTreeHeader) + nodes.size() * sizeof(LightTreeNode), NULL, GL_STATIC_DRAW);	
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(LightTreeHeader), &header);
+		if (!nodes.empty())
+		{
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(LightTreeHeader), nodes.size() * sizeof(LightTreeNode), &nodes[0]);
+		}
+	}
+	else
+	{
+		// the tree itself is unchanged
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header.environmentPmf), &header.environmentPmf);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GLResourceConfiguration::m_lightTreeSSBOBindingPointIndex, m_glResources.m_lightTreeSSBO);
+}
 
-		glUniform1i(integratorSettings.m_uniformBackgroundCDFUTexture, 
-					GLResourceConfiguration::TEXTURE_UNIT_BACKGROUND_CDF_U);	
+void Renderer::updateRenderSettings()
+{
+	if (!m_initialized) return;
 
-		glUniform1i(integratorSettings.m_uniformBackgroundCDFVTexture, 
-					GLResourceConfiguration::TEXTURE_UNIT_BACKGROUND_CDF_V);	
+	// Background images are loaded in a worker thread (see
+	// updateBackgroundImage); we keep rendering with the current background
+	// until the new one is ready. Requesting the current image cancels any
+	// pending load.
+	const std::string pendingBackgroundImage = m_renderSettings.m_backgroundImage != m_currentBackgroundImage ?
+											   m_renderSettings.m_backgroundImage : 
+											   std::string();
+	if (pendingBackgroundImage != m_environmentMapLoader.requested())
+	{
+		m_environmentMapLoader.request(pendingBackgroundImage);
+	}
+	if (m_renderSettings.m_backgroundImage.empty() && !m_currentBackgroundImage.empty())
+	{
+		setBackgroundImage(NULL);
+	}
 
-		glUniform1f(integratorSettings.m_uniformBackgroundIntegral, 
-					mapIntegralTimesSin);	
+	// the environment's share of the light samples depends on its power
+	updateLightSelection(false);
 
-		glUniform1f(integratorSettings.m_uniformBackgroundRotationRadians, 
-					m_renderSettings.m_backgroundRotationDegrees * M_PI / 180.0f);	
+	SettingsUniforms& uniforms = m_settingsUniforms.data();
+	uniforms.pathtracerMaxNumBounces = m_renderSettings.m_pathtracerMaxNumBounces;
+	uniforms.lightSelectionStrategy = m_renderSettings.m_lightSelectionStrategy;
+	uniforms.wireframeOpacity = m_renderSettings.m_wireframeOpacity;
+	uniforms.wireframeThickness = m_renderSettings.m_wireframeThickness;
+	uniforms.samplerPixelDecorrelation = m_renderSettings.m_samplerRank1PixelDecorrelation ? 1 : 0;
+	for( int i = 0; i < 3; ++i )
+	{
+		uniforms.backgroundColorTop[i] = m_renderSettings.m_backgroundColor[0][i];
+		uniforms.backgroundColorBottom[i] = m_renderSettings.m_backgroundColor[1][i];
 	}
+	uniforms.backgroundUseImage = m_currentBackgroundImage.empty() ? 0 : 1;
+	uniforms.backgroundIntegral = m_currentBackgroundRadianceIntegral;
+	uniforms.backgroundRotationRadians = m_renderSettings.m_backgroundRotationDegrees * M_PI / 180.0f;
+	m_settingsUniforms.update();
 
-	glUseProgram(0);
+	updateVoxelLod();
 	resetRender();
 }
 
@@ -1109,97 +2197,472 @@ void Renderer::saveImage(const std::string& file)
 {
 	if (!m_initialized)  return;
 
-	OIIO_NAMESPACE_USING 
-
 	const int xres = m_renderSettings.m_imageResolution.x, 
 			  yres = m_renderSettings.m_imageResolution.y;
 	const int channels = 4; // RGBA
-	float* pixels = new float[xres*yres*channels];
+	const GLsizeiptr size = (GLsizeiptr)xres * yres * channels * sizeof(float);
 
+	// copy the accumulated samples into a pixel pack buffer. This is queued
+	// like any other command, so it doesn't stall the pipeline.
+	const GLuint pbo = createReadbackBuffer(size);
 	glUseProgram(0);
-	glBindTexture(GL_TEXTURE_2D, m_glResources.m_averageTexture[m_activeSampleTexture]);
+	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_ACCUMULATION);
+	glBindTexture(GL_TEXTURE_2D, m_glResources.m_accumulationTexture);
 	glGetTexImage(GL_TEXTURE_2D,
 				  0,
 				  GL_RGBA,
 				  GL_FLOAT,
-				  pixels);
-
-	ImageOutput* out = ImageOutput::create(file.c_str());
-	if (!out) return;
-	ImageSpec spec (xres, yres, channels, TypeDesc::FLOAT);
-	out->open(file.c_str(), spec);
-	const size_t scanlineSize = xres * channels * sizeof(float);
-	out->write_image(TypeDesc::FLOAT, 
-					 (const char*)pixels + (yres - 1) * scanlineSize, // offset to last
-					 AutoStride, 
-					 -(int)scanlineSize,  // negative stride = flip image vertically
-					 AutoStride);
-	delete[] pixels;
-	out->close();
-	delete out;
+				  0); // offset into the pixel pack buffer
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	queueReadback(file,
+				  "image",
+				  pbo,
+				  size,
+				  boost::bind(&ImageWriter::write, 
+							  file, 
+							  _1, 
+							  xres, 
+							  yres, 
+							  integratorSetup[m_currentIntegrator].displayGamma));
 }
 
-std::vector<Material::SerializedData> Renderer::getMaterials() const
+bool Renderer::renderTiledImage(const std::string& file, int width, int height)
 {
-	using namespace std;
-	vector<Material::SerializedData> result;
+	if (!m_initialized) return false;
 
-	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_MATERIAL_DATA); 
-	glBindTexture(GL_TEXTURE_1D, m_glResources.m_materialDataTexture);
-	GLint width;
-	glGetTexLevelParameteriv(GL_TEXTURE_1D, 0, GL_TEXTURE_WIDTH, &width); // get width of GL texture
-	glPixelStorei(GL_PACK_ALIGNMENT,4);
-	glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+	if (m_tiledImage != NULL)
+	{
+		if (m_logger) (*m_logger)("Already rendering " + m_tiledImage->file);
+		return false;
+	}
+	if (width <= 0 || height <= 0) return false;
 
-	float* storage = new float[width];
+	// the image is rendered by the path tracer, even if we're editing
+	if (m_currentIntegrator == INTEGRATOR_EDIT_MODE)
+	{
+		m_currentIntegrator = INTEGRATOR_PATHTRACER;
+		m_sampleTimer.reset();
+	}
 
-	glGetTexImage(GL_TEXTURE_1D,
-				  0,
-				  GL_RED,
-				  GL_FLOAT,
-				  storage);
-	
-	size_t offset = 0;
-	while(offset < (size_t)width)
+	TiledImageWriter* writer = new TiledImageWriter();
+	if (!writer->open(file, width, height, integratorSetup[m_currentIntegrator].displayGamma))
 	{
-		Material::MaterialType mt = (Material::MaterialType)(storage[offset]);
+		if (m_logger) (*m_logger)("Failed to create tiled image " + file);
+		delete writer;
+		return false;
+	}
 
-		size_t dataSize = 0;
-		switch(mt)
+	m_tiledImage = new TiledImage;
+	m_tiledImage->file = file;
+	m_tiledImage->writer = writer;
+	m_tiledImage->resolution = Imath::V2i(width, height);
+	m_tiledImage->currentRegion = 0;
+	m_tiledImage->regionStarted = false;
+	m_tiledImage->frameResolution = m_renderSettings.m_imageResolution;
+
+	// regions are made of whole tiles of the file, and rendered from the top
+	// of the image down, as it's laid out in the file
+	const int tileSize = TiledImageWriter::tileSize;
+	const int regionSize = std::max(1, (m_renderSettings.m_outputTileSize + tileSize - 1) / tileSize) * tileSize;
+	for( int y = 0; y < height; y += regionSize )
+	{
+		const int regionHeight = std::min(regionSize, height - y);
+		for( int x = 0; x < width; x += regionSize )
 		{
-			case Material::MT_LAMBERT:
-			{
-				const Material::LambertMaterialData* materialData = reinterpret_cast<const Material::LambertMaterialData*>(storage + offset + 1);
-				result.push_back(Material::serializeLambert(*materialData, offset));
-				dataSize = sizeof(Material::LambertMaterialData) / sizeof(float);
-			} break;
+			const int regionWidth = std::min(regionSize, width - x);
+			m_tiledImage->regions.push_back(Imath::Box2i(Imath::V2i(x, height - y - regionHeight),
+														 Imath::V2i(x + regionWidth - 1, height - y - 1)));
+		}
+	}
 
-			case Material::MT_METAL:
-			{
-				const Material::MetalMaterialData* materialData = reinterpret_cast<const Material::MetalMaterialData*>(storage + offset + 1);
-				result.push_back(Material::serializeMetal(*materialData, offset));
-				dataSize = sizeof(Material::MetalMaterialData) / sizeof(float);
-			} break;
+	if (m_logger)
+	{
+		std::ostringstream msg;
+		msg << "Rendering " << width << "x" << height << " image " << file 
+			<< " in " << m_tiledImage->regions.size() << " tiles";
+		(*m_logger)(msg.str());
+	}
+	return true;
+}
 
-			case Material::MT_PLASTIC:
-			{
-				const Material::PlasticMaterialData* materialData = reinterpret_cast<const Material::PlasticMaterialData*>(storage + offset + 1);
-				result.push_back(Material::serializePlastic(*materialData, offset));
-				dataSize = sizeof(Material::PlasticMaterialData) / sizeof(float);
-			} break;
+void Renderer::updateTiledImage()
+{
+	if (m_tiledImage->regionStarted) return;
 
-			default: 
+	if (m_tiledImage->currentRegion < m_tiledImage->regions.size())
+	{
+		// resizing the buffers resets the render; regions of the same size
+		// (all but those along the edges) only need the latter.
+		const Imath::Box2i& region = m_tiledImage->regions[m_tiledImage->currentRegion];
+		const Imath::V2i regionResolution(region.max.x - region.min.x + 1, region.max.y - region.min.y + 1);
+		m_tiledImage->regionStarted = true;
+		if (regionResolution != m_renderSettings.m_imageResolution)
+		{
+			resizeRenderBuffers(regionResolution.x, regionResolution.y);
+		}
+		m_numberSamples = 0;
+		return;
+	}
+
+	for( size_t i = 0; i < m_pendingReadbacks.size(); ++i )
+	{
+		// the last regions are still being written
+		if (m_pendingReadbacks[i].file == m_tiledImage->file) return;
+	}
+
+	const bool success = m_tiledImage->writer->close();
+	if (m_logger) (*m_logger)((success ? "Finished rendering " : "Failed to write ") + m_tiledImage->file);
+
+	// back to rendering the frame
+	const Imath::V2i frameResolution = m_tiledImage->frameResolution;
+	delete m_tiledImage->writer;
+	delete m_tiledImage;
+	m_tiledImage = NULL;
+	resizeRenderBuffers(frameResolution.x, frameResolution.y);
+}
+
+void Renderer::saveTiledImageRegion()
+{
+	const Imath::Box2i& region = m_tiledImage->regions[m_tiledImage->currentRegion];
+	const int xres = region.max.x - region.min.x + 1,
+			  yres = region.max.y - region.min.y + 1;
+	const int channels = 4; // RGBA
+	const GLsizeiptr size = (GLsizeiptr)xres * yres * channels * sizeof(float);
+
+	const GLuint pbo = createReadbackBuffer(size);
+	glUseProgram(0);
+	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_ACCUMULATION);
+	glBindTexture(GL_TEXTURE_2D, m_glResources.m_accumulationTexture);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	std::ostringstream description;
+	description << "tile " << m_tiledImage->currentRegion + 1 << "/" << m_tiledImage->regions.size() << " of";
+	// the file counts rows from the top of the image
+	queueReadback(m_tiledImage->file,
+				  description.str(),
+				  pbo,
+				  size,
+				  boost::bind(&TiledImageWriter::writeRegion,
+							  m_tiledImage->writer,
+							  _1,
+							  region.min.x,
+							  m_tiledImage->resolution.y - 1 - region.max.y,
+							  xres,
+							  yres));
+
+	m_tiledImage->currentRegion++;
+	m_tiledImage->regionStarted = false;
+}
+
+GLuint Renderer::createReadbackBuffer(GLsizeiptr size)
+{
+	GLuint pbo;
+	glGenBuffers(1, &pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+	return pbo;
+}
+
+void Renderer::queueReadback(const std::string& file,
+							 const std::string& description,
+							 GLuint pbo,
+							 GLsizeiptr size,
+							 const boost::function<bool (const float*)>& write)
+{
+	PendingReadback readback;
+	readback.file = file;
+	readback.description = description;
+	readback.pbo = pbo;
+	readback.size = size;
+	readback.write = write;
+	readback.task = NULL;
+	// we'll map the buffer once the fence tells us the copy is done
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush(); // make sure the fence gets signaled
+
+	m_pendingReadbacks.push_back(readback);
+}
+
+void Renderer::updatePendingReadbacks()
+{
+	std::vector<PendingReadback>::iterator it = m_pendingReadbacks.begin();
+	while (it != m_pendingReadbacks.end())
+	{
+		PendingReadback& readback = *it;
+		if (readback.task == NULL)
+		{
+			const GLenum status = glClientWaitSync(readback.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			{
+				++it;
+				continue;
+			}
+			glDeleteSync(readback.fence);
+			readback.fence = 0;
+
+			// the buffer stays mapped while the worker thread reads from it
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+			const float* data = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER,
+															   0,
+															   readback.size,
+															   GL_MAP_READ_BIT);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			if (data == NULL)
 			{
-				offset = width;
-				if (m_logger) (*m_logger)("Unrecognized material type. Aborting.");
-				break;
+				if (m_logger) (*m_logger)("Failed to read back the " + readback.description + " for " + readback.file);
+				glDeleteBuffers(1, &readback.pbo);
+				it = m_pendingReadbacks.erase(it);
+				continue;
 			}
+			readback.task = new AsyncTask(boost::bind(readback.write, data));
+			++it;
+			continue;
 		}
-		offset += 1 + dataSize; // Type (1) + dataSize
-	};
 
-	delete storage;
-	return result;
+		if (!readback.task->finished())
+		{
+			++it;
+			continue;
+		}
+
+		if (m_logger)
+		{
+			(*m_logger)(readback.task->succeeded() ? "Saved " + readback.description + " " + readback.file :
+													 "Failed to save " + readback.description + " " + readback.file);
+		}
+		delete readback.task;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glDeleteBuffers(1, &readback.pbo);
+		it = m_pendingReadbacks.erase(it);
+	}
+}
+
+boost::uint64_t Renderer::sceneHash() const
+{
+	if (m_materialData.empty()) return m_sceneVoxelsHash;
+	return hashWords(m_sceneVoxelsHash, &m_materialData[0], m_materialData.size());
+}
+
+// Checkpoints of other scenes (or older versions of this one) are kept in the
+// cache until they take more than this.
+static const boost::uint64_t CHECKPOINT_CACHE_MAX_SIZE = 1024 << 20;
+
+// Write a checkpoint, from the worker thread of its readback, and prune the
+// older ones. The one just written is kept even if it's bigger than the limit
+// on its own.
+bool writeCheckpointFile(const Checkpoint& checkpoint, const std::string& file, const float* pixels)
+{
+	if (!checkpoint.write(file, pixels)) return false;
+
+	struct stat info;
+	const boost::uint64_t size = stat(file.c_str(), &info) == 0 ? (boost::uint64_t)info.st_size : 0;
+	pruneCache("checkpoint-", std::max(CHECKPOINT_CACHE_MAX_SIZE, size));
+	return true;
+}
+
+std::string Renderer::checkpointFile() const
+{
+	if (!m_renderSettings.m_checkpointFile.empty()) return m_renderSettings.m_checkpointFile;
+
+	const std::string directory = cacheDirectory();
+	if (directory.empty()) return "";
+	std::ostringstream ss;
+	ss << directory << "/checkpoint-" << std::hex << sceneHash() << ".vtc";
+	return ss.str();
+}
+
+void Renderer::writeCheckpoint()
+{
+	hashEditedVoxels();
+	const std::string file = checkpointFile();
+	if (file.empty()) return;
+	for( size_t i = 0; i < m_pendingReadbacks.size(); ++i )
+	{
+		// the previous checkpoint is still being written
+		if (m_pendingReadbacks[i].file == file) return;
+	}
+
+	Checkpoint checkpoint;
+	checkpoint.sceneHash = sceneHash();
+	checkpoint.integrator = m_currentIntegrator;
+	checkpoint.numberSamples = m_numberSamples;
+	checkpoint.width = m_glResources.m_textureDimensions[0];
+	checkpoint.height = m_glResources.m_textureDimensions[1];
+	const CameraParameters& camera = m_camera.parameters();
+	checkpoint.eye = camera.eye();
+	checkpoint.target = camera.target();
+	checkpoint.focalLength = camera.focalLength();
+	checkpoint.focalDistance = camera.focalDistance();
+	checkpoint.lensRadius = camera.lensRadius();
+	checkpoint.lensModel = camera.lensModel();
+	checkpoint.settings = m_renderSettings;
+
+	// read back the accumulation buffer, followed by the second moments
+	const GLsizeiptr accumulationSize = (GLsizeiptr)checkpoint.width * checkpoint.height * 4 * sizeof(float);
+	const GLuint pbo = createReadbackBuffer(checkpoint.pixelDataSize() * sizeof(float));
+	glUseProgram(0);
+	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_ACCUMULATION);
+	glBindTexture(GL_TEXTURE_2D, m_glResources.m_accumulationTexture);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, 0);
+	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_MOMENTS);
+	glBindTexture(GL_TEXTURE_2D, m_glResources.m_momentsTexture);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, (GLvoid*)accumulationSize);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	queueReadback(file,
+				  "checkpoint",
+				  pbo,
+				  checkpoint.pixelDataSize() * sizeof(float),
+				  boost::bind(writeCheckpointFile, checkpoint, file, _1));
+
+	m_lastCheckpointTime = time(NULL);
+	m_checkpointNumberSamples = m_numberSamples;
+	m_checkpointWritten = file;
+}
+
+void Renderer::removeCheckpoint()
+{
+	for( size_t i = 0; i < m_pendingReadbacks.size(); ++i )
+	{
+		// try again once it's written
+		if (m_pendingReadbacks[i].file == m_checkpointWritten) return;
+	}
+	if (remove(m_checkpointWritten.c_str()) == 0 && m_logger)
+	{
+		(*m_logger)("Removed checkpoint " + m_checkpointWritten + ", as the render is finished");
+	}
+	m_checkpointWritten = "";
+}
+
+bool Renderer::resumeFromCheckpoint(const std::string& file)
+{
+	if (!m_initialized) return false;
+
+	if (m_tiledImage != NULL)
+	{
+		if (m_logger) (*m_logger)("Can't resume a render while rendering " + m_tiledImage->file);
+		return false;
+	}
+	if (m_voxelEditInProgress)
+	{
+		if (m_logger) (*m_logger)("Can't resume a render while the volume is being edited");
+		return false;
+	}
+	hashEditedVoxels();
+
+	const std::string path = file.empty() ? checkpointFile() : file;
+	Checkpoint checkpoint;
+	checkpoint.settings = m_renderSettings;
+	std::vector<float> pixels;
+	if (path.empty() || !checkpoint.read(path, pixels))
+	{
+		if (m_logger) (*m_logger)("No checkpoint to resume from at " + path);
+		return false;
+	}
+	if (checkpoint.sceneHash != sceneHash())
+	{
+		if (m_logger) (*m_logger)("The checkpoint " + path + " was rendered from a different scene");
+		return false;
+	}
+	if (checkpoint.integrator != INTEGRATOR_PATHTRACER &&
+		checkpoint.integrator != INTEGRATOR_WAVEFRONT_PATHTRACER)
+	{
+		if (m_logger) (*m_logger)("The checkpoint " + path + " was rendered with an unknown integrator");
+		return false;
+	}
+	if (checkpoint.width != m_glResources.m_textureDimensions[0] ||
+		checkpoint.height != m_glResources.m_textureDimensions[1])
+	{
+		if (m_logger)
+		{
+			std::ostringstream msg;
+			msg << "The checkpoint " << path << " was rendered at " << checkpoint.width << "x" << checkpoint.height
+				<< ", set the render resolution to match it to resume";
+			(*m_logger)(msg.str());
+		}
+		return false;
+	}
+
+	// keep it in the cache over the checkpoints of other scenes
+	if (file.empty()) touchCacheEntry(path);
+
+	delete m_pendingResume;
+	m_pendingResume = new PendingResume;
+	m_pendingResume->file = path;
+	m_pendingResume->checkpoint = checkpoint;
+	m_pendingResume->pixels.swap(pixels);
+	restoreCheckpoint();
+	return true;
+}
+
+void Renderer::restoreCheckpoint()
+{
+	const Checkpoint& checkpoint = m_pendingResume->checkpoint;
+
+	// the scene may have changed while the background image was loading
+	if (checkpoint.sceneHash != sceneHash() ||
+		checkpoint.width != m_glResources.m_textureDimensions[0] ||
+		checkpoint.height != m_glResources.m_textureDimensions[1])
+	{
+		if (m_logger) (*m_logger)("The scene changed before the render could be resumed from " + m_pendingResume->file);
+		delete m_pendingResume;
+		m_pendingResume = NULL;
+		return;
+	}
+
+	m_camera.setEyeTarget(checkpoint.eye, checkpoint.target);
+	m_camera.setFocalLength(checkpoint.focalLength);
+	m_camera.setFocalDistance(checkpoint.focalDistance);
+	m_camera.setLensRadius(checkpoint.lensRadius);
+	m_camera.setLensModel((CameraParameters::CameraLensModel)checkpoint.lensModel);
+	m_renderSettings = checkpoint.settings;
+	m_currentIntegrator = (Integrator)checkpoint.integrator;
+	updateRenderSettings(); // resets the render
+
+	// the background image is loaded in the background (see
+	// updateRenderSettings), and the samples are restored once it's ready,
+	// or the render would be reset then.
+	if (m_renderSettings.m_backgroundImage != m_currentBackgroundImage)
+	{
+		if (m_logger) (*m_logger)("Loading the background image to resume the render from " + m_pendingResume->file);
+		return;
+	}
+
+	// restore the accumulated samples
+	const std::vector<float>& pixels = m_pendingResume->pixels;
+	const size_t numPixels = (size_t)checkpoint.width * checkpoint.height;
+	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_ACCUMULATION);
+	glBindTexture(GL_TEXTURE_2D, m_glResources.m_accumulationTexture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, checkpoint.width, checkpoint.height, GL_RGBA, GL_FLOAT, &pixels[0]);
+	glActiveTexture(GL_TEXTURE0 + GLResourceConfiguration::TEXTURE_UNIT_MOMENTS);
+	glBindTexture(GL_TEXTURE_2D, m_glResources.m_momentsTexture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, checkpoint.width, checkpoint.height, GL_RED, GL_FLOAT, &pixels[numPixels * 4]);
+
+	m_numberSamples = checkpoint.numberSamples;
+	m_nextTile = 0;
+	m_renderingPreview = false;
+	m_previewNumberSamples = 0;
+	m_convergenceMaskValid = false;
+	discardConvergenceReadback();
+	m_unconvergedTiles = -1;
+	m_lastCheckpointTime = time(NULL);
+	m_checkpointNumberSamples = m_numberSamples;
+	m_checkpointWritten = m_pendingResume->file;
+	// the samples per frame are timed anew, as the integrator may differ
+	m_sampleTimer.reset();
+
+	if (m_logger)
+	{
+		std::ostringstream msg;
+		msg << "Resumed render from " << m_pendingResume->file << " (" << m_numberSamples << " samples)";
+		(*m_logger)(msg.str());
+	}
+	delete m_pendingResume;
+	m_pendingResume = NULL;
 }
 
 void Renderer::updateMaterialColor(unsigned int dataOffset, const float color[3])
@@ -1216,6 +2679,22 @@ void Renderer::updateMaterialColor(unsigned int dataOffset, const float color[3]
 					GL_RED, // GLenum format,
 					GL_FLOAT, // GLenum type,
 					color); // const GLvoid * pixels
+
+	if (dataOffset + 3 <= m_materialData.size())
+	{
+		std::copy(color, color + 3, m_materialData.begin() + dataOffset);
+	}
+
+	// the power of the emissive voxels using the material might have changed
+	bool lightsChanged = false;
+	for(size_t i = 0; i < m_emissiveVoxels.size(); ++i)
+	{
+		EmissiveVoxel& voxel = m_emissiveVoxels[i];
+		if (voxel.materialOffset + 1 != (GLint)dataOffset) continue; // not its emission
+		voxel.emissionLuminance = luminance(color);
+		lightsChanged = true;
+	}
+	if (lightsChanged) updateLightSelection(true);
 }
 
 void Renderer::updateMaterialValue(unsigned int dataOffset, float value)
@@ -1232,5 +2711,7 @@ void Renderer::updateMaterialValue(unsigned int dataOffset, float value)
 					GL_RED, // GLenum format,
 					GL_FLOAT, // GLenum type,
 					&value ); // const GLvoid * pixels
+
+	if (dataOffset < m_materialData.size()) m_materialData[dataOffset] = value;
 }
 
@@ -9,16 +9,25 @@
 #include "renderer/services/service.h"
 #include "renderer/actions.h"
 #include "renderer/material/material.h"
+#include "renderer/environmentMap.h"
+#include "renderer/checkpoint.h"
+#include "renderer/asyncTask.h"
+#include "renderer/uniformBuffer.h"
+#include "shaders/uniformBlocks/uniformBlocksHost.h"
 
 #include <GL/gl.h>
 
 #include <OpenEXR/ImathMatrix.h>
 #include <OpenEXR/ImathBox.h>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
 
 #include <vector>
 #include <string>
+#include <ctime>
 
 class Mesh;
+class TiledImageWriter;
 
 class Renderer
 {
@@ -53,28 +62,43 @@ public:
 	// until a call to 'resetRender' is performed.
 	RenderResult render();
 
-	// Reload all shaders.
+	// Reload all shaders. Those of the integrators and services are only built
+	// once they're first needed; the current integrator's right away, in the
+	// background if the driver can (see Shader::enableParallelCompilation).
 	void reloadShaders(const std::string& shaderPath);
 
 	// Wipe the current voxel data and voxelize an input mesh.
     void loadMesh(const std::string& file);
 	// Wipe the current voxel data and load a .vox file.
     void loadVoxFile(const std::string& file);
-	// As a variance-reduction technique, we eliminate all those voxels which
-	// are completely surrounded by other voxels from the list of emissive
-	// voxels. These would otherwise be randomly sampled, but never contribute
-	// to the image.
-	void pruneInteriorEmissiveVoxels(const std::vector<GLint>& voxelMaterials, 
-									 Imath::V3i& volumeResolution, 
-									 std::vector<GLint>& emissiveVoxelIndices);
-
-	// Save the current accumulated framebuffer to an image file.
+
+	// Save the current accumulated framebuffer to an image file. The pixels
+	// are read back and written asynchronously, over the next frames.
     void saveImage(const std::string& file);
 
+	// Render an image of the given resolution, which may be far larger than
+	// the render buffers could hold (e.g. for print), region by region (see
+	// RenderSettings::m_outputTileSize). Each region is rendered until it
+	// converges or reaches the maximum number of samples, and then written
+	// to a tiled file (see TiledImageWriter) and its buffers reused for the
+	// next one, so memory use doesn't grow with the image. The image renders
+	// over the next frames, in place of the interactive one, and the camera
+	// can't be moved meanwhile. Returns false if the file can't be created.
+	bool renderTiledImage(const std::string& file, int width, int height);
+
 	// Reset render accumulation. This is required when a parameter such as the
 	// camera position changes.
     void resetRender();
 
+	// Reload a checkpoint (see RenderSettings::m_checkpointIntervalSeconds)
+	// and keep accumulating samples onto it, restoring the camera and render
+	// settings it was rendered with. By default, the checkpoint of the current
+	// scene is loaded. Returns false if the checkpoint is missing, or it was
+	// rendered from a different scene or at a different resolution. If the
+	// checkpoint's background image has to be loaded first, accumulation
+	// carries on once it is.
+	bool resumeFromCheckpoint(const std::string& file = "");
+
 	// Callback from the parent UI to give the renderer an opportunity to handle
 	// mouse and key events. Return true if the event was acknowledged, false
 	// otherwise.
@@ -114,6 +138,9 @@ public:
 	{
 		INTEGRATOR_PATHTRACER = 0,
 		INTEGRATOR_EDIT_MODE,
+		// same as the path tracer, split in compute stages (see
+		// renderWavefront)
+		INTEGRATOR_WAVEFRONT_PATHTRACER,
 		INTEGRATOR_TOTAL,
 	};
 
@@ -124,31 +151,102 @@ public:
 private:
 	// Synchronize camera data with the shaders.
 	void updateCamera();
+	// Current view and projection matrices of the camera.
+	void cameraMatrices(Imath::M44f& mvm, Imath::M44f& pm) const;
+	// Resolution of the image being rendered: the frame's, unless it's a
+	// region of a tiled image (see renderTiledImage).
+	Imath::V2i imageResolution() const;
+	// Set the film size matching the aspect ratio of the image.
+	void updateFilmSize();
+	// Set the viewport of an integrator program, so the frame's pixels map to
+	// those of the image being rendered.
+	void setIntegratorViewport(const IntegratorShaderSettings& settings, const Imath::V2i& resolution) const;
+	// Reallocate the render buffers, and reset the render.
+	void resizeRenderBuffers(int width, int height);
+
+	// An emissive voxel, which along with the environment make up the lights
+	// we sample.
+	struct EmissiveVoxel
+	{
+		GLint voxelIndex;
+		// offset of the voxel's material in the material data
+		GLint materialOffset;
+		// luminance of the material's emission (set by createVoxelDataTexture)
+		float emissionLuminance;
+		// faces not covered by a neighbour voxel, which are the only ones
+		// light is sampled from (+X, -X, +Y, -Y, +Z, -Z)
+		int   faceMask;
+	};
 
 	// Declare voxel resources
 	void createVoxelDataTexture (const Imath::V3i& resolution,
-								 const GLint* voxelMaterials       = NULL,
-								 const float* materialData         = NULL,
-								 size_t materialDataSize           = 0,
-								 const GLint* emissiveVoxelIndices = NULL,
-								 size_t numEmissiveVoxels          = 0);
+								 const GLint* voxelMaterials          = NULL,
+								 const float* materialData            = NULL,
+								 size_t materialDataSize              = 0,
+								 const EmissiveVoxel* emissiveVoxels  = NULL,
+								 size_t numEmissiveVoxels             = 0);
+
+	// Rebuild the structures used to select the light to sample (the alias
+	// table and light tree), from the current emissive voxels and environment
+	// settings. The light tree, which only depends on the emissive voxels, is
+	// only rebuilt if they changed.
+	void updateLightSelection(bool emissiveVoxelsChanged);
 
 	// reload shader and resources for the screen-space texture drawing shader.
 	bool reloadTexturedShader(const std::string& shaderPath);
-	// reload shader and resources for the frame accumulation shader.
-	bool reloadAverageShader(const std::string& shaderPath);
-	// reload shader and resources for each integrator
-	bool reloadIntegratorShader(const std::string& shaderPath, 
-								const std::string& name,
-								const std::string& vsFile,
-								const std::string& fsFile,
-								IntegratorShaderSettings& settings);
-
-	// Load and process background image
-	bool loadBackgroundImage(float&);
-
-	// Utility function to draw a screen-aligned quad
-	void drawFullscreenQuad();
+	// reload shader and resources for the adaptive sampling convergence test.
+	bool reloadConvergenceShader(const std::string& shaderPath);
+	// reload shader and resources for building the voxel mip chain.
+	bool reloadVoxelMipmapShader(const std::string& shaderPath);
+	// Start building the programs of the given integrator, unless they're
+	// already built or being built.
+	void requestIntegrator(Integrator integrator);
+	// Whether the programs of the given integrator are built, and ready to
+	// render with. Their build is started if need be. Unless told to wait, this
+	// returns false while they're still being built in the background.
+	bool isIntegratorReady(Integrator integrator, bool wait);
+	// start building the programs of each stage of the wavefront path tracer
+	bool startWavefrontShaders(std::vector<ShaderProgramBuild>& builds);
+	// finish building them, and look up their uniforms
+	bool finishWavefrontShaders(const std::vector<ShaderProgramBuild>& builds);
+	// look up the integrator uniforms of a newly built program, and set them
+	// to the current state
+	void setupIntegratorProgram(IntegratorShaderSettings& settings);
+	// All the built programs taking the integrator uniforms: those of the
+	// integrators drawn as a fullscreen pass, and the stages of the wavefront
+	// path tracer.
+	std::vector<IntegratorShaderSettings*> integratorPrograms();
+	// The given service, loaded on first use. NULL if there's no such service.
+	RendererService* service(RendererServiceType type);
+
+	// Collect the background image being loaded in the background, if it's
+	// ready. Returns true if the background changed.
+	bool updateBackgroundImage();
+	// Upload the given background image and its sampling distributions, or
+	// release the current one if NULL.
+	void setBackgroundImage(const EnvironmentMap* map);
+
+	// Render the given number of samples per pixel, starting at firstSample,
+	// over a region (inclusive bounds) of an image of the given resolution,
+	// with the current integrator, and add them onto the accumulation texture
+	// in use.
+	void renderSamples(const Imath::V2i& resolution, const Imath::Box2i& region, int firstSample, int numSamples);
+	// Same as above, for the wavefront path tracer. Each sample is traced in
+	// waves of up to GLResourceConfiguration::m_wavefrontMaxPaths pixels
+	// (whole rows of the region): rays are generated for all the pixels in the
+	// wave and then extended, shaded (in a separate pass per material) and
+	// connected to a light one bounce at a time, with the paths moving between
+	// stages through queues built on the GPU.
+	void renderWavefront(const Imath::V2i& resolution, const Imath::Box2i& region, int firstSample, int numSamples);
+	// Turn the sizes of the wavefront queues into the work groups of the
+	// stages which consume them (see wavefront/dispatch.cs).
+	void dispatchWavefrontQueues(int queues);
+	// (Re)allocate the wavefront path tracer buffers for the given number of
+	// paths.
+	void createWavefrontBuffers(int capacity);
+
+	// Utility function to draw a triangle covering the whole viewport
+	void drawFullscreenTriangle();
 
 	// Declare framebuffer resources
 	void createFramebuffer();
@@ -159,8 +257,88 @@ private:
 
 	// clear out list of pending "actions" requested by the user, such as
 	// selecting the active voxel, prior to rendering the next visible frame.
-	// Each action results in a render pass.
-	void processPendingActions();
+	// Each action results in a render pass. Returns true if any of the actions
+	// modified the voxel data, and keeps track of whether an edit stroke is
+	// under way.
+	bool processPendingActions();
+
+	// Generate the voxel mip chain from the supplied full resolution data, and
+	// upload all its levels to the material offset texture. If no data is
+	// supplied, the levels are allocated but their contents are left to be
+	// written on the GPU (see rebuildVoxelMipmaps).
+	void uploadVoxelMipmaps(const GLint* voxelMaterials);
+	// Regenerate the coarser levels of the mip chain on the GPU, from the full
+	// resolution voxel data which might have been modified there (e.g. by
+	// voxelization or editing).
+	void rebuildVoxelMipmaps();
+	// Read back the edited voxels and hash them, if they changed since they
+	// were last hashed (see m_sceneVoxelsHash).
+	void hashEditedVoxels();
+	// Set the coarsest level of the voxel mip chain the integrators may use.
+	void updateVoxelLod();
+
+	// Decide how many samples per pixel to render in the current frame so
+	// that it fits within the frame time budget.
+	int scheduleFrameSamples(float pixelFraction) const;
+	// Decide how many tiles of the pass to render in the current frame, or 0
+	// if a whole pass fits within the frame time budget (see
+	// RenderSettings::m_tileSize).
+	int scheduleFrameTiles(float pixelFraction) const;
+	// Split a pass over the image into tiles, in the order they're to be
+	// rendered.
+	void buildTiles(const Imath::V2i& resolution);
+	// frame time budget for the current frame
+	float frameBudgetMs() const;
+	// Whether the render has been reset within the last few frames; e.g. the
+	// user is moving the camera around.
+	bool isInteractive() const;
+	// Choose the resolution scale at which to render while interacting.
+	float chooseResolutionScale() const;
+
+	// Create a pixel pack buffer of the given size to read data back into,
+	// and leave it bound.
+	GLuint createReadbackBuffer(GLsizeiptr size);
+	// Write a file from the data being copied into the given pixel pack
+	// buffer (see PendingReadback), once the commands issuing the copy have
+	// been sent.
+	void queueReadback(const std::string& file,
+					   const std::string& description,
+					   GLuint pbo,
+					   GLsizeiptr size,
+					   const boost::function<bool (const float*)>& write);
+	// Hand the readbacks whose data has arrived over to their writer thread,
+	// and release the resources of those already written.
+	void updatePendingReadbacks();
+
+	// Move on with the tiled image being rendered: start rendering its next
+	// region, or close the file once all of them have been written.
+	void updateTiledImage();
+	// Read back the region of the tiled image just rendered, to be written.
+	void saveTiledImageRegion();
+
+	// Hash identifying the current scene: the voxel data and materials.
+	boost::uint64_t sceneHash() const;
+	// File the checkpoints of the current scene are written to.
+	std::string checkpointFile() const;
+	// Save the current render state, asynchronously.
+	void writeCheckpoint();
+	// Apply the checkpoint being resumed (m_pendingResume): its camera and
+	// settings, and then its samples once its background image is loaded.
+	void restoreCheckpoint();
+	// Remove the checkpoint of the current render, which is finished, once
+	// it's no longer being written.
+	void removeCheckpoint();
+
+	// Whether adaptive sampling applies to the samples being rendered.
+	bool isAdaptiveSamplingActive() const;
+	// Update the convergence mask from the samples accumulated so far. The
+	// number of tiles yet to converge is read back over the next frames.
+	void testConvergence();
+	// Collect the number of unconverged tiles of the last test, if it has
+	// arrived.
+	void updateConvergenceReadback();
+	// Forget about the test being read back, if any.
+	void discardConvergenceReadback();
 
 private:
 	// Whether the renderer is initialised yet. No action can be performed till
@@ -171,19 +349,77 @@ private:
 	// between the texture (voxels in 0-1 local space) and world space.
 	Imath::Box3f m_volumeBounds;
 
-	int m_activeSampleTexture;
+	// Whether the coarse levels of the voxel mip chain are out of sync with
+	// the full resolution voxel data. Rays are limited to the finest level
+	// while this is the case.
+	bool m_voxelMipmapsDirty;
+	// Whether the user is in the middle of an edit stroke (see
+	// Action::PA_END_EDIT). The mip chain is only rebuilt once it's over.
+	bool m_voxelEditInProgress;
+
+	// Lights in the voxel data.
+	std::vector<EmissiveVoxel> m_emissiveVoxels;
+
 	int m_numberSamples;
+	// Tiles of the pass being rendered in tiles, in the order they're
+	// rendered (see RenderSettings::m_tileSize), and the next one to render.
+	// The pass is already counted in m_numberSamples while it's under way, so
+	// tiles before m_nextTile have m_numberSamples samples, and the rest one
+	// less. m_nextTile is 0 when no pass is under way.
+	std::vector<Imath::Box2i> m_tiles;
+	size_t m_nextTile;
+	// Number of frames rendered since the accumulation was last reset.
+	int m_framesSinceReset;
+
+	// Whether the samples are currently being rendered into the reduced
+	// resolution preview accumulation buffer.
+	bool m_renderingPreview;
+	// Resolution of the area of the preview accumulation buffer in use.
+	Imath::V2i m_previewResolution;
+	// Number of samples in the preview accumulation buffer, once the render
+	// has moved on to full resolution. The preview is blended in until the
+	// full resolution image catches up.
+	int m_previewNumberSamples;
+
+	// Whether the convergence mask holds the result of a test for the
+	// current accumulation.
+	bool m_convergenceMaskValid;
+	// Signaled once the number of unconverged tiles from the last test has
+	// been copied into m_glResources.m_unconvergedTilesReadback, or 0 if
+	// there's no test waiting to be read back.
+	GLsync m_convergenceFence;
+	// Number of tiles which had not converged at the last test, or -1 if
+	// unknown.
+	int m_unconvergedTiles;
 
 	Camera m_camera;
 
 	IntegratorShaderSettings        m_settingsIntegrator[INTEGRATOR_TOTAL];
-	AccumulationShaderSettings      m_settingsAverage;
+	// Integrator programs are built on first use (see isIntegratorReady), and
+	// those being built are kept in m_integratorBuilds meanwhile.
+	enum ProgramState
+	{
+		PROGRAM_UNLOADED,
+		PROGRAM_BUILDING,
+		PROGRAM_READY,
+		PROGRAM_FAILED,
+	};
+	ProgramState                    m_integratorState[INTEGRATOR_TOTAL];
+	std::vector<ShaderProgramBuild> m_integratorBuilds[INTEGRATOR_TOTAL];
+	WavefrontShaderSettings         m_settingsWavefront;
 	TexturedShaderSettings          m_settingsTextured;
+	ConvergenceShaderSettings       m_settingsConvergence;
+	VoxelMipmapShaderSettings       m_settingsVoxelMipmap;
 
 	// All resources declared in OpenGL. This struct is also used to communicate
 	// shaders via textures and SSBO
 	GLResourceConfiguration m_glResources;
 
+	// Uniforms shared by all the programs, only uploaded when they change.
+	UniformBuffer<CameraUniforms>   m_cameraUniforms;
+	UniformBuffer<VolumeUniforms>   m_volumeUniforms;
+	UniformBuffer<SettingsUniforms> m_settingsUniforms;
+
 	// Current render settings
 	RenderSettings m_renderSettings;
 
@@ -191,20 +427,94 @@ private:
 	std::string m_shaderPath;
 
 	AveragedGpuTimer m_frameTimer;
+	// GPU time of the integrator passes, per full resolution sample rendered.
+	AveragedGpuTimer m_sampleTimer;
 
 	std::string m_status;
 
+	// A file being written from data read back from the GPU, such as a saved
+	// image or a checkpoint. The data is first copied into a pixel pack
+	// buffer, and then written by a worker thread straight from the mapped
+	// buffer, so neither the GPU nor the UI stall.
+	struct PendingReadback
+	{
+		std::string file;
+		// what is being written, for logging (e.g. "image")
+		std::string description;
+		GLuint pbo;
+		GLsizeiptr size;
+		// signaled once the data is in the buffer
+		GLsync fence;
+		// writes the file from the mapped buffer
+		boost::function<bool (const float*)> write;
+		// worker thread running write, started once the fence is signaled
+		AsyncTask* task;
+	};
+	std::vector<PendingReadback> m_pendingReadbacks;
+
+	// An image being rendered region by region (see renderTiledImage). The
+	// frame is one of its regions at a time, so the render buffers are sized
+	// to match.
+	struct TiledImage
+	{
+		std::string file;
+		TiledImageWriter* writer;
+		Imath::V2i resolution;
+		// regions of the image in the order they're rendered, with their
+		// origin at the bottom-left corner like the frame's, and the one
+		// being rendered (or the next one to be, if it's yet to start).
+		std::vector<Imath::Box2i> regions;
+		size_t currentRegion;
+		bool regionStarted;
+		// frame resolution to go back to once the image is finished
+		Imath::V2i frameResolution;
+	};
+	// NULL unless a tiled image is being rendered
+	TiledImage* m_tiledImage;
+
+	// Hash of the voxel data as loaded, or as last edited. The materials are
+	// hashed separately (see sceneHash), as they're edited through the UI.
+	boost::uint64_t m_sceneVoxelsHash;
+	// Whether the voxels were edited since m_sceneVoxelsHash was computed.
+	// Hashing them takes a readback of the whole volume, so it waits until a
+	// checkpoint is written or resumed (see hashEditedVoxels).
+	bool m_sceneVoxelsEdited;
+	// Copy of the material data, kept in sync with the GPU.
+	std::vector<float> m_materialData;
+	// When the last checkpoint was written (or the render was reset), and
+	// how many samples it had.
+	time_t m_lastCheckpointTime;
+	int m_checkpointNumberSamples;
+	// Checkpoint written (or resumed) for the current render, if any.
+	std::string m_checkpointWritten;
+
+	// A checkpoint waiting for its background image to load before it's
+	// resumed. Samples aren't rendered meanwhile, as they would be thrown
+	// away.
+	struct PendingResume
+	{
+		std::string file;
+		Checkpoint checkpoint;
+		std::vector<float> pixels;
+	};
+	// NULL unless a checkpoint is being resumed
+	PendingResume* m_pendingResume;
+
 	// Actions which are pending to run since the last frame
 	std::vector<Action> m_scheduledActions;
 
 	Integrator m_currentIntegrator;
 	// Current background image path, if any. This is used to avoid loading
-	// and processing textures (which is expensive) if they're already loaded
+	// and processing textures (which is expensive) if they're already loaded.
+	// It differs from the one in the render settings while the new image is
+	// being loaded.
 	std::string m_currentBackgroundImage;
 	// Cached background image radiance integral. Used to calculate the PDF of
 	// each environment sample. This integral is computed when the texture is
 	// loaded.
 	float		m_currentBackgroundRadianceIntegral;
+	// Loads background images in a worker thread.
+	EnvironmentMapLoader m_environmentMapLoader;
 
 	// Logger (potentially NULL) where error messages -mostly shader
 	// compilation- are redirected. This will be implemented in a derived class
@@ -218,4 +528,7 @@ private:
 	// etc. Services are implemented as standalone chunks of functionality which
 	// communicate and share resources with the renderer.
 	RendererService* m_services[SERVICE_TOTAL];	
+	// Whether each service has been loaded (see service). Only those loaded
+	// are told about changes to the renderer's resources.
+	bool m_serviceLoaded[SERVICE_TOTAL];
 };
@@ -5,6 +5,7 @@
 RendererService::~RendererService()
 {
 	glDeleteProgram(m_program);
+	if (glIsVertexArray(m_vao)) glDeleteVertexArrays(1, &m_vao);
 }
 
 void RendererService::runVertexShader() 
@@ -12,10 +13,12 @@ void RendererService::runVertexShader()
 	// disable rasterization and issue a single vertex draw call. This is used
 	// with vertex shaders performing computations which are not meant to be
 	// drawn directly.
+	if (m_vao == 0) glGenVertexArrays(1, &m_vao);
+
 	glEnable(GL_RASTERIZER_DISCARD);
-	glBegin(GL_POINTS);
-		glVertex3f(0,0,0);
-	glEnd();
+	glBindVertexArray(m_vao);
+	glDrawArrays(GL_POINTS, 0, 1);
+	glBindVertexArray(0);
 	glDisable(GL_RASTERIZER_DISCARD);
 }
 
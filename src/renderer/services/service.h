@@ -13,6 +13,7 @@ struct GLResourceConfiguration;
 class RendererService
 {
 public:
+	RendererService() : m_program(0), m_vao(0) {}
 	virtual ~RendererService();
 
 	virtual bool reload(const std::string& shaderPath, Logger* logger) = 0;
@@ -58,6 +59,10 @@ protected:
 	// shader program
 	GLuint m_program;
 
+	// vertex array with no attributes, used by runVertexShader. Core profile
+	// contexts won't draw without one bound.
+	GLuint m_vao;
+
 	// Normalized coordinates in screen space from where the requested picking
 	// action is originated (the actual pixel coordinates are calculated as
 	// m_pickingActionPoint * viewportSize;
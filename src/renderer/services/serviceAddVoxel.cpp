@@ -23,7 +23,6 @@ bool RendererServiceAddVoxel::reload(const std::string& shaderPath, Logger* logg
     
 	glUseProgram(m_program);
 
-	m_uniformCameraInverseModelView  = glGetUniformLocation(m_program, "cameraInverseModelView");
 	m_uniformScreenSpaceMotion       = glGetUniformLocation(m_program, "screenSpaceMotion");
 	m_uniformMaterialOffsetTexture   = glGetUniformLocation(m_program, "materialOffsetTexture");
 	m_uniformMaterialDataTexture     = glGetUniformLocation(m_program, "materialDataTexture");
@@ -48,23 +47,6 @@ void RendererServiceAddVoxel::glResourcesCreated(const GLResourceConfiguration&
 	glUseProgram(0);
 }
 
-
-void RendererServiceAddVoxel::cameraUpdated(const Imath::M44f& /*modelViewMatrix*/,
-										    const Imath::M44f& modelViewInverse,
-										    const Imath::M44f& /*projectionMatrix*/,
-										    const Imath::M44f& /*projectionInverse*/,
-										    const Camera& /*camera*/)
-{
-    glUseProgram(m_program);
-
-    glUniformMatrix4fv(m_uniformCameraInverseModelView,
-                       1,
-                       GL_TRUE,
-                       &modelViewInverse.x[0][0]);
-	
-    glUseProgram(0);
-}
-
 void RendererServiceAddVoxel::execute()
 {
     glUseProgram(m_program);
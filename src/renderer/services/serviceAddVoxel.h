@@ -12,17 +12,10 @@ public:
 
 	virtual void glResourcesCreated(const GLResourceConfiguration& glResources);
 
-	virtual void cameraUpdated(const Imath::M44f& /*modelViewMatrix*/,
-							   const Imath::M44f& /*modelViewInverse*/,
-							   const Imath::M44f& /*projectionMatrix*/,
-							   const Imath::M44f& /*projectionInverse*/,
-							   const Camera& /*camera*/);
-
 	virtual void execute();
 
 private:
 	// uniforms
-	GLuint m_uniformCameraInverseModelView;
 	GLuint m_uniformScreenSpaceMotion;
 	GLuint m_uniformMaterialOffsetTexture;
 	GLuint m_uniformMaterialDataTexture;
@@ -5,7 +5,6 @@
 #include "renderer/renderer.h"
 #include "log/logger.h"
 #include "shaders/shader.h"
-#include "camera/camera.h"
 
 bool RendererServicePicking::reloadShader(const std::string& shaderPath, 
 						  const std::string& shaderName,
@@ -29,16 +28,7 @@ bool RendererServicePicking::reloadShader(const std::string& shaderPath,
 	glUseProgram(m_program);
 
 	m_uniformMaterialOffsetTexture  = glGetUniformLocation(m_program, "materialOffsetTexture");
-	m_uniformVoxelDataResolution    = glGetUniformLocation(m_program, "voxelResolution");
-	m_uniformVolumeBoundsMin        = glGetUniformLocation(m_program, "volumeBoundsMin");
-	m_uniformVolumeBoundsMax        = glGetUniformLocation(m_program, "volumeBoundsMax");
 	m_uniformViewport               = glGetUniformLocation(m_program, "viewport");
-	m_uniformCameraNear             = glGetUniformLocation(m_program, "cameraNear");
-	m_uniformCameraFar              = glGetUniformLocation(m_program, "cameraFar");
-	m_uniformCameraProj             = glGetUniformLocation(m_program, "cameraProj");
-	m_uniformCameraInverseProj      = glGetUniformLocation(m_program, "cameraInverseProj");
-	m_uniformCameraInverseModelView = glGetUniformLocation(m_program, "cameraInverseModelView");
-	m_uniformCameraFocalLength      = glGetUniformLocation(m_program, "cameraFocalLength");             
 	m_uniformSampledFragment        = glGetUniformLocation(m_program, "sampledFragment");             
 
 	glUniform1i(m_uniformMaterialOffsetTexture, GLResourceConfiguration::TEXTURE_UNIT_MATERIAL_OFFSET);
@@ -48,37 +38,6 @@ bool RendererServicePicking::reloadShader(const std::string& shaderPath,
 	return true;
 }
 
-void RendererServicePicking::cameraUpdated(const Imath::M44f& /*modelViewMatrix*/,
-										   const Imath::M44f& modelViewInverse,
-										   const Imath::M44f& projectionMatrix,
-										   const Imath::M44f& projectionInverse,
-										   const Camera& camera)
-{
-    glUseProgram(m_program);
-
-    glUniform1f(m_uniformCameraNear, camera.parameters().nearDistance());
-	glUniform1f(m_uniformCameraFar, camera.parameters().farDistance());
-
-    glUniformMatrix4fv(m_uniformCameraInverseModelView,
-                       1,
-                       GL_TRUE,
-                       &modelViewInverse.x[0][0]);
-
-    glUniformMatrix4fv(m_uniformCameraProj,
-					   1,
-                       GL_TRUE,
-					   &projectionMatrix.x[0][0]);
-
-    glUniformMatrix4fv(m_uniformCameraInverseProj,
-					   1,
-                       GL_TRUE,
-					   &projectionInverse.x[0][0]);
-	
-	glUniform1f(m_uniformCameraFocalLength, camera.parameters().focalLength());
-
-    glUseProgram(0);
-}
-
 void RendererServicePicking::frameResized(int viewport[4])
 {
     glUseProgram(m_program);
@@ -92,29 +51,6 @@ void RendererServicePicking::frameResized(int viewport[4])
     glUseProgram(0);
 }
 
-void RendererServicePicking::volumeReloaded(const Imath::V3i& volumeResolution,
-											const Imath::Box3f& volumeBounds)
-{
-    glUseProgram(m_program);
-
-	glUniform3i(m_uniformVoxelDataResolution, 
-				volumeResolution.x, 
-				volumeResolution.y, 
-				volumeResolution.z);
-
-	glUniform3f(m_uniformVolumeBoundsMin,
-				volumeBounds.min.x,
-				volumeBounds.min.y,
-				volumeBounds.min.z);
-
-	glUniform3f(m_uniformVolumeBoundsMax,
-				volumeBounds.max.x,
-				volumeBounds.max.y,
-				volumeBounds.max.z);
-
-    glUseProgram(0);
-}
-
 void RendererServicePicking::execute()
 {
     glUseProgram(m_program);
@@ -0,0 +1,20 @@
+#include <GL/glew.h>
+
+#include "renderer/uniformBuffer.h"
+
+void UniformBufferObject::createBuffer(GLuint bindingPoint, size_t size)
+{
+	if (glIsBuffer(m_buffer)) glDeleteBuffers(1, &m_buffer);
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, m_buffer);
+}
+
+void UniformBufferObject::uploadBuffer(const void* data, size_t size)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <GL/gl.h>
+
+#include <cstddef>
+#include <memory.h>
+
+// The GL side of UniformBuffer, which doesn't depend on the type it holds.
+// It's implemented in uniformBuffer.cpp, as the buffer functions need GLEW,
+// which must be included before any other GL header.
+class UniformBufferObject
+{
+protected:
+	UniformBufferObject() : m_buffer(0) {}
+
+	void createBuffer(GLuint bindingPoint, size_t size);
+	void uploadBuffer(const void* data, size_t size);
+
+	GLuint m_buffer;
+};
+
+// A Uniform Buffer Object holding a struct of type T (see
+// shaders/uniformBlocks/uniformBlocksHost.h), bound to a binding point shared
+// by all the programs. Changes are made to a copy of its contents, which is
+// only uploaded when it differs from what the buffer holds.
+template <typename T>
+class UniformBuffer : private UniformBufferObject
+{
+public:
+	UniformBuffer() :
+		m_uploaded(false)
+	{
+		// so the padding compares equal
+		memset(&m_data, 0, sizeof(T));
+		memset(&m_uploadedData, 0, sizeof(T));
+	}
+
+	// Create the buffer and bind it. Its contents are uploaded on the next
+	// update.
+	void create(GLuint bindingPoint)
+	{
+		createBuffer(bindingPoint, sizeof(T));
+		m_uploaded = false;
+	}
+
+	T& data() { return m_data; }
+
+	// Upload the contents if they changed. Returns whether they did.
+	bool update()
+	{
+		if (m_uploaded && memcmp(&m_data, &m_uploadedData, sizeof(T)) == 0) return false;
+
+		uploadBuffer(&m_data, sizeof(T));
+		memcpy(&m_uploadedData, &m_data, sizeof(T));
+		m_uploaded = true;
+		return true;
+	}
+
+private:
+	T m_data;
+	// what the buffer holds, if m_uploaded
+	T m_uploadedData;
+	bool m_uploaded;
+};
@@ -0,0 +1,54 @@
+#version 430
+
+// Build the per-tile convergence mask used by the integrators to skip those
+// areas of the image which need no further samples. Each work group processes
+// a tile, which is flagged as converged once the standard error of the mean
+// luminance of all its pixels, relative to the mean itself, falls below the
+// threshold.
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+uniform sampler2D   accumulationTexture; // sum of samples (rgb), count (alpha)
+uniform sampler2D   momentsTexture;      // sum of squared sample luminances
+uniform ivec2       imageResolution;
+uniform int         minSamples;
+uniform float       errorThreshold;
+
+layout(r8ui, binding = 2) uniform writeonly uimage2D convergenceMask;
+layout(binding = 0, offset = 0) uniform atomic_uint unconvergedTiles;
+
+shared uint tileUnconverged;
+
+#include <shared/color.h>
+
+void main()
+{
+	if (gl_LocalInvocationIndex == 0) tileUnconverged = 0;
+	barrier();
+
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	if (all(lessThan(pixel, imageResolution)))
+	{
+		vec4 sum = texelFetch(accumulationTexture, pixel, 0);
+		float luminanceSquaredSum = texelFetch(momentsTexture, pixel, 0).r;
+
+		float n = sum.a;
+		float mean = luminance(sum.rgb) / max(n, 1.0);
+		float variance = max(0.0, luminanceSquaredSum / max(n, 1.0) - mean * mean);
+		// offset the mean so that dark pixels aren't required to reach an
+		// (imperceptible) tiny absolute error
+		float relativeError = sqrt(variance / max(n, 1.0)) / (mean + 0.01);
+
+		if (n < float(minSamples) || relativeError > errorThreshold)
+		{
+			atomicOr(tileUnconverged, 1u);
+		}
+	}
+
+	barrier();
+	if (gl_LocalInvocationIndex == 0)
+	{
+		imageStore(convergenceMask, ivec2(gl_WorkGroupID.xy), uvec4(tileUnconverged == 0u ? 1u : 0u));
+		if (tileUnconverged != 0u) atomicCounterIncrement(unconvergedTiles);
+	}
+}
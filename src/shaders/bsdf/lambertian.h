@@ -9,10 +9,10 @@
 // directions.
 vec3 sampleBSDF_Lambertian(in vec3 albedo, 
 						   in vec3 lsWo, 
-						   inout ivec2 rngOffset, 
+						   inout RandomState rng, 
 						   out vec4 f_pdf)
 {
-	vec4 lsWi_pdf = cosineSampledHemisphere(rand(rngOffset).xy);
+	vec4 lsWi_pdf = cosineSampledHemisphere(rand(rng).xy);
 	f_pdf.xyz = albedo / PI; // f 
 	f_pdf.w = lsWi_pdf.w; // pdf <-- this already includes the division by PI to express the PDF in terms of solid angle
 	return lsWi_pdf.xyz; 
@@ -102,10 +102,10 @@ vec4 evaluateBSDF_Microfacet(in vec3 reflectance,
 vec3 sampleBSDF_Microfacet(in vec3 reflectance,
 						   in float exponent,
 						   in vec3 lsWo,
-						   inout ivec2 rngOffset,
+						   inout RandomState rng,
 						   out vec4 f_pdf)
 {
-	vec2 uniformRandomSample = rand(rngOffset).xy;
+	vec2 uniformRandomSample = rand(rng).xy;
 	vec3 lsWi = sampleD(reflectance, exponent, lsWo, uniformRandomSample, f_pdf);
 
 	float cosThetaWi = lsWi.y; // angle between normal and Wi
@@ -1,9 +1,9 @@
 #version 430
 
 #include <editVoxels/selectVoxelDevice.h>
+#include <uniformBlocks/uniformBlocksDevice.h>
 
 uniform vec4		newVoxelColor = vec4(0,0,1,0);
-uniform mat4        cameraInverseModelView;
 uniform vec2		screenSpaceMotion;
 
 uniform vec3        groundColor = vec3(0.5, 0.5, 0.5);
@@ -12,7 +12,6 @@ uniform vec3        groundColor = vec3(0.5, 0.5, 0.5);
 layout(r8ui, binding = 0) uniform uimage3D voxelOccupancy;
 layout(rgba8, binding = 1) uniform image3D voxelColor;
 
-
 void main()
 {
 	vec3 cameraRight = (cameraInverseModelView * vec4(1,0,0,0)).xyz;
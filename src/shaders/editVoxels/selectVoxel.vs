@@ -1,24 +1,11 @@
 #version 430
 
 #include <editVoxels/selectVoxelDevice.h>
+#include <uniformBlocks/uniformBlocksDevice.h>
 
 uniform isampler3D  materialOffsetTexture;
-uniform sampler2D   noiseTexture;
-uniform ivec3       voxelResolution;
-uniform vec3        volumeBoundsMin;
-uniform vec3        volumeBoundsMax;
-uniform vec3        wsVoxelSize; // (boundsMax-boundsMin)/resolution
 
 uniform vec4        viewport;
-uniform float       cameraNear;
-uniform float       cameraFar;
-uniform mat4        cameraProj;
-uniform mat4        cameraInverseProj;
-uniform mat4        cameraInverseModelView;
-uniform float       cameraFocalLength;
-uniform float       cameraLensRadius;
-uniform vec2        cameraFilmSize;
-uniform int         cameraLensModel;
 
 uniform vec2        sampledFragment;
 
@@ -35,10 +22,10 @@ uniform vec2        sampledFragment;
 
 void main()
 {
-	ivec2 rngOffset = ivec2(0,0); 
+	RandomState rng = initRandomState(ivec2(0), 0);
 	vec3 wsRayOrigin;
 	vec3 wsRayDir;
-	generateRay(vec3(sampledFragment, cameraNear), rngOffset, wsRayOrigin, wsRayDir);
+	generateRay(vec3(sampledFragment, cameraNear), rng, wsRayOrigin, wsRayDir);
 	
 	// test intersection with bounds to trivially discard rays before entering
 	// traversal.
@@ -1,125 +1,64 @@
 // forward declarations
-int binarySearchCDFV( int indexHigh, float randomSample );
-int binarySearchCDFU( int row, int indexHigh, float randomSample );
+int resolveAlias( uint entry, int index, inout float randomSample );
 
 // To sample the environment texture we start with a pair of uniform random
-// variables and find the row/column indices corresponding to the low end of the
-// "bracket" containing the value of the random sample. PBRT does this by using 
-// std::lower_bound, but on the GPU we'll turn it into a binary search as we 
-// know the CDF arrays are sorted. 
+// variables, and use them to pick a row and then a column within that row
+// through their alias tables (see calculateAliasTables in image.cpp). Each
+// choice takes constant time: the random sample selects an entry of the table
+// uniformly, then we either keep the entry's own index or jump to its alias.
 // For instance:
 //
-// Uniform random value: 0.7
+// Uniform random value: 0.7, table of 4 entries
 //
-// CDF [0, 0.1, 0.5, 0.6, 0.75, 0.9, 1]
-//                    |     |
-//                  low     high
-//                    |
-//                    returned: 3
+//          entry:   0     1     2     3
+//    probability:  1.0   0.4   0.6   0.2
+//          alias:   -     0     0     2
+//                              |
+//               0.7 * 4 = 2.8 -> entry 2, with 0.8 left over. 0.8 >= 0.6, so
+//               we return its alias: 0
 //
-// The CDF "bucket size" are proportional to the pixel intensity, thus this 
-// method will sample higher intensities more often.
+// Entries are picked proportionally to the pixel intensity, thus this method
+// will sample higher intensities more often.
 
 vec2 sampleEnvironmentTexture( vec2 uniformRandomSample )
 {
-	const float sampleU = uniformRandomSample.x;
-	const float sampleV = uniformRandomSample.y;
-	const int sizeU = textureSize(backgroundCDFUTexture, 0).x;
-	const int sizeV = textureSize(backgroundCDFVTexture, 0);
+	const ivec2 size = textureSize(backgroundAliasUTexture, 0);
 
-	// Index on the last entry containing 1.0f. Can never be reached with the 
-	// sample in the range [0.0f, 1.0f).	
-	int indexHigh = sizeV - 1 ; 
+	// Pick the ROW from the marginal distribution.
+	float sampleV = uniformRandomSample.y * float(size.y);
+	int row = min(int(sampleV), size.y - 1);
+	sampleV -= float(row);
+	row = resolveAlias(texelFetch(backgroundAliasVTexture, row, 0).r, row, sampleV);
 
-	// Binary search the ROW index to look up.
-	int i = 0;
-	int row = binarySearchCDFV(indexHigh, sampleV);
+	// Pick the COLUMN from the chosen row's distribution.
+	float sampleU = uniformRandomSample.x * float(size.x);
+	int column = min(int(sampleU), size.x - 1);
+	sampleU -= float(column);
+	column = resolveAlias(texelFetch(backgroundAliasUTexture, ivec2(column, row), 0).r, column, sampleU);
 
-	ivec2 index; // Resulting 2D index we'll use to fetch texels
-	index.y = row; // This is the row we found.
-		
-	// Index on the last entry containing 1.0f. Can never be reached with the 
-	// sample in the range [0.0f, 1.0f).
-	indexHigh = sizeU - 1; 
-
-	// Binary search the COLUMN index to look up.
-	int column = binarySearchCDFU(row, indexHigh, sampleU);
-	index.x = column; // The column result.
-
-	// The previous searches have given us the lower bound of the 'brackets' on
-	// both CDF U and V, we now get the other end of the bracket and perform the 
-	// continuous sampling of the CDF to get the final u and v coordinates.
-	const float cdfLowerU = texelFetch(backgroundCDFUTexture, index, 0).r;
-	const float cdfUpperU = texelFetch(backgroundCDFUTexture, ivec2(index.x + 1, index.y), 0).r;
-	const float du = (sampleU - cdfLowerU) / (cdfUpperU - cdfLowerU);
-
-	const float cdfLowerV = texelFetch(backgroundCDFVTexture, index.y, 0).r;
-	const float cdfUpperV = texelFetch(backgroundCDFVTexture, index.y + 1, 0).r;
-	const float dv = (sampleV - cdfLowerV) / (cdfUpperV - cdfLowerV);
-
-	// Texture lookup coordinate.
-	const float u = (float(index.x) + du) / float(sizeU - 1);
-	const float v = (float(index.y) + dv) / float(sizeV - 1);
+	// The leftover of each random sample is uniformly distributed within the
+	// chosen texel, which gives us the continuous u and v coordinates.
+	const float u = (float(column) + sampleU) / float(size.x);
+	const float v = (float(row) + sampleV) / float(size.y);
 
 	return vec2(u,v);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-// Binary search the ROW corresponding to the given random sample
-int binarySearchCDFV( int indexHigh, float randomSample )
+// Choose between the given alias table entry's own index and its alias. The
+// entry packs the probability of keeping its index (16 bit fixed point) and
+// the alias (16 bits). The random sample is remapped to [0,1) again, so it can
+// be reused to jitter the sample within the chosen texel.
+int resolveAlias( uint entry, int index, inout float randomSample )
 {
-	int indexLow = 0; 
-	
-	// When a pair of limits have been found the lower index indicates the cell 
-	// to use.
-	while (indexLow != indexHigh - 1) 
+	const float probability = float(entry >> 16u) / 65535.0;
+	if (randomSample < probability)
 	{
-		int row = (indexLow + indexHigh) / 2;
-		const float cdf = texelFetch(backgroundCDFVTexture, row, 0).r;
-		if (randomSample < cdf) 
-		{
-			// If the cdf is greater than the sample, use that as new higher limit.
-			indexHigh = row;
-		}
-		else 
-		{
-			// If the sample is greater than or equal to the CDF value, use 
-			// that as new lower limit.
-			indexLow = row; 
-		}
+		randomSample = min(randomSample / probability, 0.99999994);
+		return index;
 	}
-
-	return indexLow;
+	randomSample = min((randomSample - probability) / (1.0 - probability), 0.99999994);
+	return int(entry & 0xffffu);
 }
 
-// Binary search the COLUMN corresponding to the given random sample, and a
-// pre-selected row (which we chose from CDF V)
-int binarySearchCDFU( int row, int indexHigh, float randomSample )
-{
-	int indexLow = 0; 
-
-	// When a pair of limits have been found the lower index indicates the cell 
-	// to use.
-	while (indexLow != indexHigh - 1) 
-	{
-		int column = (indexLow + indexHigh) / 2;
-		ivec2 uv = ivec2(column, row);
-		const float cdf = texelFetch(backgroundCDFUTexture, uv, 0).r;
-		if (randomSample < cdf) 
-		{
-			// If the cdf is greater than the sample, use that as new higher limit.
-			indexHigh = column;
-		}
-		else 
-		{
-			// If the sample is greater than or equal to the CDF value, use 
-			// that as new lower limit.
-			indexLow = column; 
-		}
-	}
-
-	return indexLow;
-}
-
-
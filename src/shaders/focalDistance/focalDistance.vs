@@ -1,29 +1,14 @@
 #version 430
 
 #include <focalDistance/focalDistanceDevice.h>
+#include <uniformBlocks/uniformBlocksDevice.h>
 
 uniform isampler3D  materialOffsetTexture;
-uniform sampler2D   noiseTexture;
-uniform ivec3       voxelResolution;
-uniform vec3        volumeBoundsMin;
-uniform vec3        volumeBoundsMax;
-uniform vec3        wsVoxelSize; // (boundsMax-boundsMin)/resolution
 
 uniform vec4        viewport;
-uniform float       cameraNear;
-uniform float       cameraFar;
-uniform mat4        cameraProj;
-uniform mat4        cameraInverseProj;
-uniform mat4        cameraInverseModelView;
-uniform float       cameraFocalLength;
-uniform float       cameraLensRadius;
-uniform vec2        cameraFilmSize;
-uniform int         cameraLensModel;
 
-uniform sampler2D   backgroundCDFUTexture;
-uniform sampler1D   backgroundCDFVTexture;
-uniform float	    backgroundIntegral;
-uniform float	    backgroundRotationRadians;
+uniform usampler2D  backgroundAliasUTexture;
+uniform usampler1D  backgroundAliasVTexture;
 
 uniform vec2        sampledFragment;
 uniform int         sampleCount;
@@ -44,11 +29,11 @@ const float Infinity = 99999999.0;
 
 void main()
 {
-	ivec2 rngOffset = ivec2(0,0);
+	RandomState rng = initRandomState(ivec2(0), 0);
 
 	vec3 wsRayOrigin;
 	vec3 wsRayDir;
-	generateRay(vec3(sampledFragment, 0), rngOffset, wsRayOrigin, wsRayDir);
+	generateRay(vec3(sampledFragment, 0), rng, wsRayOrigin, wsRayDir);
 	
 	// test intersection with bounds to trivially discard rays before entering
 	// traversal.
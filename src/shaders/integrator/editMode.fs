@@ -2,45 +2,25 @@
 
 #include <focalDistance/focalDistanceDevice.h>
 #include <editVoxels/selectVoxelDevice.h>
+#include <uniformBlocks/uniformBlocksDevice.h>
 
 uniform isampler3D  materialOffsetTexture;
 uniform sampler1D   materialDataTexture;
-uniform sampler2D   noiseTexture;
-uniform ivec3       voxelResolution;
-uniform vec3        volumeBoundsMin;
-uniform vec3        volumeBoundsMax;
-uniform vec3        wsVoxelSize; // (boundsMax-boundsMin)/resolution
 
 uniform vec4        viewport;
-uniform float       cameraNear;
-uniform float       cameraFar;
-uniform mat4        cameraProj;
-uniform mat4        cameraInverseProj;
-uniform mat4        cameraInverseModelView;
-uniform float       cameraFocalLength;
-uniform float       cameraLensRadius;
-uniform vec2        cameraFilmSize;
-uniform int         cameraLensModel;
-
-uniform vec3        backgroundColorTop = vec3(153.0 / 255, 187.0 / 255, 201.0 / 255) * 2;
-uniform vec3        backgroundColorBottom = vec3(77.0 / 255, 64.0 / 255, 50.0 / 255);
+
 uniform vec3        groundColor = vec3(0.5, 0.5, 0.5);
-uniform int         backgroundUseImage;
 uniform sampler2D   backgroundTexture;
-uniform sampler2D   backgroundCDFUTexture;
-uniform sampler1D   backgroundCDFVTexture;
-uniform float	    backgroundIntegral;
-uniform float	    backgroundRotationRadians;
+uniform usampler2D  backgroundAliasUTexture;
+uniform usampler1D  backgroundAliasVTexture;
 
 uniform int         sampleCount;
-uniform int			pathtracerMaxNumBounces;
-
-uniform float		wireframeOpacity = 0;
-uniform float		wireframeThickness = 0.01;
+uniform int         samplesPerPass = 1;
 
 uniform vec3		lightDirection = vec3(1, -1, -1);
 uniform float		ambientLight = 0.5;
-out vec4 outColor;
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec4 outMoments; // used for adaptive sampling
 
 #include <shared/constants.h>
 #include <shared/aabb.h>
@@ -57,15 +37,13 @@ out vec4 outColor;
 #include <materials/plastic.h>
 #include <materials/materials.h>
 #include <shared/lights.h>
+#include <shared/adaptiveSampling.h>
 
-
-void main()
+vec3 samplePixel(inout RandomState rng)
 {
-	ivec2 rngOffset = randomNumberGeneratorOffset(ivec4(gl_FragCoord), sampleCount);
-
 	vec3 wsRayOrigin;
 	vec3 wsRayDir;
-	generateRay(gl_FragCoord.xyz, rngOffset, wsRayOrigin, wsRayDir);
+	generateRay(gl_FragCoord.xyz, rng, wsRayOrigin, wsRayDir);
 
 	// test intersection with bounds to trivially discard rays before entering
 	// traversal.
@@ -76,8 +54,7 @@ void main()
 	if (aabbIsectDist < 0)
 	{
 		// we're not even hitting the volume's bounding box. Early out.
-		outColor = vec4(getBackgroundColor(wsRayDir),1);
-		return;
+		return getBackgroundColor(wsRayDir);
 	}
 
 	vec3 wsRayEntryPoint = wsRayOrigin + aabbIsectDist * wsRayDir;
@@ -86,8 +63,7 @@ void main()
 	// Cast primary ray
 	if ( !traverse(wsRayEntryPoint, wsRayDir, vsHitPos, hitGround) )
 	{
-		outColor = vec4(getBackgroundColor(wsRayDir),1);
-		return;
+		return getBackgroundColor(wsRayDir);
 	}
 
 	// convert hit position from voxel space to world space. We also use the
@@ -107,8 +83,7 @@ void main()
 	if ( ivec3(vsHitPos) == SelectVoxelData.index.xyz )
 	{
 		// Draw selected voxel as red
-		outColor = vec4(1,0,0,1);
-		return;
+		return vec3(1,0,0);
 	}
 
 	// Wireframe overlay
@@ -125,20 +100,34 @@ void main()
 		albedo *= vec3(wireframe);
 	}
 
-
 	// dot normal lighting
 	float lighting = max(0, dot(-wsRayDir, wsHitBasis.normal));
 	lighting = sqrt(lighting);
 
 	// trace shadow ray
-	if ( traverse(wsHitBasis.position, -lightDirection, vsHitPos, hitGround) )
+	if ( occluded(wsHitBasis.position, -lightDirection, FLT_MAX) )
 	{
 		lighting *= ambientLight;
 	}
 
-	vec3 radiance = albedo * lighting; 
-	
-	outColor = vec4(radiance,1);
+	return albedo * lighting; 
 }
 
+void main()
+{
+	// see pathTracer.fs, the output is added onto the accumulation buffer.
+	if (pixelConverged(gl_FragCoord.xy)) discard;
+
+	vec3 radiance = vec3(0.0);
+	float luminanceSquared = 0.0;
+	for(int i = 0; i < samplesPerPass; ++i)
+	{
+		RandomState rng = initRandomState(ivec2(gl_FragCoord.xy), sampleCount + i);
+		vec3 sampleRadiance = samplePixel(rng);
+		radiance += sampleRadiance;
+		luminanceSquared += luminance(sampleRadiance) * luminance(sampleRadiance);
+	}
+	outColor = vec4(radiance, samplesPerPass);
+	outMoments = vec4(luminanceSquared, 0, 0, 0);
+}
 
@@ -2,48 +2,25 @@
 
 #include <focalDistance/focalDistanceDevice.h>
 #include <editVoxels/selectVoxelDevice.h>
+#include <lightSampling/lightAliasTableDevice.h>
+#include <lightSampling/lightTreeDevice.h>
+#include <uniformBlocks/uniformBlocksDevice.h>
 
 uniform isampler3D  materialOffsetTexture;
 uniform sampler1D   materialDataTexture;
-uniform sampler2D   noiseTexture;
-uniform ivec3       voxelResolution;
-uniform vec3        volumeBoundsMin;
-uniform vec3        volumeBoundsMax;
-uniform vec3        wsVoxelSize; // (boundsMax-boundsMin)/resolution
 
 uniform vec4        viewport;
-uniform float       cameraNear;
-uniform float       cameraFar;
-uniform mat4        cameraProj;
-uniform mat4        cameraInverseProj;
-uniform mat4        cameraInverseModelView;
-uniform float       cameraFocalLength;
-uniform float       cameraLensRadius;
-uniform vec2        cameraFilmSize;
-uniform int         cameraLensModel;
-
-uniform vec3        backgroundColorTop = vec3(153.0 / 255, 187.0 / 255, 201.0 / 255) * 2;
-uniform vec3        backgroundColorBottom = vec3(77.0 / 255, 64.0 / 255, 50.0 / 255);
+
 uniform vec3        groundColor = vec3(0.5, 0.5, 0.5);
-uniform int         backgroundUseImage;
 uniform sampler2D   backgroundTexture;
-uniform sampler2D   backgroundCDFUTexture;
-uniform sampler1D   backgroundCDFVTexture;
-uniform float	    backgroundIntegral;
-uniform float	    backgroundRotationRadians;
-
-uniform isampler1D  emissiveVoxelIndicesTexture; // for light sampling
+uniform usampler2D  backgroundAliasUTexture;
+uniform usampler1D  backgroundAliasVTexture;
 
 uniform int         sampleCount;
-uniform int			pathtracerMaxNumBounces;
-
-uniform float		wireframeOpacity = 0;
-uniform float		wireframeThickness = 0.01;
-
-uniform float		tonemappingGamma = 2.2;
-uniform float		tonemappingExposure = 1;
+uniform int         samplesPerPass = 1;
 
-out vec4 outColor;
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec4 outMoments; // used for adaptive sampling
 
 #include <shared/constants.h>
 #include <shared/aabb.h>
@@ -60,123 +37,44 @@ out vec4 outColor;
 #include <materials/plastic.h>
 #include <materials/materials.h>
 #include <shared/lights.h>
+#include <shared/adaptiveSampling.h>
+#include <shared/directLighting.h>
 
 vec3 directLighting(in int materialDataOffset, 
 					in Basis wsHitBasis, 
 					in vec3 wsWo, 
-					inout ivec2 rngOffset)
+					inout RandomState rng)
 {
-	vec4 wsToLight_pdf = vec4(0);
-	vec3 lightRadiance;
-
-	// We have stored every emissive voxel (that is, each voxel which assigned 
-	// material contains non-zero emision) into an array. These, along with the
-	// environment map make up for all the lights in the scene. Thus we'll
-	// sample unformly amongst N+1 positions (the +1 being the environment
-	// light)
-	vec4 u = rand(rngOffset);
-	int numLights = textureSize(emissiveVoxelIndicesTexture, 0) + 1;
-	int lightIndex = int(u.x * numLights); // rand should span across [0,1) thus we need +1
-	ivec3 vsEmissiveVoxelPos;
-	const bool samplingEmissiveVoxel = lightIndex < numLights - 1; 
-	if (samplingEmissiveVoxel)
-	{
-		// sample light from an emissive voxel
-		int emissiveVoxelIndex = texelFetch(emissiveVoxelIndicesTexture, lightIndex, 0);
-		vsEmissiveVoxelPos = voxelIndexToVoxelPos(emissiveVoxelIndex, voxelResolution);
-		int emissiveVoxelMaterialDataOffset = texelFetch(materialOffsetTexture, vsEmissiveVoxelPos, 0).r;
-		lightRadiance = vec3(10) * emissionBSDF(emissiveVoxelMaterialDataOffset); // FIXME
-
-		vec3 wsEmissiveVoxelPos = (vec3(vsEmissiveVoxelPos)/voxelResolution) * (volumeBoundsMax-volumeBoundsMin) + volumeBoundsMin;
-		// jitter hit within voxel (as an approximation of jittering on the hit surface)
-		wsEmissiveVoxelPos += u.yzw * wsVoxelSize; 
-
-		vec3 toLight = wsEmissiveVoxelPos - wsHitBasis.position; 
-		const float r = length(toLight);
-		wsToLight_pdf.xyz = toLight / r; 
-
-		// Need to obtain the normal of the hit on the light. This is a bit
-		// wasteful because we've already calculated wsEmissivePosition (which
-		// we in turn needed to work out the direction towards the light in the
-		// first place, wsToLight_pdf.xyz.
-		Basis wsLightHitBasis;
-		voxelSpaceToWorldSpace(vsEmissiveVoxelPos, 
-							   wsHitBasis.position, 
-							   wsToLight_pdf.xyz,
-							   wsLightHitBasis);
-
-
-		// Calculate the area PDF, and then apply the jacobian to express that
-		// same PDF in terms of solid angle (which is what we're integrating) 
-		//
-		// cubic voxels, all sides are the same length
-		const float voxelArea = 6.0 * wsVoxelSize.x * wsVoxelSize.y; // TODO: precompute
-		const float jacobian = (r*r) / abs(dot(-wsToLight_pdf.xyz, wsLightHitBasis.normal));
-		wsToLight_pdf.w = jacobian / voxelArea ; 
-	}
-	else
-	{
-		// sample from environment
-		lightRadiance = sampleEnvironmentRadiance(wsHitBasis, u.yz, wsToLight_pdf);
-	}
+	vec3 wsToLight;
+	float wsShadowRayLength;
+	const vec3 radiance = sampleDirectLighting(materialDataOffset,
+											   wsHitBasis,
+											   wsWo,
+											   rng,
+											   wsToLight,
+											   wsShadowRayLength);
 
-	// PDF is so far expressed in terms of one light. Account for all lights.
-	wsToLight_pdf.w /= numLights;
-
-	// Sample light with MIS
-	
 	// trace shadow ray to determine whether the radiance reaches the sampled
-	// point.
-	vec3 vsShadowHitPos;
-	bool hitGround;
-
-	const bool shadowRayMissed = !traverse(wsHitBasis.position, wsToLight_pdf.xyz, vsShadowHitPos, hitGround);
-	if(samplingEmissiveVoxel)
-	{
-		// when samplign an emissive voxel, we want the shadow ray not to miss,
-		// and to hit that same voxel.
-		if ( shadowRayMissed || (vsShadowHitPos != vsEmissiveVoxelPos))
-		{
-			// light is not visible. Evaluate possible emission from hit blocker.
-			return vec3(0);
-		}
-	}
-	else
+	// point: for an emissive voxel, nothing must be hit before reaching it,
+	// whereas for the environment light the ray must not hit anything in the
+	// scene.
+	if (radiance == vec3(0) || 
+		occluded(wsHitBasis.position, wsToLight, wsShadowRayLength))
 	{
-		// for the environment light we want the shadow ray not to hit anything
-		// in the scene.
-		if (!shadowRayMissed)
-		{
-			// light is not visible. Evaluate possible emission from hit blocker.
-			return vec3(0);
-		}
+		// light is not visible.
+		return vec3(0);
 	}
-
-	// Apply MIS weight for the sampled direction. PBRT2 page 748/749);
-	
-	// transform sampled directions to local space, which we need to evaluate
-	// the BSDF
-	vec3 lsWo = worldToLocal(wsWo, wsHitBasis);
-	vec3 lsWi = worldToLocal(wsToLight_pdf.xyz, wsHitBasis);
-	vec4 bsdfF_pdf = evaluateMaterialBSDF(materialDataOffset, lsWo, lsWi);
-
-	float misWeight = powerHeuristic(wsToLight_pdf.w, bsdfF_pdf.w);
-	return bsdfF_pdf.xyz * lightRadiance * abs(dot(wsToLight_pdf.xyz, wsHitBasis.normal)) * misWeight / wsToLight_pdf.w;
-
-	// Note we do the second half, BSDF sampling, on the main integrator loop, 
-	// by sampling the BSDF for the next vertex path and calculating the MIS 
-	// weight when the ray misses and thus we have implicit visibility with the 
-	// environment light. 
+	return radiance;
 }
 
-void main()
+// Trace a single path through the pixel and return the radiance it carries.
+vec3 samplePixel(inout RandomState rng)
 {
-	ivec2 rngOffset = randomNumberGeneratorOffset(ivec4(gl_FragCoord), sampleCount);
 	vec3 radiance = vec3(0.0);
 
 	vec3 wsRayOrigin;
 	vec3 wsRayDir;
-	generateRay(gl_FragCoord.xyz, rngOffset, wsRayOrigin, wsRayDir);
+	generateRay(gl_FragCoord.xyz, rng, wsRayOrigin, wsRayDir);
 
 	// test intersection with bounds to trivially discard rays before entering
 	// traversal.
@@ -187,10 +85,7 @@ void main()
 	if (aabbIsectDist < 0)
 	{
 		// we're not even hitting the volume's bounding box. Early out.
-		radiance = getBackgroundColor(wsRayDir);
-		vec3 tonemappedRadiance = pow(radiance * tonemappingExposure, vec3(1.0 / tonemappingGamma));
-		outColor = vec4(tonemappedRadiance,1);
-		return;
+		return getBackgroundColor(wsRayDir);
 	}
 
 	vec3 wsRayEntryPoint = wsRayOrigin + aabbIsectDist * wsRayDir;
@@ -201,15 +96,18 @@ void main()
 	vec3 throughput = vec3(1.0);
 	if ( !traverse(wsRayEntryPoint, wsRayDir, vsHitPos, hitGround) )
 	{
-		radiance = getBackgroundColor(wsRayDir);
-		vec3 tonemappedRadiance = pow(radiance * tonemappingExposure, vec3(1.0 / tonemappingGamma));
-		outColor = vec4(tonemappedRadiance,1);
-		return;
+		return getBackgroundColor(wsRayDir);
 	}
 
-
 	int bounces = 0; 
 
+	// Footprint of the ray cone around the current path segment. Primary rays
+	// are traced at full resolution, but once we start bouncing off rough
+	// surfaces the ray cone widens quickly and we can afford to traverse
+	// coarser levels of the voxel mip chain.
+	float coneSpread = 0;
+	int hitLod = 0;
+
 	// PBRT2 section 16.3
 	while(bounces < pathtracerMaxNumBounces)
 	{
@@ -220,12 +118,13 @@ void main()
 		Basis wsHitBasis;
 		voxelSpaceToWorldSpace(vsHitPos, 
 							   wsRayOrigin, wsRayDir,
+							   hitLod,
 							   wsHitBasis);
 		
 		ivec3 iVsHitPos = ivec3(vsHitPos);
-		int materialDataOffset = texelFetch(materialOffsetTexture, iVsHitPos, 0).r;
+		int materialDataOffset = texelFetch(materialOffsetTexture, iVsHitPos >> hitLod, hitLod).r;
 
-		if ( iVsHitPos == SelectVoxelData.index.xyz )
+		if ( hitLod == 0 && iVsHitPos == SelectVoxelData.index.xyz )
 		{
 			// Draw selected voxel as red
 			radiance += vec3(1,0,0); 
@@ -248,14 +147,18 @@ void main()
 		radiance += throughput * directLighting(materialDataOffset, 
 												wsHitBasis, 
 												wsWo, 
-												rngOffset);
+												rng);
 		
 		// Sample the BSDF to get the new path direction
 		vec4 bsdfF_pdf;
 		vec3 lsWi = sampleMaterialBSDF(materialDataOffset,
 									   lsWo, 
-									   rngOffset, 
+									   rng, 
 									   bsdfF_pdf); 
+		// no direction to carry on in. Dividing by the zero pdf would leave a
+		// NaN throughput, which would spoil the accumulated pixel for good.
+		if (bsdfF_pdf.w <= 0) break;
+
 		// Wireframe overlay
 		if (wireframeOpacity > 0)
 		{
@@ -269,7 +172,6 @@ void main()
 			bsdfF_pdf.xyz *= vec3(wireframe);
 		}
 
-
 		vec3 wsWi = localToWorld(lsWi, wsHitBasis);
 		
 		// update throughput
@@ -278,11 +180,20 @@ void main()
 		wsRayOrigin = wsHitBasis.position;
 		wsRayDir = wsWi;
 
+		// Approximate the spread of the new ray cone as the width, at unit
+		// distance, of the solid angle covered by the sampled direction (1/pdf).
+		// Highly specular lobes produce narrow cones which stay on the finest
+		// levels, whereas diffuse bounces move on to coarser ones.
+		coneSpread = sqrt(1.0 / max(bsdfF_pdf.w, 1e-4));
+
 		// find new vertex of path 
-		if ( !traverse(wsRayOrigin, wsRayDir, vsHitPos, hitGround) )
+		if ( !traverseCone(wsRayOrigin, wsRayDir, coneSpread, vsHitPos, hitGround, hitLod) )
 		{
 			// the ray missed the scene. Handle the environment light here.
 			vec4 lightL_pdf = evaluateEnvironmentRadiance(wsRayDir);
+			// the light sampling strategy picks the environment light only
+			// part of the time
+			lightL_pdf.w *= environmentLightPmf();
 			float misWeight = powerHeuristic(bsdfF_pdf.w, lightL_pdf.w);
 			radiance += throughput * lightL_pdf.xyz  * misWeight;
 			break;
@@ -291,8 +202,32 @@ void main()
 		bounces++;
 	}
 
-	vec3 tonemappedRadiance = pow(radiance * tonemappingExposure, vec3(1.0 / tonemappingGamma));
-	outColor = vec4(tonemappedRadiance,1);
+	return radiance;
 }
 
+void main()
+{
+	// Take several samples per pixel in a single pass. The output is added
+	// (blended) onto the accumulation buffer, which keeps the sum of all the
+	// samples so far in rgb, and the number of samples in alpha. The sum of
+	// the squared luminance of the samples is kept alongside, to estimate the
+	// pixel variance.
+	if (pixelConverged(gl_FragCoord.xy)) discard;
+
+	// the sample sequences follow the pixel of the image, of which the frame
+	// may only be a region (see Renderer::renderTiledImage)
+	const ivec2 pixel = ivec2(gl_FragCoord.xy - viewport.xy);
+
+	vec3 radiance = vec3(0.0);
+	float luminanceSquared = 0.0;
+	for(int i = 0; i < samplesPerPass; ++i)
+	{
+		RandomState rng = initRandomState(pixel, sampleCount + i);
+		vec3 sampleRadiance = samplePixel(rng);
+		radiance += sampleRadiance;
+		luminanceSquared += luminance(sampleRadiance) * luminance(sampleRadiance);
+	}
+	outColor = vec4(radiance, samplesPerPass);
+	outMoments = vec4(luminanceSquared, 0, 0, 0);
+}
 
@@ -0,0 +1,37 @@
+// Device-side declaration of the Shader Storage Object used to select a light
+// to sample, proportionally to its power. The first entry is always the 
+// environment light, the rest are emissive voxels.
+
+struct LightAliasTableEntry
+{
+	float probability;
+	int   alias;
+	float pmf;
+	int   voxelIndex;
+	int   faceMask;
+};
+
+layout(std430, binding=2) buffer LightAliasTable_t
+{
+	LightAliasTableEntry entries[];
+} LightAliasTable;
+
+// Select a light proportionally to its power, with a single uniform random
+// number in [0,1). Returns the index of the emissive voxel (and the mask of
+// its exposed faces), or -1 for the environment light, and the probability of
+// having selected it.
+int selectLightByPower(in float u, out float pmf, out int faceMask)
+{
+	const int numLights = LightAliasTable.entries.length();
+	// the integer part of the scaled random number picks an entry, and its
+	// fractional part decides between the entry and its alias.
+	const float scaled = u * numLights;
+	int light = min(int(scaled), numLights - 1);
+	if (scaled - light >= LightAliasTable.entries[light].probability)
+	{
+		light = LightAliasTable.entries[light].alias;
+	}
+	pmf = LightAliasTable.entries[light].pmf;
+	faceMask = LightAliasTable.entries[light].faceMask;
+	return LightAliasTable.entries[light].voxelIndex;
+}
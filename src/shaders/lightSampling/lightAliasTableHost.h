@@ -0,0 +1,14 @@
+#pragma once
+
+// Host-side declaration of the entries of the Shader Storage Object used to
+// select a light to sample, proportionally to its power. The first entry is
+// always the environment light, the rest are emissive voxels.
+
+typedef struct 
+{
+	float probability; // alias table: probability of keeping this entry
+	int   alias;       // alias table: entry selected otherwise
+	float pmf;         // probability of selecting this entry's light
+	int   voxelIndex;  // emissive voxel, or -1 for the environment light
+	int   faceMask;    // faces of the voxel not covered by a neighbour (+X, -X, +Y, -Y, +Z, -Z)
+} LightAliasTableEntry;
@@ -0,0 +1,135 @@
+// Device-side declaration of the Shader Storage Object holding the light tree
+// (see renderer/lights/lightTree.h), and its traversal.
+
+struct LightTreeNode
+{
+	vec3  boundsMin;
+	float phi;
+	vec3  boundsMax;
+	int   child; // interior nodes: second child, leaves: emissive voxel index
+	vec3  w;
+	float cosThetaO;
+	float cosThetaE;
+	int   isLeaf;
+	int   faceMask; // leaves: exposed faces of the emissive voxel
+};
+
+layout(std430, binding=3) buffer LightTree_t
+{
+	float environmentPmf;
+	int   numNodes;
+	LightTreeNode nodes[];
+} LightTree;
+
+// cos(max(0, a - b)) and sin(max(0, a - b)), given the sines and cosines of
+// the angles a and b
+float cosSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	if (cosA > cosB) return 1.0;
+	return cosA * cosB + sinA * sinB;
+}
+
+float sinSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	if (cosA > cosB) return 0.0;
+	return sinA * cosB - cosA * sinB;
+}
+
+// Conservative estimate of the light a point p, with normal n, receives from
+// the lights within the node (PBRT v4, section 12.6.3).
+float lightTreeNodeImportance(in int node, in vec3 p, in vec3 n)
+{
+	const vec3 boundsMin = LightTree.nodes[node].boundsMin;
+	const vec3 boundsMax = LightTree.nodes[node].boundsMax;
+	const vec3 w = LightTree.nodes[node].w;
+	const float cosThetaO = LightTree.nodes[node].cosThetaO;
+
+	const vec3 center = (boundsMin + boundsMax) * 0.5;
+	const vec3 toPoint = p - center;
+	const float dist2 = dot(toPoint, toPoint);
+	// squared radius of the bounding sphere of the node
+	const vec3 diagonal = boundsMax - boundsMin;
+	const float radius2 = 0.25 * dot(diagonal, diagonal);
+	// don't let the importance blow up for points close to the lights
+	const float d2 = max(dist2, radius2);
+
+	// angle between the cone axis and the direction towards the point
+	const vec3 wi = dist2 > 0 ? toPoint / sqrt(dist2) : w;
+	const float cosThetaW = dot(w, wi);
+	const float sinThetaW = sqrt(max(0.0, 1.0 - cosThetaW * cosThetaW));
+
+	// angle subtended by the bounds (their bounding sphere) from the point
+	const float cosThetaB = dist2 < radius2 ? -1.0 : sqrt(max(0.0, 1.0 - radius2 / dist2));
+	const float sinThetaB = sqrt(max(0.0, 1.0 - cosThetaB * cosThetaB));
+
+	// minimum angle between the emitter normals and the point, and whether
+	// the point lies within the angle over which light is emitted
+	const float sinThetaO = sqrt(max(0.0, 1.0 - cosThetaO * cosThetaO));
+	const float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	const float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	const float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP <= LightTree.nodes[node].cosThetaE) return 0.0;
+
+	float importance = LightTree.nodes[node].phi * cosThetaP / d2;
+
+	// minimum angle between the point's normal and the lights
+	const float cosThetaI = abs(dot(wi, n));
+	const float sinThetaI = sqrt(max(0.0, 1.0 - cosThetaI * cosThetaI));
+	importance *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+
+	return max(importance, 0.0);
+}
+
+// Select a light for the point p, with normal n, with a single uniform random
+// number in [0,1). The tree is traversed stochastically, choosing each child
+// proportionally to its importance. Returns the index of the emissive voxel
+// (and the mask of its exposed faces), or -1 for the environment light, and
+// the probability of having selected it (0 if no light is selected).
+int selectLightFromTree(in float u, in vec3 p, in vec3 n, out float pmf, out int faceMask)
+{
+	const float ONE_MINUS_EPSILON = 0.99999994;
+	faceMask = 0;
+
+	pmf = LightTree.environmentPmf;
+	if (u < LightTree.environmentPmf || LightTree.numNodes == 0) return -1;
+	pmf = 1.0 - LightTree.environmentPmf;
+	u = min((u - LightTree.environmentPmf) / pmf, ONE_MINUS_EPSILON);
+
+	int node = 0;
+	if (LightTree.nodes[node].isLeaf != 0 && lightTreeNodeImportance(node, p, n) <= 0)
+	{
+		pmf = 0.0;
+		return -1;
+	}
+
+	while(LightTree.nodes[node].isLeaf == 0)
+	{
+		const int child0 = node + 1;
+		const int child1 = LightTree.nodes[node].child;
+		const float importance0 = lightTreeNodeImportance(child0, p, n);
+		const float importance1 = lightTreeNodeImportance(child1, p, n);
+		if (importance0 <= 0 && importance1 <= 0)
+		{
+			pmf = 0.0;
+			return -1;
+		}
+
+		// descend into either child, and rescale the random number so it's
+		// still uniformly distributed for the next choice.
+		const float p0 = importance0 / (importance0 + importance1);
+		if (u < p0)
+		{
+			node = child0;
+			u = min(u / p0, ONE_MINUS_EPSILON);
+			pmf *= p0;
+		}
+		else
+		{
+			node = child1;
+			u = min((u - p0) / (1.0 - p0), ONE_MINUS_EPSILON);
+			pmf *= 1.0 - p0;
+		}
+	}
+	faceMask = LightTree.nodes[node].faceMask;
+	return LightTree.nodes[node].child;
+}
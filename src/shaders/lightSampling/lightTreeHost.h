@@ -0,0 +1,26 @@
+#pragma once
+
+// Host-side declaration of the Shader Storage Object holding the light tree
+// (see renderer/lights/lightTree.h). The buffer starts with a header, 
+// followed by the nodes of the tree in depth-first order.
+
+typedef struct
+{
+	float environmentPmf; // probability of sampling the environment instead of the tree
+	int   numNodes;
+	int   padding[2];
+} LightTreeHeader;
+
+typedef struct 
+{
+	float boundsMin[3];
+	float phi;          // emitted power
+	float boundsMax[3];
+	int   child;        // interior nodes: second child (the first one follows the node), leaves: emissive voxel index
+	float w[3];         // axis of the cone bounding the emitter normals
+	float cosThetaO;    // spread of the cone bounding the emitter normals
+	float cosThetaE;    // angle over which light is emitted, past the normals
+	int   isLeaf;
+	int   faceMask;     // leaves: faces of the voxel not covered by a neighbour (+X, -X, +Y, -Y, +Z, -Z)
+	int   padding;
+} LightTreeNode;
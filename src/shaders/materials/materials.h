@@ -29,15 +29,15 @@ vec4 evaluateMaterialBSDF(in int materialDataOffset,
 // directions.
 vec3 sampleMaterialBSDF(in int materialDataOffset,
 						in vec3 lsWo, 
-						inout ivec2 rngOffset, 
+						inout RandomState rng, 
 						out vec4 f_pdf)
 {
 	int materialType = int(texelFetch(materialDataTexture, materialDataOffset, 0).r);
 	switch(materialType)
 	{
-		case MATERIAL_MATTE:   return sampleMaterialBSDF_Matte(materialDataOffset + 1, lsWo, rngOffset, f_pdf);
-		case MATERIAL_METAL:   return sampleMaterialBSDF_Metal(materialDataOffset + 1, lsWo, rngOffset, f_pdf);
-		case MATERIAL_PLASTIC: return sampleMaterialBSDF_Plastic(materialDataOffset + 1, lsWo, rngOffset, f_pdf);
+		case MATERIAL_MATTE:   return sampleMaterialBSDF_Matte(materialDataOffset + 1, lsWo, rng, f_pdf);
+		case MATERIAL_METAL:   return sampleMaterialBSDF_Metal(materialDataOffset + 1, lsWo, rng, f_pdf);
+		case MATERIAL_PLASTIC: return sampleMaterialBSDF_Plastic(materialDataOffset + 1, lsWo, rng, f_pdf);
 		default: return vec3(0);
 	}
 }
@@ -11,14 +11,14 @@ vec4 evaluateMaterialBSDF_Matte(in int materialDataOffset,
 
 vec3 sampleMaterialBSDF_Matte(in int materialDataOffset,
 							  in vec3 lsWo, 
-							  inout ivec2 rngOffset, 
+							  inout RandomState rng, 
 							  out vec4 f_pdf)
 {
 	vec3 albedo = vec3(texelFetch(materialDataTexture, materialDataOffset + 3, 0).r,
 					   texelFetch(materialDataTexture, materialDataOffset + 4, 0).r,
 					   texelFetch(materialDataTexture, materialDataOffset + 5, 0).r);
 	
-	return sampleBSDF_Lambertian(albedo, lsWo, rngOffset, f_pdf);
+	return sampleBSDF_Lambertian(albedo, lsWo, rng, f_pdf);
 }
 
 vec3 emissionMaterialBSDF_Matte(in int materialDataOffset)
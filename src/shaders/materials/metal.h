@@ -18,7 +18,7 @@ vec4 evaluateMaterialBSDF_Metal(in int materialDataOffset,
 
 vec3 sampleMaterialBSDF_Metal(in int materialDataOffset, 
 							  in vec3 lsWo, 
-							  inout ivec2 rngOffset, 
+							  inout RandomState rng, 
 							  out vec4 f_pdf)
 {
 	//vec3 emission = vec3(texelFetch(materialDataTexture, materialDataOffset + 0, 0).r,
@@ -32,7 +32,7 @@ vec3 sampleMaterialBSDF_Metal(in int materialDataOffset,
 	float roughness = texelFetch(materialDataTexture, materialDataOffset + 6, 0).r;
 	float exponent = roughness; // TODO
 
-	return sampleBSDF_Microfacet(reflectance, exponent, lsWo, rngOffset, f_pdf);
+	return sampleBSDF_Microfacet(reflectance, exponent, lsWo, rng, f_pdf);
 }
 
 vec3 emissionMaterialBSDF_Metal(in int materialDataOffset)
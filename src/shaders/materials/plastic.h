@@ -18,13 +18,13 @@ vec4 evaluateMaterialBSDF_Plastic(in int materialDataOffset,
 
 vec3 sampleMaterialBSDF_Plastic(in int materialDataOffset,
 								in vec3 lsWo, 
-								inout ivec2 rngOffset, 
+								inout RandomState rng, 
 								out vec4 f_pdf)
 {
 	float roughness = texelFetch(materialDataTexture, materialDataOffset + 6, 0).r;
 	float exponent = roughness; // TODO
 
-	return sampleBSDF_Microfacet(vec3(1), exponent, lsWo, rngOffset, f_pdf);
+	return sampleBSDF_Microfacet(vec3(1), exponent, lsWo, rng, f_pdf);
 }
 
 vec3 emissionMaterialBSDF_Plastic(in int materialDataOffset)
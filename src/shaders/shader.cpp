@@ -1,9 +1,14 @@
 #include <GL/glew.h>
 
 #include "shaders/shader.h"
+#include "cache/cache.h"
+#include <unistd.h>
 #include <stdio.h>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 void log(Logger* logger, const std::string& msg)
 {
@@ -50,21 +55,34 @@ bool loadFile( const std::string& file, std::string& contents )
 }
 
 // search for #include directives (not supported in GLSL, and emulate them
-// by pasting the header contents within the output stream
-bool includeHeaders( std::string& code, 
+// by pasting the header contents within the output stream. Headers may include
+// others in turn. The code is scanned once, front to back, so the expansion
+// takes time linear in the size of the result.
+bool expandIncludes( const std::string& code,
 					 const std::string& includeBasePath,
+					 std::string& result,
+					 int depth,
 					 Logger* logger)
 {
 	using namespace std;	
 
+	// only a header which ends up including itself nests this deep
+	if (depth > 32)
+	{
+		log(logger, "Too many nested includes, is a header including itself?");
+		return false;
+	}
+
+	string::size_type from = 0;
 	string::size_type s;
-	while((s = code.find("#include", 0)) != string::npos)
+	while((s = code.find("#include", from)) != string::npos)
 	{
 		string::size_type includeStart = s;
 		string::size_type includeEnd = code.find('\n', s);
 		if (includeEnd == string::npos) break; 
 		string includeDirective = code.substr(includeStart, includeEnd - includeStart);
-		code.erase(includeStart, includeEnd - includeStart);
+		result.append(code, from, includeStart - from);
+		from = includeEnd;
 
 		string headerFile;
 		{
@@ -87,12 +105,27 @@ bool includeHeaders( std::string& code,
 			log(logger, "Failed to load header " + headerFilePath);
 			return false;	
 		}
-		code.insert(includeStart, headercode);
+		if ( !expandIncludes(headercode, includeBasePath, result, depth + 1, logger) )
+		{
+			return false;
+		}
 	}
+	result.append(code, from, string::npos);
 
 	return true;
 }
 
+bool includeHeaders( std::string& code, 
+					 const std::string& includeBasePath,
+					 Logger* logger)
+{
+	std::string result;
+	result.reserve(code.size());
+	if (!expandIncludes(code, includeBasePath, result, 0, logger)) return false;
+	code.swap(result);
+	return true;
+}
+
 bool parseShader( const std::string& file, 
 				  const std::string& includeBasePath,
 				  std::string& contents,
@@ -169,107 +202,415 @@ bool Shader::compileProgramFromFile( const std::string& name,
 								   logger);
 }
 
-GLuint createShader(const std::string& programName,
-					GLuint shaderType,
-				    const std::string& shaderCode,
-				    const std::string& shaderPreprocessor,
-					char* infoLog, 
-                    GLsizei& logLength,
-				    Logger* logger)
+// Compile a shader and attach it to the given program. Its compilation log
+// isn't queried here, as that would wait for it to be compiled (see
+// Shader::finishProgram).
+void attachShader(GLuint program,
+				  GLuint shaderType,
+				  const std::string& shaderCode,
+				  const std::string& shaderPreprocessor)
 {
-    GLuint shader = glCreateShader( shaderType );
-	const char* source[2] = { shaderPreprocessor.c_str(),
-							  shaderCode.c_str() };
-	glShaderSource( shader, 2, source, NULL );
+	// the #version directive must come first, so the preprocessor definitions
+	// go right after it
+	std::string::size_type versionEnd = shaderCode.find("#version");
+	if (versionEnd == std::string::npos)
+	{
+		versionEnd = 0;
+	}
+	else
+	{
+		versionEnd = shaderCode.find('\n', versionEnd);
+		versionEnd = versionEnd == std::string::npos ? shaderCode.size() : versionEnd + 1;
+	}
+	const std::string version = shaderCode.substr(0, versionEnd);
+	const std::string body = shaderCode.substr(versionEnd);
+
+	GLuint shader = glCreateShader( shaderType );
+	const char* source[3] = { version.c_str(),
+							  shaderPreprocessor.c_str(),
+							  body.c_str() };
+	glShaderSource( shader, 3, source, NULL );
 	glCompileShader( shader );
-	glGetShaderInfoLog( shader, 512, &logLength, infoLog );
-	if ( logLength > 0 )
+	glAttachShader( program, shader );
+
+	// mark this copy for disposal. It won't be actually deleted till we 
+	// dispose the program it is attached to. 
+	glDeleteShader( shader );
+}
+
+const char* shaderTypeName(GLint shaderType)
+{
+	switch(shaderType)
 	{
-        log( logger, std::string("Program ") + programName + std::string(": Vertex shader compilation log:\n") + infoLog);
-		logWithLineNumbers( logger, shaderPreprocessor + shaderCode );
+	case GL_VERTEX_SHADER:   return "Vertex";
+	case GL_GEOMETRY_SHADER: return "Geometry";
+	case GL_FRAGMENT_SHADER: return "Fragment";
+	case GL_COMPUTE_SHADER:  return "Compute";
+	default:                 return "Unknown";
 	}
-    return shader;
 }
 
-bool Shader::compileProgramFromCode ( const std::string& name,
-									  const std::string &vertexShaderCode,
-									  const std::string &vertexShaderPreprocessor,
-									  const std::string &geometryShaderCode,
-									  const std::string &geometryShaderPreprocessor,
-									  const std::string &fragmentShaderCode,
-									  const std::string &fragmentShaderPreprocessor,
-									  GLuint& result,
-									  Logger* logger)
+// Bump this whenever the way programs are cached changes, so outdated cache
+// entries are ignored.
+static const boost::uint32_t PROGRAM_CACHE_VERSION = 1;
+static const char PROGRAM_CACHE_MAGIC[4] = { 'V', 'T', 'P', 'B' };
+// anything larger can only be a corrupt entry
+static const boost::uint32_t PROGRAM_CACHE_MAX_BINARY_LENGTH = 64 << 20;
+
+// Header of a cached program binary, which follows it.
+struct ProgramCacheHeader
 {
-	char infoLog[ 512 ];
-	GLsizei logLength = 0;
+	char magic[4];
+	boost::uint32_t version;
+	boost::uint32_t binaryFormat;
+	boost::uint32_t binaryLength;
+};
+
+// Cached program binaries take this much disk space at most, the least
+// recently used ones are removed beyond that.
+static const boost::uint64_t PROGRAM_CACHE_MAX_SIZE = 64 << 20;
+
+// Hash identifying the driver, as binaries can't be shared across drivers or
+// driver versions.
+boost::uint64_t driverHash()
+{
+	boost::uint64_t hash = HASH_SEED;
+	const GLenum driverStrings[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (int i = 0; i < 3; ++i)
+	{
+		const char* driverString = (const char*)glGetString(driverStrings[i]);
+		if (driverString != NULL) hash = hashString(hash, driverString);
+	}
+	return hash;
+}
 
-	GLuint program = glCreateProgram();
+// Hash identifying a linked program for a given driver: the preprocessor
+// definitions and the (include-expanded) code of each of its stages.
+boost::uint64_t programHash(const std::string* const* sources, size_t numSources)
+{
+	boost::uint64_t hash = HASH_SEED;
+	for (size_t i = 0; i < numSources; ++i)
+	{
+		// so moving code from one stage to the next changes the hash
+		hash = hashCombine(hash, sources[i]->size());
+		hash = hashString(hash, *sources[i]);
+	}
+	return hash;
+}
 
+// Keep the cached programs within PROGRAM_CACHE_MAX_SIZE. Entries are pruned
+// by when they were last used only, whichever driver built them: machines
+// switching between GPUs or drivers keep the programs of each.
+void pruneProgramCache()
+{
+	pruneCache("program-", PROGRAM_CACHE_MAX_SIZE);
+}
+
+// Path of the cache entry for the program with the given hash. Empty if
+// there's nowhere to cache programs, or the driver can't retrieve them.
+std::string programCacheFile(boost::uint64_t hash)
+{
+	GLint numBinaryFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats);
+	if (numBinaryFormats <= 0) return "";
+
+	const std::string directory = cacheDirectory();
+	if (directory.empty()) return "";
+
+	// the cache is pruned once per run
+	static bool pruned = false;
+	if (!pruned)
 	{
+		pruneProgramCache();
+		pruned = true;
+	}
 
-		// compile vertex shader
-		{
-			GLuint vs = createShader( name,
-									  GL_VERTEX_SHADER,
-									  vertexShaderCode,
-									  vertexShaderPreprocessor,
-									  infoLog,
-									  logLength,
-									  logger );
-
-			glAttachShader( program, vs );
-			
-			// mark this copy for disposal. It won't be actually deleted till we 
-			// dispose the program it is attached to. 
-			glDeleteShader( vs ); 
-		}
+	// entries are named after the driver, so those of different drivers
+	// never collide
+	std::ostringstream ss;
+	ss << directory << "/program-" << std::hex << driverHash() << "-" << hash << ".bin";
+	return ss.str();
+}
+
+// Link the program from the binary cached in the given file. Fails if there's
+// no such entry, or the driver turns it down, which leaves the program ready
+// to be built from source.
+bool readProgramCache(const std::string& file, GLuint program)
+{
+	std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+	if (!in) return false;
+
+	ProgramCacheHeader header;
+	if (!in.read((char*)&header, sizeof(header))) return false;
+	if (memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC)) != 0 ||
+		header.version != PROGRAM_CACHE_VERSION ||
+		header.binaryLength == 0 || header.binaryLength > PROGRAM_CACHE_MAX_BINARY_LENGTH)
+	{
+		return false;
+	}
 
-		// compile fragment shader
+	std::vector<char> binary(header.binaryLength);
+	if (!in.read(&binary[0], binary.size())) return false;
+
+	glProgramBinary(program, header.binaryFormat, &binary[0], binary.size());
+	GLint linked;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE) return false;
+	touchCacheEntry(file);
+	return true;
+}
+
+void writeProgramCache(const std::string& file, GLuint program)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0 || (boost::uint32_t)length > PROGRAM_CACHE_MAX_BINARY_LENGTH) return;
+
+	std::vector<char> binary(length);
+	GLenum binaryFormat = 0;
+	glGetProgramBinary(program, length, &length, &binaryFormat, &binary[0]);
+	if (length <= 0) return;
+
+	ProgramCacheHeader header;
+	memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+	header.version = PROGRAM_CACHE_VERSION;
+	header.binaryFormat = binaryFormat;
+	header.binaryLength = length;
+
+	// write to a temporary file first, so other instances never read a
+	// partially written entry.
+	std::ostringstream ss;
+	ss << file << "." << getpid() << ".tmp";
+	const std::string temporaryFile = ss.str();
+	{
+		std::ofstream out(temporaryFile.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out) return;
+		out.write((const char*)&header, sizeof(header));
+		out.write(&binary[0], length);
+		if (!out)
 		{
-			GLuint fs = createShader( name,
-									  GL_FRAGMENT_SHADER,
-									  fragmentShaderCode,
-									  fragmentShaderPreprocessor,
-									  infoLog,
-									  logLength,
-									  logger );
-
-			glAttachShader( program, fs );
-			
-			// mark this copy for disposal. It won't be actually deleted till we 
-			// dispose the program it is attached to. 
-			glDeleteShader( fs );
+			out.close();
+			remove(temporaryFile.c_str());
+			return;
 		}
+	}
+	if (rename(temporaryFile.c_str(), file.c_str()) != 0) remove(temporaryFile.c_str());
+}
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// whether the driver builds programs in the background
+static bool s_parallelCompilation = false;
+
+bool Shader::enableParallelCompilation()
+{
+	s_parallelCompilation = false;
+#ifdef GL_KHR_parallel_shader_compile
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		// as many threads as the driver sees fit
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		s_parallelCompilation = true;
+	}
+#endif
+#ifdef GL_ARB_parallel_shader_compile
+	if (!s_parallelCompilation && GLEW_ARB_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		s_parallelCompilation = true;
+	}
+#endif
+	return s_parallelCompilation;
+}
+
+// Start building a program from the given stages (empty code for the stages it
+// hasn't got), or link it right away from the cache if it's there.
+void startProgramFromCode( const std::string& name,
+						   const std::string* const* sources,
+						   const GLuint* shaderTypes,
+						   size_t numStages,
+						   ShaderProgramBuild& build )
+{
+	build.name = name;
+	build.cacheFile = programCacheFile(programHash(sources, numStages * 2));
+	build.program = glCreateProgram();
+	build.fromCache = !build.cacheFile.empty() && readProgramCache(build.cacheFile, build.program);
+	if (build.fromCache) return;
+
+	for (size_t i = 0; i < numStages; ++i)
+	{
+		const std::string& preprocessor = *sources[i * 2];
+		const std::string& code = *sources[i * 2 + 1];
+		if (!code.empty()) attachShader( build.program, shaderTypes[i], code, preprocessor );
+	}
+	if (!build.cacheFile.empty()) glProgramParameteri( build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+	glLinkProgram( build.program );
+}
+
+bool Shader::startProgramFromFile( const std::string& name,
+								   const std::string& includeBasePath,
+								   const std::string &vertexShaderFile,
+								   const std::string &vertexShaderPreprocessor,
+								   const std::string &fragmentShaderFile,
+								   const std::string &fragmentShaderPreprocessor,
+								   ShaderProgramBuild& build,
+								   Logger* logger)
+{
+	using namespace std;
+
+	string vs, fs;
+	if (!parseShader( vertexShaderFile, includeBasePath, vs, logger ))
+	{
+		log(logger, std::string("error parsing file ") + vertexShaderFile);
+		logWithLineNumbers(logger, vs);
+		return false;
+	}
+	if (!parseShader( fragmentShaderFile, includeBasePath, fs, logger))
+	{
+		log(logger, std::string("error parsing file ") + fragmentShaderFile);
+		logWithLineNumbers(logger, fs);
+		return false;
+	}
+
+	const std::string empty;
+	const std::string* sources[6] = { &vertexShaderPreprocessor, &vs,
+									  &empty, &empty,
+									  &fragmentShaderPreprocessor, &fs };
+	const GLuint shaderTypes[3] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+	startProgramFromCode( name, sources, shaderTypes, 3, build );
+	return true;
+}
+
+bool Shader::startComputeProgramFromFile( const std::string& name,
+										  const std::string& includeBasePath,
+										  const std::string &computeShaderFile,
+										  const std::string &computeShaderPreprocessor,
+										  ShaderProgramBuild& build,
+										  Logger* logger)
+{
+	using namespace std;
+
+	string cs;
+	if (!parseShader( computeShaderFile, includeBasePath, cs, logger ))
+	{
+		log(logger, std::string("error parsing file ") + computeShaderFile);
+		logWithLineNumbers(logger, cs);
+		return false;
+	}
 
-		// optionally compile fragment shader
-		if (!geometryShaderCode.empty()) 
+	const std::string* sources[2] = { &computeShaderPreprocessor, &cs };
+	const GLuint shaderTypes[1] = { GL_COMPUTE_SHADER };
+	startProgramFromCode( name, sources, shaderTypes, 1, build );
+	return true;
+}
+
+bool Shader::isProgramReady( const ShaderProgramBuild& build )
+{
+	// without parallel compilation, the driver builds programs as they're
+	// started, or at the latest when first queried, so there's no telling.
+	if (!s_parallelCompilation || build.fromCache) return true;
+	GLint completed = GL_FALSE;
+	glGetProgramiv( build.program, GL_COMPLETION_STATUS_KHR, &completed );
+	return completed == GL_TRUE;
+}
+
+bool Shader::finishProgram( const ShaderProgramBuild& build,
+							GLuint& result,
+							Logger* logger)
+{
+	result = build.program;
+	GLint linked;
+	glGetProgramiv( build.program, GL_LINK_STATUS, &linked);
+	if (build.fromCache) return linked == GL_TRUE;
+
+	char infoLog[ 512 ];
+	GLsizei logLength = 0;
+
+	GLuint shaders[4];
+	GLsizei numShaders = 0;
+	glGetAttachedShaders( build.program, 4, &numShaders, shaders );
+	for (GLsizei i = 0; i < numShaders; ++i)
+	{
+		glGetShaderInfoLog( shaders[i], 512, &logLength, infoLog );
+		if ( logLength <= 0 ) continue;
+
+		GLint shaderType = 0;
+		glGetShaderiv( shaders[i], GL_SHADER_TYPE, &shaderType );
+		log( logger, std::string("Program ") + build.name + ": " + shaderTypeName(shaderType) + " shader compilation log:\n" + infoLog );
+
+		GLint sourceLength = 0;
+		glGetShaderiv( shaders[i], GL_SHADER_SOURCE_LENGTH, &sourceLength );
+		if ( sourceLength > 0 )
 		{
-			GLuint gs = createShader( name,
-									  GL_GEOMETRY_SHADER,
-									  geometryShaderCode,
-									  geometryShaderPreprocessor,
-									  infoLog,
-									  logLength, 
-									  logger );
-
-			glAttachShader( program, gs );
-			
-			// mark this copy for disposal. It won't be actually deleted till we 
-			// dispose the program it is attached to. 
-			glDeleteShader( gs );
+			std::vector<char> source(sourceLength);
+			glGetShaderSource( shaders[i], sourceLength, NULL, &source[0] );
+			logWithLineNumbers( logger, &source[0] );
 		}
-		glLinkProgram( program );
 	}
 
-	result = program;
-	GLint linked; 
-	glGetProgramiv( program, GL_LINK_STATUS, &linked);
-	glGetProgramInfoLog( program, 512, &logLength, infoLog );
+	glGetProgramInfoLog( build.program, 512, &logLength, infoLog );
 	if ( logLength > 0 )
 	{
-		log( logger, std::string("Program ") + name + std::string(": Fragment shader compilation log:\n") + infoLog );
+		log( logger, std::string("Program ") + build.name + std::string(": link log:\n") + infoLog );
 	}
+	if ( linked == GL_TRUE && !build.cacheFile.empty() ) writeProgramCache(build.cacheFile, build.program);
 	return linked == GL_TRUE;
 }
 
+bool Shader::compileProgramFromCode ( const std::string& name,
+									  const std::string &vertexShaderCode,
+									  const std::string &vertexShaderPreprocessor,
+									  const std::string &geometryShaderCode,
+									  const std::string &geometryShaderPreprocessor,
+									  const std::string &fragmentShaderCode,
+									  const std::string &fragmentShaderPreprocessor,
+									  GLuint& result,
+									  Logger* logger)
+{
+	const std::string* sources[6] = { &vertexShaderPreprocessor, &vertexShaderCode,
+									  &geometryShaderPreprocessor, &geometryShaderCode,
+									  &fragmentShaderPreprocessor, &fragmentShaderCode };
+	const GLuint shaderTypes[3] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+	ShaderProgramBuild build;
+	startProgramFromCode( name, sources, shaderTypes, 3, build );
+	return finishProgram( build, result, logger );
+}
+
+
+bool Shader::compileComputeProgramFromFile( const std::string& name, 
+											const std::string& includeBasePath,
+											const std::string &computeShaderFile,
+											const std::string &computeShaderPreprocessor,
+											GLuint& result,
+											Logger* logger)
+{
+	using namespace std;
+
+	string cs;
+	if (!parseShader( computeShaderFile, includeBasePath, cs, logger ))
+	{
+		log(logger, std::string("error parsing file ") + computeShaderFile);
+		logWithLineNumbers(logger, cs);
+		return false;
+	}
+
+	return compileComputeProgramFromCode( name,
+										  cs, computeShaderPreprocessor,
+										  result,
+										  logger);
+}
+
+bool Shader::compileComputeProgramFromCode ( const std::string& name,
+											 const std::string &computeShaderCode,
+											 const std::string &computeShaderPreprocessor,
+											 GLuint& result,
+											 Logger* logger)
+{
+	const std::string* sources[2] = { &computeShaderPreprocessor, &computeShaderCode };
+	const GLuint shaderTypes[1] = { GL_COMPUTE_SHADER };
+	ShaderProgramBuild build;
+	startProgramFromCode( name, sources, shaderTypes, 1, build );
+	return finishProgram( build, result, logger );
+}
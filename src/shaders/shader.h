@@ -4,6 +4,24 @@
 #include <string>
 #include <src/log/logger.h>
 
+// A program being built (see Shader::startProgramFromFile)
+struct ShaderProgramBuild
+{
+	std::string name;
+	GLuint      program;
+	// where the linked binary is cached, if anywhere
+	std::string cacheFile;
+	// whether the program was linked from the cache, rather than built
+	bool        fromCache;
+};
+
+// Replace the #include <file> directives in the given code with the contents
+// of the files, relative to includeBasePath (which ends in a slash), as GLSL
+// doesn't support them.
+bool includeHeaders( std::string& code,
+					 const std::string& includeBasePath,
+					 Logger* logger = NULL );
+
 class Shader
 {
 public:
@@ -38,57 +56,121 @@ public:
 										GLuint& result,
 										Logger* logger = NULL);
 
+	static bool compileComputeProgramFromFile( const std::string& name,
+											   const std::string& includeBasePath,
+											   const std::string &computeShaderFile,
+											   const std::string &computeShaderPreprocessor,
+											   GLuint& result,
+											   Logger* logger = NULL);
+
+	static bool compileComputeProgramFromCode( const std::string& name,
+											   const std::string &computeShaderCode,
+											   const std::string &computeShaderPreprocessor,
+											   GLuint& result,
+											   Logger* logger = NULL);
+
+	// Let the driver build programs on threads of its own, where it supports
+	// GL_KHR_parallel_shader_compile. Returns whether it does.
+	static bool enableParallelCompilation();
+
+	// The functions above, split in two: start building a program, which
+	// carries on in the background if parallel compilation is enabled, then
+	// wait for it to be done and report any errors. isProgramReady tells
+	// whether finishProgram would have to wait.
+	static bool startProgramFromFile( const std::string& name,
+									  const std::string& includeBasePath,
+									  const std::string &vertexShaderFile,
+									  const std::string &vertexShaderPreprocessor,
+									  const std::string &fragmentShaderFile,
+									  const std::string &fragmentShaderPreprocessor,
+									  ShaderProgramBuild& build,
+									  Logger* logger = NULL);
+
+	static bool startComputeProgramFromFile( const std::string& name,
+											 const std::string& includeBasePath,
+											 const std::string &computeShaderFile,
+											 const std::string &computeShaderPreprocessor,
+											 ShaderProgramBuild& build,
+											 Logger* logger = NULL);
+
+	static bool isProgramReady( const ShaderProgramBuild& build );
+
+	static bool finishProgram( const ShaderProgramBuild& build,
+							   GLuint& result,
+							   Logger* logger = NULL );
 };
 
 struct IntegratorShaderSettings
 {
 	GLuint m_program;
 
-	// uniforms
+	// uniforms. The camera, volume and render settings are shared by all
+	// programs through uniform buffers (see uniformBlocksHost.h).
 	GLuint m_uniformMaterialOffsetTexture;
 	GLuint m_uniformMaterialDataTexture;
-	GLuint m_emissiveVoxelIndicesTexture;
-	GLuint m_uniformNoiseTexture;
-	GLuint m_uniformVoxelDataResolution;
-	GLuint m_uniformVolumeBoundsMin;
-	GLuint m_uniformVolumeBoundsMax;
-	GLuint m_uniformVoxelSize;
 	GLuint m_uniformViewport;
-	GLuint m_uniformCameraNear;
-	GLuint m_uniformCameraFar;
-	GLuint m_uniformCameraProj;
-	GLuint m_uniformCameraInverseProj;
-	GLuint m_uniformCameraInverseModelView;
-	GLuint m_uniformCameraFocalLength;
-	GLuint m_uniformCameraLensRadius;
-	GLuint m_uniformCameraFilmSize;
 	GLuint m_uniformLightDir;
 	GLuint m_uniformSampleCount;
-	GLuint m_uniformCameraLensModel;
-	GLuint m_uniformPathtracerMaxPathBounces;
-	GLuint m_uniformWireframeOpacity;
-	GLuint m_uniformWireframeThickness;
+	GLuint m_uniformSamplesPerPass;
 	GLuint m_uniformFocalDistanceSSBOStorageBlock;
 	GLuint m_uniformSelectedVoxelSSBOStorageBlock;
-	GLuint m_uniformBackgroundColorTop;
-	GLuint m_uniformBackgroundColorBottom;
-	GLuint m_uniformBackgroundUseImage;
+	GLuint m_uniformLightAliasTableSSBOStorageBlock;
+	GLuint m_uniformLightTreeSSBOStorageBlock;
 	GLuint m_uniformBackgroundTexture;
-	GLuint m_uniformBackgroundCDFUTexture;
-	GLuint m_uniformBackgroundCDFVTexture;
-	GLuint m_uniformBackgroundIntegral;
-	GLuint m_uniformBackgroundRotationRadians;
+	GLuint m_uniformBackgroundAliasUTexture;
+	GLuint m_uniformBackgroundAliasVTexture;
+	GLuint m_uniformAdaptiveSampling;
+	GLuint m_uniformConvergenceMask;
+};
+
+// The compute programs making up the stages of the wavefront path tracer (see
+// shaders/wavefront). All of them take the integrator uniforms, and a few
+// take some of their own.
+struct WavefrontShaderSettings
+{
+	enum Stage
+	{
+		STAGE_GENERATE = 0,
+		STAGE_EXTEND,
+		// one shading stage per material, in Material::MaterialType order
+		STAGE_SHADE_MATTE,
+		STAGE_SHADE_METAL,
+		STAGE_SHADE_PLASTIC,
+		STAGE_CONNECT,
+		STAGE_ACCUMULATE,
+		STAGE_DISPATCH,
+		STAGE_TOTAL,
+	};
+
+	IntegratorShaderSettings m_stages[STAGE_TOTAL];
+
+	// uniforms
+	GLuint m_uniformGenerateWaveOrigin;
+	GLuint m_uniformGenerateWaveSize;
+	GLuint m_uniformAccumulateWaveOrigin;
+	GLuint m_uniformAccumulateWaveSize;
+	GLuint m_uniformAccumulateMoments;
+	GLuint m_uniformDispatchQueues;
 };
-			
-struct AccumulationShaderSettings
+
+struct ConvergenceShaderSettings
 {
 	GLuint m_program;
-	
+
 	// uniforms
-	GLuint m_uniformSampleTexture;
-	GLuint m_uniformAverageTexture;
-	GLuint m_uniformSampleCount;
-    GLuint m_uniformViewport;
+	GLuint m_uniformAccumulationTexture;
+	GLuint m_uniformMomentsTexture;
+	GLuint m_uniformImageResolution;
+	GLuint m_uniformMinSamples;
+	GLuint m_uniformErrorThreshold;
+};
+
+struct VoxelMipmapShaderSettings
+{
+	GLuint m_program;
+
+	// uniforms
+	GLuint m_uniformDestinationResolution;
 };
 
 struct TexturedShaderSettings 
@@ -98,6 +180,11 @@ struct TexturedShaderSettings
 	// uniforms
 	GLuint m_uniformTexture;
     GLuint m_uniformViewport;
+	GLuint m_uniformTonemappingGamma;
+	GLuint m_uniformTextureWeight;
+	GLuint m_uniformPreviewTexture;
+	GLuint m_uniformPreviewScale;
+	GLuint m_uniformPreviewWeight;
 };
 
 
@@ -0,0 +1,14 @@
+// The image is split in tiles which stop being sampled once their estimated
+// error falls below a threshold. See adaptiveSampling/convergence.cs
+
+uniform int         adaptiveSampling = 0; // whether convergenceMask is valid
+uniform usampler2D  convergenceMask; // non-zero for converged tiles
+
+// must match the work group size in adaptiveSampling/convergence.cs
+const int CONVERGENCE_TILE_SIZE = 16;
+
+bool pixelConverged(in vec2 fragCoord)
+{
+	if (adaptiveSampling == 0) return false;
+	return texelFetch(convergenceMask, ivec2(fragCoord) / CONVERGENCE_TILE_SIZE, 0).r != 0u;
+}
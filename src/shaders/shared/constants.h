@@ -1,3 +1,4 @@
 float PI        = 3.14159265359;
 float TWO_PI    = 6.28318530718;
 float INV_TWOPI = 0.15915494309;
+float FLT_MAX   = 3.402823466e+38;
@@ -1,7 +1,7 @@
 vec4 screenToEyeSpaceOrthographic(vec3 windowSpace)
 {
 	vec3 ndcPos;
-	ndcPos.xy = (windowSpace.xy / viewport.zw) * 2 - vec2(1);
+	ndcPos.xy = ((windowSpace.xy - viewport.xy) / viewport.zw) * 2 - vec2(1);
 	ndcPos.z = (2.0 * windowSpace.z - gl_DepthRange.near - gl_DepthRange.far) / (gl_DepthRange.far - gl_DepthRange.near);
 
 	// orthographic
@@ -58,17 +58,20 @@ vec3 worldToLocal(in vec3 wsV,
 
 void voxelSpaceToWorldSpace(in vec3 vsP, 
 							in vec3 wsRayOrigin, in vec3 wsRayDir,
+							in int lod,
 							out Basis wsHitBasis)
 {
 	// vsP marks the lower-left corner of the voxel. Calculate the
-	// precise ray/voxel intersection in world-space
+	// precise ray/voxel intersection in world-space. Voxels in coarser levels
+	// of the mip chain are 2^lod times bigger.
+	vec3 wsLodVoxelSize = wsVoxelSize * float(1 << lod);
 	vec3 wsVoxelMin = vsP * wsVoxelSize + volumeBoundsMin; 
-	vec3 wsVoxelMax = wsVoxelMin + wsVoxelSize; 
+	vec3 wsVoxelMax = wsVoxelMin + wsLodVoxelSize; 
 	float voxelHitDistance = rayAABBIntersection(wsRayOrigin, wsRayDir, wsVoxelMin, wsVoxelMax);
 
 	wsHitBasis.position = wsRayOrigin + wsRayDir * voxelHitDistance; 
 	
-	vec3 wsVoxelCenter = wsVoxelMin + wsVoxelSize * 0.5;
+	vec3 wsVoxelCenter = wsVoxelMin + wsLodVoxelSize * 0.5;
 	vec3 centerToHit = wsHitBasis.position - wsVoxelCenter; 
 	vec3 absCenterToHit = abs(centerToHit); 
 	vec3 mask = step(absCenterToHit.yxx, absCenterToHit.xyz) * step(absCenterToHit.zzy, absCenterToHit.xyz);
@@ -81,6 +84,13 @@ void voxelSpaceToWorldSpace(in vec3 vsP,
 	wsHitBasis.tangent = normalize(cross(wsHitBasis.binormal, wsHitBasis.normal));
 }
 
+void voxelSpaceToWorldSpace(in vec3 vsP, 
+							in vec3 wsRayOrigin, in vec3 wsRayDir,
+							out Basis wsHitBasis)
+{
+	voxelSpaceToWorldSpace(vsP, wsRayOrigin, wsRayDir, 0, wsHitBasis);
+}
+
 // pole at +Y (theta = 0)
 vec3 sphericalToCartesian(float phi, float theta)
 {
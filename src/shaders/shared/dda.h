@@ -99,4 +99,164 @@ bool traverse(in vec3 wsRayOrigin,
 	return traverse(wsRayOrigin, wsRayDir, MAX_STEPS, vsHitPos, hitGround);
 }
 
+// Occlusion query, used for shadow rays. Walks the grid from wsRayOrigin along
+// wsRayDir and returns true as soon as an occupied voxel is found closer than 
+// wsMaxDistance. Unlike traverse() we don't care about which voxel is hit, so
+// there's no need to find the closest one or to return any hit information.
+// As in traverse(), leaving the volume through the bottom means the ray hit
+// the (optional) ground.
+bool occluded(in vec3 wsRayOrigin, 
+			  in vec3 wsRayDir,
+			  in float wsMaxDistance)
+{
+	vec3 voxelExtent = vec3(1.0) / (volumeBoundsMax - volumeBoundsMin);
+	wsRayOrigin += sign(wsRayDir) * ISECT_EPSILON;
+	vec3 voxelOrigin = (wsRayOrigin - volumeBoundsMin) * voxelExtent * voxelResolution;
+	vec3 voxelPos = floor(voxelOrigin);
+
+	// the DDA distances are measured in voxels (cubic, all sides are the same
+	// length). Leave some slack for the origin offset above, so that a ray
+	// ending right at a voxel face doesn't enter that voxel.
+	const float vsMaxDistance = wsMaxDistance / wsVoxelSize.x - 0.01;
+
+	wsRayDir = mix(wsRayDir, vec3(1e-5), step(abs(wsRayDir), vec3(1e-5)));
+
+	vec3 wsRayDirIncrement = vec3(1.0f) / wsRayDir;
+	vec3 wsRayDirSign = sign(wsRayDir);
+
+	vec3 dis = (voxelPos-voxelOrigin + 0.5 + wsRayDirSign*0.5) * wsRayDirIncrement;
+	vec3 mask=vec3(0.0);
+
+	// distance at which the ray enters the current voxel
+	float vsDistance = 0;
+
+	int MAX_STEPS = int(2 * ceil(length(vec3(voxelResolution))));
+	for(int steps = 0; steps < MAX_STEPS && vsDistance < vsMaxDistance; ++steps) 
+	{
+		if (any(lessThan(voxelPos, vec3(0.0))) || 
+			any(greaterThanEqual(voxelPos,voxelResolution))) 
+		{
+			return voxelPos.y < 0;
+		}
+
+		if (texelFetch(materialOffsetTexture, ivec3(voxelPos), 0).r >= 0) return true;
+
+		vsDistance = min(dis.x, min(dis.y, dis.z));
+		mask = step(dis.xyz, dis.yxy) * step(dis.xyz, dis.zzx);
+		dis += mask * wsRayDirSign * wsRayDirIncrement;
+		voxelPos += mask * wsRayDirSign;
+	}
+	return false;
+}
+
+// Choose the level of the voxel mip chain whose voxels roughly match the
+// width of a ray cone's footprint, vsDistance voxels away from its apex.
+// coneSpread is the growth of the footprint width per unit of distance.
+//
+// Note we won't switch to a coarse level until the ray has travelled at least
+// two of its voxels away from the origin; otherwise the coarse voxel
+// containing the surface the ray departs from would immediately occlude it.
+int rayConeLod(in float vsDistance, in float coneSpread)
+{
+	if (voxelMaxLod <= 0 || coneSpread <= 0) return 0;
+	const int footprintLod = int(floor(log2(max(vsDistance * coneSpread, 1.0))));
+	const int distanceLod = int(floor(log2(max(vsDistance, 1.0)))) - 1;
+	return clamp(min(footprintLod, distanceLod), 0, voxelMaxLod);
+}
+
+// Same as raymarch, but the DDA progressively moves onto coarser levels of the
+// voxel mip chain as the footprint of the ray cone grows. Returns the voxel
+// hit (vsHitPos, in finest level coordinates, marking the lower-left corner of
+// the voxel) and the level it belongs to (hitLod). Voxels at level L are 2^L 
+// times the size of the finest ones.
+bool raymarchCone(in vec3 wsRayOrigin, 
+				  in vec3 wsRayDir,
+				  in float coneSpread,
+				  in int maxSteps,
+				  out vec3 vsHitPos,
+				  out int hitLod)
+{
+	vec3 voxelExtent = vec3(1.0) / (volumeBoundsMax - volumeBoundsMin);
+	wsRayOrigin += sign(wsRayDir) * ISECT_EPSILON;
+	vec3 voxelOrigin = (wsRayOrigin - volumeBoundsMin) * voxelExtent * voxelResolution;
+
+	hitLod = 0;
+	vsHitPos = floor(voxelOrigin);
+	if (any(lessThan(vsHitPos, vec3(0.0))) || 
+		any(greaterThanEqual(vsHitPos,voxelResolution))) return false;
+
+	wsRayDir = mix(wsRayDir, vec3(1e-5), step(abs(wsRayDir), vec3(1e-5)));
+
+	vec3 wsRayDirIncrement = vec3(1.0f) / wsRayDir;
+	vec3 wsRayDirSign = sign(wsRayDir);
+
+	// distance travelled along the ray, measured in finest level voxels
+	float vsDistance = 0;
+	int lod = 0;
+	int steps = 0;
+	bool lodChanged = true;
+	while(lodChanged)
+	{
+		lodChanged = false;
+
+		// (re)start the DDA at the current level from the current position.
+		// The start point is nudged forward so that we don't land on the voxel
+		// we're leaving when the position falls on a voxel boundary.
+		const float lodScale = float(1 << lod);
+		const vec3 lodResolution = vec3((voxelResolution + ivec3((1 << lod) - 1)) >> lod);
+		const float lodStartDistance = vsDistance;
+		const vec3 lodOrigin = (voxelOrigin + (vsDistance + ISECT_EPSILON) * wsRayDir) / lodScale;
+
+		vec3 voxelPos = floor(lodOrigin);
+		vec3 dis = (voxelPos-lodOrigin + 0.5 + wsRayDirSign*0.5) * wsRayDirIncrement;
+		vec3 mask=vec3(0.0);
+
+		while(steps < maxSteps) 
+		{
+			vsHitPos = voxelPos * lodScale;
+			hitLod = lod;
+
+			// break from the traversal if we've gone out of bounds 
+			if (any(lessThan(voxelPos, vec3(0.0))) || 
+				any(greaterThanEqual(voxelPos,lodResolution))) return false;
+
+			if (texelFetch(materialOffsetTexture, ivec3(voxelPos), lod).r >= 0) return true;
+
+			// distance at which we leave the current voxel
+			vsDistance = lodStartDistance + min(dis.x, min(dis.y, dis.z)) * lodScale;
+
+			mask = step(dis.xyz, dis.yxy) * step(dis.xyz, dis.zzx);
+			dis += mask * wsRayDirSign * wsRayDirIncrement;
+			voxelPos += mask * wsRayDirSign;
+			
+			steps++;
+
+			if (rayConeLod(vsDistance, coneSpread) > lod)
+			{
+				lod = rayConeLod(vsDistance, coneSpread);
+				lodChanged = true;
+				break;
+			}
+		}
+	}
+	return false;
+}
+
+bool traverseCone(in vec3 wsRayOrigin, 
+				  in vec3 wsRayDir,
+				  in float coneSpread,
+				  out vec3 vsHitPos, 
+				  out bool hitGround,
+				  out int hitLod)
+{
+	int MAX_STEPS = int(2 * ceil(length(vec3(voxelResolution))));
+	if (raymarchCone(wsRayOrigin, wsRayDir, coneSpread, MAX_STEPS, vsHitPos, hitLod))
+	{
+		hitGround = false;
+		return true;
+	}
+	hitGround = (vsHitPos.y < 0);
+	return hitGround;
+}
+
 
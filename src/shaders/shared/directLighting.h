@@ -0,0 +1,147 @@
+// Light sampling at the vertices of a path, shared by the path tracer and the
+// shading stages of the wavefront path tracer.
+
+// BSDF of the material being shaded. The path tracer may shade any material,
+// whereas each wavefront shading stage handles a single one, and defines its
+// own before including this file.
+#ifndef evaluateShadingBSDF
+#define evaluateShadingBSDF evaluateMaterialBSDF
+#endif
+
+const int LIGHT_SELECTION_POWER = 0;
+const int LIGHT_SELECTION_LIGHT_TREE = 1;
+
+// Choose a light to sample from the given shading point. Returns the index of
+// an emissive voxel (along with the mask of its exposed faces), or -1 for the
+// environment light, and the probability of the choice (0 if no light could
+// be chosen).
+int selectLight(in float u, in Basis wsHitBasis, out float pmf, out int faceMask)
+{
+	if (lightSelectionStrategy == LIGHT_SELECTION_LIGHT_TREE)
+	{
+		return selectLightFromTree(u, wsHitBasis.position, wsHitBasis.normal, pmf, faceMask);
+	}
+	return selectLightByPower(u, pmf, faceMask);
+}
+
+// Probability of choosing the environment light (which, unlike emissive
+// voxels, doesn't depend on the shading point).
+float environmentLightPmf()
+{
+	if (lightSelectionStrategy == LIGHT_SELECTION_LIGHT_TREE)
+	{
+		return LightTree.environmentPmf;
+	}
+	return LightAliasTable.entries[0].pmf;
+}
+
+// Sample the light reaching the shading point from one of the lights, with
+// MIS. Returns the radiance reflected towards wsWo, provided that nothing
+// blocks the shadow ray from the shading point along wsToLight, up to
+// wsShadowRayLength; the caller is left to test the visibility. Returns 0
+// (and no shadow ray needs tracing) when the light sample can't contribute.
+vec3 sampleDirectLighting(in int materialDataOffset,
+						  in Basis wsHitBasis,
+						  in vec3 wsWo,
+						  inout RandomState rng,
+						  out vec3 wsToLight,
+						  out float wsShadowRayLength)
+{
+	vec4 wsToLight_pdf = vec4(0);
+	vec3 lightRadiance;
+	// length of the shadow ray: the ray must reach the light unoccluded
+	wsShadowRayLength = FLT_MAX;
+	wsToLight = vec3(0);
+
+	// Every emissive voxel (that is, each voxel which assigned material
+	// contains non-zero emision) along with the environment make up for all
+	// the lights in the scene. We pick one of them according to its
+	// (estimated) contribution, either globally by its power, or to this
+	// point in particular through the light tree.
+	vec4 u = rand(rng);
+	float lightPmf;
+	int emissiveVoxelFaces;
+	const int emissiveVoxelIndex = selectLight(u.x, wsHitBasis, lightPmf, emissiveVoxelFaces);
+	if (lightPmf <= 0) return vec3(0);
+	const bool samplingEmissiveVoxel = emissiveVoxelIndex >= 0;
+	if (samplingEmissiveVoxel)
+	{
+		// sample light from an emissive voxel
+		ivec3 vsEmissiveVoxelPos = voxelIndexToVoxelPos(emissiveVoxelIndex, voxelResolution);
+		int emissiveVoxelMaterialDataOffset = texelFetch(materialOffsetTexture, vsEmissiveVoxelPos, 0).r;
+		lightRadiance = vec3(10) * emissionBSDF(emissiveVoxelMaterialDataOffset); // FIXME
+
+		// Only the faces of the voxel which aren't covered by a neighbour can
+		// emit light towards the scene. Pick one of them uniformly (they are
+		// all the same size), and a point on it.
+		const int numFaces = bitCount(emissiveVoxelFaces);
+		if (numFaces == 0) return vec3(0);
+		int face = -1;
+		for(int i = min(int(u.w * numFaces), numFaces - 1); i >= 0; --i)
+		{
+			face = findLSB(emissiveVoxelFaces);
+			emissiveVoxelFaces &= ~(1 << face);
+		}
+
+		// faces are ordered +X, -X, +Y, -Y, +Z, -Z
+		const int axis = face >> 1;
+		const bool positiveFace = (face & 1) == 0;
+		vec3 wsLightNormal = vec3(0);
+		wsLightNormal[axis] = positiveFace ? 1.0 : -1.0;
+		vec3 faceOffset;
+		faceOffset[axis] = positiveFace ? 1.0 : 0.0;
+		faceOffset[(axis + 1) % 3] = u.y;
+		faceOffset[(axis + 2) % 3] = u.z;
+		vec3 wsLightPos = (vec3(vsEmissiveVoxelPos) + faceOffset) * wsVoxelSize + volumeBoundsMin;
+
+		vec3 toLight = wsLightPos - wsHitBasis.position;
+		const float r = length(toLight);
+		wsToLight_pdf.xyz = toLight / r;
+
+		// faces only emit light outwards, so there's nothing to gain from a
+		// face pointing away from us.
+		const float cosThetaLight = dot(-wsToLight_pdf.xyz, wsLightNormal);
+		if (cosThetaLight <= 0) return vec3(0);
+
+		// nothing must block the ray before it reaches the sampled point
+		wsShadowRayLength = r;
+
+		// Calculate the area PDF, and then apply the jacobian to express that
+		// same PDF in terms of solid angle (which is what we're integrating)
+		//
+		// cubic voxels, all sides are the same length
+		const float facesArea = numFaces * wsVoxelSize.x * wsVoxelSize.y;
+		const float jacobian = (r*r) / cosThetaLight;
+		wsToLight_pdf.w = jacobian / facesArea;
+	}
+	else
+	{
+		// sample from environment
+		lightRadiance = sampleEnvironmentRadiance(wsHitBasis, u.yz, wsToLight_pdf);
+	}
+
+	// PDF is so far expressed in terms of one light. Account for the
+	// probability of having selected it.
+	wsToLight_pdf.w *= lightPmf;
+	if (wsToLight_pdf.w <= 0) return vec3(0);
+	wsToLight = wsToLight_pdf.xyz;
+
+	// Apply MIS weight for the sampled direction. PBRT2 page 748/749);
+
+	// transform sampled directions to local space, which we need to evaluate
+	// the BSDF
+	vec3 lsWo = worldToLocal(wsWo, wsHitBasis);
+	vec3 lsWi = worldToLocal(wsToLight_pdf.xyz, wsHitBasis);
+	// all the materials only reflect light, so there's nothing to gain from a
+	// light behind the surface (and the microfacet BSDF turns NaN there).
+	if (lsWi.y <= 0) return vec3(0);
+	vec4 bsdfF_pdf = evaluateShadingBSDF(materialDataOffset, lsWo, lsWi);
+
+	float misWeight = powerHeuristic(wsToLight_pdf.w, bsdfF_pdf.w);
+	return bsdfF_pdf.xyz * lightRadiance * abs(dot(wsToLight_pdf.xyz, wsHitBasis.normal)) * misWeight / wsToLight_pdf.w;
+
+	// Note we do the second half, BSDF sampling, on the main integrator loop,
+	// by sampling the BSDF for the next vertex path and calculating the MIS
+	// weight when the ray misses and thus we have implicit visibility with the
+	// environment light.
+}
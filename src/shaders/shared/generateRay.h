@@ -8,11 +8,11 @@ void generateRay_Orthographic(in vec3 fragmentPos,
 
 #ifdef PINHOLE
 void generateRay_Pinhole(in vec3 fragmentPos, 
-						 inout ivec2 rngOffset,
+						 inout RandomState rng,
 						 out vec3 wsRayOrigin, 
 						 out vec3 wsRayDir)
 {
-	vec4 uniformRandomSample = rand(rngOffset);
+	vec4 uniformRandomSample = rand(rng);
 	vec3 jitter =  vec3(uniformRandomSample.x - 0.5,
 					    uniformRandomSample.y - 0.5, 
 						0);
@@ -28,7 +28,7 @@ void generateRay_Pinhole(in vec3 fragmentPos,
 
 #ifdef THINLENS
 void generateRay_ThinLens(in vec3 fragmentPos, 
-						  inout ivec2 rngOffset,
+						  inout RandomState rng,
 						  out vec3 wsRayOrigin, 
 						  out vec3 wsRayDir)
 {
@@ -76,7 +76,7 @@ void generateRay_ThinLens(in vec3 fragmentPos,
 	// the comment above.
 	float cameraFocalDistance = FocalDistanceData.focalDistance;
 
-	vec4 uniformRandomSample = rand(rngOffset);
+	vec4 uniformRandomSample = rand(rng);
 	vec2 unitDiskSample = uniformlySampleDisk(uniformRandomSample.xy);
 	vec3 esLensSamplePoint = vec3(unitDiskSample * cameraLensRadius, 0);
 
@@ -101,18 +101,18 @@ void generateRay_ThinLens(in vec3 fragmentPos,
 }
 #endif
 
-void generateRay(vec3 frag, inout ivec2 rngOffset, out vec3 wsRayOrigin, out vec3 wsRayDir)
+void generateRay(vec3 frag, inout RandomState rng, out vec3 wsRayOrigin, out vec3 wsRayDir)
 {
 	if (cameraLensModel == 0)
 	{
-		generateRay_Pinhole(frag, rngOffset, wsRayOrigin, wsRayDir);
+		generateRay_Pinhole(frag, rng, wsRayOrigin, wsRayDir);
 	}
 	else if(cameraLensModel == 1)
 	{
 #ifdef THINLENS
-		generateRay_ThinLens(frag, rngOffset, wsRayOrigin, wsRayDir);
+		generateRay_ThinLens(frag, rng, wsRayOrigin, wsRayDir);
 #else
-		generateRay_Pinhole(frag, rngOffset, wsRayOrigin, wsRayDir);
+		generateRay_Pinhole(frag, rng, wsRayOrigin, wsRayDir);
 #endif
 	}
 	else
@@ -1,29 +1,121 @@
-// Thomas Wang hash http://www.burtleburtle.net/bob/hash/integer.html
-// Reference from Nathan Reed's blog http://www.reedbeta.com/blog/2013/01/12/quick-and-easy-gpu-random-numbers-in-d3d11/
-int hash(int seed)
+// Owen-scrambled Sobol sampler, following Burley's "Practical Hash-based Owen
+// Scrambling" (JCGT 2020). Random numbers are drawn 4 dimensions at a time;
+// each 4D set is a shuffled and scrambled 4D Sobol sequence, independently
+// randomized per pixel and per set (padding), so consecutive samples of a
+// pixel remain well stratified in each set.
+
+// Pixels are decorrelated as samplerPixelDecorrelation says (see
+// uniformBlocks/uniformBlocksDevice.h).
+
+struct RandomState
+{
+	uvec2 pixel;
+	uint  seed;        // per-pixel seed
+	uint  sampleIndex; // index of the sample within the pixel's sequence
+	uint  dimension;   // next dimension to be drawn
+};
+
+// Sobol direction numbers for dimensions 1-3 (Joe & Kuo). Dimension 0 is the
+// van der Corput sequence, which is just the bit-reversed index.
+const uint sobolDirections[96] = uint[96](
+	0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u, 0xaa000000u, 0xff000000u,
+	0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u, 0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u,
+	0x80008000u, 0xc000c000u, 0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u,
+	0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu, 0xaaaaaaaau, 0xffffffffu,
+
+	0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u, 0x8e000000u, 0xc5000000u,
+	0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u, 0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u,
+	0xe8808000u, 0x5cc0c000u, 0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u,
+	0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu, 0x8e00eeeeu, 0xc5005555u,
+
+	0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u, 0xa2000000u, 0x93000000u,
+	0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u, 0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u,
+	0x208f8000u, 0x51474000u, 0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u,
+	0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u, 0x200200a2u, 0x50050093u
+);
+
+// PCG hash, from Jarzynski & Olano "Hash Functions for GPU Rendering" (JCGT 2020)
+uint hash(uint v)
+{
+	uint state = v * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+uint hashCombine(uint seed, uint v)
+{
+	return seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+uvec4 sobol4D(uint index)
 {
-    seed = (seed ^ 61) ^ (seed >> 16);
-    seed *= 9;
-    seed = seed ^ (seed >> 4);
-    seed *= 0x27d4eb2d;
-    seed = seed ^ (seed >> 15);
-    return seed;
+	uvec4 x = uvec4(bitfieldReverse(index), 0u, 0u, 0u);
+	for(int bit = 0; index != 0u; ++bit, index >>= 1)
+	{
+		if ((index & 1u) != 0u)
+		{
+			x.y ^= sobolDirections[bit];
+			x.z ^= sobolDirections[32 + bit];
+			x.w ^= sobolDirections[64 + bit];
+		}
+	}
+	return x;
 }
 
-ivec2 randomNumberGeneratorOffset(in ivec4 seed, in int sequence)
+uint laineKarrasPermutation(uint x, uint seed)
 {
-	ivec2 res = textureSize(noiseTexture,0);
-	int offset = hash(seed.x + seed.y * res.x) ^ hash(sequence);
-	return ivec2(offset % res.x,  (offset / res.x) % res.y);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return x;
 }
 
-vec4 rand(inout ivec2 offset)
+uint nestedUniformScramble(uint x, uint seed)
 {
-	vec4 randomNumber = texelFetch(noiseTexture, offset, 0);
-	ivec2 res = textureSize(noiseTexture,0);
-	offset.x = (offset.x + 1) % res.x;
-	if (offset.x == 0) offset.y = (offset.y + 1) % res.y;
-	return randomNumber;
+	x = bitfieldReverse(x);
+	x = laineKarrasPermutation(x, seed);
+	x = bitfieldReverse(x);
+	return x;
 }
 
+// Toroidal shift for the given pixel from a rank-1 lattice, using the
+// generalized golden ratio for 4 dimensions (the positive root of x^5 = x + 1)
+vec4 rank1PixelShift(uvec2 pixel)
+{
+	const vec4 alpha = vec4(0.8566748839, 0.7338918566, 0.6287067210, 0.5385972572);
+	return fract(vec4(pixel.x) * alpha + vec4(pixel.y) * alpha.yzwx);
+}
 
+RandomState initRandomState(in ivec2 pixel, in int sampleIndex)
+{
+	RandomState state;
+	state.pixel = uvec2(pixel);
+	state.seed = samplerPixelDecorrelation == 1 ? 0u : hash(hashCombine(hash(uint(pixel.x)), uint(pixel.y)));
+	state.sampleIndex = uint(sampleIndex);
+	state.dimension = 0u;
+	return state;
+}
+
+// Draw the next 4 dimensions of the current sample, in [0,1)
+vec4 rand(inout RandomState state)
+{
+	uint seed = hash(hashCombine(state.seed, state.dimension));
+	state.dimension += 4u;
+
+	uint index = nestedUniformScramble(state.sampleIndex, seed);
+	uvec4 x = sobol4D(index);
+	x.x = nestedUniformScramble(x.x, hashCombine(seed, 0u));
+	x.y = nestedUniformScramble(x.y, hashCombine(seed, 1u));
+	x.z = nestedUniformScramble(x.z, hashCombine(seed, 2u));
+	x.w = nestedUniformScramble(x.w, hashCombine(seed, 3u));
+
+	// keep 24 bits, so the conversion to float doesn't round up to 1
+	vec4 u = vec4(x >> 8u) * exp2(-24.0);
+	if (samplerPixelDecorrelation == 1)
+	{
+		u = min(fract(u + rank1PixelShift(state.pixel)), vec4(0.99999994));
+	}
+	return u;
+}
@@ -1,9 +1,14 @@
-#version 120
+#version 430
+
+#include <uniformBlocks/uniformBlocksDevice.h>
 
 void main()
 {
 	// don't apply any sort of transform on the geometry, this is a screen-space
-	// shader.
-	gl_Position = ftransform();
+	// shader. A single triangle covers the whole viewport (see
+	// Renderer::drawFullscreenTriangle), its vertices made up from their index
+	// so no vertex attributes are needed. It lies on the near plane, which the
+	// integrators rely on to unproject gl_FragCoord.
+	vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+	gl_Position = vec4(position, cameraNear, 1);
 }
-
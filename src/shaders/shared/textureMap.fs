@@ -1,12 +1,37 @@
-#version 130
+#version 430
 
-uniform sampler2D texture;
+// The textures hold the sum of all the samples taken so far for each pixel
+// (rgb), as well as the number of samples (alpha).
+uniform sampler2D accumulationTexture;
 uniform vec4 viewport;
 
+// Reduced resolution image rendered while the user interacts. Only the
+// fraction of the texture given by previewScale is in use, and it is
+// upscaled to cover the viewport.
+uniform sampler2D previewTexture;
+uniform vec2 previewScale = vec2(1);
+
+// Contribution of each of the images to the final result.
+uniform float textureWeight = 1;
+uniform float previewWeight = 0;
+
+uniform float tonemappingGamma = 2.2;
+uniform float tonemappingExposure = 1;
+
 out vec4 outColor;
 
 void main()
 {
-	outColor = texture2D(texture, (gl_FragCoord.xy - viewport.xy) / viewport.zw);
-}
+	vec2 uv = (gl_FragCoord.xy - viewport.xy) / viewport.zw;
+	vec4 sum = textureWeight * texture(accumulationTexture, uv);
+	if (previewWeight > 0)
+	{
+		// don't let the bilinear filtering reach outside the area in use
+		vec2 halfTexel = 0.5 / vec2(textureSize(previewTexture, 0));
+		vec2 previewUV = clamp(uv * previewScale, halfTexel, previewScale - halfTexel);
+		sum += previewWeight * texture(previewTexture, previewUV);
+	}
 
+	vec3 radiance = sum.rgb / max(sum.a, 1e-6);
+	outColor = vec4(pow(radiance * tonemappingExposure, vec3(1.0 / tonemappingGamma)), 1);
+}
@@ -1,4 +1,4 @@
-#version 130
+#version 430
 
 out vec4 outColor;
 
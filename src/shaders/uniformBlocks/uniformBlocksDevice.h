@@ -0,0 +1,43 @@
+// Device-side declaration of the Uniform Buffer Objects shared by all the
+// programs: the camera, the voxel volume and the render settings (see
+// uniformBlocksHost.h). The blocks have no instance name, so their members
+// read like any other uniform.
+
+layout(std140, row_major, binding=0) uniform CameraUniforms_t
+{
+	mat4  cameraProj;
+	mat4  cameraInverseProj;
+	mat4  cameraInverseModelView;
+	vec2  cameraFilmSize;
+	float cameraNear;
+	float cameraFar;
+	float cameraFocalLength;
+	float cameraLensRadius;
+	int   cameraLensModel;
+};
+
+layout(std140, binding=1) uniform VolumeUniforms_t
+{
+	ivec3 voxelResolution;
+	int   voxelMaxLod; // coarsest level of the voxel mip chain in use
+	vec3  volumeBoundsMin;
+	vec3  volumeBoundsMax;
+	vec3  wsVoxelSize; // (boundsMax-boundsMin)/resolution
+};
+
+layout(std140, binding=2) uniform SettingsUniforms_t
+{
+	vec3  backgroundColorTop;
+	int   backgroundUseImage;
+	vec3  backgroundColorBottom;
+	float backgroundIntegral;
+	float backgroundRotationRadians;
+	int   pathtracerMaxNumBounces;
+	int   lightSelectionStrategy; // see RenderSettings::LightSelectionStrategy
+	// 0 = decorrelate pixels by hashing (white noise), 1 = shift all pixels'
+	// sequences by a rank-1 lattice over the image, which spreads the error as
+	// (approximately) blue noise (see shared/random.h).
+	int   samplerPixelDecorrelation;
+	float wireframeOpacity;
+	float wireframeThickness;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+// Host-side declaration of the Uniform Buffer Objects shared by all the
+// programs (see uniformBlocksDevice.h). They follow the std140 layout, where
+// a vec3 takes up 16 bytes unless a scalar fills in the last 4, hence the
+// padding.
+
+typedef struct
+{
+	// stored by rows, as Imath builds them (see Renderer::updateCamera)
+	float cameraProj[16];
+	float cameraInverseProj[16];
+	float cameraInverseModelView[16];
+	float cameraFilmSize[2];
+	float cameraNear;
+	float cameraFar;
+	float cameraFocalLength;
+	float cameraLensRadius;
+	int   cameraLensModel;
+	int   pad;
+} CameraUniforms;
+
+typedef struct
+{
+	int   voxelResolution[3];
+	int   voxelMaxLod;
+	float volumeBoundsMin[3];
+	float pad0;
+	float volumeBoundsMax[3];
+	float pad1;
+	float wsVoxelSize[3];
+	float pad2;
+} VolumeUniforms;
+
+typedef struct
+{
+	float backgroundColorTop[3];
+	int   backgroundUseImage;
+	float backgroundColorBottom[3];
+	float backgroundIntegral;
+	float backgroundRotationRadians;
+	int   pathtracerMaxNumBounces;
+	int   lightSelectionStrategy;
+	int   samplerPixelDecorrelation;
+	float wireframeOpacity;
+	float wireframeThickness;
+	int   pad[2];
+} SettingsUniforms;
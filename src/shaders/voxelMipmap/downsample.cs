@@ -0,0 +1,47 @@
+#version 430
+
+// Build a level of the voxel mip chain from the one below it, as
+// VoxelMipmap::generate does on the CPU: a voxel is occupied if any of its 8
+// children is, and takes the material shared by the majority of its occupied
+// children, resolving ties in favour of the first child found.
+
+layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+
+uniform ivec3 destinationResolution;
+
+layout(r32i, binding = 5) uniform readonly iimage3D sourceLevel;
+layout(r32i, binding = 6) uniform writeonly iimage3D destinationLevel;
+
+void main()
+{
+	ivec3 voxel = ivec3(gl_GlobalInvocationID);
+	if (any(greaterThanEqual(voxel, destinationResolution))) return;
+
+	// children in the same order as on the CPU, x varying fastest
+	int children[8];
+	int numChildren = 0;
+	for(int i = 0; i < 8; ++i)
+	{
+		ivec3 child = 2 * voxel + ivec3(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+		int material = imageLoad(sourceLevel, child).r;
+		if (material >= 0) children[numChildren++] = material;
+	}
+
+	int best = -1;
+	int bestCount = 0;
+	for(int i = 0; i < numChildren; ++i)
+	{
+		int count = 1;
+		for(int j = i + 1; j < numChildren; ++j)
+		{
+			if (children[j] == children[i]) count++;
+		}
+		if (count > bestCount)
+		{
+			best = children[i];
+			bestCount = count;
+		}
+	}
+
+	imageStore(destinationLevel, voxel, ivec4(best));
+}
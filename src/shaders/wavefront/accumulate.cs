@@ -0,0 +1,34 @@
+#version 430
+
+// Wavefront path tracer, last stage: add the radiance carried by each path of
+// the wave onto its pixel, as the path tracer does through blending.
+
+uniform ivec2 waveOrigin; // bottom-left pixel of the wave
+uniform ivec2 waveSize;   // in pixels
+uniform int  accumulateMoments;
+
+layout(rgba32f, binding = 3) uniform image2D accumulation; // sum of samples (rgb), count (alpha)
+layout(r32f, binding = 4) uniform image2D moments;         // sum of squared sample luminances
+
+#include <wavefront/wavefrontStage.h>
+
+void main()
+{
+	const uint path = gl_GlobalInvocationID.x;
+	if (path >= uint(waveSize.x * waveSize.y)) return;
+
+	// converged pixels take no samples
+	const PathState state = WavefrontPaths.paths[path];
+	if (state.bounces < 0) return;
+
+	const ivec2 pixel = waveOrigin + ivec2(path % uint(waveSize.x), path / uint(waveSize.x));
+
+	// each pixel has a single path in the wave, so no other invocation writes
+	// to it
+	imageStore(accumulation, pixel, imageLoad(accumulation, pixel) + vec4(state.radiance, 1));
+	if (accumulateMoments != 0)
+	{
+		const float sampleLuminance = luminance(state.radiance);
+		imageStore(moments, pixel, imageLoad(moments, pixel) + vec4(sampleLuminance * sampleLuminance, 0, 0, 0));
+	}
+}
@@ -0,0 +1,21 @@
+#version 430
+
+// Wavefront path tracer: trace the shadow rays left by the shading stages,
+// and add the light they carry onto their paths when nothing blocks them.
+
+#include <wavefront/wavefrontStage.h>
+
+void main()
+{
+	if (gl_GlobalInvocationID.x >= WavefrontQueueCounters.shadowQueueSize) return;
+	const uint path = WavefrontQueues.entries[shadowQueueEntry(gl_GlobalInvocationID.x)];
+
+	// for an emissive voxel, nothing must be hit before reaching it, whereas
+	// for the environment light the ray must not hit anything in the scene.
+	if (!occluded(WavefrontPaths.paths[path].wsRayOrigin,
+				  WavefrontPaths.paths[path].wsShadowRayDir,
+				  WavefrontPaths.paths[path].wsShadowRayLength))
+	{
+		WavefrontPaths.paths[path].radiance += WavefrontPaths.paths[path].shadowRadiance;
+	}
+}
@@ -0,0 +1,51 @@
+#version 430
+
+// Wavefront path tracer: turn the sizes of the queues filled by the last
+// stage into the number of work groups of the stages which consume them
+// (see glDispatchComputeIndirect), and empty the queues consumed by the last
+// stage. This runs on a single invocation between stages, so the queues never
+// need to be read back.
+
+uniform int queues; // which queues were filled, see WAVEFRONT_QUEUES_* in wavefrontHost.h
+
+const int QUEUES_SHADE = 0;  // after the extend stage
+const int QUEUES_EXTEND = 1; // after the generate and shading stages
+
+#include <wavefront/wavefrontStage.h>
+
+uint workGroups(uint queueSize)
+{
+	return (queueSize + WAVEFRONT_GROUP_SIZE - 1) / WAVEFRONT_GROUP_SIZE;
+}
+
+void main()
+{
+	if (gl_GlobalInvocationID.x != 0) return;
+
+	if (queues == QUEUES_SHADE)
+	{
+		for(int material = 0; material < WAVEFRONT_NUM_MATERIALS; ++material)
+		{
+			WavefrontQueueCounters.shadeDispatch[material * 3 + 0] = workGroups(WavefrontQueueCounters.shadeQueueSize[material]);
+			WavefrontQueueCounters.shadeDispatch[material * 3 + 1] = 1u;
+			WavefrontQueueCounters.shadeDispatch[material * 3 + 2] = 1u;
+		}
+		// the shading stages queue the extended paths again, along with their
+		// shadow rays
+		WavefrontQueueCounters.extendQueueSize = 0u;
+		WavefrontQueueCounters.shadowQueueSize = 0u;
+	}
+	else
+	{
+		WavefrontQueueCounters.extendDispatch[0] = workGroups(WavefrontQueueCounters.extendQueueSize);
+		WavefrontQueueCounters.extendDispatch[1] = 1u;
+		WavefrontQueueCounters.extendDispatch[2] = 1u;
+		WavefrontQueueCounters.connectDispatch[0] = workGroups(WavefrontQueueCounters.shadowQueueSize);
+		WavefrontQueueCounters.connectDispatch[1] = 1u;
+		WavefrontQueueCounters.connectDispatch[2] = 1u;
+		for(int material = 0; material < WAVEFRONT_NUM_MATERIALS; ++material)
+		{
+			WavefrontQueueCounters.shadeQueueSize[material] = 0u;
+		}
+	}
+}
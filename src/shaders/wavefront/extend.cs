@@ -0,0 +1,74 @@
+#version 430
+
+// Wavefront path tracer: find the voxel hit by the ray of each path in the
+// extend queue, and sort the paths by the material hit into the shading
+// queues. Rays leaving the scene pick up the environment light (with MIS for
+// bounce rays, as in the path tracer).
+
+#include <wavefront/wavefrontStage.h>
+#include <shared/directLighting.h>
+
+void main()
+{
+	if (gl_GlobalInvocationID.x >= WavefrontQueueCounters.extendQueueSize) return;
+	const uint path = WavefrontQueues.entries[extendQueueEntry(gl_GlobalInvocationID.x)];
+	PathState state = WavefrontPaths.paths[path];
+
+	vec3 vsHitPos;
+	bool hitGround;
+	int hitLod = 0;
+	bool hit;
+	if (state.bounces == 0)
+	{
+		// primary rays start at the volume bounds, and are traced at full
+		// resolution
+		const float aabbIsectDist = rayAABBIntersection(state.wsRayOrigin, state.wsRayDir,
+														volumeBoundsMin, volumeBoundsMax);
+		const vec3 wsRayEntryPoint = state.wsRayOrigin + aabbIsectDist * state.wsRayDir;
+		hit = traverse(wsRayEntryPoint, state.wsRayDir, vsHitPos, hitGround);
+	}
+	else
+	{
+		hit = traverseCone(state.wsRayOrigin, state.wsRayDir, state.coneSpread, vsHitPos, hitGround, hitLod);
+	}
+
+	if (!hit)
+	{
+		if (state.bounces == 0)
+		{
+			WavefrontPaths.paths[path].radiance = getBackgroundColor(state.wsRayDir);
+		}
+		else
+		{
+			// the ray missed the scene. Handle the environment light here.
+			vec4 lightL_pdf = evaluateEnvironmentRadiance(state.wsRayDir);
+			// the light sampling strategy picks the environment light only
+			// part of the time
+			lightL_pdf.w *= environmentLightPmf();
+			float misWeight = powerHeuristic(state.bsdfPdf, lightL_pdf.w);
+			WavefrontPaths.paths[path].radiance = state.radiance + state.throughput * lightL_pdf.xyz * misWeight;
+		}
+		return;
+	}
+
+	// the path is complete
+	if (state.bounces >= pathtracerMaxNumBounces) return;
+
+	ivec3 iVsHitPos = ivec3(vsHitPos);
+	if ( hitLod == 0 && iVsHitPos == SelectVoxelData.index.xyz )
+	{
+		// Draw selected voxel as red
+		WavefrontPaths.paths[path].radiance = state.radiance + vec3(1,0,0);
+		return;
+	}
+
+	const int materialDataOffset = texelFetch(materialOffsetTexture, iVsHitPos >> hitLod, hitLod).r;
+	const int materialType = int(texelFetch(materialDataTexture, materialDataOffset, 0).r);
+	// unknown materials reflect no light
+	if (materialType < 0 || materialType >= WAVEFRONT_NUM_MATERIALS) return;
+
+	WavefrontPaths.paths[path].vsHitPos = vsHitPos;
+	WavefrontPaths.paths[path].hitLod = hitLod;
+	WavefrontPaths.paths[path].materialDataOffset = materialDataOffset;
+	pushShadeQueue(materialType, path);
+}
@@ -0,0 +1,64 @@
+#version 430
+
+// Wavefront path tracer, first stage: start a path through each pixel of the
+// wave (a rectangle of the image, one path per pixel in scanline order), and
+// queue those which enter the volume to be extended. Rays missing it already
+// carry the background.
+
+uniform ivec2 waveOrigin; // bottom-left pixel of the wave
+uniform ivec2 waveSize;   // in pixels
+
+#include <wavefront/wavefrontStage.h>
+
+void main()
+{
+	const uint path = gl_GlobalInvocationID.x;
+	if (path >= uint(waveSize.x * waveSize.y)) return;
+
+	PathState state;
+	state.coneSpread = 0;
+	state.bsdfPdf = 0;
+	state.throughput = vec3(1.0);
+	state.bounces = 0;
+	state.radiance = vec3(0.0);
+	state.materialDataOffset = -1;
+	state.vsHitPos = vec3(0);
+	state.hitLod = 0;
+	state.wsShadowRayDir = vec3(0);
+	state.wsShadowRayLength = 0;
+	state.shadowRadiance = vec3(0);
+
+	const ivec2 pixel = waveOrigin + ivec2(path % uint(waveSize.x), path / uint(waveSize.x));
+
+	// the fragment the path tracer would shade for this pixel, on the
+	// triangle drawn by Renderer::drawFullscreenTriangle
+	const vec3 fragCoord = vec3(vec2(pixel) + 0.5, 0.5 * cameraNear + 0.5);
+
+	// as in the path tracer, the sample sequences follow the pixel of the
+	// whole image
+	RandomState rng = initRandomState(pixel - ivec2(viewport.xy), sampleCount);
+	if (pixelConverged(fragCoord.xy))
+	{
+		state.bounces = -1;
+		storeRandomState(state, rng);
+		WavefrontPaths.paths[path] = state;
+		return;
+	}
+
+	generateRay(fragCoord, rng, state.wsRayOrigin, state.wsRayDir);
+	storeRandomState(state, rng);
+
+	// test intersection with bounds to trivially discard rays before entering
+	// traversal.
+	const float aabbIsectDist = rayAABBIntersection(state.wsRayOrigin, state.wsRayDir,
+													volumeBoundsMin, volumeBoundsMax);
+	if (aabbIsectDist < 0)
+	{
+		state.radiance = getBackgroundColor(state.wsRayDir);
+		WavefrontPaths.paths[path] = state;
+		return;
+	}
+
+	WavefrontPaths.paths[path] = state;
+	pushExtendQueue(path);
+}
@@ -0,0 +1,125 @@
+#version 430
+
+// Wavefront path tracer: shade the paths which hit the material given by
+// SHADE_MATERIAL (one of MATERIAL_MATTE, MATERIAL_METAL or MATERIAL_PLASTIC,
+// see materials.h). This program is built once per material, so the BSDF code
+// is the same for all the paths being shaded, rather than switching on the
+// material of each one.
+//
+// Each path samples a light, which leaves a shadow ray to be traced by the
+// connect stage, and then samples its BSDF to continue the path, which is
+// queued to be extended again.
+
+#include <wavefront/wavefrontStage.h>
+
+#if SHADE_MATERIAL == MATERIAL_MATTE
+	#define evaluateShadedMaterialBSDF evaluateMaterialBSDF_Matte
+	#define sampleShadedMaterialBSDF   sampleMaterialBSDF_Matte
+	#define emissionShadedMaterialBSDF emissionMaterialBSDF_Matte
+#elif SHADE_MATERIAL == MATERIAL_METAL
+	#define evaluateShadedMaterialBSDF evaluateMaterialBSDF_Metal
+	#define sampleShadedMaterialBSDF   sampleMaterialBSDF_Metal
+	#define emissionShadedMaterialBSDF emissionMaterialBSDF_Metal
+#elif SHADE_MATERIAL == MATERIAL_PLASTIC
+	#define evaluateShadedMaterialBSDF evaluateMaterialBSDF_Plastic
+	#define sampleShadedMaterialBSDF   sampleMaterialBSDF_Plastic
+	#define emissionShadedMaterialBSDF emissionMaterialBSDF_Plastic
+#endif
+
+// light samples are evaluated for the material being shaded too. Its
+// parameters follow its type in the material data.
+#define evaluateShadingBSDF(materialDataOffset, lsWo, lsWi) \
+	evaluateShadedMaterialBSDF((materialDataOffset) + 1, lsWo, lsWi)
+#include <shared/directLighting.h>
+
+void main()
+{
+	if (gl_GlobalInvocationID.x >= WavefrontQueueCounters.shadeQueueSize[SHADE_MATERIAL]) return;
+	const uint path = WavefrontQueues.entries[shadeQueueEntry(SHADE_MATERIAL, gl_GlobalInvocationID.x)];
+	PathState state = WavefrontPaths.paths[path];
+	RandomState rng = pathRandomState(state);
+
+	// convert hit position from voxel space to world space, along with the
+	// basis for the local<->world space conversions.
+	Basis wsHitBasis;
+	voxelSpaceToWorldSpace(state.vsHitPos,
+						   state.wsRayOrigin, state.wsRayDir,
+						   state.hitLod,
+						   wsHitBasis);
+	const int materialDataOffset = state.materialDataOffset;
+
+	// the salient direction for the incoming light, bounced back though the
+	// current ray.
+	vec3 wsWo = -state.wsRayDir;
+	vec3 lsWo = worldToLocal(wsWo, wsHitBasis);
+
+	// add emission from surface
+	if ( state.bounces == 0 )
+	{
+		vec3 Le = emissionShadedMaterialBSDF(materialDataOffset + 1);
+		state.radiance += state.throughput * Le;
+	}
+
+	// Sample illumination from lights to find path contribution, once the
+	// connect stage finds the light is visible
+	vec3 wsToLight;
+	float wsShadowRayLength;
+	const vec3 lightRadiance = sampleDirectLighting(materialDataOffset,
+													wsHitBasis,
+													wsWo,
+													rng,
+													wsToLight,
+													wsShadowRayLength);
+	const bool castShadowRay = lightRadiance != vec3(0);
+	state.shadowRadiance = state.throughput * lightRadiance;
+	state.wsShadowRayDir = wsToLight;
+	state.wsShadowRayLength = wsShadowRayLength;
+
+	// Sample the BSDF to get the new path direction
+	vec4 bsdfF_pdf;
+	vec3 lsWi = sampleShadedMaterialBSDF(materialDataOffset + 1,
+										 lsWo,
+										 rng,
+										 bsdfF_pdf);
+	// no direction to carry on in. Dividing by the zero pdf would leave a NaN
+	// throughput, so the path ends here, once its light sample is connected.
+	const bool continuePath = bsdfF_pdf.w > 0;
+
+	// Wireframe overlay
+	if (wireframeOpacity > 0)
+	{
+		vec3 vsVoxelCenter = (wsHitBasis.position - volumeBoundsMin) / (volumeBoundsMax - volumeBoundsMin) * voxelResolution;
+		vec3 uvw = state.vsHitPos - vsVoxelCenter;
+		vec2 uv = abs(vec2(dot(wsHitBasis.normal.yzx, uvw), dot( wsHitBasis.normal.zxy, uvw)));
+		float wireframe = step(wireframeThickness, uv.x) * step(uv.x, 1-wireframeThickness) *
+						  step(wireframeThickness, uv.y) * step(uv.y, 1-wireframeThickness);
+
+		wireframe = (1-wireframeOpacity) + wireframeOpacity * wireframe;
+		bsdfF_pdf.xyz *= vec3(wireframe);
+	}
+
+	// the shadow ray starts at the hit point, as does the new ray
+	state.wsRayOrigin = wsHitBasis.position;
+
+	if (continuePath)
+	{
+		vec3 wsWi = localToWorld(lsWi, wsHitBasis);
+
+		// update throughput
+		state.throughput *= (bsdfF_pdf.xyz * abs(dot(wsWi, wsHitBasis.normal)) / bsdfF_pdf.w);
+
+		state.wsRayDir = wsWi;
+		state.bsdfPdf = bsdfF_pdf.w;
+
+		// Approximate the spread of the new ray cone as the width, at unit
+		// distance, of the solid angle covered by the sampled direction (1/pdf).
+		state.coneSpread = sqrt(1.0 / max(bsdfF_pdf.w, 1e-4));
+
+		state.bounces++;
+	}
+	storeRandomState(state, rng);
+	WavefrontPaths.paths[path] = state;
+
+	if (castShadowRay) pushShadowQueue(path);
+	if (continuePath) pushExtendQueue(path);
+}
@@ -0,0 +1,87 @@
+// Device-side declaration of the Shader Storage Objects holding the state of
+// the paths traced by the wavefront path tracer, and the queues of paths
+// waiting on each of its stages (see wavefrontHost.h).
+
+// number of materials with a shading stage of their own (see materials.h)
+#define WAVEFRONT_NUM_MATERIALS 3
+// work group size of the stages processing a queue of paths
+#define WAVEFRONT_GROUP_SIZE 64
+
+struct PathState
+{
+	vec3  wsRayOrigin;
+	float coneSpread;        // see traverseCone, 0 for primary rays
+	vec3  wsRayDir;
+	float bsdfPdf;           // of the BSDF sample the ray was generated from
+	vec3  throughput;
+	int   bounces;           // -1 for converged pixels, which take no sample
+	vec3  radiance;          // carried by the path so far
+	int   materialDataOffset;
+	vec3  vsHitPos;          // voxel hit by the ray (see traverseCone)
+	int   hitLod;
+	vec3  wsShadowRayDir;    // shadow ray cast from wsRayOrigin
+	float wsShadowRayLength;
+	vec3  shadowRadiance;    // reaching the path if the shadow ray is unoccluded
+	uint  rngSeed;           // RandomState of the pixel's sample
+	uvec2 pixel;
+	uint  sampleIndex;
+	uint  rngDimension;
+};
+
+layout(std430, binding=4) buffer WavefrontPaths_t
+{
+	PathState paths[];
+} WavefrontPaths;
+
+// Queues of indices into WavefrontPaths, one after the other: paths whose ray
+// is to be extended, paths which hit each material and are to be shaded, and
+// paths with a shadow ray to be traced. Each queue has room for all the paths.
+layout(std430, binding=5) buffer WavefrontQueues_t
+{
+	uint entries[];
+} WavefrontQueues;
+
+layout(std430, binding=6) buffer WavefrontQueueCounters_t
+{
+	uint capacity;           // paths in WavefrontPaths
+	uint extendQueueSize;
+	uint shadeQueueSize[WAVEFRONT_NUM_MATERIALS];
+	uint shadowQueueSize;
+	// indirect dispatch arguments of the stages consuming each queue
+	uint extendDispatch[3];
+	uint shadeDispatch[3 * WAVEFRONT_NUM_MATERIALS];
+	uint connectDispatch[3];
+} WavefrontQueueCounters;
+
+uint extendQueueEntry(uint i)
+{
+	return i;
+}
+
+uint shadeQueueEntry(int material, uint i)
+{
+	return (1 + material) * WavefrontQueueCounters.capacity + i;
+}
+
+uint shadowQueueEntry(uint i)
+{
+	return (1 + WAVEFRONT_NUM_MATERIALS) * WavefrontQueueCounters.capacity + i;
+}
+
+void pushExtendQueue(uint path)
+{
+	const uint i = atomicAdd(WavefrontQueueCounters.extendQueueSize, 1u);
+	WavefrontQueues.entries[extendQueueEntry(i)] = path;
+}
+
+void pushShadeQueue(int material, uint path)
+{
+	const uint i = atomicAdd(WavefrontQueueCounters.shadeQueueSize[material], 1u);
+	WavefrontQueues.entries[shadeQueueEntry(material, i)] = path;
+}
+
+void pushShadowQueue(uint path)
+{
+	const uint i = atomicAdd(WavefrontQueueCounters.shadowQueueSize, 1u);
+	WavefrontQueues.entries[shadowQueueEntry(i)] = path;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// Host-side declaration of the Shader Storage Objects used by the wavefront
+// path tracer: the state of each path being traced, and the queues of paths
+// waiting on each stage, along with their sizes (see wavefrontDevice.h).
+
+// number of materials with a shading stage of their own (see
+// Material::MaterialType)
+#define WAVEFRONT_NUM_MATERIALS 3
+// work group size of the stages processing a queue of paths
+#define WAVEFRONT_GROUP_SIZE 64
+
+typedef struct
+{
+	float        wsRayOrigin[3];
+	float        coneSpread;
+	float        wsRayDir[3];
+	float        bsdfPdf;
+	float        throughput[3];
+	int          bounces;
+	float        radiance[3];
+	int          materialDataOffset;
+	float        vsHitPos[3];
+	int          hitLod;
+	float        wsShadowRayDir[3];
+	float        wsShadowRayLength;
+	float        shadowRadiance[3];
+	unsigned int rngSeed;
+	unsigned int pixel[2];
+	unsigned int sampleIndex;
+	unsigned int rngDimension;
+} WavefrontPathState;
+
+typedef struct
+{
+	unsigned int capacity;        // paths the buffers have room for
+	unsigned int extendQueueSize;
+	unsigned int shadeQueueSize[WAVEFRONT_NUM_MATERIALS];
+	unsigned int shadowQueueSize;
+	// indirect dispatch arguments (work groups in x, y and z) of the stages
+	// consuming each queue
+	unsigned int extendDispatch[3];
+	unsigned int shadeDispatch[WAVEFRONT_NUM_MATERIALS][3];
+	unsigned int connectDispatch[3];
+} WavefrontQueueCounters;
+
+// Number of queue entries per path: the extend, shade (one per material) and
+// shadow ray queues.
+#define WAVEFRONT_QUEUES_PER_PATH (WAVEFRONT_NUM_MATERIALS + 2)
+
+// Queues filled by the last stage, whose sizes are to be turned into the work
+// groups of the stages consuming them (see wavefront/dispatch.cs)
+#define WAVEFRONT_QUEUES_SHADE  0 // after the extend stage
+#define WAVEFRONT_QUEUES_EXTEND 1 // after the generate and shading stages
@@ -0,0 +1,61 @@
+// Declarations shared by all the stages of the wavefront path tracer. They
+// take the same uniforms as the path tracer (see integrator/pathTracer.fs),
+// which they reproduce one stage at a time.
+
+#include <focalDistance/focalDistanceDevice.h>
+#include <editVoxels/selectVoxelDevice.h>
+#include <lightSampling/lightAliasTableDevice.h>
+#include <lightSampling/lightTreeDevice.h>
+#include <wavefront/wavefrontDevice.h>
+#include <uniformBlocks/uniformBlocksDevice.h>
+
+uniform isampler3D  materialOffsetTexture;
+uniform sampler1D   materialDataTexture;
+
+uniform vec4        viewport;
+
+uniform vec3        groundColor = vec3(0.5, 0.5, 0.5);
+uniform sampler2D   backgroundTexture;
+uniform usampler2D  backgroundAliasUTexture;
+uniform usampler1D  backgroundAliasVTexture;
+
+uniform int         sampleCount;
+
+#include <shared/constants.h>
+#include <shared/aabb.h>
+#include <shared/coordinates.h>
+#include <shared/dda.h>
+#include <shared/sampling.h>
+#include <shared/random.h>
+#include <shared/generateRay.h>
+#include <bsdf/lambertian.h>
+#include <bsdf/microfacet.h>
+#include <bsdf/bsdf.h>
+#include <materials/matte.h>
+#include <materials/metal.h>
+#include <materials/plastic.h>
+#include <materials/materials.h>
+#include <shared/lights.h>
+#include <shared/adaptiveSampling.h>
+
+layout(local_size_x = WAVEFRONT_GROUP_SIZE) in;
+
+// The state of the path's random number generator, so the path picks up its
+// sample where the previous stage left it.
+RandomState pathRandomState(in PathState path)
+{
+	RandomState rng;
+	rng.pixel = path.pixel;
+	rng.seed = path.rngSeed;
+	rng.sampleIndex = path.sampleIndex;
+	rng.dimension = path.rngDimension;
+	return rng;
+}
+
+void storeRandomState(inout PathState path, in RandomState rng)
+{
+	path.pixel = rng.pixel;
+	path.rngSeed = rng.seed;
+	path.sampleIndex = rng.sampleIndex;
+	path.rngDimension = rng.dimension;
+}
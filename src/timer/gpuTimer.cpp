@@ -9,6 +9,10 @@ GpuTimer::GpuTimer()
 {
 	memset(m_queries, 0, NUM_QUEUED_SAMPLES * 2 * sizeof(GLuint));
 	m_nextQueryIndex = 0;
+	m_numPendingQueries = 0;
+	m_numDiscardedQueries = 0;
+	m_measuring = false;
+	m_discardMeasurement = false;
 }
 
 GpuTimer::~GpuTimer()
@@ -32,40 +36,69 @@ void GpuTimer::init()
 
 void GpuTimer::sampleBegin()
 {
+	// If the GPU is lagging so far behind that none of the queries has been
+	// resolved yet, skip this measurement rather than waiting for them.
+	m_measuring = m_numPendingQueries < NUM_QUEUED_SAMPLES;
+	if (!m_measuring) return;
+
 	glQueryCounter(m_queries[m_nextQueryIndex][0], GL_TIMESTAMP);
+	m_discardMeasurement = false;
 }
 
-void GpuTimer::sampleEnd()
+void GpuTimer::sampleEnd(float weight)
 {
+	if (!m_measuring) return;
+
 	glQueryCounter(m_queries[m_nextQueryIndex][1], GL_TIMESTAMP);
+	m_weights[m_nextQueryIndex] = weight;
 	m_nextQueryIndex = (m_nextQueryIndex + 1) % NUM_QUEUED_SAMPLES;
+	m_numPendingQueries++;
+	if (m_discardMeasurement) m_numDiscardedQueries++;
+	m_measuring = false;
 }
 
-float GpuTimer::lastSampleTime() const
+bool GpuTimer::collectSample(float& seconds, float& weight)
 {
-	int lastSample = m_nextQueryIndex - 1;
-	if ( lastSample < 0 ) lastSample += NUM_QUEUED_SAMPLES;
-	
-	// wait for second result to be available (first one will be implicitly
-	// available as well, since it was issued before).
-	// Because we're double-buffering the queries, the samples should be
-	// immediately available since the last frame's command buffer should be
-	// processed by now.
-	GLint timerAvailable = 0;
-	while (!timerAvailable)
+	// the results of discarded queries are retrieved all the same, so the
+	// queries can be reused, and then ignored.
+	while (collectQuery(seconds, weight))
 	{
-		glGetQueryObjectiv(m_queries[lastSample][1], GL_QUERY_RESULT_AVAILABLE, &timerAvailable);
+		if (m_numDiscardedQueries == 0) return true;
+		m_numDiscardedQueries--;
 	}
+	return false;
+}
+
+void GpuTimer::discardPendingSamples()
+{
+	m_numDiscardedQueries = m_numPendingQueries;
+	if (m_measuring) m_discardMeasurement = true;
+}
+
+bool GpuTimer::collectQuery(float& seconds, float& weight)
+{
+	if (m_numPendingQueries == 0) return false;
+
+	int oldestSample = m_nextQueryIndex - (int)m_numPendingQueries;
+	if ( oldestSample < 0 ) oldestSample += NUM_QUEUED_SAMPLES;
+	
+	// check whether the second result is available (first one will be
+	// implicitly available as well, since it was issued before).
+	GLint timerAvailable = 0;
+	glGetQueryObjectiv(m_queries[oldestSample][1], GL_QUERY_RESULT_AVAILABLE, &timerAvailable);
+	if (!timerAvailable) return false;
 	
 	// get query results
 	GLuint64 startTime, endTime;
-	glGetQueryObjectui64v(m_queries[lastSample][0], GL_QUERY_RESULT, &startTime);
-	glGetQueryObjectui64v(m_queries[lastSample][1], GL_QUERY_RESULT, &endTime);
+	glGetQueryObjectui64v(m_queries[oldestSample][0], GL_QUERY_RESULT, &startTime);
+	glGetQueryObjectui64v(m_queries[oldestSample][1], GL_QUERY_RESULT, &endTime);
+	m_numPendingQueries--;
 
 	GLuint64 nanoseconds = endTime - startTime;
-	float seconds = float(nanoseconds) / 1000000000.0;
+	seconds = float(nanoseconds) / 1000000000.0;
+	weight = m_weights[oldestSample];
 
-	return seconds;
+	return true;
 }
 
 AveragedGpuTimer::AveragedGpuTimer()
@@ -73,12 +106,14 @@ AveragedGpuTimer::AveragedGpuTimer()
 	m_numSamples = 0;
 	m_sampleCapacity = 0;
 	m_sampledTimes = NULL;
-	m_nextSampleIndex = -1;
+	m_sampledWeights = NULL;
+	m_nextSampleIndex = 0;
 }
 
 AveragedGpuTimer::~AveragedGpuTimer()
 {
 	free(m_sampledTimes);
+	free(m_sampledWeights);
 }
 
 void AveragedGpuTimer::init(unsigned int numAveragedSamples)
@@ -86,24 +121,27 @@ void AveragedGpuTimer::init(unsigned int numAveragedSamples)
 	m_timer.init();
 	m_sampleCapacity = numAveragedSamples;
 	m_sampledTimes = (float*)malloc(m_sampleCapacity * sizeof(float));
+	m_sampledWeights = (float*)malloc(m_sampleCapacity * sizeof(float));
 }
 
 void AveragedGpuTimer::sampleBegin()
 {
-	if ( m_numSamples > 0 )
+	// before starting a new measurement, collect all the previous ones which
+	// are ready by now
+	float seconds, weight;
+	while( m_timer.collectSample(seconds, weight) )
 	{
-		// before starting a new measurement, collect the last one, which should
-		// be ready by now
-		m_sampledTimes[m_nextSampleIndex] = m_timer.lastSampleTime();
+		m_sampledTimes[m_nextSampleIndex] = seconds;
+		m_sampledWeights[m_nextSampleIndex] = weight;
+		m_numSamples = std::min(m_numSamples + 1, m_sampleCapacity);
+		m_nextSampleIndex = (m_nextSampleIndex + 1) % m_sampleCapacity;
 	}
-	m_numSamples = std::min(m_numSamples + 1, m_sampleCapacity);
-	m_nextSampleIndex = (m_nextSampleIndex + 1) % m_sampleCapacity;
 	m_timer.sampleBegin();
 }
 
-void AveragedGpuTimer::sampleEnd()
+void AveragedGpuTimer::sampleEnd(float weight)
 {
-	m_timer.sampleEnd();
+	m_timer.sampleEnd(weight);
 }
 
 float AveragedGpuTimer::averageSampleTime() const
@@ -111,12 +149,21 @@ float AveragedGpuTimer::averageSampleTime() const
 	if ( m_numSamples == 0 ) return 0.0f;
 
 	float totalSeconds = 0;
+	float totalWeight = 0;
 	for( unsigned int i = 0; i < m_numSamples; ++i )
 	{
-		int index = m_nextSampleIndex - m_numSamples + i;	
+		int index = m_nextSampleIndex - (int)m_numSamples + (int)i;
 		if(index < 0) index += m_sampleCapacity;
 
-		totalSeconds += m_sampledTimes[i];
+		totalSeconds += m_sampledTimes[index];
+		totalWeight += m_sampledWeights[index];
 	}
-	return totalSeconds / m_numSamples;
+	return totalWeight > 0 ? totalSeconds / totalWeight : 0.0f;
+}
+
+void AveragedGpuTimer::reset()
+{
+	m_timer.discardPendingSamples();
+	m_numSamples = 0;
+	m_nextSampleIndex = 0;
 }
@@ -2,6 +2,9 @@
 
 #include <GL/gl.h>
 
+// Measures GPU time through timestamp queries. Results are retrieved
+// asynchronously, a few frames after being issued, so the CPU never stalls
+// waiting for the GPU to catch up.
 class GpuTimer
 {
 public:
@@ -10,13 +13,33 @@ public:
 
 	void init();
 	void sampleBegin();
-	void sampleEnd();
-	float lastSampleTime() const;
+	// Each measurement can be given a weight (e.g. the amount of work done
+	// between sampleBegin and sampleEnd), which is returned along with the
+	// measured time.
+	void sampleEnd(float weight = 1.0f);
+	// Retrieve the oldest measurement whose result is available. Returns false
+	// if there is none, without waiting for the GPU.
+	bool collectSample(float& seconds, float& weight);
+	// Drop the measurements still in flight, including the current one if
+	// sampleEnd hasn't been called yet. Their results are never collected.
+	void discardPendingSamples();
 
 private:
-	static const unsigned int NUM_QUEUED_SAMPLES = 2;
+	// Retrieve the oldest pending query, whether discarded or not.
+	bool collectQuery(float& seconds, float& weight);
+
+	static const unsigned int NUM_QUEUED_SAMPLES = 4;
 	GLuint m_queries[NUM_QUEUED_SAMPLES][2];
+	float m_weights[NUM_QUEUED_SAMPLES];
 	int m_nextQueryIndex;
+	unsigned int m_numPendingQueries;
+	// how many of the oldest pending queries were discarded
+	unsigned int m_numDiscardedQueries;
+	// false if the current measurement was dropped because all the queries
+	// were still in flight.
+	bool m_measuring;
+	// whether the current measurement was discarded before it ended
+	bool m_discardMeasurement;
 };
 
 class AveragedGpuTimer
@@ -27,11 +50,17 @@ public:
 
 	void init(unsigned int numAveragedSamples = 10);
 	void sampleBegin();
-	void sampleEnd();
+	void sampleEnd(float weight = 1.0f);
+	// Average time per unit of weight over the last collected measurements,
+	// or 0 if no measurement is available yet.
 	float averageSampleTime() const;
+	// Discard all the measurements, including those still in flight, e.g.
+	// once the work being measured changes.
+	void reset();
 private:
 	GpuTimer m_timer;
 	float* m_sampledTimes;
+	float* m_sampledWeights;
 	unsigned int m_numSamples;
 	unsigned int m_sampleCapacity;
 	int m_nextSampleIndex;
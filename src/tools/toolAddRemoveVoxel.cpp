@@ -73,3 +73,17 @@ bool ToolAddRemoveVoxel::mouseMoveEvent(QMouseEvent *event, QSize widgetDimensio
     return false; // don't kill the event, let the camera process it as well
 }
 
+bool ToolAddRemoveVoxel::mouseReleaseEvent(QMouseEvent* event, QSize widgetDimensions)
+{
+	const float fx = (float)event->pos().x() / widgetDimensions.width(); 
+	const float fy = (float)event->pos().y() / widgetDimensions.height();
+
+	// let the renderer catch up with the voxels added or removed during the
+	// stroke
+	m_renderer.requestAction(fx, fy,
+							 0, 0,
+							 Action::PA_END_EDIT,
+							 false);
+
+	return false;
+}
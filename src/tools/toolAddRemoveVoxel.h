@@ -9,6 +9,7 @@ public:
 	ToolAddRemoveVoxel(Renderer& renderer) : m_renderer(renderer) {}
 	virtual bool mousePressEvent(QMouseEvent* /*event*/, QSize /*widgetDimensions*/);
 	virtual bool mouseMoveEvent(QMouseEvent *event, QSize widgetDimensions);
+	virtual bool mouseReleaseEvent(QMouseEvent* event, QSize widgetDimensions);
 
 private:
 	Renderer& m_renderer;
@@ -18,8 +18,18 @@
 #define _STRINGIFY(x) #x
 #define STRINGIFY(x) _STRINGIFY(x)
 
+// The renderer sticks to the core profile, which spares the driver from
+// validating calls against the compatibility one.
+static QGLFormat glFormat()
+{
+	QGLFormat format(QGL::SampleBuffers);
+	format.setVersion(4, 5);
+	format.setProfile(QGLFormat::CoreProfile);
+	return format;
+}
+
 GLWidget::GLWidget(QWidget *parent)
-     : QGLWidget(QGLFormat(QGL::SampleBuffers), parent)
+     : QGLWidget(glFormat(), parent)
 {
     m_resolutionMode = RenderPropertiesUI::RM_MATCH_WINDOW;
 	m_resolutionLongestAxis = 1024;
@@ -48,6 +58,8 @@ void GLWidget::initializeGL()
 #ifdef QT5
 	initializeOpenGLFunctions();
 #else
+	// core profile entry points aren't found otherwise
+	glewExperimental = GL_TRUE;
 	glewInit();
 #endif
 
@@ -269,6 +281,20 @@ void GLWidget::onPathtracerMaxPathBouncesChanged(int value)
 	update();
 }
 
+void GLWidget::onVoxelLodMaxLevelChanged(int value)
+{
+	m_renderer.renderSettings().m_voxelLodMaxLevel = value;
+	m_renderer.updateRenderSettings();
+	update();
+}
+
+void GLWidget::onAdaptiveSamplingThresholdChanged(double value)
+{
+	m_renderer.renderSettings().m_adaptiveSamplingThreshold = (float)value;
+	m_renderer.updateRenderSettings();
+	update();
+}
+
 void GLWidget::onWireframeOpacityChanged(int value)
 {
 	m_renderer.renderSettings().m_wireframeOpacity = (float)value / 100;
@@ -302,6 +328,19 @@ void GLWidget::loadVoxFile(QString file)
 void GLWidget::saveImage(QString file)
 {
 	m_renderer.saveImage(file.toStdString());
+	// the image is written over the next frames
+	update();
+}
+
+void GLWidget::resumeRender()
+{
+	if (m_renderer.resumeFromCheckpoint()) update();
+}
+
+void GLWidget::renderTiledImage(QString file, int width, int height)
+{
+	// the image renders over the next frames
+	if (m_renderer.renderTiledImage(file.toStdString(), width, height)) update();
 }
 
 void GLWidget::reloadShaders()
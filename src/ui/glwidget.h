@@ -48,6 +48,8 @@ public slots:
     void loadMesh(QString file);
     void loadVoxFile(QString file);
     void saveImage(QString file);
+    void resumeRender();
+    void renderTiledImage(QString file, int width, int height);
 
     void cameraFStopChanged(QString fstop);
 	void cameraFocalLengthChanged(QString length);
@@ -55,6 +57,8 @@ public slots:
     void cameraControllerChanged(QString mode);
     void onPathtracerMaxSamplesChanged(int);
     void onPathtracerMaxPathBouncesChanged(int);
+    void onVoxelLodMaxLevelChanged(int);
+    void onAdaptiveSamplingThresholdChanged(double);
     void onResolutionSettingsChanged(RenderPropertiesUI::ResolutionMode mode, int axis1, int axis2);
     void onWireframeOpacityChanged(int);
     void onWireframeThicknessChanged(int);
@@ -6,6 +6,7 @@
 #include <assert.h>
 
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QSlider>
 #include <QVariant>
 #include <QWidget>
@@ -46,6 +47,10 @@ MainWindow::MainWindow(QWidget *parent) :
             ui->glWidget, SLOT(onPathtracerMaxSamplesChanged(int)));
     connect(ui->renderProperties, SIGNAL(pathtracerMaxPathBouncesChanged(int)),
             ui->glWidget, SLOT(onPathtracerMaxPathBouncesChanged(int)));
+    connect(ui->renderProperties, SIGNAL(voxelLodMaxLevelChanged(int)),
+            ui->glWidget, SLOT(onVoxelLodMaxLevelChanged(int)));
+    connect(ui->renderProperties, SIGNAL(adaptiveSamplingThresholdChanged(double)),
+            ui->glWidget, SLOT(onAdaptiveSamplingThresholdChanged(double)));
     connect(ui->renderProperties, SIGNAL(resolutionSettingsChanged(void)),
             this, SLOT(onResolutionSettingsChanged(void)));
     connect(ui->renderProperties, SIGNAL(wireframeOpacityChanged(int)),
@@ -152,6 +157,28 @@ void MainWindow::on_actionSave_Image_triggered()
 
 }
 
+void MainWindow::on_actionResume_Render_triggered()
+{
+    ui->glWidget->resumeRender();
+}
+
+void MainWindow::on_actionRender_Tiled_Image_triggered()
+{
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    tr("Render Tiled Image"),
+                                                     "untitled.exr",
+                                                     tr("Tiled Images (*.exr *.tif)"));
+    if(fileName.size() == 0) return;
+
+    bool ok;
+    const int width = QInputDialog::getInt(this, tr("Render Tiled Image"), tr("Width"), 8192, 1, 65536, 1, &ok);
+    if (!ok) return;
+    const int height = QInputDialog::getInt(this, tr("Render Tiled Image"), tr("Height"), width, 1, 65536, 1, &ok);
+    if (!ok) return;
+
+    ui->glWidget->renderTiledImage(fileName, width, height);
+}
+
 QWidget* MainWindow::appendMaterialProperty(const Material::SerializedData& data, QTreeWidgetItem* parent)
 {
 	QTreeWidgetItem* child = new QTreeWidgetItem(parent);
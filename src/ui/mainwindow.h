@@ -31,6 +31,8 @@ private slots:
     void on_actionSelect_Focal_Point_toggled(bool arg1);
     void on_actionAdd_Voxel_triggered(bool checked);
     void on_actionSave_Image_triggered();
+    void on_actionResume_Render_triggered();
+    void on_actionRender_Tiled_Image_triggered();
 	void onMaterialCreated(Material::SerializedData&);
 	void onMaterialColorChanged(QColor);
 	void onMaterialValueChanged(int);
@@ -1,5 +1,6 @@
 #include "renderpropertiesui.h"
 #include "ui_renderpropertiesui.h"
+#include "voxel/voxelMipmap.h"
 
 #include <QFileDialog>
 
@@ -11,6 +12,7 @@ RenderPropertiesUI::RenderPropertiesUI(QWidget *parent) :
     ui->constantFrame->setEnabled(ui->backgroundConstant->isChecked());
     ui->gradientFrame->setEnabled(ui->backgroundGradient->isChecked());
     ui->imageFrame->setEnabled(ui->backgroundImage->isChecked());
+    ui->voxelLodMaxLevelSpinBox->setMaximum(VoxelMipmap::MAX_LEVELS - 1);
 
 	connect(ui->backgroundConstantButton, SIGNAL(beginUserInteraction(void)), 
 			this, SLOT(onBeginUserInteraction(void)));
@@ -41,6 +43,16 @@ void RenderPropertiesUI::onPathtracerMaxPathBouncesChanged(int value)
     emit pathtracerMaxPathBouncesChanged(value);
 }
 
+void RenderPropertiesUI::onVoxelLodMaxLevelChanged(int value)
+{
+	emit voxelLodMaxLevelChanged(value);
+}
+
+void RenderPropertiesUI::onAdaptiveSamplingThresholdChanged(double value)
+{
+	emit adaptiveSamplingThresholdChanged(value);
+}
+
 void RenderPropertiesUI::onResolutionSettingsChanged()
 {
     emit resolutionSettingsChanged();
@@ -33,6 +33,8 @@ public:
 signals:
 	void pathtracerMaxSamplesChanged(int);
 	void pathtracerMaxPathBouncesChanged(int);
+	void voxelLodMaxLevelChanged(int);
+	void adaptiveSamplingThresholdChanged(double);
 	void resolutionSettingsChanged();
 	void wireframeOpacityChanged(int);
 	void wireframeThicknessChanged(int);
@@ -48,6 +50,8 @@ signals:
 public slots:
 	void onPathtracerMaxSamplesChanged(int);
 	void onPathtracerMaxPathBouncesChanged(int);
+	void onVoxelLodMaxLevelChanged(int);
+	void onAdaptiveSamplingThresholdChanged(double);
 	void onResolutionSettingsChanged();
 	void onWireframeOpacityChanged(int value);
 	void onWireframeThicknessChanged(int value);
@@ -0,0 +1,23 @@
+#include "voxel/voxelGrid.h"
+
+#include <algorithm>
+
+VoxelGrid::VoxelGrid(const GLint* voxelMaterials, const Imath::V3i& resolution) :
+	m_voxelMaterials(voxelMaterials),
+	m_resolution(resolution),
+	m_bounds(volumeBounds(resolution))
+{
+	m_voxelSize = (m_bounds.max.x - m_bounds.min.x) / resolution.x;
+	m_invVoxelSize = 1.0f / m_voxelSize;
+}
+
+/*static*/ Imath::Box3f VoxelGrid::volumeBounds(const Imath::V3i& resolution)
+{
+	const float sizeMultiplier = 1000;
+	const float voxelSize = sizeMultiplier / std::max(resolution.x, std::max(resolution.y, resolution.z));
+	const Imath::V3f boundsSize(voxelSize * resolution.x,
+								voxelSize * resolution.y,
+								voxelSize * resolution.z);
+	return Imath::Box3f(-boundsSize * 0.5f, boundsSize * 0.5f);
+}
+
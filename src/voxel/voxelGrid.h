@@ -0,0 +1,63 @@
+#pragma once
+
+#include <GL/gl.h>
+#include <OpenEXR/ImathVec.h>
+#include <OpenEXR/ImathBox.h>
+
+// Dense voxel grid as produced by the loaders (see VoxLoader::load): one
+// material offset per voxel, or -1 for empty voxels, stored along X, then Y,
+// then Z. The grid is placed in world space the same way the renderer does,
+// centered on the origin with cubic voxels (see volumeBounds).
+//
+// The voxel data is referenced, not copied, and must outlive the grid. All
+// methods are const, so a grid can be shared by any number of threads.
+class VoxelGrid
+{
+public:
+	VoxelGrid(const GLint* voxelMaterials, const Imath::V3i& resolution);
+
+	// World space bounds of a volume with the given resolution. The longest
+	// side of the volume is always 1000 units long.
+	static Imath::Box3f volumeBounds(const Imath::V3i& resolution);
+
+	const Imath::V3i& resolution() const { return m_resolution; }
+	const Imath::Box3f& bounds() const { return m_bounds; }
+	// length of the side of a voxel, in world space
+	float voxelSize() const { return m_voxelSize; }
+
+	bool contains(const Imath::V3i& voxel) const
+	{
+		return voxel.x >= 0 && voxel.y >= 0 && voxel.z >= 0 &&
+			   voxel.x < m_resolution.x && voxel.y < m_resolution.y && voxel.z < m_resolution.z;
+	}
+
+	// Material offsets of all the voxels, see voxelIndex
+	const GLint* materials() const { return m_voxelMaterials; }
+	// Material offset of a voxel within the grid, or -1 if it's empty
+	GLint material(const Imath::V3i& voxel) const { return m_voxelMaterials[voxelIndex(voxel)]; }
+	GLint material(size_t voxelIndex) const { return m_voxelMaterials[voxelIndex]; }
+
+	size_t voxelIndex(const Imath::V3i& voxel) const
+	{
+		return ((size_t)voxel.z * m_resolution.y + voxel.y) * m_resolution.x + voxel.x;
+	}
+	Imath::V3i voxelPosition(size_t voxelIndex) const
+	{
+		return Imath::V3i((int)(voxelIndex % m_resolution.x),
+						  (int)((voxelIndex / m_resolution.x) % m_resolution.y),
+						  (int)(voxelIndex / ((size_t)m_resolution.x * m_resolution.y)));
+	}
+
+	// Conversions between world space and (continuous) voxel space, where
+	// voxel v spans [v, v+1) along each axis.
+	Imath::V3f worldToVoxel(const Imath::V3f& wsP) const { return (wsP - m_bounds.min) * m_invVoxelSize; }
+	Imath::V3f voxelToWorld(const Imath::V3f& vsP) const { return vsP * m_voxelSize + m_bounds.min; }
+
+private:
+	const GLint* m_voxelMaterials;
+	Imath::V3i m_resolution;
+	Imath::Box3f m_bounds;
+	float m_voxelSize;
+	float m_invVoxelSize;
+};
+
@@ -0,0 +1,130 @@
+#include "voxel/voxelMipmap.h"
+
+#include "thirdParty/boost/threadpool.hpp"
+
+#include <algorithm>
+
+using namespace boost::threadpool;
+
+/*static*/ int VoxelMipmap::numLevels(const Imath::V3i& resolution, int maxLevels)
+{
+	const int maxDimension = std::max(resolution.x, std::max(resolution.y, resolution.z));
+	int levels = 1;
+	while(levels < maxLevels && (1 << levels) < maxDimension) levels++;
+	return levels;
+}
+
+/*static*/ Imath::V3i VoxelMipmap::levelResolution(const Imath::V3i& resolution,
+												   int numLevels,
+												   int level)
+{
+	const int alignment = 1 << (numLevels - 1);
+	Imath::V3i padded(((resolution.x + alignment - 1) / alignment) * alignment,
+					  ((resolution.y + alignment - 1) / alignment) * alignment,
+					  ((resolution.z + alignment - 1) / alignment) * alignment);
+	return Imath::V3i(padded.x >> level, padded.y >> level, padded.z >> level);
+}
+
+// Choose the material for a coarse voxel out of its (up to 8) occupied
+// children: the most frequent one, resolving ties in favour of the first
+// child found.
+inline GLint majorityMaterial(const GLint* children, int numChildren)
+{
+	GLint best = -1;
+	int bestCount = 0;
+	for(int i = 0; i < numChildren; ++i)
+	{
+		int count = 1;
+		for(int j = i + 1; j < numChildren; ++j)
+		{
+			if (children[j] == children[i]) count++;
+		}
+		if (count > bestCount)
+		{
+			best = children[i];
+			bestCount = count;
+		}
+	}
+	return best;
+}
+
+// Downsample slices [fromZ, toZ) of the destination level
+void downsampleTask(const GLint* source,
+					Imath::V3i sourceResolution,
+					GLint* destination,
+					Imath::V3i destinationResolution,
+					int fromZ,
+					int toZ)
+{
+	const size_t sourceSliceSize = (size_t)sourceResolution.x * sourceResolution.y;
+	const size_t destinationSliceSize = (size_t)destinationResolution.x * destinationResolution.y;
+
+	for(int z = fromZ; z < toZ; ++z)
+	{
+		for(int y = 0; y < destinationResolution.y; ++y)
+		{
+			for(int x = 0; x < destinationResolution.x; ++x)
+			{
+				GLint children[8];
+				int numChildren = 0;
+				for(int i = 0; i < 8; ++i)
+				{
+					const size_t child = (size_t)(2 * z + ((i >> 2) & 1)) * sourceSliceSize +
+										 (size_t)(2 * y + ((i >> 1) & 1)) * sourceResolution.x +
+										 (size_t)(2 * x + (i & 1));
+					if (source[child] >= 0) children[numChildren++] = source[child];
+				}
+				destination[z * destinationSliceSize + y * destinationResolution.x + x] = majorityMaterial(children, numChildren);
+			}
+		}
+	}
+}
+
+/*static*/ void VoxelMipmap::generate(const GLint* voxelMaterials,
+									  const Imath::V3i& resolution,
+									  int numLevels,
+									  std::vector< std::vector<GLint> >& levels)
+{
+	levels.resize(numLevels);
+
+	// copy the input data into the (padded) first level
+	{
+		const Imath::V3i paddedResolution = levelResolution(resolution, numLevels, 0);
+		levels[0].assign((size_t)paddedResolution.x * paddedResolution.y * paddedResolution.z, -1);
+		for(int z = 0; z < resolution.z; ++z)
+		{
+			for(int y = 0; y < resolution.y; ++y)
+			{
+				const GLint* row = voxelMaterials + ((size_t)z * resolution.y + y) * resolution.x;
+				std::copy(row, row + resolution.x,
+						  &levels[0][((size_t)z * paddedResolution.y + y) * paddedResolution.x]);
+			}
+		}
+	}
+
+	const unsigned int numThreads = std::max(1u, boost::thread::hardware_concurrency());
+	pool tp(numThreads);
+
+	for(int level = 1; level < numLevels; ++level)
+	{
+		const Imath::V3i sourceResolution = levelResolution(resolution, numLevels, level - 1);
+		const Imath::V3i destinationResolution = levelResolution(resolution, numLevels, level);
+		levels[level].resize((size_t)destinationResolution.x * destinationResolution.y * destinationResolution.z);
+
+		// every level depends on the previous one, so we can only parallelize
+		// the work within a level. Split it in chunks of slices.
+		const int slicesPerTask = std::max(1, destinationResolution.z / (int)numThreads);
+		for(int z = 0; z < destinationResolution.z; z += slicesPerTask)
+		{
+			tp.schedule(boost::bind(downsampleTask,
+									&levels[level - 1][0],
+									sourceResolution,
+									&levels[level][0],
+									destinationResolution,
+									z,
+									std::min(destinationResolution.z, z + slicesPerTask)));
+		}
+		tp.wait();
+	}
+}
+
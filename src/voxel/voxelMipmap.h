@@ -0,0 +1,43 @@
+#pragma once
+
+#include <GL/gl.h>
+#include <OpenEXR/ImathVec.h>
+#include <vector>
+
+// Coarser representations of a voxel grid, used to traverse rays with a wide
+// footprint (e.g. those spawned by diffuse bounces) through fewer, bigger
+// voxels.
+//
+// Each level halves the resolution of the previous one. A voxel is occupied if
+// any of its 8 children is (so thin features don't vanish from the coarse
+// levels) and it takes the material shared by the majority of its occupied
+// children.
+class VoxelMipmap
+{
+public:
+	// Maximum number of levels generated, including the full resolution one.
+	static const int MAX_LEVELS = 5;
+
+	// Number of levels (including the full resolution one) that make up the
+	// mip chain of a volume with the given resolution.
+	static int numLevels(const Imath::V3i& resolution,
+						 int maxLevels = MAX_LEVELS);
+
+	// Resolution of the given level. All levels are padded so their size is a
+	// multiple of 2^(numLevels-1), which means every voxel at a given level
+	// maps to exactly 2x2x2 voxels in the level below it (and also fulfills
+	// the mipmap completeness rules of OpenGL textures). The padding voxels
+	// are always empty.
+	static Imath::V3i levelResolution(const Imath::V3i& resolution,
+									  int numLevels,
+									  int level);
+
+	// Generate the mip chain for the given voxel data. The output contains
+	// numLevels entries, the first one being the (padded) input data.
+	// Downsampling each level is spread across all available cores.
+	static void generate(const GLint* voxelMaterials,
+						 const Imath::V3i& resolution,
+						 int numLevels,
+						 std::vector< std::vector<GLint> >& levels);
+};
+
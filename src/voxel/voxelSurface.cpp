@@ -0,0 +1,134 @@
+#include "voxel/voxelSurface.h"
+
+#include "thirdParty/boost/threadpool.hpp"
+
+#include <algorithm>
+
+using namespace boost::threadpool;
+
+VoxelSurface::VoxelSurface(const GLint* voxelMaterials, const Imath::V3i& resolution) :
+	m_resolution(resolution),
+	m_wordsPerRow((resolution.x + 63) / 64)
+{
+	const size_t numWords = m_wordsPerRow * resolution.y * resolution.z;
+	m_occupancy.assign(numWords, 0);
+	for(int i = 0; i < 6; ++i) m_faces[i].resize(numWords);
+
+	const unsigned int numThreads = std::max(1u, boost::thread::hardware_concurrency());
+	pool tp(numThreads);
+
+	// The bits past the end of each row are left empty, which makes voxels on
+	// the border of the grid expose their outer faces.
+	const int slicesPerTask = std::max(1, resolution.z / (int)numThreads);
+	for(int z = 0; z < resolution.z; z += slicesPerTask)
+	{
+		tp.schedule(boost::bind(&VoxelSurface::fillOccupancy, this, voxelMaterials, z, std::min(resolution.z, z + slicesPerTask)));
+	}
+	tp.wait();
+
+	// the faces of each slice depend on the occupancy of its neighbours, so
+	// only start once the whole bitset is ready.
+	for(int z = 0; z < resolution.z; z += slicesPerTask)
+	{
+		tp.schedule(boost::bind(&VoxelSurface::findFaces, this, z, std::min(resolution.z, z + slicesPerTask)));
+	}
+	tp.wait();
+}
+
+void VoxelSurface::fillOccupancy(const GLint* voxelMaterials, int fromZ, int toZ)
+{
+	for(int z = fromZ; z < toZ; ++z)
+	{
+		for(int y = 0; y < m_resolution.y; ++y)
+		{
+			const GLint* row = voxelMaterials + ((size_t)z * m_resolution.y + y) * m_resolution.x;
+			uint64_t* words = &m_occupancy[rowOffset(y, z)];
+			for(int x = 0; x < m_resolution.x; ++x)
+			{
+				if (row[x] >= 0) words[x >> 6] |= uint64_t(1) << (x & 63);
+			}
+		}
+	}
+}
+
+void VoxelSurface::findFaces(int fromZ, int toZ)
+{
+	// an empty row, standing for the neighbours outside of the grid
+	const std::vector<uint64_t> emptyRow(m_wordsPerRow, 0);
+
+	for(int z = fromZ; z < toZ; ++z)
+	{
+		for(int y = 0; y < m_resolution.y; ++y)
+		{
+			const size_t offset = rowOffset(y, z);
+			const uint64_t* row = &m_occupancy[offset];
+			const uint64_t* rowUp    = y + 1 < m_resolution.y ? &m_occupancy[rowOffset(y + 1, z)] : &emptyRow[0];
+			const uint64_t* rowDown  = y > 0                  ? &m_occupancy[rowOffset(y - 1, z)] : &emptyRow[0];
+			const uint64_t* rowFront = z + 1 < m_resolution.z ? &m_occupancy[rowOffset(y, z + 1)] : &emptyRow[0];
+			const uint64_t* rowBack  = z > 0                  ? &m_occupancy[rowOffset(y, z - 1)] : &emptyRow[0];
+
+			for(size_t w = 0; w < m_wordsPerRow; ++w)
+			{
+				// occupancy of the next/previous voxel along X, carrying the
+				// bit across word boundaries
+				const uint64_t next = (row[w] >> 1) | (w + 1 < m_wordsPerRow ? row[w + 1] << 63 : 0);
+				const uint64_t previous = (row[w] << 1) | (w > 0 ? row[w - 1] >> 63 : 0);
+
+				m_faces[0][offset + w] = row[w] & ~next;
+				m_faces[1][offset + w] = row[w] & ~previous;
+				m_faces[2][offset + w] = row[w] & ~rowUp[w];
+				m_faces[3][offset + w] = row[w] & ~rowDown[w];
+				m_faces[4][offset + w] = row[w] & ~rowFront[w];
+				m_faces[5][offset + w] = row[w] & ~rowBack[w];
+			}
+		}
+	}
+}
+
+int VoxelSurface::faceMask(GLint voxelIndex) const
+{
+	const int x = voxelIndex % m_resolution.x;
+	const int yz = voxelIndex / m_resolution.x;
+	const size_t word = (size_t)yz * m_wordsPerRow + (x >> 6);
+	const int bit = x & 63;
+
+	int mask = 0;
+	for(int i = 0; i < 6; ++i)
+	{
+		mask |= (int)((m_faces[i][word] >> bit) & 1) << i;
+	}
+	return mask;
+}
+
+void VoxelSurface::surfaceVoxels(std::vector<GLint>& voxelIndices,
+								 std::vector<unsigned char>& faceMasks) const
+{
+	voxelIndices.clear();
+	faceMasks.clear();
+
+	const size_t numRows = (size_t)m_resolution.y * m_resolution.z;
+	for(size_t row = 0; row < numRows; ++row)
+	{
+		for(size_t w = 0; w < m_wordsPerRow; ++w)
+		{
+			const size_t word = row * m_wordsPerRow + w;
+			uint64_t surface = m_faces[0][word] | m_faces[1][word] | m_faces[2][word] |
+							   m_faces[3][word] | m_faces[4][word] | m_faces[5][word];
+			// visit the set bits only
+			while(surface != 0)
+			{
+				const int bit = __builtin_ctzll(surface);
+				surface &= surface - 1;
+
+				int mask = 0;
+				for(int i = 0; i < 6; ++i)
+				{
+					mask |= (int)((m_faces[i][word] >> bit) & 1) << i;
+				}
+				voxelIndices.push_back((GLint)(row * m_resolution.x + w * 64 + bit));
+				faceMasks.push_back((unsigned char)mask);
+			}
+		}
+	}
+}
+
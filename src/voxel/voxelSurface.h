@@ -0,0 +1,59 @@
+#pragma once
+
+#include <GL/gl.h>
+#include <OpenEXR/ImathVec.h>
+#include <stdint.h>
+#include <vector>
+
+// Faces of a voxel grid which are exposed, i.e. which separate an occupied
+// voxel from an empty one (or from the outside of the grid). Voxels with no
+// exposed faces are interior voxels, which can never be seen.
+//
+// The occupancy of the grid is stored as a bitset with one bit per voxel, and
+// rows of voxels along X packed into 64-bit words. The exposed faces in each
+// direction are then found a whole word at a time, by masking the occupancy
+// of each row with the (negated) occupancy of its neighbour row, or of the
+// same row shifted by one voxel for faces along X. Slices of the grid are
+// processed in parallel.
+class VoxelSurface
+{
+public:
+	// Faces of a voxel, as bits of a face mask
+	enum Face
+	{
+		FACE_POSITIVE_X = 1 << 0,
+		FACE_NEGATIVE_X = 1 << 1,
+		FACE_POSITIVE_Y = 1 << 2,
+		FACE_NEGATIVE_Y = 1 << 3,
+		FACE_POSITIVE_Z = 1 << 4,
+		FACE_NEGATIVE_Z = 1 << 5,
+	};
+
+	// Find the exposed faces of the given voxel data, where empty voxels are
+	// marked by negative values.
+	VoxelSurface(const GLint* voxelMaterials, const Imath::V3i& resolution);
+
+	// Mask of the exposed faces of the voxel with the given (linear) index.
+	// This is 0 for both empty and interior voxels.
+	int faceMask(GLint voxelIndex) const;
+
+	// List all the voxels with any exposed face, and their face masks, in
+	// order of their index.
+	void surfaceVoxels(std::vector<GLint>& voxelIndices,
+					   std::vector<unsigned char>& faceMasks) const;
+
+private:
+	// Set the occupancy bits of slices [fromZ, toZ)
+	void fillOccupancy(const GLint* voxelMaterials, int fromZ, int toZ);
+	// Compute the exposed faces of slices [fromZ, toZ)
+	void findFaces(int fromZ, int toZ);
+
+	size_t rowOffset(int y, int z) const { return ((size_t)z * m_resolution.y + y) * m_wordsPerRow; }
+
+	Imath::V3i m_resolution;
+	size_t m_wordsPerRow;
+	std::vector<uint64_t> m_occupancy;
+	// one bitset per face direction, in the order of the Face enum
+	std::vector<uint64_t> m_faces[6];
+};
+
@@ -0,0 +1,100 @@
+#include "renderer/lights/aliasTable.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+
+// Probability of drawing each index from the table: its entry is picked with
+// probability 1/n and kept with the entry's probability, and it's also the
+// alias of other entries.
+std::vector<double> drawProbabilities(const std::vector<AliasTable::Entry>& table)
+{
+	const size_t n = table.size();
+	std::vector<double> p(n, 0.0);
+	for(size_t i = 0; i < n; ++i)
+	{
+		p[i] += table[i].probability / (double)n;
+		p[table[i].alias] += (1.0 - table[i].probability) / (double)n;
+	}
+	return p;
+}
+
+BOOST_AUTO_TEST_SUITE(AliasTableTest)
+
+BOOST_AUTO_TEST_CASE(MatchesWeights)
+{
+	srand(1);
+	std::vector<float> weights(1000);
+	double sum = 0;
+	for(size_t i = 0; i < weights.size(); ++i)
+	{
+		// a few outcomes much likelier than the rest, as bright lights are
+		weights[i] = (float)rand() / RAND_MAX * (i % 100 == 0 ? 1000.0f : 1.0f);
+		sum += weights[i];
+	}
+
+	std::vector<AliasTable::Entry> table;
+	std::vector<float> pmf;
+	AliasTable::build(weights, table, pmf);
+	BOOST_REQUIRE_EQUAL(table.size(), weights.size());
+	BOOST_REQUIRE_EQUAL(pmf.size(), weights.size());
+
+	const std::vector<double> p = drawProbabilities(table);
+	for(size_t i = 0; i < weights.size(); ++i)
+	{
+		BOOST_CHECK(table[i].probability >= 0 && table[i].probability <= 1);
+		BOOST_CHECK(table[i].alias >= 0 && table[i].alias < (int)table.size());
+		BOOST_CHECK_CLOSE(pmf[i], weights[i] / sum, 1e-3);
+		BOOST_CHECK_CLOSE(p[i], weights[i] / sum, 1e-3);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(ZeroWeightsAreNeverDrawn)
+{
+	std::vector<float> weights(8, 0.0f);
+	weights[1] = 3.0f;
+	weights[6] = 1.0f;
+
+	std::vector<AliasTable::Entry> table;
+	std::vector<float> pmf;
+	AliasTable::build(weights, table, pmf);
+
+	const std::vector<double> p = drawProbabilities(table);
+	for(size_t i = 0; i < weights.size(); ++i)
+	{
+		if (weights[i] == 0)
+		{
+			BOOST_CHECK_EQUAL(pmf[i], 0.0f);
+			BOOST_CHECK_SMALL(p[i], 1e-6);
+		}
+	}
+	BOOST_CHECK_CLOSE(p[1], 0.75, 1e-3);
+	BOOST_CHECK_CLOSE(p[6], 0.25, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(AllZeroWeightsAreUniform)
+{
+	std::vector<float> weights(5, 0.0f);
+	std::vector<AliasTable::Entry> table;
+	std::vector<float> pmf;
+	AliasTable::build(weights, table, pmf);
+
+	const std::vector<double> p = drawProbabilities(table);
+	for(size_t i = 0; i < weights.size(); ++i)
+	{
+		BOOST_CHECK_CLOSE(pmf[i], 0.2f, 1e-3);
+		BOOST_CHECK_CLOSE(p[i], 0.2, 1e-3);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(Empty)
+{
+	std::vector<float> weights;
+	std::vector<AliasTable::Entry> table(3);
+	std::vector<float> pmf(3);
+	AliasTable::build(weights, table, pmf);
+	BOOST_CHECK(table.empty());
+	BOOST_CHECK(pmf.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,146 @@
+#include "cache/cache.h"
+#include "temporaryDirectory.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <sys/stat.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <fstream>
+
+// Write an entry of the given size to the cache, last used at the given time
+std::string writeEntry(const std::string& name, size_t size, time_t lastUsed)
+{
+	const std::string path = cacheDirectory() + "/" + name;
+	{
+		std::ofstream out(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		out << std::string(size, 'x');
+	}
+	utimbuf times;
+	times.actime = lastUsed;
+	times.modtime = lastUsed;
+	utime(path.c_str(), &times);
+	return path;
+}
+
+std::vector<std::string> entryNames(const std::string& prefix)
+{
+	std::vector<std::string> names;
+	const std::vector<CacheEntry> entries = listCacheEntries(prefix);
+	for(size_t i = 0; i < entries.size(); ++i) names.push_back(entries[i].name);
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+BOOST_AUTO_TEST_SUITE(CacheTest)
+
+BOOST_AUTO_TEST_CASE(Hashes)
+{
+	// FNV-1a of a single 32 bit value
+	BOOST_CHECK_EQUAL(hashCombine(HASH_SEED, 0), HASH_SEED * 1099511628211ULL);
+	BOOST_CHECK(hashCombine(HASH_SEED, 1) != hashCombine(HASH_SEED, 2));
+	BOOST_CHECK_EQUAL(hashString(HASH_SEED, ""), HASH_SEED);
+
+	// buffers are hashed a word at a time, whatever their alignment
+	const boost::uint32_t words[] = { 1, 2, 3 };
+	char unaligned[sizeof(words) + 1];
+	memcpy(unaligned + 1, words, sizeof(words));
+	const boost::uint64_t expected = hashCombine(hashCombine(hashCombine(HASH_SEED, 1), 2), 3);
+	BOOST_CHECK_EQUAL(hashWords(HASH_SEED, words, 3), expected);
+	BOOST_CHECK_EQUAL(hashWords(HASH_SEED, unaligned + 1, 3), expected);
+
+	// the order of the values matters
+	BOOST_CHECK(hashString(HASH_SEED, "ab") != hashString(HASH_SEED, "ba"));
+}
+
+BOOST_AUTO_TEST_CASE(Directory)
+{
+	TemporaryDirectory cache;
+	cache.makeCacheHome();
+	BOOST_CHECK_EQUAL(cacheDirectory(), cache.path() + "/voxelToy");
+
+	struct stat info;
+	BOOST_CHECK(stat(cacheDirectory().c_str(), &info) == 0 && S_ISDIR(info.st_mode));
+}
+
+BOOST_AUTO_TEST_CASE(ListEntries)
+{
+	TemporaryDirectory cache;
+	cache.makeCacheHome();
+	BOOST_CHECK(listCacheEntries("").empty());
+
+	writeEntry("program-1-a.bin", 10, 1000);
+	writeEntry("program-2-b.bin", 20, 2000);
+	writeEntry("envmap-c.bin", 30, 3000);
+	mkdir((cacheDirectory() + "/program-directory").c_str(), 0755);
+
+	std::vector<std::string> names = entryNames("program-");
+	BOOST_REQUIRE_EQUAL(names.size(), 2u);
+	BOOST_CHECK_EQUAL(names[0], "program-1-a.bin");
+	BOOST_CHECK_EQUAL(names[1], "program-2-b.bin");
+	BOOST_CHECK_EQUAL(entryNames("").size(), 3u);
+
+	const std::vector<CacheEntry> entries = listCacheEntries("envmap-");
+	BOOST_REQUIRE_EQUAL(entries.size(), 1u);
+	BOOST_CHECK_EQUAL(entries[0].path, cacheDirectory() + "/envmap-c.bin");
+	BOOST_CHECK_EQUAL(entries[0].size, 30u);
+	BOOST_CHECK_EQUAL(entries[0].lastUsed, 3000);
+}
+
+BOOST_AUTO_TEST_CASE(PruneLeastRecentlyUsed)
+{
+	TemporaryDirectory cache;
+	cache.makeCacheHome();
+
+	writeEntry("envmap-a.bin", 100, 1000);
+	const std::string b = writeEntry("envmap-b.bin", 100, 2000);
+	writeEntry("envmap-c.bin", 100, 3000);
+	writeEntry("envmap-d.bin", 100, 4000);
+	// other kinds of entries aren't affected
+	writeEntry("program-e.bin", 1000, 500);
+
+	// using b makes it the most recent
+	touchCacheEntry(b);
+	BOOST_CHECK(listCacheEntries("envmap-b")[0].lastUsed > 4000);
+
+	pruneCache("envmap-", 250);
+	std::vector<std::string> names = entryNames("envmap-");
+	BOOST_REQUIRE_EQUAL(names.size(), 2u);
+	BOOST_CHECK_EQUAL(names[0], "envmap-b.bin");
+	BOOST_CHECK_EQUAL(names[1], "envmap-d.bin");
+	BOOST_CHECK_EQUAL(entryNames("program-").size(), 1u);
+
+	// within the limit already
+	pruneCache("envmap-", 200);
+	BOOST_CHECK_EQUAL(entryNames("envmap-").size(), 2u);
+
+	pruneCache("envmap-", 0);
+	BOOST_CHECK(entryNames("envmap-").empty());
+}
+
+BOOST_AUTO_TEST_CASE(TemporaryFiles)
+{
+	TemporaryDirectory cache;
+	cache.makeCacheHome();
+
+	// a write in progress, and one interrupted long ago
+	const time_t now = time(NULL);
+	writeEntry("program-a.bin", 100, now);
+	writeEntry("program-b.bin.123.tmp", 100, now);
+	writeEntry("program-c.bin.456.tmp", 100, now - 24 * 60 * 60);
+
+	std::vector<std::string> names = entryNames("program-");
+	BOOST_REQUIRE_EQUAL(names.size(), 1u);
+	BOOST_CHECK_EQUAL(names[0], "program-a.bin");
+
+	// only the stale one is removed
+	pruneCache("program-", 1000);
+	BOOST_CHECK_EQUAL(entryNames("program-").size(), 1u);
+	std::ifstream inProgress((cacheDirectory() + "/program-b.bin.123.tmp").c_str());
+	BOOST_CHECK(inProgress.good());
+	std::ifstream interrupted((cacheDirectory() + "/program-c.bin.456.tmp").c_str());
+	BOOST_CHECK(!interrupted.good());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
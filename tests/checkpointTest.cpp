@@ -0,0 +1,178 @@
+#include "renderer/checkpoint.h"
+#include "temporaryDirectory.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <iterator>
+
+// A checkpoint with every stored field set to something other than its
+// default, and matching pixel data.
+Checkpoint testCheckpoint(std::vector<float>& pixels)
+{
+	Checkpoint checkpoint;
+	checkpoint.sceneHash = 0x0123456789abcdefULL;
+	checkpoint.integrator = 2;
+	checkpoint.numberSamples = 1234;
+	checkpoint.width = 33;
+	checkpoint.height = 17;
+	checkpoint.eye = Imath::V3f(1, 2, 3);
+	checkpoint.target = Imath::V3f(-4, 5, -6);
+	checkpoint.focalLength = 35.0f;
+	checkpoint.focalDistance = 420.0f;
+	checkpoint.lensRadius = 0.5f;
+	checkpoint.lensModel = 1;
+
+	RenderSettings& settings = checkpoint.settings;
+	settings.m_pathtracerMaxNumBounces = 7;
+	settings.m_pathtracerMaxSamples = 4096;
+	settings.m_adaptiveSamplingThreshold = 0.02f;
+	settings.m_adaptiveSamplingMinSamples = 64;
+	settings.m_wireframeOpacity = 0.25f;
+	settings.m_wireframeThickness = 0.01f;
+	settings.m_voxelLodMaxLevel = 3;
+	settings.m_samplerRank1PixelDecorrelation = true;
+	settings.m_lightSelectionStrategy = RenderSettings::LIGHT_SELECTION_LIGHT_TREE;
+	settings.m_backgroundImage = "/images/sky.exr";
+	settings.m_backgroundColor[0] = Imath::V3f(0.1f, 0.2f, 0.3f);
+	settings.m_backgroundColor[1] = Imath::V3f(0.4f, 0.5f, 0.6f);
+	settings.m_backgroundRotationDegrees = 90;
+
+	pixels.resize(checkpoint.pixelDataSize());
+	for(size_t i = 0; i < pixels.size(); ++i) pixels[i] = (float)i * 0.5f;
+	return checkpoint;
+}
+
+BOOST_AUTO_TEST_SUITE(CheckpointTest)
+
+BOOST_AUTO_TEST_CASE(RoundTrip)
+{
+	TemporaryDirectory directory;
+	const std::string file = directory.path() + "/render.vtc";
+
+	std::vector<float> pixels;
+	const Checkpoint written = testCheckpoint(pixels);
+	BOOST_REQUIRE(written.write(file, &pixels[0]));
+
+	Checkpoint read;
+	std::vector<float> readPixels;
+	BOOST_REQUIRE(read.read(file, readPixels));
+
+	BOOST_CHECK_EQUAL(read.sceneHash, written.sceneHash);
+	BOOST_CHECK_EQUAL(read.integrator, written.integrator);
+	BOOST_CHECK_EQUAL(read.numberSamples, written.numberSamples);
+	BOOST_CHECK_EQUAL(read.width, written.width);
+	BOOST_CHECK_EQUAL(read.height, written.height);
+	BOOST_CHECK(read.eye == written.eye);
+	BOOST_CHECK(read.target == written.target);
+	BOOST_CHECK_EQUAL(read.focalLength, written.focalLength);
+	BOOST_CHECK_EQUAL(read.focalDistance, written.focalDistance);
+	BOOST_CHECK_EQUAL(read.lensRadius, written.lensRadius);
+	BOOST_CHECK_EQUAL(read.lensModel, written.lensModel);
+
+	const RenderSettings& a = read.settings;
+	const RenderSettings& b = written.settings;
+	BOOST_CHECK_EQUAL(a.m_pathtracerMaxNumBounces, b.m_pathtracerMaxNumBounces);
+	BOOST_CHECK_EQUAL(a.m_pathtracerMaxSamples, b.m_pathtracerMaxSamples);
+	BOOST_CHECK_EQUAL(a.m_adaptiveSamplingThreshold, b.m_adaptiveSamplingThreshold);
+	BOOST_CHECK_EQUAL(a.m_adaptiveSamplingMinSamples, b.m_adaptiveSamplingMinSamples);
+	BOOST_CHECK_EQUAL(a.m_wireframeOpacity, b.m_wireframeOpacity);
+	BOOST_CHECK_EQUAL(a.m_wireframeThickness, b.m_wireframeThickness);
+	BOOST_CHECK_EQUAL(a.m_voxelLodMaxLevel, b.m_voxelLodMaxLevel);
+	BOOST_CHECK_EQUAL(a.m_samplerRank1PixelDecorrelation, b.m_samplerRank1PixelDecorrelation);
+	BOOST_CHECK_EQUAL(a.m_lightSelectionStrategy, b.m_lightSelectionStrategy);
+	BOOST_CHECK_EQUAL(a.m_backgroundImage, b.m_backgroundImage);
+	BOOST_CHECK(a.m_backgroundColor[0] == b.m_backgroundColor[0]);
+	BOOST_CHECK(a.m_backgroundColor[1] == b.m_backgroundColor[1]);
+	BOOST_CHECK_EQUAL(a.m_backgroundRotationDegrees, b.m_backgroundRotationDegrees);
+
+	BOOST_CHECK(readPixels == pixels);
+}
+
+BOOST_AUTO_TEST_CASE(UnstoredSettingsAreLeftUntouched)
+{
+	TemporaryDirectory directory;
+	const std::string file = directory.path() + "/render.vtc";
+
+	std::vector<float> pixels;
+	const Checkpoint written = testCheckpoint(pixels);
+	BOOST_REQUIRE(written.write(file, &pixels[0]));
+
+	Checkpoint read;
+	read.settings.m_checkpointIntervalSeconds = 77;
+	read.settings.m_samplesPerPass = 5;
+	std::vector<float> readPixels;
+	BOOST_REQUIRE(read.read(file, readPixels));
+	BOOST_CHECK_EQUAL(read.settings.m_checkpointIntervalSeconds, 77);
+	BOOST_CHECK_EQUAL(read.settings.m_samplesPerPass, 5);
+}
+
+BOOST_AUTO_TEST_CASE(InvalidFiles)
+{
+	TemporaryDirectory directory;
+	const std::string file = directory.path() + "/render.vtc";
+	Checkpoint read;
+	std::vector<float> readPixels;
+
+	BOOST_CHECK(!read.read(file, readPixels));
+
+	std::vector<float> pixels;
+	const Checkpoint written = testCheckpoint(pixels);
+	BOOST_REQUIRE(written.write(file, &pixels[0]));
+	std::string contents;
+	{
+		std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+		contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	// truncated pixel data
+	{
+		std::ofstream out(file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		out.write(contents.data(), contents.size() - 1);
+	}
+	BOOST_CHECK(!read.read(file, readPixels));
+
+	// bad magic
+	{
+		std::string corrupt = contents;
+		corrupt[0] = 'X';
+		std::ofstream out(file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		out.write(corrupt.data(), corrupt.size());
+	}
+	BOOST_CHECK(!read.read(file, readPixels));
+
+	// another version of the format
+	{
+		std::string corrupt = contents;
+		corrupt[4]++;
+		std::ofstream out(file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		out.write(corrupt.data(), corrupt.size());
+	}
+	BOOST_CHECK(!read.read(file, readPixels));
+}
+
+BOOST_AUTO_TEST_CASE(NoTemporaryFilesAreLeft)
+{
+	TemporaryDirectory directory;
+	const std::string file = directory.path() + "/render.vtc";
+
+	std::vector<float> pixels;
+	const Checkpoint written = testCheckpoint(pixels);
+	BOOST_REQUIRE(written.write(file, &pixels[0]));
+	// overwriting the previous checkpoint
+	BOOST_REQUIRE(written.write(file, &pixels[0]));
+
+	int numFiles = 0;
+	DIR* dir = opendir(directory.path().c_str());
+	while (const dirent* entry = readdir(dir))
+	{
+		if (entry->d_name[0] != '.') numFiles++;
+	}
+	closedir(dir);
+	BOOST_CHECK_EQUAL(numFiles, 1);
+
+	// a checkpoint can't be written where there's no directory
+	BOOST_CHECK(!written.write(directory.path() + "/missing/render.vtc", &pixels[0]));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
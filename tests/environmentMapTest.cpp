@@ -0,0 +1,116 @@
+#include "renderer/environmentMap.h"
+#include "renderer/imageWriter.h"
+#include "cache/cache.h"
+#include "temporaryDirectory.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <utime.h>
+
+#include <cstdlib>
+#include <fstream>
+
+// Write an image with random pixels, as laid out in the accumulation buffer
+// (see ImageWriter::write).
+bool writeRandomImage(const std::string& file, int width, int height)
+{
+	std::vector<float> pixels((size_t)width * height * 4);
+	for(size_t i = 0; i < pixels.size(); ++i)
+	{
+		pixels[i] = i % 4 == 3 ? 1.0f : (float)rand() / RAND_MAX;
+	}
+	return ImageWriter::write(file, &pixels[0], width, height, 1.0f);
+}
+
+void setModificationTime(const std::string& file, time_t time)
+{
+	utimbuf times;
+	times.actime = time;
+	times.modtime = time;
+	utime(file.c_str(), &times);
+}
+
+void checkSameDistributions(const EnvironmentMap& a, const EnvironmentMap& b)
+{
+	BOOST_CHECK_EQUAL(a.aliasUWidth, b.aliasUWidth);
+	BOOST_CHECK_EQUAL(a.aliasUHeight, b.aliasUHeight);
+	BOOST_CHECK(a.aliasU == b.aliasU);
+	BOOST_CHECK(a.aliasV == b.aliasV);
+	BOOST_CHECK_EQUAL(a.radianceIntegral, b.radianceIntegral);
+}
+
+BOOST_AUTO_TEST_SUITE(EnvironmentMapTest)
+
+BOOST_AUTO_TEST_CASE(CacheRoundTrip)
+{
+	srand(1);
+	TemporaryDirectory cache;
+	cache.makeCacheHome();
+	TemporaryDirectory images;
+	const std::string image = images.path() + "/sky.exr";
+	BOOST_REQUIRE(writeRandomImage(image, 64, 32));
+	setModificationTime(image, 1000000);
+
+	// the first load computes the distributions, and caches them
+	EnvironmentMap computed;
+	BOOST_REQUIRE(loadEnvironmentMap(image, computed));
+	BOOST_CHECK_EQUAL(computed.width, 64u);
+	BOOST_CHECK_EQUAL(computed.height, 32u);
+	std::vector<CacheEntry> entries = listCacheEntries("envmap-");
+	BOOST_REQUIRE_EQUAL(entries.size(), 1u);
+
+	// the second one reads them back
+	EnvironmentMap cached;
+	BOOST_REQUIRE(loadEnvironmentMap(image, cached));
+	checkSameDistributions(computed, cached);
+	BOOST_CHECK(computed.pixels == cached.pixels);
+	BOOST_CHECK_EQUAL(listCacheEntries("envmap-").size(), 1u);
+
+	// and they do come from the cache: tamper with the radiance integral
+	// stored in the entry's header (see CacheHeader)
+	{
+		std::fstream entry(entries[0].path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		const float tampered = 1234.5f;
+		entry.seekp(6 * sizeof(boost::uint32_t));
+		entry.write((const char*)&tampered, sizeof(tampered));
+	}
+	EnvironmentMap tampered;
+	BOOST_REQUIRE(loadEnvironmentMap(image, tampered));
+	BOOST_CHECK_EQUAL(tampered.radianceIntegral, 1234.5f);
+}
+
+BOOST_AUTO_TEST_CASE(ModifiedImagesMissTheCache)
+{
+	srand(2);
+	TemporaryDirectory cache;
+	cache.makeCacheHome();
+	TemporaryDirectory images;
+	const std::string image = images.path() + "/sky.exr";
+	BOOST_REQUIRE(writeRandomImage(image, 64, 32));
+	setModificationTime(image, 1000000);
+
+	EnvironmentMap before;
+	BOOST_REQUIRE(loadEnvironmentMap(image, before));
+
+	// same size, new contents
+	BOOST_REQUIRE(writeRandomImage(image, 64, 32));
+	setModificationTime(image, 2000000);
+
+	EnvironmentMap after;
+	BOOST_REQUIRE(loadEnvironmentMap(image, after));
+	BOOST_CHECK_EQUAL(listCacheEntries("envmap-").size(), 2u);
+	BOOST_CHECK(before.pixels != after.pixels);
+	BOOST_CHECK(before.aliasU != after.aliasU);
+}
+
+BOOST_AUTO_TEST_CASE(MissingImage)
+{
+	TemporaryDirectory cache;
+	cache.makeCacheHome();
+
+	EnvironmentMap map;
+	BOOST_CHECK(!loadEnvironmentMap(cache.path() + "/missing.exr", map));
+	BOOST_CHECK(listCacheEntries("envmap-").empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,340 @@
+#include <GL/glew.h>
+
+#include "renderer/renderer.h"
+#include "renderer/image.h"
+#include "temporaryDirectory.h"
+
+#include <boost/test/unit_test.hpp>
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <Qt> // for the Qt::Key codes the renderer handles
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#define _STRINGIFY(x) #x
+#define STRINGIFY(x) _STRINGIFY(x)
+
+namespace
+{
+
+// An OpenGL context without a window system (EGL_MESA_platform_surfaceless),
+// on Mesa's software rasterizer, llvmpipe. Renders are then the same on any
+// machine, and the tolerances below hold. It's not valid where EGL or
+// llvmpipe aren't available, in which case the tests are skipped.
+class SoftwareContext
+{
+public:
+	SoftwareContext();
+	~SoftwareContext();
+
+	bool valid() const { return m_valid; }
+	// why the context isn't valid
+	const std::string& error() const { return m_error; }
+
+private:
+	bool m_valid;
+	std::string m_error;
+#ifdef HAVE_EGL
+	EGLDisplay m_display;
+	EGLContext m_context;
+#endif
+};
+
+#ifdef HAVE_EGL
+
+SoftwareContext::SoftwareContext() :
+	m_valid(false),
+	m_display(EGL_NO_DISPLAY),
+	m_context(EGL_NO_CONTEXT)
+{
+	// pick llvmpipe over a hardware driver, unless told otherwise
+	setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay == NULL)
+	{
+		m_error = "EGL_EXT_platform_base isn't supported";
+		return;
+	}
+	m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	EGLint major, minor;
+	if (m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, &major, &minor))
+	{
+		m_display = EGL_NO_DISPLAY;
+		m_error = "EGL_MESA_platform_surfaceless isn't supported";
+		return;
+	}
+
+	// the renderer needs compute shaders, and still uses a few deprecated
+	// functions
+	const EGLint attributes[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 5,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+		EGL_NONE
+	};
+	if (!eglBindAPI(EGL_OPENGL_API) ||
+		(m_context = eglCreateContext(m_display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes)) == EGL_NO_CONTEXT)
+	{
+		m_error = "can't create an OpenGL 4.5 context";
+		return;
+	}
+	if (!eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context))
+	{
+		m_error = "can't make the context current";
+		return;
+	}
+
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	if (renderer == NULL || std::string(renderer).find("llvmpipe") == std::string::npos)
+	{
+		m_error = std::string("the context isn't on llvmpipe but ") + (renderer != NULL ? renderer : "unknown");
+		return;
+	}
+	m_valid = true;
+}
+
+SoftwareContext::~SoftwareContext()
+{
+	if (m_display == EGL_NO_DISPLAY) return;
+	eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (m_context != EGL_NO_CONTEXT) eglDestroyContext(m_display, m_context);
+	eglTerminate(m_display);
+}
+
+#else
+
+SoftwareContext::SoftwareContext() :
+	m_valid(false),
+	m_error("built without EGL")
+{
+}
+
+SoftwareContext::~SoftwareContext()
+{
+}
+
+#endif // HAVE_EGL
+
+// Passes the renderer's messages on to the test log (see --log_level), so
+// e.g. shader errors show up
+class MessageLogger : public Logger
+{
+public:
+	virtual void operator()(const std::string& msg) { BOOST_TEST_MESSAGE(msg); }
+};
+
+// Small enough to render quickly without a GPU, but large enough for a few
+// tiles, and for the image statistics to mean something.
+const int IMAGE_WIDTH  = 96;
+const int IMAGE_HEIGHT = 64;
+const int NUM_SAMPLES  = 256;
+
+// Renders of the same scene and camera, at a fixed number of samples.
+// The sampler's sequences only depend on the pixel and sample index (see
+// shared/random.h), so there's no seed to set: the images are the same
+// every time.
+class SceneRenderer
+{
+public:
+	SceneRenderer(const std::string& outputPath) :
+		m_outputPath(outputPath),
+		m_frames(0)
+	{
+		const std::string shaderPath = std::string(STRINGIFY(SHADER_DIR)) + "/";
+		m_renderer.setLogger(&m_logger);
+		m_renderer.initialize(shaderPath);
+		m_renderer.loadVoxFile(shaderPath + "../../resources/scene_fall.vox");
+
+		RenderSettings& settings = m_renderer.renderSettings();
+		settings.m_imageResolution = Imath::V2i(IMAGE_WIDTH, IMAGE_HEIGHT);
+		settings.m_pathtracerMaxSamples = NUM_SAMPLES;
+		settings.m_pathtracerMaxNumBounces = 2;
+		settings.m_checkpointIntervalSeconds = 0; // off
+		// the renderer leaves these to the UI
+		settings.m_wireframeOpacity = 0;
+		settings.m_wireframeThickness = 0.01f;
+		// lit by a sky-like gradient
+		settings.m_backgroundImage = "";
+		settings.m_backgroundColor[0] = Imath::V3f(0.9f, 0.95f, 1.0f);
+		settings.m_backgroundColor[1] = Imath::V3f(0.4f, 0.35f, 0.3f);
+		settings.m_backgroundRotationDegrees = 0;
+		m_renderer.updateRenderSettings();
+		m_renderer.resizeFrame(IMAGE_WIDTH, IMAGE_HEIGHT, 0, 0, IMAGE_WIDTH, IMAGE_HEIGHT);
+	}
+
+	Renderer& renderer() { return m_renderer; }
+	// number of frames the last render took
+	int frames() const { return m_frames; }
+
+	// Render until all the samples are taken, and read the image back as it
+	// would be saved (resolved and with the display gamma). Returns false if
+	// the render doesn't finish or the image can't be read.
+	bool render(const std::string& name, std::vector<float>& pixels)
+	{
+		m_frames = 0;
+		if (!finish()) return false;
+
+		const std::string file = m_outputPath + "/" + name + ".exr";
+		m_renderer.saveImage(file);
+		if (!finish()) return false;
+
+		unsigned int width, height;
+		return loadImage(file, width, height, pixels) &&
+			   width == (unsigned int)IMAGE_WIDTH &&
+			   height == (unsigned int)IMAGE_HEIGHT;
+	}
+
+private:
+	bool finish()
+	{
+		// shaders are built and samples rendered over as many frames as it
+		// takes, but it mustn't hang if something goes wrong
+		const int maxFrames = 100 * NUM_SAMPLES;
+		for( int frame = 0; frame < maxFrames; ++frame, ++m_frames )
+		{
+			if (m_renderer.render() == Renderer::RR_FINISHED_RENDERING) return true;
+		}
+		return false;
+	}
+
+	MessageLogger m_logger;
+	Renderer m_renderer;
+	std::string m_outputPath;
+	int m_frames;
+};
+
+float luminance(const float* rgb)
+{
+	return 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2];
+}
+
+float meanLuminance(const std::vector<float>& pixels)
+{
+	double sum = 0;
+	for( size_t i = 0; i < pixels.size(); i += 3 ) sum += luminance(&pixels[i]);
+	return (float)(sum / (pixels.size() / 3));
+}
+
+// Root mean square of the difference in luminance of each pixel
+float rmsError(const std::vector<float>& a, const std::vector<float>& b)
+{
+	double sum = 0;
+	for( size_t i = 0; i < a.size(); i += 3 )
+	{
+		const double error = luminance(&a[i]) - luminance(&b[i]);
+		sum += error * error;
+	}
+	return (float)sqrt(sum / (a.size() / 3));
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(IntegratorComparisonTest)
+
+// The wavefront path tracer takes the same samples as the megakernel one, so
+// their images must only differ by floating point noise, rather than the
+// variance of two independent renders.
+BOOST_AUTO_TEST_CASE(WavefrontMatchesPathTracer)
+{
+	SoftwareContext context;
+	if (!context.valid())
+	{
+		BOOST_TEST_MESSAGE("Skipping the integrator comparison: " << context.error());
+		return;
+	}
+
+	TemporaryDirectory directory;
+	directory.makeCacheHome();
+	SceneRenderer scene(directory.path());
+
+	std::vector<float> pathTracer;
+	BOOST_REQUIRE(scene.render("pathTracer", pathTracer));
+
+	// switch to the wavefront integrator, as the UI does
+	BOOST_REQUIRE(scene.renderer().onKeyPress(Qt::Key_P));
+	std::vector<float> wavefront;
+	BOOST_REQUIRE(scene.render("wavefront", wavefront));
+
+	// the scene is lit, and not just by the background
+	const float mean = meanLuminance(pathTracer);
+	BOOST_REQUIRE_GT(mean, 0.05f);
+
+	// tolerances, relative to the mean luminance of the image (after the
+	// display gamma)
+	const float meanTolerance = 0.005f;
+	const float pixelTolerance = 0.01f;
+	BOOST_CHECK_SMALL(meanLuminance(wavefront) / mean - 1.0f, meanTolerance);
+	BOOST_CHECK_SMALL(rmsError(pathTracer, wavefront) / mean, pixelTolerance);
+}
+
+// Passes split in tiles (see RenderSettings::m_tileSize) shade every pixel
+// with the same rays as whole passes, with either integrator.
+BOOST_AUTO_TEST_CASE(TiledPassesMatchWholePasses)
+{
+	SoftwareContext context;
+	if (!context.valid())
+	{
+		BOOST_TEST_MESSAGE("Skipping the tiled pass comparison: " << context.error());
+		return;
+	}
+
+	TemporaryDirectory directory;
+	directory.makeCacheHome();
+	SceneRenderer scene(directory.path());
+
+	// every tile is rendered, so a few samples are enough
+	const int numSamples = 16;
+	RenderSettings& settings = scene.renderer().renderSettings();
+	settings.m_pathtracerMaxSamples = numSamples;
+	// every frame renders at full resolution
+	settings.m_dynamicResolutionMinScale = 1;
+	const RenderSettings wholePasses = settings;
+
+	// tiles smaller than the image, and not dividing it evenly. With a
+	// budget no pass fits in, a single tile is rendered per frame.
+	const int tileSize = 20;
+	const int numTiles = ((IMAGE_WIDTH + tileSize - 1) / tileSize) * ((IMAGE_HEIGHT + tileSize - 1) / tileSize);
+	RenderSettings tiledPasses = wholePasses;
+	tiledPasses.m_tileSize = tileSize;
+	tiledPasses.m_interactiveFrameBudgetMs = 0.001f;
+	tiledPasses.m_idleFrameBudgetMs = 0.001f;
+
+	const char* integrators[] = { "pathTracer", "wavefront" };
+	for( int i = 0; i < 2; ++i )
+	{
+		BOOST_TEST_CHECKPOINT(integrators[i]);
+		settings = wholePasses;
+		scene.renderer().updateRenderSettings();
+		// switch to the wavefront integrator, as the UI does
+		if (i > 0) BOOST_REQUIRE(scene.renderer().onKeyPress(Qt::Key_P));
+
+		std::vector<float> whole;
+		BOOST_REQUIRE(scene.render(std::string(integrators[i]) + "Whole", whole));
+
+		settings = tiledPasses;
+		scene.renderer().updateRenderSettings();
+		std::vector<float> tiled;
+		BOOST_REQUIRE(scene.render(std::string(integrators[i]) + "Tiled", tiled));
+		// the passes were indeed tiled
+		BOOST_CHECK_GE(scene.frames(), numSamples * numTiles);
+
+		// same samples, so only floating point noise is allowed for
+		const float mean = meanLuminance(whole);
+		BOOST_REQUIRE_GT(mean, 0.05f);
+		const float pixelTolerance = 0.001f;
+		BOOST_CHECK_SMALL(rmsError(whole, tiled) / mean, pixelTolerance);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,165 @@
+#include "renderer/lights/lightTree.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdlib>
+
+// An emissive voxel at the given position, emitting from all of its faces
+LightTree::LightBounds voxelLight(int index, const Imath::V3f& position, float phi)
+{
+	LightTree::LightBounds light;
+	light.bounds = Imath::Box3f(position, position + Imath::V3f(1));
+	light.phi = phi;
+	light.w = Imath::V3f(0, 0, 1);
+	light.cosThetaO = -1;
+	light.cosThetaE = 0;
+	light.light = index;
+	light.faceMask = 63;
+	return light;
+}
+
+// A light emitting along a single direction
+LightTree::LightBounds faceLight(int index, const Imath::V3f& position, const Imath::V3f& normal)
+{
+	LightTree::LightBounds light = voxelLight(index, position, 1.0f);
+	light.w = normal;
+	light.cosThetaO = 1;
+	return light;
+}
+
+// Whether the cone of normals of the node encloses the given one
+bool enclosesCone(const LightTreeNode& node, const LightTreeNode& other)
+{
+	if (node.cosThetaO <= -1) return true;
+	const float cosThetaD = node.w[0] * other.w[0] + node.w[1] * other.w[1] + node.w[2] * other.w[2];
+	const float thetaD = acos(std::min(1.0f, std::max(-1.0f, cosThetaD)));
+	return thetaD + acos(other.cosThetaO) <= acos(node.cosThetaO) + 1e-3f;
+}
+
+// Check the subtree under the given node, and return the leaves in it.
+std::vector<int> checkSubtree(const std::vector<LightTreeNode>& nodes, int nodeIndex, std::vector<int>& lightCount)
+{
+	BOOST_REQUIRE(nodeIndex >= 0 && nodeIndex < (int)nodes.size());
+	const LightTreeNode& node = nodes[nodeIndex];
+	std::vector<int> leaves;
+	if (node.isLeaf)
+	{
+		BOOST_REQUIRE(node.child >= 0 && node.child < (int)lightCount.size());
+		lightCount[node.child]++;
+		leaves.push_back(nodeIndex);
+		return leaves;
+	}
+
+	// the first child follows its parent
+	const int children[2] = { nodeIndex + 1, node.child };
+	BOOST_REQUIRE(node.child > nodeIndex + 1);
+	float phi = 0;
+	for(int c = 0; c < 2; ++c)
+	{
+		const LightTreeNode& child = nodes[children[c]];
+		phi += child.phi;
+		for(int i = 0; i < 3; ++i)
+		{
+			BOOST_CHECK(node.boundsMin[i] <= child.boundsMin[i]);
+			BOOST_CHECK(node.boundsMax[i] >= child.boundsMax[i]);
+		}
+		BOOST_CHECK(node.cosThetaE <= child.cosThetaE);
+
+		const std::vector<int> childLeaves = checkSubtree(nodes, children[c], lightCount);
+		leaves.insert(leaves.end(), childLeaves.begin(), childLeaves.end());
+	}
+	BOOST_CHECK_CLOSE(node.phi, phi, 1e-3);
+
+	// merging cones isn't associative, so the node's cone need not enclose
+	// those of its children, but it does enclose every light's below it.
+	for(size_t i = 0; i < leaves.size(); ++i) BOOST_CHECK(enclosesCone(node, nodes[leaves[i]]));
+
+	return leaves;
+}
+
+BOOST_AUTO_TEST_SUITE(LightTreeTest)
+
+BOOST_AUTO_TEST_CASE(Structure)
+{
+	srand(1);
+	std::vector<LightTree::LightBounds> lights;
+	for(int i = 0; i < 500; ++i)
+	{
+		const Imath::V3f position((float)(rand() % 64), (float)(rand() % 64), (float)(rand() % 64));
+		lights.push_back(voxelLight(i, position, 0.1f + (float)rand() / RAND_MAX));
+	}
+	std::vector<LightTreeNode> nodes;
+	LightTree::build(lights, nodes);
+
+	BOOST_REQUIRE_EQUAL(lights.size(), 500u);
+	BOOST_REQUIRE_EQUAL(nodes.size(), 2 * lights.size() - 1);
+
+	// every light is in exactly one leaf
+	std::vector<int> lightCount(lights.size(), 0);
+	BOOST_CHECK_EQUAL(checkSubtree(nodes, 0, lightCount).size(), 500u);
+	for(size_t i = 0; i < lightCount.size(); ++i) BOOST_CHECK_EQUAL(lightCount[i], 1);
+}
+
+BOOST_AUTO_TEST_CASE(DarkLightsAreLeftOut)
+{
+	std::vector<LightTree::LightBounds> lights;
+	lights.push_back(voxelLight(0, Imath::V3f(0, 0, 0), 1.0f));
+	lights.push_back(voxelLight(1, Imath::V3f(5, 0, 0), 0.0f));
+	lights.push_back(voxelLight(2, Imath::V3f(9, 0, 0), 2.0f));
+	std::vector<LightTreeNode> nodes;
+	LightTree::build(lights, nodes);
+
+	BOOST_REQUIRE_EQUAL(lights.size(), 2u);
+	BOOST_REQUIRE_EQUAL(nodes.size(), 3u);
+	BOOST_CHECK_CLOSE(nodes[0].phi, 3.0f, 1e-3);
+	for(size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (nodes[i].isLeaf) BOOST_CHECK(nodes[i].child != 1);
+	}
+
+	lights.clear();
+	lights.push_back(voxelLight(0, Imath::V3f(0, 0, 0), 0.0f));
+	LightTree::build(lights, nodes);
+	BOOST_CHECK(nodes.empty());
+}
+
+BOOST_AUTO_TEST_CASE(CoincidentLights)
+{
+	// no axis to split the lights along, they're split evenly instead
+	std::vector<LightTree::LightBounds> lights;
+	for(int i = 0; i < 7; ++i) lights.push_back(voxelLight(i, Imath::V3f(3, 3, 3), 1.0f));
+	std::vector<LightTreeNode> nodes;
+	LightTree::build(lights, nodes);
+
+	BOOST_REQUIRE_EQUAL(nodes.size(), 13u);
+	std::vector<int> lightCount(lights.size(), 0);
+	BOOST_CHECK_EQUAL(checkSubtree(nodes, 0, lightCount).size(), 7u);
+}
+
+BOOST_AUTO_TEST_CASE(NormalCones)
+{
+	// lights facing different ways, whose cones must be merged
+	const Imath::V3f normals[6] =
+	{
+		Imath::V3f(1, 0, 0), Imath::V3f(0, 1, 0), Imath::V3f(0, 0, 1),
+		Imath::V3f(-1, 0, 0), Imath::V3f(0, -1, 0), Imath::V3f(0.6f, 0.8f, 0),
+	};
+	std::vector<LightTree::LightBounds> lights;
+	for(int i = 0; i < 60; ++i) lights.push_back(faceLight(i, Imath::V3f((float)i, (float)(i % 7), 0), normals[i % 6]));
+	std::vector<LightTreeNode> nodes;
+	LightTree::build(lights, nodes);
+
+	std::vector<int> lightCount(lights.size(), 0);
+	BOOST_CHECK_EQUAL(checkSubtree(nodes, 0, lightCount).size(), 60u);
+
+	// two cones merged into the one enclosing them both
+	const LightTree::LightBounds merged = LightTree::merge(faceLight(0, Imath::V3f(0), normals[0]),
+														   faceLight(1, Imath::V3f(0), normals[1]));
+	BOOST_CHECK_CLOSE(merged.cosThetaO, cos(M_PI / 4), 1e-2);
+	BOOST_CHECK_CLOSE(merged.w.x, (float)sqrt(0.5), 1e-2);
+	BOOST_CHECK_CLOSE(merged.w.y, (float)sqrt(0.5), 1e-2);
+	BOOST_CHECK_EQUAL(merged.light, -1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,4 @@
+// Unit tests of the parts of the renderer which run on the CPU. Each file
+// holds the test suite of one module; the test runner is built here.
+#define BOOST_TEST_MODULE VoxelToy
+#include <boost/test/included/unit_test.hpp>
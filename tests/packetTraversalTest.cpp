@@ -0,0 +1,199 @@
+#include "cpuRenderer/packetTraversal.h"
+#include "cpuRenderer/coordinates.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+
+namespace
+{
+
+float randomFloat(float from, float to)
+{
+	return from + (to - from) * (float)rand() / RAND_MAX;
+}
+
+// Voxel grid with random occupancy, and the data it references
+struct RandomGrid
+{
+	RandomGrid(const Imath::V3i& resolution, float occupancy) :
+		voxels(makeVoxels(resolution, occupancy)),
+		grid(&voxels[0], resolution)
+	{
+	}
+
+	static std::vector<GLint> makeVoxels(const Imath::V3i& resolution, float occupancy)
+	{
+		std::vector<GLint> voxels((size_t)resolution.x * resolution.y * resolution.z);
+		for(size_t i = 0; i < voxels.size(); ++i) voxels[i] = randomFloat(0, 1) < occupancy ? 0 : -1;
+		return voxels;
+	}
+
+	std::vector<GLint> voxels;
+	VoxelGrid grid;
+};
+
+// Rays as x,y,z triplets
+struct Rays
+{
+	void add(const Imath::V3f& origin, const Imath::V3f& direction, float vsMaxDistance)
+	{
+		for(int i = 0; i < 3; ++i)
+		{
+			origins.push_back(origin[i]);
+			directions.push_back(direction[i]);
+		}
+		maxDistances.push_back(vsMaxDistance);
+	}
+	size_t size() const { return maxDistances.size(); }
+	Imath::V3f origin(size_t i) const { return Imath::V3f(origins[i * 3], origins[i * 3 + 1], origins[i * 3 + 2]); }
+	Imath::V3f direction(size_t i) const { return Imath::V3f(directions[i * 3], directions[i * 3 + 1], directions[i * 3 + 2]); }
+
+	std::vector<float> origins, directions, maxDistances;
+};
+
+// Coherent rays through the grid, from a viewpoint outside of it
+Rays primaryRays(const VoxelGrid& grid, int raysPerSide)
+{
+	Rays rays;
+	const Imath::Box3f& bounds = grid.bounds();
+	const Imath::V3f eye = bounds.center() + Imath::V3f(0.3f, 0.2f, -1.0f) * bounds.size().length();
+	for(int y = 0; y < raysPerSide; ++y)
+	{
+		for(int x = 0; x < raysPerSide; ++x)
+		{
+			const Imath::V3f target = bounds.min + Imath::V3f((x + 0.5f) / raysPerSide, (y + 0.5f) / raysPerSide, 0.5f) * bounds.size();
+			const Imath::V3f direction = (target - eye).normalized();
+			// rays start where they enter the grid, as in the renderer
+			const float entry = rayAABBIntersection(eye, direction, bounds.min, bounds.max);
+			if (entry >= 0) rays.add(eye + direction * entry, direction, HUGE_VALF);
+		}
+	}
+	return rays;
+}
+
+// Incoherent rays starting inside the grid, some of them short (as shadow
+// rays are) and some along the axes
+Rays randomRays(const VoxelGrid& grid, size_t numRays)
+{
+	Rays rays;
+	const Imath::Box3f& bounds = grid.bounds();
+	for(size_t i = 0; i < numRays; ++i)
+	{
+		const Imath::V3f origin(randomFloat(bounds.min.x, bounds.max.x),
+								randomFloat(bounds.min.y, bounds.max.y),
+								randomFloat(bounds.min.z, bounds.max.z));
+		Imath::V3f direction(randomFloat(-1, 1), randomFloat(-1, 1), randomFloat(-1, 1));
+		if (i % 10 == 0) direction[i % 3] = 0;
+		if (i % 17 == 0)
+		{
+			direction = Imath::V3f(0);
+			direction[i % 3] = i % 2 ? 1.0f : -1.0f;
+		}
+		if (direction.length2() == 0) direction = Imath::V3f(1, 0, 0);
+		rays.add(origin, direction.normalized(), i % 3 == 0 ? randomFloat(0, 20) : HUGE_VALF);
+	}
+	return rays;
+}
+
+// Compare the results of the rays walked together with walk()
+void checkAgainstScalar(const VoxelGrid& grid,
+						const Rays& rays,
+						const std::vector<Imath::V3i>& positions,
+						const std::vector<TraversalResult>& results)
+{
+	const int maxSteps = maxTraversalSteps(grid.resolution());
+	size_t numHits = 0;
+	for(size_t i = 0; i < rays.size(); ++i)
+	{
+		Imath::V3i expectedPosition;
+		const TraversalResult expected = walk(grid, rays.origin(i), rays.direction(i), rays.maxDistances[i], maxSteps, expectedPosition);
+		BOOST_CHECK_EQUAL(results[i], expected);
+		BOOST_CHECK(positions[i] == expectedPosition);
+		if (expected == TRAVERSAL_HIT) numHits++;
+	}
+	// the grids are neither empty nor solid, so both outcomes are exercised
+	BOOST_CHECK(numHits > 0);
+	BOOST_CHECK(numHits < rays.size());
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(PacketTraversalTest)
+
+BOOST_AUTO_TEST_CASE(PacketsMatchScalarWalk)
+{
+	srand(1);
+	BOOST_TEST_MESSAGE("AVX2 kernel: " << (packetTraversalUsesAVX2() ? "yes" : "no"));
+	const RandomGrid grid(Imath::V3i(37, 21, 29), 0.05f);
+
+	const Rays rays = primaryRays(grid.grid, 48);
+	std::vector<Imath::V3i> positions(rays.size());
+	std::vector<TraversalResult> results(rays.size());
+	walkRayPackets(grid.grid, rays.size(), &rays.origins[0], &rays.directions[0], NULL, &positions[0], &results[0]);
+	checkAgainstScalar(grid.grid, rays, positions, results);
+}
+
+BOOST_AUTO_TEST_CASE(StreamsMatchScalarWalk)
+{
+	srand(2);
+	const RandomGrid grid(Imath::V3i(40, 40, 40), 0.02f);
+
+	// not a whole number of packets
+	const Rays rays = randomRays(grid.grid, 5003);
+	std::vector<Imath::V3i> positions(rays.size());
+	std::vector<TraversalResult> results(rays.size());
+	walkRayStream(grid.grid, rays.size(), &rays.origins[0], &rays.directions[0], &rays.maxDistances[0], &positions[0], &results[0]);
+	checkAgainstScalar(grid.grid, rays, positions, results);
+
+	// the same rays, unsorted
+	walkRayPackets(grid.grid, rays.size(), &rays.origins[0], &rays.directions[0], &rays.maxDistances[0], &positions[0], &results[0]);
+	checkAgainstScalar(grid.grid, rays, positions, results);
+}
+
+BOOST_AUTO_TEST_CASE(InactiveLanesAreUntouched)
+{
+	srand(3);
+	const RandomGrid grid(Imath::V3i(16, 16, 16), 0.1f);
+	const Rays rays = randomRays(grid.grid, RayPacket::SIZE);
+
+	RayPacket packet;
+	for(int i = 0; i < RayPacket::SIZE; ++i)
+	{
+		packet.originX[i] = rays.origins[i * 3];
+		packet.originY[i] = rays.origins[i * 3 + 1];
+		packet.originZ[i] = rays.origins[i * 3 + 2];
+		packet.dirX[i] = rays.directions[i * 3];
+		packet.dirY[i] = rays.directions[i * 3 + 1];
+		packet.dirZ[i] = rays.directions[i * 3 + 2];
+		packet.vsMaxDistance[i] = rays.maxDistances[i];
+	}
+
+	PacketHits hits;
+	for(int i = 0; i < RayPacket::SIZE; ++i)
+	{
+		hits.voxelX[i] = hits.voxelY[i] = hits.voxelZ[i] = -12345;
+		hits.result[i] = TRAVERSAL_STOPPED;
+	}
+	const int activeMask = 0x5a; // lanes 1, 3, 4, 6
+	const int maxSteps = maxTraversalSteps(grid.grid.resolution());
+	walkPacket(grid.grid, packet, activeMask, maxSteps, hits);
+
+	for(int i = 0; i < RayPacket::SIZE; ++i)
+	{
+		if (activeMask & (1 << i))
+		{
+			Imath::V3i expectedPosition;
+			const TraversalResult expected = walk(grid.grid, rays.origin(i), rays.direction(i), rays.maxDistances[i], maxSteps, expectedPosition);
+			BOOST_CHECK_EQUAL(hits.result[i], expected);
+			BOOST_CHECK(Imath::V3i(hits.voxelX[i], hits.voxelY[i], hits.voxelZ[i]) == expectedPosition);
+		}
+		else
+		{
+			BOOST_CHECK_EQUAL(hits.voxelX[i], -12345);
+			BOOST_CHECK_EQUAL(hits.result[i], TRAVERSAL_STOPPED);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,163 @@
+#include "cpuRenderer/rayQuery.h"
+#include "cpuRenderer/workStealingPool.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+
+// A 10x10x10 grid with a single occupied voxel at (5,5,5), with material
+// offset 42.
+struct SingleVoxelScene
+{
+	SingleVoxelScene() :
+		resolution(10, 10, 10),
+		voxels((size_t)resolution.x * resolution.y * resolution.z, -1),
+		grid(&voxels[0], resolution),
+		pool(4)
+	{
+		voxels[grid.voxelIndex(Imath::V3i(5, 5, 5))] = 42;
+	}
+
+	// world space position of a point given in voxel space
+	Imath::V3f point(float x, float y, float z) const { return grid.voxelToWorld(Imath::V3f(x, y, z)); }
+
+	Imath::V3i resolution;
+	std::vector<GLint> voxels;
+	VoxelGrid grid;
+	WorkStealingPool pool;
+};
+
+// Rays as x,y,z triplets
+struct RayBatch
+{
+	void add(const Imath::V3f& origin, const Imath::V3f& direction, float maxDistance = 0)
+	{
+		for(int i = 0; i < 3; ++i)
+		{
+			origins.push_back(origin[i]);
+			directions.push_back(direction[i]);
+		}
+		maxDistances.push_back(maxDistance);
+	}
+	size_t size() const { return maxDistances.size(); }
+
+	std::vector<float> origins, directions, maxDistances;
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(RayQueryTest)
+
+BOOST_AUTO_TEST_CASE(Intersect)
+{
+	SingleVoxelScene scene;
+	const RayQuery query(scene.grid, scene.pool);
+	const float voxelSize = scene.grid.voxelSize();
+
+	RayBatch rays;
+	// from outside the volume, straight at the -Z face of the voxel
+	rays.add(scene.point(5.5f, 5.5f, -10), Imath::V3f(0, 0, 1));
+	// the same, with a direction which isn't normalized
+	rays.add(scene.point(5.5f, 5.5f, -10), Imath::V3f(0, 0, 7));
+	// from inside the volume, at the +X face
+	rays.add(scene.point(9.5f, 5.5f, 5.5f), Imath::V3f(-1, 0, 0));
+	// along the edge of the voxel, exactly on two of its face planes
+	rays.add(scene.point(5, 5, -3), Imath::V3f(0, 0, 1));
+	// missing the voxel, missing the volume, pointing away, no direction
+	rays.add(scene.point(2.5f, 5.5f, -10), Imath::V3f(0, 0, 1));
+	rays.add(scene.point(-5, -5, -5), Imath::V3f(0, 0, 1));
+	rays.add(scene.point(5.5f, 5.5f, -10), Imath::V3f(0, 0, -1));
+	rays.add(scene.point(5.5f, 5.5f, -10), Imath::V3f(0, 0, 0));
+
+	RayHits hits;
+	query.intersect(rays.size(), &rays.origins[0], &rays.directions[0], hits);
+	BOOST_REQUIRE_EQUAL(hits.size(), rays.size());
+
+	for(int i = 0; i < 2; ++i)
+	{
+		BOOST_CHECK(hits.voxel[i] == Imath::V3i(5, 5, 5));
+		BOOST_CHECK(hits.normal[i] == Imath::V3f(0, 0, -1));
+		BOOST_CHECK_CLOSE(hits.distance[i], 15 * voxelSize, 1e-3);
+		BOOST_CHECK_EQUAL(hits.materialOffset[i], 42);
+	}
+
+	BOOST_CHECK(hits.voxel[2] == Imath::V3i(5, 5, 5));
+	BOOST_CHECK(hits.normal[2] == Imath::V3f(1, 0, 0));
+	BOOST_CHECK_CLOSE(hits.distance[2], 3.5f * voxelSize, 1e-3);
+
+	BOOST_CHECK_EQUAL(hits.materialOffset[3], 42);
+	BOOST_CHECK_CLOSE(hits.distance[3], 8 * voxelSize, 1e-3);
+
+	for(size_t i = 4; i < rays.size(); ++i)
+	{
+		BOOST_CHECK_EQUAL(hits.distance[i], -1.0f);
+		BOOST_CHECK_EQUAL(hits.materialOffset[i], -1);
+		BOOST_CHECK(hits.voxel[i] == Imath::V3i(0));
+		BOOST_CHECK(hits.normal[i] == Imath::V3f(0));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(Occluded)
+{
+	SingleVoxelScene scene;
+	const RayQuery query(scene.grid, scene.pool);
+	const float voxelSize = scene.grid.voxelSize();
+
+	RayBatch rays;
+	// stopping short of the voxel, and past it
+	rays.add(scene.point(5.5f, 5.5f, -10), Imath::V3f(0, 0, 1), 14 * voxelSize);
+	rays.add(scene.point(5.5f, 5.5f, -10), Imath::V3f(0, 0, 1), 16 * voxelSize);
+	// between two points inside the volume, on either side of the voxel
+	rays.add(scene.point(5.5f, 5.5f, 1.5f), Imath::V3f(0, 0, 1), 7 * voxelSize);
+	// ending right on the voxel face
+	rays.add(scene.point(5.5f, 5.5f, 1), Imath::V3f(0, 0, 1), 4 * voxelSize);
+	// not reaching the volume
+	rays.add(scene.point(5.5f, 5.5f, -10), Imath::V3f(0, 0, 1), 5 * voxelSize);
+
+	std::vector<unsigned char> occluded;
+	query.occluded(rays.size(), &rays.origins[0], &rays.directions[0], &rays.maxDistances[0], occluded);
+	BOOST_REQUIRE_EQUAL(occluded.size(), rays.size());
+	BOOST_CHECK_EQUAL(occluded[0], 0);
+	BOOST_CHECK_EQUAL(occluded[1], 1);
+	BOOST_CHECK_EQUAL(occluded[2], 1);
+	BOOST_CHECK_EQUAL(occluded[3], 0);
+	BOOST_CHECK_EQUAL(occluded[4], 0);
+}
+
+BOOST_AUTO_TEST_CASE(ManyChunks)
+{
+	SingleVoxelScene scene;
+	const RayQuery query(scene.grid, scene.pool);
+
+	// several chunks' worth of rays, every other one hitting the voxel
+	const size_t numRays = RayQuery::CHUNK_SIZE * 3 + 123;
+	RayBatch rays;
+	for(size_t i = 0; i < numRays; ++i)
+	{
+		const float x = i % 2 ? 5.5f : 0.5f + (float)(i % 5); // columns 0 to 4 are empty
+		const float jitter = (float)(i % 97) / 97 * 0.5f + 0.25f;
+		rays.add(scene.point(x, 5 + jitter, -10), Imath::V3f(0, 0, 1), 1e6f);
+	}
+
+	RayHits coherent, incoherent;
+	query.intersect(rays.size(), &rays.origins[0], &rays.directions[0], coherent, RayQuery::RAYS_COHERENT);
+	query.intersect(rays.size(), &rays.origins[0], &rays.directions[0], incoherent, RayQuery::RAYS_INCOHERENT);
+	std::vector<unsigned char> occluded;
+	query.occluded(rays.size(), &rays.origins[0], &rays.directions[0], &rays.maxDistances[0], occluded, RayQuery::RAYS_INCOHERENT);
+
+	for(size_t i = 0; i < numRays; ++i)
+	{
+		const bool hit = i % 2 == 1;
+		BOOST_CHECK_EQUAL(coherent.materialOffset[i], hit ? 42 : -1);
+		BOOST_CHECK_EQUAL(incoherent.materialOffset[i], coherent.materialOffset[i]);
+		BOOST_CHECK_EQUAL(incoherent.distance[i], coherent.distance[i]);
+		BOOST_CHECK_EQUAL(occluded[i], hit ? 1 : 0);
+	}
+
+	// no rays at all
+	query.intersect(0, NULL, NULL, coherent);
+	BOOST_CHECK_EQUAL(coherent.size(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,164 @@
+#include <GL/glew.h>
+
+#include "shaders/shader.h"
+#include "temporaryDirectory.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <iterator>
+
+#define _STRINGIFY(x) #x
+#define STRINGIFY(x) _STRINGIFY(x)
+
+std::string readFile(const std::string& file)
+{
+	std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& file, const std::string& contents)
+{
+	std::ofstream out(file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	out.write(contents.data(), contents.size());
+}
+
+// The expansion as it used to be done, pasting each header in place and
+// searching the whole code again from the start. Headers including
+// themselves make it loop forever.
+bool includeHeadersReference(std::string& code, const std::string& includeBasePath)
+{
+	std::string::size_type s;
+	while((s = code.find("#include", 0)) != std::string::npos)
+	{
+		std::string::size_type includeEnd = code.find('\n', s);
+		if (includeEnd == std::string::npos) break;
+		const std::string includeDirective = code.substr(s, includeEnd - s);
+		code.erase(s, includeEnd - s);
+
+		std::string::size_type openBracket = includeDirective.find('<', 0);
+		std::string::size_type closeBracket = includeDirective.find('>', 0);
+		if (openBracket == std::string::npos || closeBracket == std::string::npos) return false;
+		const std::string headerFile = includeDirective.substr(openBracket + 1, closeBracket - openBracket - 1);
+
+		const std::string headerCode = readFile(includeBasePath + headerFile);
+		if (headerCode.empty()) return false;
+		code.insert(s, headerCode);
+	}
+	return true;
+}
+
+// Shader sources in the given directory and below it. The headers are there
+// too, alongside the C++ ones, but they are covered by the sources.
+void findShaders(const std::string& directory, std::vector<std::string>& files)
+{
+	DIR* dir = opendir(directory.c_str());
+	if (dir == NULL) return;
+	while (const dirent* file = readdir(dir))
+	{
+		const std::string name = file->d_name;
+		if (name == "." || name == "..") continue;
+		const std::string path = directory + "/" + name;
+		const std::string::size_type dot = name.rfind('.');
+		const std::string extension = dot != std::string::npos ? name.substr(dot) : "";
+		if (extension == ".vs" || extension == ".gs" || extension == ".fs" || extension == ".cs")
+		{
+			files.push_back(path);
+		}
+		else if (file->d_type == DT_DIR)
+		{
+			findShaders(path, files);
+		}
+	}
+	closedir(dir);
+}
+
+// Keeps the messages logged
+class TestLogger : public Logger
+{
+public:
+	virtual void operator()(const std::string& msg) { messages.push_back(msg); }
+	std::vector<std::string> messages;
+};
+
+BOOST_AUTO_TEST_SUITE(ShaderIncludeTest)
+
+BOOST_AUTO_TEST_CASE(MatchesPreviousExpansion)
+{
+	const std::string shaderDirectory(STRINGIFY(SHADER_DIR));
+	std::vector<std::string> files;
+	findShaders(shaderDirectory, files);
+	BOOST_REQUIRE(!files.empty());
+
+	size_t numIncluding = 0;
+	for(size_t i = 0; i < files.size(); ++i)
+	{
+		std::string code = readFile(files[i]);
+		if (code.find("#include") != std::string::npos) numIncluding++;
+		std::string expected = code;
+		BOOST_REQUIRE(includeHeadersReference(expected, shaderDirectory + "/"));
+
+		BOOST_CHECK_MESSAGE(includeHeaders(code, shaderDirectory + "/"), files[i]);
+		BOOST_CHECK_MESSAGE(code == expected, files[i]);
+	}
+	BOOST_CHECK(numIncluding > 0);
+}
+
+BOOST_AUTO_TEST_CASE(NestedIncludes)
+{
+	TemporaryDirectory directory;
+	const std::string base = directory.path() + "/";
+	writeFile(base + "a.h", "a0\n#include <b.h>\na1\n");
+	writeFile(base + "b.h", "b0\n#include <c.h>\n#include <c.h>\nb1\n");
+	writeFile(base + "c.h", "c\n");
+
+	std::string code = "#include <a.h>\nmain\n#include <c.h>\n";
+	std::string expected = code;
+	BOOST_REQUIRE(includeHeadersReference(expected, base));
+	BOOST_REQUIRE(includeHeaders(code, base));
+	BOOST_CHECK_EQUAL(code, "a0\nb0\nc\n\nc\n\nb1\n\na1\n\nmain\nc\n\n");
+	BOOST_CHECK_EQUAL(code, expected);
+
+	// nothing to include
+	code = "void main() {}\n";
+	BOOST_REQUIRE(includeHeaders(code, base));
+	BOOST_CHECK_EQUAL(code, "void main() {}\n");
+}
+
+BOOST_AUTO_TEST_CASE(SelfInclusionFails)
+{
+	TemporaryDirectory directory;
+	const std::string base = directory.path() + "/";
+	writeFile(base + "a.h", "#include <b.h>\n");
+	writeFile(base + "b.h", "#include <a.h>\n");
+
+	TestLogger logger;
+	std::string code = "#include <a.h>\n";
+	BOOST_CHECK(!includeHeaders(code, base, &logger));
+	BOOST_CHECK(!logger.messages.empty());
+}
+
+BOOST_AUTO_TEST_CASE(MalformedDirectives)
+{
+	TemporaryDirectory directory;
+	const std::string base = directory.path() + "/";
+	writeFile(base + "a.h", "a\n");
+
+	// quotes aren't supported
+	TestLogger logger;
+	std::string code = "#include \"a.h\"\n";
+	BOOST_CHECK(!includeHeaders(code, base, &logger));
+	BOOST_CHECK_EQUAL(logger.messages.size(), 1u);
+
+	// missing header
+	code = "#include <missing.h>\n";
+	BOOST_CHECK(!includeHeaders(code, base, &logger));
+	BOOST_CHECK_EQUAL(logger.messages.size(), 2u);
+
+	// a directive on the last line, with no line break, is left as it is
+	code = "#include <a.h>\n#include <a.h>";
+	BOOST_REQUIRE(includeHeaders(code, base));
+	BOOST_CHECK_EQUAL(code, "a\n\n#include <a.h>");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
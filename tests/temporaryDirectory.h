@@ -0,0 +1,69 @@
+#pragma once
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Directory created for the duration of a test, and removed along with its
+// files afterwards. It may be made the cache directory of the application
+// (see cacheDirectory), so tests never touch the user's cache.
+class TemporaryDirectory
+{
+public:
+	TemporaryDirectory()
+	{
+		char path[] = "/tmp/voxelToyTest.XXXXXX";
+		if (mkdtemp(path) != NULL) m_path = path;
+		m_cacheHome = false;
+	}
+
+	~TemporaryDirectory()
+	{
+		if (m_cacheHome)
+		{
+			if (m_previousCacheHome.empty()) unsetenv("XDG_CACHE_HOME");
+			else setenv("XDG_CACHE_HOME", m_previousCacheHome.c_str(), 1);
+		}
+		if (m_path.empty()) return;
+		removeContents(m_path);
+		rmdir(m_path.c_str());
+	}
+
+	const std::string& path() const { return m_path; }
+
+	// Point $XDG_CACHE_HOME here, until the directory is removed.
+	void makeCacheHome()
+	{
+		const char* previous = getenv("XDG_CACHE_HOME");
+		m_previousCacheHome = previous != NULL ? previous : "";
+		m_cacheHome = true;
+		setenv("XDG_CACHE_HOME", m_path.c_str(), 1);
+	}
+
+private:
+	// not copyable
+	TemporaryDirectory(const TemporaryDirectory&);
+	TemporaryDirectory& operator=(const TemporaryDirectory&);
+
+	static void removeContents(const std::string& directory)
+	{
+		DIR* dir = opendir(directory.c_str());
+		if (dir == NULL) return;
+		while (const dirent* file = readdir(dir))
+		{
+			const std::string name = file->d_name;
+			if (name == "." || name == "..") continue;
+			const std::string path = directory + "/" + name;
+			removeContents(path);
+			if (remove(path.c_str()) != 0) rmdir(path.c_str());
+		}
+		closedir(dir);
+	}
+
+	std::string m_path;
+	bool m_cacheHome;
+	std::string m_previousCacheHome;
+};
@@ -0,0 +1,132 @@
+#include "voxel/voxelMipmap.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+
+size_t voxelIndex(const Imath::V3i& resolution, int x, int y, int z)
+{
+	return ((size_t)z * resolution.y + y) * resolution.x + x;
+}
+
+// A 2x2x2 volume with the given children, in x, y, z order, and its single
+// voxel coarse level
+GLint downsampleChildren(const GLint children[8])
+{
+	const Imath::V3i resolution(2, 2, 2);
+	std::vector< std::vector<GLint> > levels;
+	VoxelMipmap::generate(children, resolution, 2, levels);
+	BOOST_REQUIRE_EQUAL(levels.size(), 2u);
+	BOOST_REQUIRE_EQUAL(levels[1].size(), 1u);
+	return levels[1][0];
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(VoxelMipmapTest)
+
+BOOST_AUTO_TEST_CASE(MajorityMaterial)
+{
+	// empty stays empty
+	const GLint empty[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+	BOOST_CHECK_EQUAL(downsampleChildren(empty), -1);
+
+	// a single occupied child is enough to occupy its parent, so thin
+	// features don't vanish
+	const GLint single[8] = { -1, -1, -1, -1, -1, -1, 32, -1 };
+	BOOST_CHECK_EQUAL(downsampleChildren(single), 32);
+
+	// the most frequent material wins, however many children are empty
+	const GLint majority[8] = { 16, 48, -1, 48, 16, -1, 48, -1 };
+	BOOST_CHECK_EQUAL(downsampleChildren(majority), 48);
+	const GLint full[8] = { 0, 16, 16, 0, 16, 0, 0, 0 };
+	BOOST_CHECK_EQUAL(downsampleChildren(full), 0);
+
+	// ties go to the first child found, x varying fastest
+	const GLint tie[8] = { -1, 64, 16, -1, 16, 64, -1, -1 };
+	BOOST_CHECK_EQUAL(downsampleChildren(tie), 64);
+	const GLint tieAllDifferent[8] = { -1, -1, -1, -1, 80, 16, 32, 48 };
+	BOOST_CHECK_EQUAL(downsampleChildren(tieAllDifferent), 80);
+}
+
+BOOST_AUTO_TEST_CASE(OddResolution)
+{
+	const Imath::V3i resolution(5, 3, 7);
+	const int numLevels = VoxelMipmap::numLevels(resolution);
+	BOOST_REQUIRE_EQUAL(numLevels, 3);
+
+	// padded to a multiple of 4, so each level halves the previous one exactly
+	BOOST_CHECK_EQUAL(VoxelMipmap::levelResolution(resolution, numLevels, 0), Imath::V3i(8, 4, 8));
+	BOOST_CHECK_EQUAL(VoxelMipmap::levelResolution(resolution, numLevels, 1), Imath::V3i(4, 2, 4));
+	BOOST_CHECK_EQUAL(VoxelMipmap::levelResolution(resolution, numLevels, 2), Imath::V3i(2, 1, 2));
+
+	// only the far corner is occupied
+	std::vector<GLint> voxels((size_t)resolution.x * resolution.y * resolution.z, -1);
+	voxels[voxelIndex(resolution, 4, 2, 6)] = 16;
+
+	std::vector< std::vector<GLint> > levels;
+	VoxelMipmap::generate(&voxels[0], resolution, numLevels, levels);
+	BOOST_REQUIRE_EQUAL(levels.size(), 3u);
+
+	// the first level is the input data, with empty padding
+	const Imath::V3i padded(8, 4, 8);
+	BOOST_REQUIRE_EQUAL(levels[0].size(), 8u * 4 * 8);
+	for(int z = 0; z < padded.z; ++z)
+	{
+		for(int y = 0; y < padded.y; ++y)
+		{
+			for(int x = 0; x < padded.x; ++x)
+			{
+				const bool inside = x < resolution.x && y < resolution.y && z < resolution.z;
+				const GLint expected = inside ? voxels[voxelIndex(resolution, x, y, z)] : -1;
+				BOOST_CHECK_EQUAL(levels[0][voxelIndex(padded, x, y, z)], expected);
+			}
+		}
+	}
+
+	// the corner voxel is carried all the way up, and nothing else
+	BOOST_REQUIRE_EQUAL(levels[1].size(), 4u * 2 * 4);
+	BOOST_REQUIRE_EQUAL(levels[2].size(), 2u * 1 * 2);
+	for(size_t i = 0; i < levels[1].size(); ++i)
+	{
+		BOOST_CHECK_EQUAL(levels[1][i], i == voxelIndex(Imath::V3i(4, 2, 4), 2, 1, 3) ? 16 : -1);
+	}
+	for(size_t i = 0; i < levels[2].size(); ++i)
+	{
+		BOOST_CHECK_EQUAL(levels[2][i], i == voxelIndex(Imath::V3i(2, 1, 2), 1, 0, 1) ? 16 : -1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(LevelCount)
+{
+	// levels stop once a single voxel covers the largest dimension
+	BOOST_CHECK_EQUAL(VoxelMipmap::numLevels(Imath::V3i(1, 1, 1)), 1);
+	BOOST_CHECK_EQUAL(VoxelMipmap::numLevels(Imath::V3i(2, 1, 1)), 1);
+	BOOST_CHECK_EQUAL(VoxelMipmap::numLevels(Imath::V3i(3, 1, 1)), 2);
+	BOOST_CHECK_EQUAL(VoxelMipmap::numLevels(Imath::V3i(1, 8, 1)), 3);
+	BOOST_CHECK_EQUAL(VoxelMipmap::numLevels(Imath::V3i(1, 1, 9)), 4);
+
+	// and never go past the maximum
+	const int maxLevels = VoxelMipmap::MAX_LEVELS;
+	BOOST_CHECK_EQUAL(VoxelMipmap::numLevels(Imath::V3i(4096, 16, 16)), maxLevels);
+	BOOST_CHECK_EQUAL(VoxelMipmap::numLevels(Imath::V3i(4096, 16, 16), 2), 2);
+	BOOST_CHECK_EQUAL(VoxelMipmap::numLevels(Imath::V3i(4096, 16, 16), 1), 1);
+
+	// padding depends on the number of levels, not the maximum
+	const Imath::V3i resolution(100, 3, 17);
+	const int numLevels = VoxelMipmap::numLevels(resolution);
+	BOOST_REQUIRE_EQUAL(numLevels, maxLevels);
+	BOOST_CHECK_EQUAL(VoxelMipmap::levelResolution(resolution, numLevels, 0), Imath::V3i(112, 16, 32));
+	BOOST_CHECK_EQUAL(VoxelMipmap::levelResolution(resolution, numLevels, numLevels - 1), Imath::V3i(7, 1, 2));
+
+	std::vector<GLint> voxels((size_t)resolution.x * resolution.y * resolution.z, 0);
+	std::vector< std::vector<GLint> > levels;
+	VoxelMipmap::generate(&voxels[0], resolution, numLevels, levels);
+	BOOST_REQUIRE_EQUAL(levels.size(), (size_t)maxLevels);
+	BOOST_CHECK_EQUAL(levels.back().size(), 7u * 1 * 2);
+	// every coarsest voxel covers some of the (fully occupied) volume
+	for(size_t i = 0; i < levels.back().size(); ++i) BOOST_CHECK_EQUAL(levels.back()[i], 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+#include "voxel/voxelSurface.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+
+// Random voxel data, with the given fraction of occupied voxels
+std::vector<GLint> randomVoxels(const Imath::V3i& resolution, float occupancy)
+{
+	std::vector<GLint> voxels((size_t)resolution.x * resolution.y * resolution.z);
+	for(size_t i = 0; i < voxels.size(); ++i)
+	{
+		voxels[i] = (float)rand() / RAND_MAX < occupancy ? (GLint)(i % 7) * 16 : -1;
+	}
+	return voxels;
+}
+
+// Exposed faces of a voxel, checking each of its neighbours in turn
+int referenceFaceMask(const std::vector<GLint>& voxels, const Imath::V3i& resolution, const Imath::V3i& v)
+{
+	const Imath::V3i neighbours[6] =
+	{
+		Imath::V3i(1, 0, 0), Imath::V3i(-1, 0, 0),
+		Imath::V3i(0, 1, 0), Imath::V3i(0, -1, 0),
+		Imath::V3i(0, 0, 1), Imath::V3i(0, 0, -1),
+	};
+	const size_t index = ((size_t)v.z * resolution.y + v.y) * resolution.x + v.x;
+	if (voxels[index] < 0) return 0;
+
+	int mask = 0;
+	for(int face = 0; face < 6; ++face)
+	{
+		const Imath::V3i n = v + neighbours[face];
+		const bool outside = n.x < 0 || n.y < 0 || n.z < 0 || 
+							 n.x >= resolution.x || n.y >= resolution.y || n.z >= resolution.z;
+		if (outside || voxels[((size_t)n.z * resolution.y + n.y) * resolution.x + n.x] < 0) mask |= 1 << face;
+	}
+	return mask;
+}
+
+void checkSurface(const Imath::V3i& resolution, float occupancy)
+{
+	const std::vector<GLint> voxels = randomVoxels(resolution, occupancy);
+	const VoxelSurface surface(&voxels[0], resolution);
+
+	std::vector<GLint> expectedIndices;
+	for(int z = 0; z < resolution.z; ++z)
+	{
+		for(int y = 0; y < resolution.y; ++y)
+		{
+			for(int x = 0; x < resolution.x; ++x)
+			{
+				const GLint index = (GLint)(((size_t)z * resolution.y + y) * resolution.x + x);
+				const int expected = referenceFaceMask(voxels, resolution, Imath::V3i(x, y, z));
+				BOOST_CHECK_EQUAL(surface.faceMask(index), expected);
+				if (expected != 0) expectedIndices.push_back(index);
+			}
+		}
+	}
+
+	std::vector<GLint> indices;
+	std::vector<unsigned char> faceMasks;
+	surface.surfaceVoxels(indices, faceMasks);
+	BOOST_REQUIRE_EQUAL(indices.size(), expectedIndices.size());
+	BOOST_REQUIRE_EQUAL(faceMasks.size(), expectedIndices.size());
+	for(size_t i = 0; i < indices.size(); ++i)
+	{
+		BOOST_CHECK_EQUAL(indices[i], expectedIndices[i]);
+		BOOST_CHECK_EQUAL((int)faceMasks[i], surface.faceMask(indices[i]));
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(VoxelSurfaceTest)
+
+BOOST_AUTO_TEST_CASE(MatchesNeighbourChecks)
+{
+	srand(1);
+	// rows shorter than, as long as, and straddling 64-bit words
+	checkSurface(Imath::V3i(13, 7, 5), 0.5f);
+	checkSurface(Imath::V3i(64, 4, 3), 0.7f);
+	checkSurface(Imath::V3i(130, 6, 9), 0.6f);
+	checkSurface(Imath::V3i(1, 1, 1), 1.0f);
+}
+
+BOOST_AUTO_TEST_CASE(SolidBlock)
+{
+	// only the voxels on the sides of a full grid are exposed
+	const Imath::V3i resolution(70, 5, 4);
+	const std::vector<GLint> voxels((size_t)resolution.x * resolution.y * resolution.z, 0);
+	const VoxelSurface surface(&voxels[0], resolution);
+
+	std::vector<GLint> indices;
+	std::vector<unsigned char> faceMasks;
+	surface.surfaceVoxels(indices, faceMasks);
+	const size_t interior = (size_t)(resolution.x - 2) * (resolution.y - 2) * (resolution.z - 2);
+	BOOST_CHECK_EQUAL(indices.size(), voxels.size() - interior);
+
+	// a corner voxel
+	BOOST_CHECK_EQUAL(surface.faceMask(0), VoxelSurface::FACE_NEGATIVE_X | 
+										   VoxelSurface::FACE_NEGATIVE_Y | 
+										   VoxelSurface::FACE_NEGATIVE_Z);
+	// an interior one
+	BOOST_CHECK_EQUAL(surface.faceMask((2 * resolution.y + 2) * resolution.x + 35), 0);
+}
+
+BOOST_AUTO_TEST_CASE(Empty)
+{
+	const Imath::V3i resolution(65, 3, 3);
+	const std::vector<GLint> voxels((size_t)resolution.x * resolution.y * resolution.z, -1);
+	const VoxelSurface surface(&voxels[0], resolution);
+
+	std::vector<GLint> indices;
+	std::vector<unsigned char> faceMasks;
+	surface.surfaceVoxels(indices, faceMasks);
+	BOOST_CHECK(indices.empty());
+	BOOST_CHECK(faceMasks.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,113 @@
+#include "cpuRenderer/workStealingPool.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+// Counts how many times each task runs, and which thread runs it
+struct TaskLog
+{
+	explicit TaskLog(size_t numTasks) : runs(numTasks, 0), threads(numTasks) {}
+
+	void run(size_t task, int sleepMilliseconds)
+	{
+		if (sleepMilliseconds > 0) boost::this_thread::sleep(boost::posix_time::milliseconds(sleepMilliseconds));
+		boost::lock_guard<boost::mutex> lock(mutex);
+		runs[task]++;
+		threads[task] = boost::this_thread::get_id();
+	}
+
+	boost::mutex mutex;
+	std::vector<int> runs;
+	std::vector<boost::thread::id> threads;
+};
+
+std::vector<WorkStealingPool::Task> makeTasks(TaskLog& log, size_t numTasks, int firstTaskSleepMilliseconds = 0)
+{
+	std::vector<WorkStealingPool::Task> tasks;
+	for(size_t i = 0; i < numTasks; ++i)
+	{
+		tasks.push_back(boost::bind(&TaskLog::run, &log, i, i == 0 ? firstTaskSleepMilliseconds : 0));
+	}
+	return tasks;
+}
+
+void runBatch(WorkStealingPool* pool, const std::vector<WorkStealingPool::Task>* tasks)
+{
+	pool->run(*tasks);
+}
+
+BOOST_AUTO_TEST_SUITE(WorkStealingPoolTest)
+
+BOOST_AUTO_TEST_CASE(EveryTaskRunsOnce)
+{
+	WorkStealingPool pool(4);
+	BOOST_CHECK_EQUAL(pool.numThreads(), 4);
+
+	// fewer tasks than threads, and several batches on the same threads
+	const size_t batchSizes[] = { 1, 3, 4, 1000, 37 };
+	for(size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); ++b)
+	{
+		TaskLog log(batchSizes[b]);
+		pool.run(makeTasks(log, batchSizes[b]));
+		for(size_t i = 0; i < batchSizes[b]; ++i) BOOST_CHECK_EQUAL(log.runs[i], 1);
+	}
+
+	// an empty batch returns straight away
+	pool.run(std::vector<WorkStealingPool::Task>());
+}
+
+BOOST_AUTO_TEST_CASE(IdleWorkersSteal)
+{
+	WorkStealingPool pool(4);
+
+	// the first task, at the front of the calling thread's block, is much
+	// slower than the rest: the other workers take over the rest of its block
+	const size_t numTasks = 400;
+	TaskLog log(numTasks);
+	pool.run(makeTasks(log, numTasks, 200));
+
+	for(size_t i = 0; i < numTasks; ++i) BOOST_CHECK_EQUAL(log.runs[i], 1);
+	BOOST_CHECK(pool.numSteals() > 0);
+	size_t stolenFromFirstBlock = 0;
+	for(size_t i = 1; i < numTasks / 4; ++i)
+	{
+		if (log.threads[i] != log.threads[0]) stolenFromFirstBlock++;
+	}
+	BOOST_CHECK(stolenFromFirstBlock > 0);
+}
+
+BOOST_AUTO_TEST_CASE(SingleThread)
+{
+	WorkStealingPool pool(1);
+	const size_t numTasks = 50;
+	TaskLog log(numTasks);
+	pool.run(makeTasks(log, numTasks));
+	for(size_t i = 0; i < numTasks; ++i)
+	{
+		BOOST_CHECK_EQUAL(log.runs[i], 1);
+		BOOST_CHECK(log.threads[i] == boost::this_thread::get_id());
+	}
+	BOOST_CHECK_EQUAL(pool.numSteals(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentCallersTakeTurns)
+{
+	WorkStealingPool pool(4);
+	const size_t numTasks = 500;
+	TaskLog logA(numTasks), logB(numTasks);
+	const std::vector<WorkStealingPool::Task> tasksA = makeTasks(logA, numTasks, 20);
+	const std::vector<WorkStealingPool::Task> tasksB = makeTasks(logB, numTasks, 20);
+
+	boost::thread callerA(boost::bind(&runBatch, &pool, &tasksA));
+	boost::thread callerB(boost::bind(&runBatch, &pool, &tasksB));
+	callerA.join();
+	callerB.join();
+
+	for(size_t i = 0; i < numTasks; ++i)
+	{
+		BOOST_CHECK_EQUAL(logA.runs[i], 1);
+		BOOST_CHECK_EQUAL(logB.runs[i], 1);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()